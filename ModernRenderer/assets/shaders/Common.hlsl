@@ -24,6 +24,8 @@ cbuffer CameraData : register(b0, space0)
     uint cameraInstanceFrustumCullingDisabled;
     uint cameraMeshletFrustumCullingDisabled;
     uint cameraMeshletBackfaceCullingDisabled;
+    uint cameraMeshletSmallFeatureCullingDisabled;
+    float cameraSmallFeatureCullingPixelThreshold;
 };
 
 cbuffer DrawData : register(b1, space0)
@@ -139,6 +141,13 @@ float3 TransformObjectToWorld(float3 positionOS, float4x4 objectToWorld)
     return mul(float4(positionOS, 1.0), objectToWorld).xyz;
 }
 
+// Returns the largest scale factor of the object to world transform, used to scale bounding spheres
+float GetMaxScale(float4x4 objectToWorld)
+{
+    float3x3 m = (float3x3)objectToWorld;
+    return sqrt(max(dot(m[0], m[0]), max(dot(m[1], m[1]), dot(m[2], m[2]))));
+}
+
 float3 TransformObjectToWorldNormal(float3 normalOS, float4x4 objectToWorld)
 {
     float3 normalWS = mul(normalOS, (float3x3)objectToWorld);
@@ -250,3 +259,43 @@ void DecodeVisibility(uint visibility, out uint visibleMeshetID, out uint triang
     visibleMeshetID = visibility & 0x1FFFFFF;
     triangleID = visibility >> 25;
 }
+
+// 64 bit visibility: x is the visible meshlet index, y packs 24 bit instance index and 8 bit triangle index
+// Keep in sync with VisibilityBuffer.hpp
+uint2 EncodeVisibility64(uint instanceID, uint visibleMeshetID, uint triangleID)
+{
+    return uint2(visibleMeshetID, ((instanceID & 0xFFFFFF) << 8) | (triangleID & 0xFF));
+}
+
+void DecodeVisibility64(uint2 visibility, out uint instanceID, out uint visibleMeshetID, out uint triangleID)
+{
+    visibleMeshetID = visibility.x;
+    instanceID = visibility.y >> 8;
+    triangleID = visibility.y & 0xFF;
+}
+
+// The visibility format is selected when the pipeline is created with the VISIBILITY_BUFFER_64BIT define
+#ifdef VISIBILITY_BUFFER_64BIT
+#define VisibilityData uint2
+#else
+#define VisibilityData uint
+#endif
+
+VisibilityData EncodeVisibilityData(uint instanceID, uint visibleMeshetID, uint triangleID)
+{
+#ifdef VISIBILITY_BUFFER_64BIT
+    return EncodeVisibility64(instanceID, visibleMeshetID, triangleID);
+#else
+    return EncodeVisibility(visibleMeshetID, triangleID);
+#endif
+}
+
+void DecodeVisibilityData(VisibilityData visibility, out uint visibleMeshetID, out uint triangleID)
+{
+#ifdef VISIBILITY_BUFFER_64BIT
+    uint instanceID;
+    DecodeVisibility64(visibility, instanceID, visibleMeshetID, triangleID);
+#else
+    DecodeVisibility(visibility, visibleMeshetID, triangleID);
+#endif
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// Counters shared by the instance and meshlet culling passes
+// Keep in sync with CullingCounter in CullingStatistics.hpp
+#define CULLING_COUNTER_MESHLETS_AFTER_INSTANCE_CULLING 0
+#define CULLING_COUNTER_VISIBLE_INSTANCES 1
+#define CULLING_COUNTER_TESTED_INSTANCES 2
+#define CULLING_COUNTER_MESHLETS_AFTER_CONE_CULLING 3
+#define CULLING_COUNTER_MESHLETS_AFTER_FRUSTUM_CULLING 4
+#define CULLING_COUNTER_TRIANGLES 5
+#define CULLING_COUNTER_VISIBLE_MESHLETS 15
+
+RWBuffer<uint> _VisibleMeshletsCount : register(u3, space0);
+
+// Aggregate the value over the wave to issue a single atomic per wave
+void IncrementCullingCounter(uint counter, uint value)
+{
+    uint total = WaveActiveSum(value);
+    if (WaveIsFirstLane() && total > 0)
+        InterlockedAdd(_VisibleMeshletsCount[counter], total);
+}
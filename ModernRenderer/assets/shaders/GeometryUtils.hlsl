@@ -143,6 +143,31 @@ float SphereFrustumIntersection(Frustum frustum, float3 center, float radius)
     return min(min(dist01, dist23), dist45) + radius;
 }
 
+// Computes the NDC bounds (minX, minY, maxX, maxY) of a view space sphere projected by a perspective camera.
+// Returns false when the sphere intersects the near plane, in which case the bounds can't be computed.
+// 2D Polyhedral Bounds of a Clipped, Perspective-Projected 3D Sphere. Michael Mara, Morgan McGuire. 2013
+// Keep in sync with MatrixUtils::ProjectSphere
+bool ProjectSphere(float3 centerVS, float radius, float nearPlane, float p00, float p11, out float4 boundsNDC)
+{
+    boundsNDC = 0;
+    if (centerVS.z < radius + nearPlane)
+        return false;
+
+    float3 cr = centerVS * radius;
+    float czr2 = centerVS.z * centerVS.z - radius * radius;
+
+    float vx = sqrt(centerVS.x * centerVS.x + czr2);
+    float minX = (vx * centerVS.x - cr.z) / (vx * centerVS.z + cr.x);
+    float maxX = (vx * centerVS.x + cr.z) / (vx * centerVS.z - cr.x);
+
+    float vy = sqrt(centerVS.y * centerVS.y + czr2);
+    float minY = (vy * centerVS.y - cr.z) / (vy * centerVS.z + cr.y);
+    float maxY = (vy * centerVS.y + cr.z) / (vy * centerVS.z - cr.y);
+
+    boundsNDC = float4(minX * p00, minY * p11, maxX * p00, maxY * p11);
+    return true;
+}
+
 bool CheckOverlap(OBB obb, float3 planeNormal, float planeDistance)
 {
     // Max projection of the half-diagonal onto the normal (always positive).
@@ -1,6 +1,7 @@
 #include "Common.hlsl"
 #include "MeshUtils.hlsl"
 #include "GeometryUtils.hlsl"
+#include "CullingUtils.hlsl"
 
 // Custom indirect struct to dispatch mesh shader with the instance ID patched as CBuffer
 struct IndirectExecuteMesh
@@ -13,12 +14,13 @@ struct IndirectExecuteMesh
 
 RWBuffer<uint> _IndirectCommandCounts : register(u1, space0);
 RWStructuredBuffer<IndirectExecuteMesh> _IndirectMeshArgs : register(u2, space0);
-RWBuffer<uint> _VisibleMeshletsCount : register(u3, space0);
 
 [numthreads(1, 1, 1)]
 void clear(uint3 threadID : SV_DispatchThreadID)
 {
-    _VisibleMeshletsCount[0] = 0;
+    _VisibleMeshletsCount[CULLING_COUNTER_MESHLETS_AFTER_INSTANCE_CULLING] = 0;
+    _VisibleMeshletsCount[CULLING_COUNTER_VISIBLE_INSTANCES] = 0;
+    _VisibleMeshletsCount[CULLING_COUNTER_TESTED_INSTANCES] = 0;
 }
 
 [numthreads(64, 1, 1)]
@@ -27,21 +29,29 @@ void main(uint threadID : SV_DispatchThreadID)
     uint instanceCout, stride;
     instanceData.GetDimensions(instanceCout, stride);
     
-    if (threadID < instanceCout)
+    bool tested = threadID < instanceCout;
+    bool visible = false;
+
+    if (tested)
     {
         InstanceData instance = LoadInstance(threadID, true);
         
         // Frustum culling against the object OBB
-        if (FrustumOBBIntersection(instance.obb, cameraCullingFrustum) || cameraInstanceFrustumCullingDisabled)
+        visible = FrustumOBBIntersection(instance.obb, cameraCullingFrustum) || cameraInstanceFrustumCullingDisabled;
+        if (visible)
         {
             // TODO: wave interlock with surviving instances in the wavefront
             //uint argumentIndex = _IndirectCommandCounts[0];
             
             uint outStartIndex;
-            InterlockedAdd(_VisibleMeshletsCount[0], instance.meshletCount, outStartIndex);
+            InterlockedAdd(_VisibleMeshletsCount[CULLING_COUNTER_MESHLETS_AFTER_INSTANCE_CULLING], instance.meshletCount, outStartIndex);
             
+            // The list is sized for every meshlet of the scene unless it exceeds the largest buffer, see Scene::UploadInstancesToGPU
+            uint capacity, stride;
+            visibleMeshlets0.GetDimensions(capacity, stride);
+            uint writeCount = outStartIndex < capacity ? min(instance.meshletCount, capacity - outStartIndex) : 0;
             
-            for (uint i = 0; i < instance.meshletCount; i++)
+            for (uint i = 0; i < writeCount; i++)
             {
                 VisibleMeshlet v;
                 
@@ -54,13 +64,18 @@ void main(uint threadID : SV_DispatchThreadID)
             //InterlockedCompareExchange(_IndirectCommandCounts[0], 0, 0);
         }
     }
+
+    IncrementCullingCounter(CULLING_COUNTER_TESTED_INSTANCES, tested ? 1 : 0);
+    IncrementCullingCounter(CULLING_COUNTER_VISIBLE_INSTANCES, visible ? 1 : 0);
 }
 
 [numthreads(1, 1, 1)]
 void updateIndirectArguments()
 {
     // TODO: support multiple commands
-    uint groupCount = ceil(_VisibleMeshletsCount[0] / 64.0);
+    uint capacity, stride;
+    visibleMeshlets0.GetDimensions(capacity, stride);
+    uint groupCount = ceil(min(_VisibleMeshletsCount[CULLING_COUNTER_MESHLETS_AFTER_INSTANCE_CULLING], capacity) / 64.0);
 
     IndirectExecuteMesh args;
 
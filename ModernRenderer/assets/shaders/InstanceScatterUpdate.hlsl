@@ -0,0 +1,17 @@
+#include "Common.hlsl"
+
+// Instances moved on the CPU since the previous frame, see InstanceUpdater.hpp
+// Keep the thread group size in sync with InstanceUpdater::threadGroupSize
+StructuredBuffer<InstanceData> _InstanceUpdates : register(t0, space0);
+// The first element is the number of updates, followed by the destination index of each update
+Buffer<uint> _InstanceUpdateIndices : register(t1, space0);
+RWStructuredBuffer<InstanceData> _Instances : register(u0, space0);
+
+[numthreads(64, 1, 1)]
+void main(uint threadID : SV_DispatchThreadID)
+{
+    if (threadID >= _InstanceUpdateIndices[0])
+        return;
+
+    _Instances[_InstanceUpdateIndices[threadID + 1]] = _InstanceUpdates[threadID];
+}
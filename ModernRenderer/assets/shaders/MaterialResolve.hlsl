@@ -0,0 +1,138 @@
+#include "Common.hlsl"
+#include "MeshUtils.hlsl"
+#include "VisibilityUtils.hlsl"
+
+// Pixels are classified in tiles of 8x8, each tile is appended to the list of every material it contains.
+// The resolve is then dispatched once per material over its tile list so that all the threads of a group run the same material.
+// Keep in sync with MaterialClassification.hpp
+#define MATERIAL_TILE_SIZE 8
+#define MAX_MATERIALS_PER_TILE (MATERIAL_TILE_SIZE * MATERIAL_TILE_SIZE)
+#define INVALID_MATERIAL 0xFFFFFFFF
+
+// Custom indirect struct to dispatch the resolve with the material index patched as CBuffer (instanceOffset)
+struct IndirectExecuteResolve
+{
+    uint materialIndex;
+    uint threadGroupX;
+    uint threadGroupY;
+    uint threadGroupZ;
+};
+
+Texture2D<float> _DepthTexture : register(t2, space2);
+RWTexture2D<float4> _OutputColor : register(u0, space0);
+RWBuffer<uint> _MaterialTileCounts : register(u1, space0);
+// Tile lists of all materials, each material has room for every tile of the screen
+RWBuffer<uint> _MaterialTiles : register(u2, space0);
+RWStructuredBuffer<IndirectExecuteResolve> _IndirectResolveArgs : register(u3, space0);
+
+groupshared uint tileMaterials[MAX_MATERIALS_PER_TILE];
+
+uint GetMaterialCount()
+{
+    uint materialCount, stride;
+    materialBuffer.GetDimensions(materialCount, stride);
+    return materialCount;
+}
+
+uint2 GetTileCount()
+{
+    return (uint2(cameraResolution.xy) + MATERIAL_TILE_SIZE - 1) / MATERIAL_TILE_SIZE;
+}
+
+uint PackTile(uint2 tile)
+{
+    return tile.x | (tile.y << 16);
+}
+
+uint2 UnpackTile(uint packedTile)
+{
+    return uint2(packedTile & 0xFFFF, packedTile >> 16);
+}
+
+// Returns INVALID_MATERIAL for pixels outside of the screen or not covered by any geometry
+uint LoadPixelMaterial(uint2 pixel)
+{
+    if (any(pixel >= uint2(cameraResolution.xy)) || _DepthTexture.Load(uint3(pixel, 0)) >= 1.0)
+        return INVALID_MATERIAL;
+
+    return GetVisibilityMaterialIndex(_VisibilityTexture.Load(uint3(pixel, 0)));
+}
+
+[numthreads(64, 1, 1)]
+void clear(uint threadID : SV_DispatchThreadID)
+{
+    if (threadID < GetMaterialCount())
+        _MaterialTileCounts[threadID] = 0;
+}
+
+[numthreads(MATERIAL_TILE_SIZE, MATERIAL_TILE_SIZE, 1)]
+void classify(uint2 tile : SV_GroupID, uint2 pixel : SV_DispatchThreadID, uint threadIndex : SV_GroupIndex)
+{
+    tileMaterials[threadIndex] = INVALID_MATERIAL;
+    GroupMemoryBarrierWithGroupSync();
+
+    uint material = LoadPixelMaterial(pixel);
+
+    // Remove duplicates inside the wave first to reduce the number of groupshared atomics
+    bool pending = material != INVALID_MATERIAL;
+    while (pending)
+    {
+        uint current = WaveReadLaneFirst(material);
+        if (current == material)
+        {
+            pending = false;
+
+            if (WaveIsFirstLane())
+            {
+                // Insert the material in the groupshared set, a tile can't contain more materials than pixels
+                for (uint i = 0; i < MAX_MATERIALS_PER_TILE; i++)
+                {
+                    uint original;
+                    InterlockedCompareExchange(tileMaterials[i], INVALID_MATERIAL, current, original);
+                    if (original == INVALID_MATERIAL || original == current)
+                        break;
+                }
+            }
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    uint tileMaterial = tileMaterials[threadIndex];
+    if (tileMaterial != INVALID_MATERIAL)
+    {
+        uint2 tileCount = GetTileCount();
+        uint writeIndex;
+        InterlockedAdd(_MaterialTileCounts[tileMaterial], 1, writeIndex);
+        _MaterialTiles[tileMaterial * tileCount.x * tileCount.y + writeIndex] = PackTile(tile);
+    }
+}
+
+[numthreads(64, 1, 1)]
+void updateIndirectArguments(uint threadID : SV_DispatchThreadID)
+{
+    if (threadID >= GetMaterialCount())
+        return;
+
+    IndirectExecuteResolve args;
+    args.materialIndex = threadID;
+    args.threadGroupX = _MaterialTileCounts[threadID];
+    args.threadGroupY = 1;
+    args.threadGroupZ = 1;
+    _IndirectResolveArgs[threadID] = args;
+}
+
+[numthreads(MATERIAL_TILE_SIZE, MATERIAL_TILE_SIZE, 1)]
+void resolve(uint tileIndex : SV_GroupID, uint2 threadID : SV_GroupThreadID)
+{
+    uint materialIndex = instanceOffset;
+    uint2 tileCount = GetTileCount();
+    uint2 tile = UnpackTile(_MaterialTiles[materialIndex * tileCount.x * tileCount.y + tileIndex]);
+    uint2 pixel = tile * MATERIAL_TILE_SIZE + threadID;
+
+    // Other materials of the tile are shaded by their own dispatch
+    if (LoadPixelMaterial(pixel) != materialIndex)
+        return;
+
+    _OutputColor[pixel] = ShadeVisibility(pixel + 0.5, _VisibilityTexture.Load(uint3(pixel, 0)));
+}
@@ -1,6 +1,7 @@
 #include "Common.hlsl"
 #include "MeshUtils.hlsl"
 #include "GeometryUtils.hlsl"
+#include "CullingUtils.hlsl"
 
 // Custom indirect struct to dispatch mesh shader with the instance ID patched as CBuffer
 struct IndirectExecuteMesh
@@ -13,22 +14,50 @@ struct IndirectExecuteMesh
 
 RWBuffer<uint> _IndirectCommandCounts : register(u1, space0);
 RWStructuredBuffer<IndirectExecuteMesh> _IndirectMeshArgs : register(u2, space0);
-RWBuffer<uint> _VisibleMeshletsCount : register(u3, space0);
 
-#define VISIBLE_MESHLET_COUNT_KEY 15
+// Project the bounding sphere of the meshlet on screen and compare its size with the pixel threshold.
+// The screen size is evaluated from the rendering camera, freezing the culling only affects the frustum tests.
+bool IsSmallFeature(uint meshletIndex, InstanceData instance)
+{
+    Bounds bounds = meshletBounds[meshletIndex];
+    float3 centerRWS = TransformObjectToWorld(bounds.center, instance.objectToWorld) - cameraPosition.xyz;
+    float radius = bounds.radius * GetMaxScale(instance.objectToWorld);
+
+    // The projection matrix doesn't have off-center terms so the view space position can be recovered from clip space
+    float4 centerCS = TransformCameraRelativeWorldToHClip(centerRWS);
+    float p00 = projectionMatrix[0][0];
+    float p11 = projectionMatrix[1][1];
+    float3 centerVS = float3(centerCS.x / p00, centerCS.y / p11, centerCS.w);
+
+    float4 boundsNDC;
+    if (!ProjectSphere(centerVS, radius, cameraNearPlane, p00, p11, boundsNDC))
+        return false;
+
+    float2 sizeInPixels = (boundsNDC.zw - boundsNDC.xy) * 0.5 * cameraResolution.xy;
+    return max(sizeInPixels.x, sizeInPixels.y) < cameraSmallFeatureCullingPixelThreshold;
+}
 
 [numthreads(1, 1, 1)]
 void clear()
 {
-    _VisibleMeshletsCount[VISIBLE_MESHLET_COUNT_KEY] = 0;
+    _VisibleMeshletsCount[CULLING_COUNTER_VISIBLE_MESHLETS] = 0;
+    _VisibleMeshletsCount[CULLING_COUNTER_MESHLETS_AFTER_CONE_CULLING] = 0;
+    _VisibleMeshletsCount[CULLING_COUNTER_MESHLETS_AFTER_FRUSTUM_CULLING] = 0;
+    _VisibleMeshletsCount[CULLING_COUNTER_TRIANGLES] = 0;
 }
 
 [numthreads(64, 1, 1)]
 void main(uint threadID : SV_DispatchThreadID)
 {
     uint visibleMeshletIndex = threadID; // TODO: support over max 65k meshlets on screen
+    bool passedConeCulling = false;
+    bool passedFrustumCulling = false;
+    uint emittedTriangles = 0;
     
-    if (visibleMeshletIndex < _VisibleMeshletsCount[0])
+    uint inputCapacity, inputStride;
+    visibleMeshlets0.GetDimensions(inputCapacity, inputStride);
+    
+    if (visibleMeshletIndex < min(_VisibleMeshletsCount[CULLING_COUNTER_MESHLETS_AFTER_INSTANCE_CULLING], inputCapacity))
     {
         VisibleMeshlet visibleMeshlet = visibleMeshlets0[visibleMeshletIndex];
     
@@ -45,27 +74,45 @@ void main(uint threadID : SV_DispatchThreadID)
         if (!cameraMeshletBackfaceCullingDisabled)
             if (dot(normalize(bounds.coneApex - cameraCullingPosition.xyz), bounds.coneAxis) >= bounds.coneCutoff)
                 visible = false;
+        passedConeCulling = visible;
 
         // Perform frustum culling on the meshlet
         if (!cameraMeshletFrustumCullingDisabled)
             if (visible && SphereFrustumIntersection(cameraCullingFrustum, bounds.center, bounds.radius) <= 0)
                 visible = false;
+        passedFrustumCulling = visible;
+
+        // Perform small feature culling, meshlets smaller than the threshold on screen are not rasterized
+        if (!cameraMeshletSmallFeatureCullingDisabled && !orthographicCamera)
+            if (visible && IsSmallFeature(visibleMeshlet.meshletIndex, instance))
+                visible = false;
     
         if (visible)
         {
             // TODO: wave compaction
             uint writeIndex;
             // TODO: support over max 65k meshlets on screen
-            InterlockedAdd(_VisibleMeshletsCount[VISIBLE_MESHLET_COUNT_KEY], 1, writeIndex);
-            visibleMeshlets1[writeIndex] = visibleMeshlet;
+            InterlockedAdd(_VisibleMeshletsCount[CULLING_COUNTER_VISIBLE_MESHLETS], 1, writeIndex);
+            uint capacity, stride;
+            visibleMeshlets1.GetDimensions(capacity, stride);
+            if (writeIndex < capacity)
+                visibleMeshlets1[writeIndex] = visibleMeshlet;
+            emittedTriangles = meshlets[visibleMeshlet.meshletIndex].triangleCount;
         }
     }
+
+    // Statistics are accumulated outside of the branch so that the whole wave participates
+    IncrementCullingCounter(CULLING_COUNTER_MESHLETS_AFTER_CONE_CULLING, passedConeCulling ? 1 : 0);
+    IncrementCullingCounter(CULLING_COUNTER_MESHLETS_AFTER_FRUSTUM_CULLING, passedFrustumCulling ? 1 : 0);
+    IncrementCullingCounter(CULLING_COUNTER_TRIANGLES, emittedTriangles);
 }
 
 [numthreads(1, 1, 1)]
 void updateIndirectArguments()
 {
-    uint groupCount = _VisibleMeshletsCount[VISIBLE_MESHLET_COUNT_KEY]; // TODO: support multiple commands
+    uint capacity, stride;
+    visibleMeshlets1.GetDimensions(capacity, stride);
+    uint groupCount = min(_VisibleMeshletsCount[CULLING_COUNTER_VISIBLE_MESHLETS], capacity); // TODO: support multiple commands
     
     IndirectExecuteMesh args;
 
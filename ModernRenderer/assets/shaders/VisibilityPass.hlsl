@@ -8,7 +8,11 @@ struct VisibilityMeshToFragment
 
 struct VisibilityPrimitiveAttribute
 {
+#ifdef VISIBILITY_BUFFER_64BIT
+    nointerpolation uint2 packedVisibilityData : VISIBILITY;
+#else
     uint packedVisibilityData : SV_PrimitiveID;
+#endif
     bool primitiveCulled : SV_CullPrimitive;
 };
 
@@ -36,7 +40,7 @@ void mesh(
     {
         triangles[primitiveId] = LoadPrimitive(meshlet.triangleOffset, primitiveId);
         VisibilityPrimitiveAttribute attribute;
-        attribute.packedVisibilityData = EncodeVisibility(groupID, threadID);
+        attribute.packedVisibilityData = EncodeVisibilityData(instanceID, groupID, threadID);
         attribute.primitiveCulled = false;
         sharedPrimitives[primitiveId] = attribute;
     }
@@ -53,7 +57,7 @@ void mesh(
     }
 }
 
-uint fragment(VisibilityMeshToFragment input, VisibilityPrimitiveAttribute prim) : SV_TARGET0
+VisibilityData fragment(VisibilityMeshToFragment input, VisibilityPrimitiveAttribute prim) : SV_TARGET0
 {
     return prim.packedVisibilityData;
 }
@@ -1,23 +1,9 @@
+#pragma once
+
 #include "Common.hlsl"
 #include "MeshUtils.hlsl"
 
-Texture2D<uint> _VisibilityTexture : register(t1, space2);
-
-struct ForwardMeshToFragment
-{
-    float4 positionCS : SV_POSITION;
-    float2 uv : TEXCOORD0;
-};
-
-ForwardMeshToFragment GetFullscreenTriangleVertex(uint id)
-{
-    ForwardMeshToFragment v;
-    
-    v.positionCS = GetFullScreenTriangleVertexPosition(id);
-    v.uv = GetFullScreenTriangleTexCoord(id);
-
-    return v;
-}
+Texture2D<VisibilityData> _VisibilityTexture : register(t1, space2);
 
 struct BarycentricDeriv
 {
@@ -132,26 +118,20 @@ void InterpolateWithDeriv(BarycentricDeriv bary, float2 v0, float2 v1, float2 v2
     v_ddy.y = tvY.z;
 }
 
-[NumThreads(1, 1, 1)]
-[OutputTopology("triangle")]
-void mesh(
-    out indices uint3 triangles[1],
-    out vertices ForwardMeshToFragment vertices[3])
+uint GetVisibilityMaterialIndex(VisibilityData visibilityData)
 {
-    SetMeshOutputCounts(3, 1);
-    
-    triangles[0] = uint3(0, 1, 2);
-    vertices[0] = GetFullscreenTriangleVertex(0);
-    vertices[1] = GetFullscreenTriangleVertex(1);
-    vertices[2] = GetFullscreenTriangleVertex(2);
+    uint visibleMeshetID, triangleID;
+    DecodeVisibilityData(visibilityData, visibleMeshetID, triangleID);
+
+    VisibleMeshlet visibleMeshlet = visibleMeshlets1[visibleMeshetID];
+    return instanceData[visibleMeshlet.instanceIndex].materialIndex;
 }
 
-float4 fragment(ForwardMeshToFragment input) : SV_TARGET0
+// Reconstructs the surface attributes of the triangle stored in the visibility buffer and shades the pixel
+float4 ShadeVisibility(float2 positionSS, VisibilityData visibilityData)
 {
-    uint visibilityData = _VisibilityTexture.Load(uint3(input.positionCS.xy, 0));
-    
     uint visibleMeshetID, triangleID;
-    DecodeVisibility(visibilityData, visibleMeshetID, triangleID);
+    DecodeVisibilityData(visibilityData, visibleMeshetID, triangleID);
     
     VisibleMeshlet visibleMeshlet = visibleMeshlets1[visibleMeshetID];
     Meshlet meshlet = meshlets[visibleMeshlet.meshletIndex];
@@ -169,7 +149,7 @@ float4 fragment(ForwardMeshToFragment input) : SV_TARGET0
     TransformedVertex attrib1 = LoadVertexAttributes(visibleMeshlet.meshletIndex, index1, visibleMeshlet.instanceIndex);
     TransformedVertex attrib2 = LoadVertexAttributes(visibleMeshlet.meshletIndex, index2, visibleMeshlet.instanceIndex);
     
-    float2 pixelNDC = input.positionCS.xy * cameraResolution.zw * 2 - 1;
+    float2 pixelNDC = positionSS * cameraResolution.zw * 2 - 1;
     pixelNDC.y = -pixelNDC.y;
     BarycentricDeriv bary = CalcFullBary(attrib0.positionCS, attrib1.positionCS, attrib2.positionCS, pixelNDC, cameraResolution.zw * 2);
     
@@ -0,0 +1,508 @@
+#include "Benchmark.hpp"
+#include "Renderer.hpp"
+#include "Profiler.hpp"
+#include "CullingStatistics.hpp"
+#include "Timer.hpp"
+#include "FrameContext.hpp"
+#include "JobSystem.hpp"
+#include "ShaderCache.hpp"
+#include "MatrixUtils.hpp"
+#include "MeshPool.hpp"
+#include "RenderSettings.hpp"
+#include "MaterialTileValidation.hpp"
+#include "Json.hpp"
+#include <fstream>
+#include <cmath>
+#include <random>
+#include <cfloat>
+#include <cctype>
+#include <unordered_set>
+
+// Counters of CullingStatisticsFrame reported by the benchmark
+static const std::pair<const char*, unsigned CullingStatisticsFrame::*> cullingCounterFields[] =
+{
+	{ "instancesTested", &CullingStatisticsFrame::instancesTested },
+	{ "instancesVisible", &CullingStatisticsFrame::instancesVisible },
+	{ "meshletsAfterInstanceCulling", &CullingStatisticsFrame::meshletsAfterInstanceCulling },
+	{ "meshletsAfterConeCulling", &CullingStatisticsFrame::meshletsAfterConeCulling },
+	{ "meshletsAfterFrustumCulling", &CullingStatisticsFrame::meshletsAfterFrustumCulling },
+	{ "meshletsVisible", &CullingStatisticsFrame::meshletsVisible },
+	{ "trianglesEmitted", &CullingStatisticsFrame::trianglesEmitted },
+};
+
+bool Benchmark::ParseArgs(int argc, char* argv[], Settings& settings)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--benchmark")
+			settings.enabled = true;
+		else if (arg == "--scene" && hasValue)
+			settings.sceneName = argv[++i];
+		else if (arg == "--camera-path" && hasValue)
+			settings.cameraPathFile = argv[++i];
+		else if (arg == "--frames" && hasValue)
+			settings.frameCount = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--warmup" && hasValue)
+			settings.warmupFrameCount = std::max(0, std::atoi(argv[++i]));
+		else if (arg == "--report" && hasValue)
+			settings.reportPath = argv[++i];
+		else if (arg == "--animate-instances" && hasValue)
+			settings.animatedInstancePercent = std::clamp((float)std::atof(argv[++i]), 0.0f, 100.0f);
+		else if (arg == "--renderer" && hasValue)
+		{
+			std::string renderer = argv[++i];
+			if (renderer == "rasterization" || renderer == "pathtracing")
+				settings.pathTracing = renderer == "pathtracing";
+			else
+				printf("Unknown renderer %s, expected rasterization or pathtracing\n", renderer.c_str());
+		}
+		else if (arg == "--stream-meshes")
+		{
+			settings.streamedMeshesPerFrame = 1;
+			if (hasValue && std::isdigit((unsigned char)argv[i + 1][0]))
+				settings.streamedMeshesPerFrame = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (arg == "--benchmark-bounds")
+		{
+			settings.boundsBenchmarkInstances = 10000000;
+			if (hasValue && std::isdigit((unsigned char)argv[i + 1][0]))
+				settings.boundsBenchmarkInstances = std::max(1, std::atoi(argv[++i]));
+		}
+	}
+
+	if (settings.enabled && settings.sceneName.empty())
+		settings.sceneName = Scene::GetSceneNames()[0];
+
+	return settings.enabled;
+}
+
+int Benchmark::RunBoundsBenchmark(unsigned instanceCount)
+{
+	// Same distribution of transforms for every run, the instances share a few meshes like in the generated scenes
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+	std::vector<AABB> meshBounds(16);
+	for (auto& bounds : meshBounds)
+	{
+		glm::vec3 center(unit(random), unit(random), unit(random));
+		glm::vec3 extents(scale(random), scale(random), scale(random));
+		bounds = { center - extents, center + extents };
+	}
+
+	printf("Bounds benchmark: generating %u instances\n", instanceCount);
+	InstanceStore store;
+	store.Reserve(instanceCount);
+	std::vector<Scene::InstanceData> instanceData(instanceCount);
+	std::vector<unsigned> meshIndices(instanceCount);
+	for (unsigned i = 0; i < instanceCount; i++)
+	{
+		glm::vec3 position = glm::vec3(unit(random), unit(random), unit(random)) * 1000.0f;
+		glm::vec3 rotation = glm::vec3(unit(random), unit(random), unit(random)) * 180.0f;
+		glm::mat4 transform = glm::transpose(MatrixUtils::Translation(position) * MatrixUtils::Rotation(rotation) * MatrixUtils::Scale(glm::vec3(scale(random))));
+
+		meshIndices[i] = random() % meshBounds.size();
+		store.Add(transform, meshBounds[meshIndices[i]], 0, 0, 0);
+		instanceData[i].objectToWorld = transform;
+	}
+
+	// Best of a few runs to hide the page faults of the first one
+	constexpr unsigned runCount = 3;
+	auto measure = [&](const char* name, auto&& function)
+	{
+		double bestSeconds = DBL_MAX;
+		for (unsigned run = 0; run < runCount; run++)
+		{
+			uint64_t startTicks = Timer::GetTicks();
+			function();
+			bestSeconds = std::min(bestSeconds, Timer::TicksToSeconds(Timer::GetTicks() - startTicks));
+		}
+		printf("  %-28s %8.2f ms  %6.2f ns/instance\n", name, bestSeconds * 1000.0, bestSeconds * 1e9 / instanceCount);
+	};
+
+	measure("OBB constructor (AoS)", [&]()
+	{
+		for (unsigned i = 0; i < instanceCount; i++)
+			instanceData[i].obb = OBB(meshBounds[meshIndices[i]], instanceData[i].objectToWorld);
+	});
+	measure("InstanceStore scalar (SoA)", [&]() { store.ComputeBoundsScalar(0, instanceCount); });
+	measure(InstanceStore::IsAVXSupported() ? "InstanceStore AVX (SoA)" : "InstanceStore (SoA, no AVX)", [&]() { store.ComputeBounds(0, instanceCount); });
+
+	// The batches must match the constructor, up to the rounding of normalize
+	float maxError = 0.0f;
+	for (unsigned i = 0; i < instanceCount; i++)
+	{
+		const OBB& expected = instanceData[i].obb;
+		OBB obb = store.GetOBB(i);
+		float error = glm::length(obb.center - expected.center) / std::max(1.0f, glm::length(expected.center));
+		error = std::max(error, glm::length(obb.right - expected.right));
+		error = std::max(error, glm::length(obb.up - expected.up));
+		error = std::max(error, std::abs(obb.extentRight - expected.extentRight) / std::max(1.0f, expected.extentRight));
+		error = std::max(error, std::abs(obb.extentUp - expected.extentUp) / std::max(1.0f, expected.extentUp));
+		error = std::max(error, std::abs(obb.extentForward - expected.extentForward) / std::max(1.0f, expected.extentForward));
+		maxError = std::max(maxError, error);
+	}
+	printf("  max relative error %g\n", maxError);
+
+	return maxError < 1e-4f ? 0 : 1;
+}
+
+Benchmark::Benchmark(const Settings& settings, std::shared_ptr<Adapter> adapter)
+{
+	this->settings = settings;
+	cullingCounters.resize(std::size(cullingCounterFields));
+
+	// Optional, the memory section of the report is empty when DXGI 1.4 is not available
+	((DXAdapter*)adapter.get())->GetAdapter().As(&dxgiAdapter);
+
+	// The whole path is played over the measured frames with a fixed timestep
+	if (!settings.cameraPathFile.empty() && cameraPath.Load(settings.cameraPathFile))
+	{
+		cameraPathPlayer.SetTimestep(settings.frameCount > 1 ? cameraPath.GetDuration() / (settings.frameCount - 1) : 0.0f);
+		cameraPathPlayer.Play(cameraPath, false);
+	}
+}
+
+void Benchmark::CounterStatistics::AddSample(unsigned value)
+{
+	sum += value;
+	min = std::min(min, value);
+	max = std::max(max, value);
+	sampleCount++;
+}
+
+void Benchmark::SampleMemoryUsage()
+{
+	if (!dxgiAdapter)
+		return;
+
+	DXGI_QUERY_VIDEO_MEMORY_INFO local = {};
+	DXGI_QUERY_VIDEO_MEMORY_INFO nonLocal = {};
+	dxgiAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &local);
+	dxgiAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL, &nonLocal);
+
+	currentMemory.localUsage = local.CurrentUsage;
+	currentMemory.localBudget = local.Budget;
+	currentMemory.nonLocalUsage = nonLocal.CurrentUsage;
+
+	peakMemory.localUsage = std::max(peakMemory.localUsage, currentMemory.localUsage);
+	peakMemory.localBudget = std::max(peakMemory.localBudget, currentMemory.localBudget);
+	peakMemory.nonLocalUsage = std::max(peakMemory.nonLocalUsage, currentMemory.nonLocalUsage);
+}
+
+void Benchmark::SampleCullingStatistics()
+{
+	// The statistics are read back a few frames late, only count each frame once
+	if (!CullingStatistics::HasData())
+		return;
+
+	const CullingStatisticsFrame& frame = CullingStatistics::GetLatest();
+	if (frame.frameIndex == lastCullingFrameIndex)
+		return;
+	lastCullingFrameIndex = frame.frameIndex;
+
+	for (size_t i = 0; i < std::size(cullingCounterFields); i++)
+		cullingCounters[i].AddSample(frame.*cullingCounterFields[i].second);
+}
+
+void Benchmark::AnimateInstances(Scene& scene, unsigned frame, bool measured)
+{
+	if (animationStride == 0)
+		return;
+
+	double startTime = Timer::GetTimeInSeconds();
+
+	// Every animationStride-th instance bobs up and down, the dirty instances are spread over the whole buffer
+	float time = frame * 0.05f;
+	for (size_t i = 0; i < animationBaseTransforms.size(); i += animationStride)
+	{
+		glm::vec3 offset = glm::vec3(0.0f, 0.25f * std::sin(time + (float)i), 0.0f);
+		// Instance transforms are stored transposed, see SceneGenerator
+		scene.SetInstanceTransform(i, animationBaseTransforms[i] * glm::transpose(MatrixUtils::Translation(offset)));
+	}
+
+	if (measured)
+		instanceAnimationMillis.AddSample((Timer::GetTimeInSeconds() - startTime) * 1000.0);
+}
+
+void Benchmark::SampleInstanceUpdate(const Renderer& renderer)
+{
+	if (animationStride == 0)
+		return;
+
+	const InstanceUpdater::Statistics& statistics = renderer.GetInstanceUpdater().GetStatistics();
+	instanceUpdateMillis.AddSample(statistics.cpuMillis);
+	updatedInstances.AddSample(statistics.updatedInstances);
+	instanceUploadBytes += statistics.uploadBytes;
+	if (statistics.scattered)
+		scatteredFrameCount++;
+}
+
+void Benchmark::StreamMeshes(bool measured)
+{
+	if (streamedMeshes.empty())
+		return;
+
+	double startTime = Timer::GetTimeInSeconds();
+
+	// The old ranges are released once the frames in flight are complete, so the mesh always moves
+	for (unsigned i = 0; i < settings.streamedMeshesPerFrame; i++)
+	{
+		std::shared_ptr<Mesh> mesh = streamedMeshes[nextStreamedMesh];
+		nextStreamedMesh = (nextStreamedMesh + 1) % streamedMeshes.size();
+
+		MeshPool::RemoveMesh(mesh);
+		if (MeshPool::PushNewMesh(mesh) == MeshPool::invalidMeshletOffset)
+		{
+			// The instances of the mesh now read released ranges, the run fails
+			printf("Benchmark: mesh streaming stopped, the MeshPool heaps are full\n");
+			failedMeshPushes++;
+			streamedMeshes.clear();
+			return;
+		}
+		if (measured)
+			streamedMeshCount++;
+	}
+
+	if (measured)
+		meshStreamingMillis.AddSample((Timer::GetTimeInSeconds() - startTime) * 1000.0);
+}
+
+bool Benchmark::IsValidatingMaterialTiles() const
+{
+	return MaterialTileValidation::IsEnabled() && !settings.pathTracing;
+}
+
+Scene::TLASStatistics Benchmark::GetMeasuredTLASStatistics(const Scene& scene) const
+{
+	Scene::TLASStatistics statistics;
+	statistics.refitCount = scene.tlasStatistics.refitCount - tlasStatisticsStart.refitCount;
+	statistics.rebuildCount = scene.tlasStatistics.rebuildCount - tlasStatisticsStart.rebuildCount;
+	return statistics;
+}
+
+int Benchmark::Run(std::shared_ptr<Device> device, Renderer& renderer, Camera& camera, std::shared_ptr<Scene> scene, const AppSize& size)
+{
+	std::shared_ptr<CommandQueue> commandQueue = device->GetCommandQueue(CommandListType::kGraphics);
+
+	printf("Benchmark: %ls, %u frames (%u warmup)\n", scene->name.c_str(), settings.frameCount, settings.warmupFrameCount);
+
+	if (settings.animatedInstancePercent > 0.0f && !scene->instances.empty())
+	{
+		animationStride = std::max(1u, (unsigned)std::round(100.0f / settings.animatedInstancePercent));
+		for (const auto& instance : scene->instances)
+			animationBaseTransforms.push_back(instance.transform);
+		printf("Benchmark: animating %.1f%% of the instances\n", settings.animatedInstancePercent);
+	}
+
+	if (settings.streamedMeshesPerFrame > 0)
+	{
+		std::unordered_set<Mesh*> uniqueMeshes;
+		for (const auto& instance : scene->instances)
+			for (const auto& part : instance.model.parts)
+				if (uniqueMeshes.insert(part.mesh.get()).second)
+					streamedMeshes.push_back(part.mesh);
+		printf("Benchmark: streaming %u of %zu meshes per frame\n", settings.streamedMeshesPerFrame, streamedMeshes.size());
+	}
+
+	if (settings.pathTracing)
+	{
+		renderer.controls.rendererMode = Renderer::RendererMode::PathTracing;
+		printf("Benchmark: path tracing\n");
+		if (MaterialTileValidation::IsEnabled())
+			printf("Benchmark: the path tracer has no material tiles, --validate-material-tiles is ignored\n");
+	}
+
+	unsigned totalFrameCount = settings.warmupFrameCount + settings.frameCount;
+	double lastFrameTime = Timer::GetTimeInSeconds();
+	for (unsigned frame = 0; frame < totalFrameCount; frame++)
+	{
+		auto cmd = FrameContext::BeginFrame();
+		Profiler::ReadbackStats(commandQueue);
+		if (IsValidatingMaterialTiles())
+			MaterialTileValidation::BeginFrame();
+
+		bool measured = frame >= settings.warmupFrameCount;
+		double frameTime = Timer::GetTimeInSeconds();
+		if (frame == settings.warmupFrameCount)
+		{
+			Profiler::ResetStatistics();
+			measureStartTime = frameTime;
+			tlasStatisticsStart = scene->tlasStatistics;
+		}
+		else if (measured)
+		{
+			cpuFrameMillis.AddSample((frameTime - lastFrameTime) * 1000.0);
+			SampleCullingStatistics();
+		}
+		lastFrameTime = frameTime;
+
+		if (measured)
+			SampleMemoryUsage();
+
+		// Warmup frames stay at the start of the path so that the first measured frame doesn't pay for any streaming
+		if (measured)
+		{
+			cameraPathPlayer.Update(camera);
+		}
+		else if (!cameraPath.IsEmpty())
+		{
+			CameraPath::Keyframe pose = cameraPath.Evaluate(0.0f);
+			camera.SetPose(pose.position, pose.rotation);
+		}
+		camera.UpdateCamera(size);
+		AnimateInstances(*scene, frame, measured);
+		StreamMeshes(measured);
+
+		renderer.UpdateCommandList(cmd, nullptr, camera, scene);
+		if (measured)
+			SampleInstanceUpdate(renderer);
+		FrameContext::Submit(commandQueue);
+		FrameContext::EndFrame(commandQueue);
+		if (IsValidatingMaterialTiles())
+			MaterialTileValidation::ValidateFrame(*scene);
+	}
+	FrameContext::WaitIdle();
+	measureEndTime = Timer::GetTimeInSeconds();
+	measuredFrameCount = settings.frameCount;
+	transientPlan = renderer.GetTransientResources().GetPlan();
+
+	if (!WriteReport(*scene, size))
+		return 1;
+
+	printf("Benchmark: %.2f s, %.1f fps, report written to %s\n", measureEndTime - measureStartTime, measuredFrameCount / (measureEndTime - measureStartTime), settings.reportPath.c_str());
+	Scene::TLASStatistics tlas = GetMeasuredTLASStatistics(*scene);
+	printf("Benchmark: TLAS %u refits, %u rebuilds\n", tlas.refitCount, tlas.rebuildCount);
+
+	// Fail the run when a pass exceeds its budget or the material tiles don't match the CPU reference, so that
+	// regressions can be caught automatically
+	unsigned budgetViolations = Profiler::ReportBudgetViolations();
+	unsigned materialTileMismatches = IsValidatingMaterialTiles() ? MaterialTileValidation::ReportMismatches() : 0;
+	return budgetViolations + materialTileMismatches + failedMeshPushes > 0 ? 1 : 0;
+}
+
+bool Benchmark::WriteReport(const Scene& scene, const AppSize& size) const
+{
+	std::ofstream file(settings.reportPath, std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+	{
+		printf("Failed to write benchmark report %s\n", settings.reportPath.c_str());
+		return false;
+	}
+
+	double totalSeconds = measureEndTime - measureStartTime;
+	constexpr double megaByte = 1024.0 * 1024.0;
+
+	file << "{\n";
+	const Scene::BuildStatistics& build = scene.buildStatistics;
+	file << "  \"scene\": \"" << EscapeJSON(std::string(scene.name.begin(), scene.name.end())) << "\",\n";
+	file << "  \"instances\": " << scene.instanceStore.GetCount() << ",\n";
+	file << "  \"sceneBuild\": { \"loadSeconds\": " << build.loadSeconds
+		<< ", \"meshPoolUploadSeconds\": " << build.meshPoolUploadSeconds
+		<< ", \"rtasBuildSeconds\": " << build.rtasBuildSeconds
+		<< ", \"instanceUploadSeconds\": " << build.instanceUploadSeconds
+		<< ", \"instanceUploadBytes\": " << build.instanceUploadBytes
+		<< ", \"maxMeshletsVisible\": " << build.maxMeshletsVisible
+		<< ", \"visibleMeshletsCapacity\": " << build.visibleMeshletsCapacity << " },\n";
+	file << "  \"cameraPath\": \"" << EscapeJSON(settings.cameraPathFile) << "\",\n";
+	file << "  \"resolution\": [" << size.width() << ", " << size.height() << "],\n";
+	file << "  \"frames\": " << measuredFrameCount << ",\n";
+	file << "  \"warmupFrames\": " << settings.warmupFrameCount << ",\n";
+	file << "  \"jobWorkers\": " << JobSystem::GetWorkerCount() << ",\n";
+	file << "  \"renderer\": \"" << (settings.pathTracing ? "pathtracing" : "rasterization") << "\",\n";
+	file << "  \"visibilityFormat\": \"" << (RenderSettings::visibilityBuffer64Bit ? "R32G32" : "R32") << "\",\n";
+	ShaderCache::Statistics shaderCache = ShaderCache::GetStatistics();
+	file << "  \"shaderCache\": { \"hits\": " << shaderCache.hits
+		<< ", \"misses\": " << shaderCache.misses
+		<< ", \"loadSeconds\": " << shaderCache.loadSeconds
+		<< ", \"compileSeconds\": " << shaderCache.compileSeconds << " },\n";
+	file << "  \"totalSeconds\": " << totalSeconds << ",\n";
+	file << "  \"averageFPS\": " << (totalSeconds > 0 ? measuredFrameCount / totalSeconds : 0) << ",\n";
+	file << "  \"cpuFrameMillis\": { \"mean\": " << cpuFrameMillis.GetMean()
+		<< ", \"min\": " << cpuFrameMillis.GetMin()
+		<< ", \"max\": " << cpuFrameMillis.GetMax()
+		<< ", \"p50\": " << cpuFrameMillis.GetP50()
+		<< ", \"p95\": " << cpuFrameMillis.GetP95()
+		<< ", \"p99\": " << cpuFrameMillis.GetP99() << " },\n";
+
+	if (animationStride != 0)
+	{
+		size_t animatedCount = (animationBaseTransforms.size() + animationStride - 1) / animationStride;
+		double meanUpdated = updatedInstances.sampleCount > 0 ? (double)updatedInstances.sum / updatedInstances.sampleCount : 0;
+		file << "  \"instanceUpdate\": { \"animatedPercent\": " << settings.animatedInstancePercent
+			<< ", \"animatedInstances\": " << animatedCount
+			<< ", \"updatedInstanceData\": " << meanUpdated
+			<< ", \"uploadMBPerFrame\": " << (measuredFrameCount > 0 ? instanceUploadBytes / megaByte / measuredFrameCount : 0)
+			<< ", \"scatteredFrames\": " << scatteredFrameCount
+			<< ", \"animationMillis\": { \"mean\": " << instanceAnimationMillis.GetMean() << ", \"p95\": " << instanceAnimationMillis.GetP95() << " }"
+			<< ", \"recordMillis\": { \"mean\": " << instanceUpdateMillis.GetMean() << ", \"p95\": " << instanceUpdateMillis.GetP95() << " } },\n";
+	}
+
+	Scene::TLASStatistics tlas = GetMeasuredTLASStatistics(scene);
+	file << "  \"tlas\": { \"refits\": " << tlas.refitCount << ", \"rebuilds\": " << tlas.rebuildCount << " },\n";
+
+	if (IsValidatingMaterialTiles())
+	{
+		const MaterialTileValidation::Statistics& validation = MaterialTileValidation::GetStatistics();
+		file << "  \"materialTileValidation\": { \"validatedFrames\": " << validation.validatedFrames
+			<< ", \"mismatchedFrames\": " << validation.mismatchedFrames
+			<< ", \"missingTiles\": " << validation.missingTiles
+			<< ", \"extraTiles\": " << validation.extraTiles
+			<< ", \"duplicatedTiles\": " << validation.duplicatedTiles
+			<< ", \"invalidPixels\": " << validation.invalidPixels << " },\n";
+	}
+
+	file << "  \"markers\": ";
+	Profiler::WriteMarkerStatistics(file, "  ");
+	file << ",\n";
+
+	file << "  \"culling\": {";
+	for (size_t i = 0; i < cullingCounters.size(); i++)
+	{
+		const CounterStatistics& counter = cullingCounters[i];
+		double mean = counter.sampleCount > 0 ? (double)counter.sum / counter.sampleCount : 0;
+		file << (i == 0 ? "\n" : ",\n") << "    \"" << cullingCounterFields[i].first << "\": { \"mean\": " << mean
+			<< ", \"min\": " << (counter.sampleCount > 0 ? counter.min : 0)
+			<< ", \"max\": " << counter.max << " }";
+	}
+	file << "\n  },\n";
+
+	file << "  \"memory\": { \"localUsageMB\": " << currentMemory.localUsage / megaByte
+		<< ", \"peakLocalUsageMB\": " << peakMemory.localUsage / megaByte
+		<< ", \"localBudgetMB\": " << currentMemory.localBudget / megaByte
+		<< ", \"nonLocalUsageMB\": " << currentMemory.nonLocalUsage / megaByte
+		<< ", \"peakNonLocalUsageMB\": " << peakMemory.nonLocalUsage / megaByte
+		<< ", \"transientHeapMB\": " << transientPlan.heapSize / megaByte
+		<< ", \"transientSavedMB\": " << transientPlan.GetSavedBytes() / megaByte << " },\n";
+
+	std::vector<MeshPool::HeapStatistics> heaps = MeshPool::GetHeapStatistics();
+	file << "  \"meshPool\": {";
+	for (size_t i = 0; i < heaps.size(); i++)
+	{
+		const RangeAllocator::Statistics& heap = heaps[i].allocator;
+		file << (i == 0 ? "\n" : ",\n") << "    \"" << heaps[i].name << "\": { \"capacity\": " << heap.capacity
+			<< ", \"used\": " << heap.usedSize
+			<< ", \"freeBlocks\": " << heap.freeBlockCount
+			<< ", \"largestFreeBlock\": " << heap.largestFreeBlock
+			<< ", \"fragmentation\": " << heap.fragmentation << " }";
+	}
+	const MeshPool::CompactionStatistics& compaction = MeshPool::GetCompactionStatistics();
+	file << ",\n    \"compaction\": { \"count\": " << compaction.compactionCount
+		<< ", \"movedRanges\": " << compaction.moveCount
+		<< ", \"uploadedMB\": " << compaction.uploadedBytes / megaByte << " }";
+	if (settings.streamedMeshesPerFrame > 0)
+	{
+		file << ",\n    \"streaming\": { \"meshesPerFrame\": " << settings.streamedMeshesPerFrame
+			<< ", \"streamedMeshes\": " << streamedMeshCount
+			<< ", \"failedPushes\": " << failedMeshPushes
+			<< ", \"millis\": { \"mean\": " << meshStreamingMillis.GetMean() << ", \"p95\": " << meshStreamingMillis.GetP95() << " } }";
+	}
+	file << "\n  }\n";
+	file << "}\n";
+
+	return true;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Instance/Instance.h"
+#include <Adapter/DXAdapter.h>
+#include <dxgi1_4.h>
+#include "AppBox/AppBox.h"
+#include "Camera.hpp"
+#include "Scene.hpp"
+#include "CameraPath.hpp"
+#include "RollingStatistics.hpp"
+#include "TransientResourcePlanner.hpp"
+#include <climits>
+
+class Renderer;
+
+// Renders a scene along a camera path for a fixed number of frames without presenting, then writes a JSON report
+// with the timings of every profiler marker, the culling statistics and the GPU memory usage.
+// Usage: --benchmark --scene <name> [--camera-path <file>] [--frames <count>] [--warmup <count>] [--report <file.json>]
+//        [--animate-instances <percent>] [--renderer <rasterization|pathtracing>] [--stream-meshes [count]]
+// --animate-instances moves a percentage of the instances every frame to measure the incremental instance upload,
+// e.g. with --generate uniform --instances 1000000 and 1, 10 and 100 percent.
+// --stream-meshes removes meshes of the scene from the MeshPool and pushes them again, count per frame (1 by default),
+// which uploads them to new ranges of the resident heaps, updates the instances using them and fragments the heaps.
+// With --validate-material-tiles (see MaterialTileValidation) the result of the validation is added to the report and
+// a mismatch fails the run, the validated frames wait for the GPU so the timings aren't representative. The path
+// tracer doesn't classify the material tiles, the validation is skipped with --renderer pathtracing.
+// --benchmark-bounds [count] only measures the construction of the instance OBBs on the CPU (10M instances by default)
+// with the per instance OBB constructor, the scalar InstanceStore loop and the AVX one, then exits.
+class Benchmark
+{
+public:
+	struct Settings
+	{
+		bool enabled = false;
+		// Also used outside of the benchmark to select the scene, the default scene is loaded when empty
+		std::string sceneName;
+		std::string cameraPathFile;
+		unsigned frameCount = 1000;
+		unsigned warmupFrameCount = 60;
+		std::string reportPath = "BenchmarkReport.json";
+		// Percentage of the instances moved every frame, spread over the whole scene
+		float animatedInstancePercent = 0.0f;
+		// Instance count of --benchmark-bounds, 0 when disabled
+		unsigned boundsBenchmarkInstances = 0;
+		bool pathTracing = false;
+		// Meshes removed and pushed again every frame, 0 when disabled
+		unsigned streamedMeshesPerFrame = 0;
+	};
+
+private:
+	struct CounterStatistics
+	{
+		uint64_t sum = 0;
+		unsigned min = UINT_MAX;
+		unsigned max = 0;
+		unsigned sampleCount = 0;
+
+		void AddSample(unsigned value);
+	};
+
+	struct MemoryUsage
+	{
+		uint64_t localUsage = 0;
+		uint64_t localBudget = 0;
+		uint64_t nonLocalUsage = 0;
+	};
+
+	Settings settings;
+	ComPtr<IDXGIAdapter3> dxgiAdapter;
+	CameraPath cameraPath;
+	CameraPathPlayer cameraPathPlayer;
+
+	RollingStatistics cpuFrameMillis;
+	double measureStartTime = 0;
+	double measureEndTime = 0;
+	unsigned measuredFrameCount = 0;
+
+	// Instance animation, the transforms are offset from the ones of the loaded scene
+	std::vector<glm::mat4> animationBaseTransforms;
+	unsigned animationStride = 0;
+	RollingStatistics instanceAnimationMillis;
+	RollingStatistics instanceUpdateMillis;
+	CounterStatistics updatedInstances;
+	uint64_t instanceUploadBytes = 0;
+	unsigned scatteredFrameCount = 0;
+
+	// Mesh streaming, the meshes of the scene are streamed in turn
+	std::vector<std::shared_ptr<Mesh>> streamedMeshes;
+	size_t nextStreamedMesh = 0;
+	RollingStatistics meshStreamingMillis;
+	uint64_t streamedMeshCount = 0;
+	unsigned failedMeshPushes = 0;
+
+	// TLAS statistics of the scene at the first measured frame
+	Scene::TLASStatistics tlasStatisticsStart;
+
+	uint64_t lastCullingFrameIndex = UINT64_MAX;
+	std::vector<CounterStatistics> cullingCounters;
+
+	MemoryUsage currentMemory;
+	MemoryUsage peakMemory;
+	TransientResourcePlanner::Plan transientPlan;
+
+	void SampleMemoryUsage();
+	void SampleCullingStatistics();
+	void AnimateInstances(Scene& scene, unsigned frame, bool measured);
+	void SampleInstanceUpdate(const Renderer& renderer);
+	void StreamMeshes(bool measured);
+	bool IsValidatingMaterialTiles() const;
+	Scene::TLASStatistics GetMeasuredTLASStatistics(const Scene& scene) const;
+	bool WriteReport(const Scene& scene, const AppSize& size) const;
+
+public:
+	// Returns true if --benchmark is in the arguments, unknown arguments are ignored
+	static bool ParseArgs(int argc, char* argv[], Settings& settings);
+
+	// Micro-benchmark of InstanceStore::ComputeBounds, doesn't need a device. Returns the process exit code.
+	static int RunBoundsBenchmark(unsigned instanceCount);
+
+	Benchmark(const Settings& settings, std::shared_ptr<Adapter> adapter);
+
+	// Renders all the frames and writes the report, returns the process exit code
+	int Run(std::shared_ptr<Device> device, Renderer& renderer, Camera& camera, std::shared_ptr<Scene> scene, const AppSize& size);
+};
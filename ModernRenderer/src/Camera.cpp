@@ -6,14 +6,18 @@
 #include "Camera.hpp"
 #include <glm/gtx/rotate_vector.hpp> 
 #include "RenderSettings.hpp"
+#include "FrameContext.hpp"
 
 Camera::Camera(std::shared_ptr<Device> device, AppBox & app)
 {
 	position = glm::vec3(0, 0, -5);
 	rotation = glm::vec2(0, 0);
 
+    // Written on the GPU timeline with a copy from the frame upload arena, so the CPU never overwrites
+    // the data of a frame that is still in flight
     cameraDataBuffer = device->CreateBuffer(BindFlag::kConstantBuffer | BindFlag::kCopyDest, sizeof(GPUCameraData));
-    cameraDataBuffer->CommitMemory(MemoryType::kUpload);
+    cameraDataBuffer->CommitMemory(MemoryType::kDefault);
+    cameraDataBuffer->SetName("Camera Data");
 
     ViewDesc constant_view_desc = {};
     constant_view_desc.view_type = ViewType::kConstantBuffer;
@@ -95,10 +99,11 @@ void Camera::UpdateCamera(const AppSize& size)
 	gpuData.cameraInstanceFrustumCullingDisabled = RenderSettings::frustumInstanceCullingDisabled;
 	gpuData.cameraMeshletFrustumCullingDisabled = RenderSettings::frustumMeshletCullingDisabled;
 	gpuData.cameraMeshletBackfaceCullingDisabled = RenderSettings::backfacingMeshletCullingDisabled;
+	gpuData.cameraMeshletSmallFeatureCullingDisabled = RenderSettings::smallFeatureMeshletCullingDisabled;
+	gpuData.cameraSmallFeatureCullingPixelThreshold = RenderSettings::smallFeatureCullingPixelThreshold;
 
-	cameraDataBuffer->UpdateUploadBuffer(0, &gpuData, sizeof(GPUCameraData));
-
-	movedSinceLastFrame = false;
+	movedSinceLastFrame = poseChanged;
+	poseChanged = false;
 	if (cameraControls.rotation != glm::vec2(0))
 		movedSinceLastFrame = true;
 	if (cameraControls.movement != glm::vec3(0))
@@ -107,11 +112,29 @@ void Camera::UpdateCamera(const AppSize& size)
 	cameraControls.Reset();
 }
 
+void Camera::UploadCameraData(std::shared_ptr<CommandList> cmd) const
+{
+	auto upload = FrameContext::Upload(&gpuData, sizeof(GPUCameraData));
+
+	cmd->ResourceBarrier({ { cameraDataBuffer, ResourceState::kCommon, ResourceState::kCopyDest } });
+	cmd->CopyBuffer(upload.buffer, cameraDataBuffer, { { upload.offset, 0, sizeof(GPUCameraData) } });
+	cmd->ResourceBarrier({ { cameraDataBuffer, ResourceState::kCopyDest, ResourceState::kCommon } });
+}
+
 bool Camera::HasMoved() const
 {
 	return movedSinceLastFrame;
 }
 
+void Camera::SetPose(const glm::vec3& position, const glm::vec2& rotation)
+{
+	if (this->position != position || this->rotation != rotation)
+		poseChanged = true;
+
+	this->position = position;
+	this->rotation = rotation;
+}
+
 void Camera::CameraControls::CheckKeyMask(unsigned& mask, CameraKey c, int expectedKey, int key, int action)
 {
 	if (key == expectedKey)
@@ -25,6 +25,8 @@ struct GPUCameraData
     unsigned cameraInstanceFrustumCullingDisabled; // TODO: 32 bit int flag
     unsigned cameraMeshletFrustumCullingDisabled;
     unsigned cameraMeshletBackfaceCullingDisabled;
+    unsigned cameraMeshletSmallFeatureCullingDisabled;
+    float cameraSmallFeatureCullingPixelThreshold;
 };
 
 class Camera
@@ -66,6 +68,7 @@ private:
     std::shared_ptr<Device> device;
     GLFWwindow* window;
     bool movedSinceLastFrame;
+    bool poseChanged = false;
 
     // Disable copy constructor
     Camera(const Camera&) = delete;
@@ -99,5 +102,10 @@ public:
     Camera(std::shared_ptr<Device> device, AppBox& app);
 
     void UpdateCamera(const AppSize& size);
+    // Records the copy of gpuData to the camera constant buffer, must be the first command of the frame
+    void UploadCameraData(std::shared_ptr<CommandList> cmd) const;
     bool HasMoved() const;
+
+    // Moves the camera without input, applied by the next UpdateCamera. Rotation is yaw and pitch in radians.
+    void SetPose(const glm::vec3& position, const glm::vec2& rotation);
 };
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "CameraPath.hpp"
+#include "Timer.hpp"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+// Header of the binary format, followed by the keyframes
+struct CameraPathFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t keyframeCount;
+};
+
+static constexpr char cameraPathMagic[4] = { 'C', 'A', 'M', 'P' };
+static constexpr uint32_t cameraPathVersion = 1;
+static_assert(sizeof(CameraPath::Keyframe) == 6 * sizeof(float), "Keyframes are written as is in the binary format");
+
+static bool IsBinaryCameraPath(const std::string& path)
+{
+	const std::string extension = ".campath";
+	return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+bool CameraPath::Load(const std::string& path)
+{
+	bool binary = IsBinaryCameraPath(path);
+	std::ifstream file(path, binary ? std::ios::in | std::ios::binary : std::ios::in);
+	if (!file.is_open())
+	{
+		printf("Failed to open camera path %s\n", path.c_str());
+		return false;
+	}
+
+	keyframes.clear();
+
+	if (binary)
+	{
+		CameraPathFileHeader header;
+		file.read((char*)&header, sizeof(header));
+		if (!file || !std::equal(std::begin(cameraPathMagic), std::end(cameraPathMagic), header.magic) || header.version != cameraPathVersion)
+		{
+			printf("Invalid camera path file %s\n", path.c_str());
+			return false;
+		}
+
+		keyframes.resize(header.keyframeCount);
+		file.read((char*)keyframes.data(), keyframes.size() * sizeof(Keyframe));
+		if (!file)
+		{
+			printf("Truncated camera path file %s\n", path.c_str());
+			keyframes.clear();
+			return false;
+		}
+	}
+	else
+	{
+		std::string line;
+		while (std::getline(file, line))
+		{
+			line = line.substr(0, line.find('#'));
+			if (line.find_first_not_of(" \t\r") == std::string::npos)
+				continue;
+
+			Keyframe keyframe;
+			std::istringstream values(line);
+			if (!(values >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.rotation.x >> keyframe.rotation.y))
+			{
+				printf("Invalid camera path keyframe: %s\n", line.c_str());
+				continue;
+			}
+			keyframes.push_back(keyframe);
+		}
+	}
+
+	// Evaluate relies on increasing times
+	std::stable_sort(keyframes.begin(), keyframes.end(), [](const Keyframe& a, const Keyframe& b) { return a.time < b.time; });
+
+	return !keyframes.empty();
+}
+
+bool CameraPath::Save(const std::string& path) const
+{
+	bool binary = IsBinaryCameraPath(path);
+	std::ofstream file(path, binary ? std::ios::out | std::ios::trunc | std::ios::binary : std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+	{
+		printf("Failed to write camera path %s\n", path.c_str());
+		return false;
+	}
+
+	if (binary)
+	{
+		CameraPathFileHeader header;
+		std::copy(std::begin(cameraPathMagic), std::end(cameraPathMagic), header.magic);
+		header.version = cameraPathVersion;
+		header.keyframeCount = (uint32_t)keyframes.size();
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)keyframes.data(), keyframes.size() * sizeof(Keyframe));
+	}
+	else
+	{
+		file << "# time positionX positionY positionZ yaw pitch\n";
+		for (const auto& keyframe : keyframes)
+			file << keyframe.time << ' ' << keyframe.position.x << ' ' << keyframe.position.y << ' ' << keyframe.position.z << ' ' << keyframe.rotation.x << ' ' << keyframe.rotation.y << '\n';
+	}
+
+	return true;
+}
+
+// Cubic Hermite interpolation with Catmull-Rom tangents computed from the keyframe times, which handles uneven spacing
+template<typename T>
+static T CatmullRom(const T& p0, const T& p1, const T& p2, const T& p3, float t0, float t1, float t2, float t3, float u)
+{
+	float segment = t2 - t1;
+	T m1 = t2 > t0 ? (p2 - p0) * (segment / (t2 - t0)) : T(0);
+	T m2 = t3 > t1 ? (p3 - p1) * (segment / (t3 - t1)) : T(0);
+
+	float u2 = u * u;
+	float u3 = u2 * u;
+	return p1 * (2 * u3 - 3 * u2 + 1) + m1 * (u3 - 2 * u2 + u) + p2 * (-2 * u3 + 3 * u2) + m2 * (u3 - u2);
+}
+
+CameraPath::Keyframe CameraPath::Evaluate(float time) const
+{
+	if (keyframes.empty())
+		return { 0.0f, glm::vec3(0, 0, -5), glm::vec2(0) };
+	if (keyframes.size() == 1 || time <= keyframes.front().time)
+		return keyframes.front();
+	if (time >= keyframes.back().time)
+		return keyframes.back();
+
+	// Segment [i, i + 1] containing the time
+	auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float t, const Keyframe& k) { return t < k.time; });
+	size_t i = (next - keyframes.begin()) - 1;
+
+	const Keyframe& k0 = keyframes[i > 0 ? i - 1 : i];
+	const Keyframe& k1 = keyframes[i];
+	const Keyframe& k2 = keyframes[i + 1];
+	const Keyframe& k3 = keyframes[std::min(i + 2, keyframes.size() - 1)];
+
+	float u = k2.time > k1.time ? (time - k1.time) / (k2.time - k1.time) : 0.0f;
+
+	Keyframe result;
+	result.time = time;
+	result.position = CatmullRom(k0.position, k1.position, k2.position, k3.position, k0.time, k1.time, k2.time, k3.time, u);
+	result.rotation = CatmullRom(k0.rotation, k1.rotation, k2.rotation, k3.rotation, k0.time, k1.time, k2.time, k3.time, u);
+	return result;
+}
+
+void CameraPathRecorder::Start()
+{
+	path.keyframes.clear();
+	startTime = Timer::GetTimeInSeconds();
+	nextSampleTime = startTime;
+	recording = true;
+}
+
+void CameraPathRecorder::Record(const Camera& camera)
+{
+	if (!recording)
+		return;
+
+	double now = Timer::GetTimeInSeconds();
+	if (now < nextSampleTime)
+		return;
+
+	// Keep a fixed sample rate even when frames are skipped so that the file size only depends on the duration
+	while (nextSampleTime <= now)
+		nextSampleTime += sampleInterval;
+
+	path.keyframes.push_back({ (float)(now - startTime), camera.position, camera.rotation });
+}
+
+void CameraPathPlayer::Play(const CameraPath& path, bool loop)
+{
+	this->path = path.IsEmpty() ? nullptr : &path;
+	this->loop = loop;
+	frameIndex = 0;
+}
+
+bool CameraPathPlayer::IsFinished() const
+{
+	return path == nullptr || (!loop && frameIndex * timestep > path->GetDuration());
+}
+
+void CameraPathPlayer::Update(Camera& camera)
+{
+	if (path == nullptr)
+		return;
+
+	float time = frameIndex * timestep;
+	float duration = path->GetDuration();
+	if (loop && duration > 0)
+		time = std::fmod(time, duration);
+
+	CameraPath::Keyframe pose = path->Evaluate(time);
+	camera.SetPose(pose.position, pose.rotation);
+	frameIndex++;
+}
+
+bool CameraPathControls::Play(const std::string& file)
+{
+	recorder.Stop();
+	if (!path.Load(file))
+		return false;
+
+	player.Play(path, true);
+	return true;
+}
+
+void CameraPathControls::OnKey(int key, int action)
+{
+	if (action != GLFW_PRESS)
+		return;
+
+	if (key == GLFW_KEY_F5)
+	{
+		if (recorder.IsRecording())
+		{
+			recorder.Stop();
+			path = recorder.GetPath();
+			if (path.Save(recordPath))
+				printf("Camera path recorded to %s: %zu keyframes, %.1f s\n", recordPath.c_str(), path.keyframes.size(), path.GetDuration());
+		}
+		else
+		{
+			player.Stop();
+			recorder.Start();
+			printf("Recording camera path\n");
+		}
+	}
+
+	if (key == GLFW_KEY_F6 && !recorder.IsRecording())
+	{
+		if (player.IsPlaying())
+			player.Stop();
+		else
+			player.Play(path, true);
+	}
+}
+
+void CameraPathControls::BeginFrame(Camera& camera)
+{
+	if (player.IsPlaying())
+		player.Update(camera);
+}
+
+void CameraPathControls::EndFrame(const Camera& camera)
+{
+	recorder.Record(camera);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include "Camera.hpp"
+
+// Timed sequence of camera poses, allows to render exactly the same views across runs.
+// Files ending with .campath use a compact binary format, other files are text with one
+// "time positionX positionY positionZ yaw pitch" keyframe per line, # starts a comment.
+class CameraPath
+{
+public:
+	struct Keyframe
+	{
+		float time; // In seconds, increasing
+		glm::vec3 position;
+		glm::vec2 rotation;
+	};
+
+	std::vector<Keyframe> keyframes;
+
+	bool Load(const std::string& path);
+	bool Save(const std::string& path) const;
+
+	// Pose at the time in seconds, clamped to the path duration.
+	// Catmull-Rom interpolation so that fly-throughs are smooth even with few keyframes.
+	Keyframe Evaluate(float time) const;
+
+	float GetDuration() const { return keyframes.empty() ? 0.0f : keyframes.back().time; }
+	bool IsEmpty() const { return keyframes.empty(); }
+};
+
+// Samples the camera pose at a fixed rate while recording
+class CameraPathRecorder
+{
+private:
+	CameraPath path;
+	float sampleInterval;
+	double startTime = 0;
+	double nextSampleTime = 0;
+	bool recording = false;
+
+public:
+	CameraPathRecorder(float sampleRate = 30.0f) : sampleInterval(1.0f / sampleRate) {}
+
+	void Start();
+	void Stop() { recording = false; }
+	bool IsRecording() const { return recording; }
+
+	// Must be called after Camera::UpdateCamera every frame
+	void Record(const Camera& camera);
+
+	const CameraPath& GetPath() const { return path; }
+};
+
+// Replays a path with a fixed timestep per frame instead of the elapsed time,
+// so that every run renders the same views regardless of the frame rate
+class CameraPathPlayer
+{
+private:
+	const CameraPath* path = nullptr;
+	float timestep;
+	uint64_t frameIndex = 0;
+	bool loop = false;
+
+public:
+	CameraPathPlayer(float timestep = 1.0f / 60.0f) : timestep(timestep) {}
+
+	void Play(const CameraPath& path, bool loop);
+	void Stop() { path = nullptr; }
+	bool IsPlaying() const { return path != nullptr && !IsFinished(); }
+	bool IsFinished() const;
+
+	void SetTimestep(float timestep) { this->timestep = timestep; }
+
+	// Applies the pose of the current frame and advances by one timestep, must be called before Camera::UpdateCamera
+	void Update(Camera& camera);
+};
+
+// Key bindings of the interactive mode:
+// F5 starts and stops the recording, which is saved to recordPath when stopped
+// F6 starts and stops the looping playback of the last recorded or loaded path
+class CameraPathControls : InputEvents
+{
+private:
+	CameraPath path;
+	CameraPathRecorder recorder;
+	CameraPathPlayer player;
+	std::string recordPath;
+
+public:
+	CameraPathControls(const std::string& recordPath = "RecordedCameraPath.campath") : recordPath(recordPath) {}
+
+	// Loads a path and starts playing it
+	bool Play(const std::string& file);
+
+	void OnKey(int key, int action) override;
+	void OnMouse(bool first, double xpos, double ypos) override {}
+
+	// Must be called before Camera::UpdateCamera
+	void BeginFrame(Camera& camera);
+	// Must be called after Camera::UpdateCamera
+	void EndFrame(const Camera& camera);
+};
@@ -0,0 +1,62 @@
+#include "CompactionPlanner.hpp"
+#include <algorithm>
+
+std::vector<CompactionPlanner::Move> CompactionPlanner::Plan(std::vector<Range> ranges)
+{
+	std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.offset < b.offset; });
+
+	std::vector<Move> moves;
+	uint32_t cursor = 0;
+	for (const auto& range : ranges)
+	{
+		if (range.size == 0)
+			continue;
+
+		// The ranges before a pinned one can't move past it, the pinned ranges after the cursor start after the
+		// end of the range being moved since the ranges are sorted
+		if (range.pinned)
+		{
+			cursor = std::max(cursor, range.offset + range.size);
+			continue;
+		}
+
+		if (range.offset != cursor)
+			moves.push_back({ range.id, range.offset, cursor, range.size });
+		cursor += range.size;
+	}
+
+	return moves;
+}
+
+void CompactionPlanner::Relocate(uint32_t* values, size_t count, const Move& move)
+{
+	for (size_t i = 0; i < count; i++)
+		values[i] = Relocate(values[i], move);
+}
+
+bool CompactionPlanner::Validate(const std::vector<Range>& ranges, const std::vector<Move>& moves)
+{
+	// Pinned ranges may share an id, they are never moved
+	std::vector<Range> current = ranges;
+
+	auto overlaps = [](uint32_t offsetA, uint32_t sizeA, uint32_t offsetB, uint32_t sizeB)
+	{
+		return sizeA > 0 && sizeB > 0 && offsetA < offsetB + sizeB && offsetB < offsetA + sizeA;
+	};
+
+	for (const auto& move : moves)
+	{
+		auto moved = std::find_if(current.begin(), current.end(), [&](const Range& range) { return !range.pinned && range.id == move.id; });
+		if (moved == current.end() || moved->offset != move.from || moved->size != move.size)
+			return false;
+
+		for (const auto& other : current)
+		{
+			if (&other != &*moved && overlaps(move.to, move.size, other.offset, other.size))
+				return false;
+		}
+		moved->offset = move.to;
+	}
+
+	return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Plans the compaction of a heap allocated with RangeAllocator. The live ranges slide towards the start of the heap
+// in offset order, so the destination of a move is either free space or overlaps the range being moved: the moves
+// can be applied one at a time, spread over several frames, without ever writing over another live range.
+// Pinned ranges (e.g. ranges that the GPU can still read) stay in place and the next ranges slide up to their end.
+class CompactionPlanner
+{
+public:
+	struct Range
+	{
+		// Identifies the owner of the range in the moves
+		uint32_t id;
+		uint32_t offset;
+		uint32_t size;
+		bool pinned = false;
+	};
+
+	struct Move
+	{
+		uint32_t id;
+		uint32_t from;
+		uint32_t to;
+		uint32_t size;
+	};
+
+	// The ranges must not overlap, empty ranges are never moved. The moves are sorted by destination.
+	static std::vector<Move> Plan(std::vector<Range> ranges);
+
+	// Offsets stored in other data that point into a moved range
+	static uint32_t Relocate(uint32_t value, const Move& move) { return value - move.from + move.to; }
+	static void Relocate(uint32_t* values, size_t count, const Move& move);
+
+	// Returns false if applying the moves in order writes over a live range or leaves two ranges overlapping
+	static bool Validate(const std::vector<Range>& ranges, const std::vector<Move>& moves);
+};
@@ -0,0 +1,97 @@
+#include "CullingStatistics.hpp"
+#include "RenderSettings.hpp"
+#include <imgui.h>
+
+CullingStatistics CullingStatistics::instance;
+
+void CullingStatistics::Init(std::shared_ptr<Device> device)
+{
+	instance.device = device;
+
+	for (unsigned i = 0; i < readbackLatency; i++)
+	{
+		instance.readbackBuffers[i] = device->CreateBuffer(BindFlag::kCopyDest, sizeof(uint32_t) * (unsigned)CullingCounter::Count);
+		instance.readbackBuffers[i]->CommitMemory(MemoryType::kReadback);
+		instance.readbackBuffers[i]->SetName("Culling Statistics Readback " + std::to_string(i));
+	}
+
+	// Without UI, the statistics are dumped to a file so that they can be analyzed after the run
+	if (RenderSettings::noUI)
+	{
+		instance.csvFile.open("CullingStatistics.csv", std::ios::out | std::ios::trunc);
+		instance.csvFile << "frame,instancesTested,instancesVisible,meshletsAfterInstanceCulling,meshletsAfterConeCulling,meshletsAfterFrustumCulling,meshletsVisible,trianglesEmitted\n";
+	}
+}
+
+void CullingStatistics::EnqueueReadback(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> counterBuffer)
+{
+	unsigned slot = instance.frameIndex % readbackLatency;
+
+	cmd->BeginEvent("Culling Statistics Readback");
+	cmd->CopyBuffer(counterBuffer, instance.readbackBuffers[slot], { { 0, 0, sizeof(uint32_t) * (unsigned)CullingCounter::Count } });
+	cmd->EndEvent();
+
+	instance.readbackFrameIndices[slot] = instance.frameIndex;
+	instance.frameIndex++;
+}
+
+void CullingStatistics::ReadbackStats()
+{
+	// The slot that is about to be overwritten holds the oldest frame, which has finished executing on the GPU
+	if (instance.frameIndex < readbackLatency)
+		return;
+
+	unsigned slot = instance.frameIndex % readbackLatency;
+	uint32_t* counters = (uint32_t*)instance.readbackBuffers[slot]->Map();
+
+	CullingStatisticsFrame frame;
+	frame.frameIndex = instance.readbackFrameIndices[slot];
+	frame.instancesTested = counters[(unsigned)CullingCounter::TestedInstances];
+	frame.instancesVisible = counters[(unsigned)CullingCounter::VisibleInstances];
+	frame.meshletsAfterInstanceCulling = counters[(unsigned)CullingCounter::MeshletsAfterInstanceCulling];
+	frame.meshletsAfterConeCulling = counters[(unsigned)CullingCounter::MeshletsAfterConeCulling];
+	frame.meshletsAfterFrustumCulling = counters[(unsigned)CullingCounter::MeshletsAfterFrustumCulling];
+	frame.meshletsVisible = counters[(unsigned)CullingCounter::VisibleMeshlets];
+	frame.trianglesEmitted = counters[(unsigned)CullingCounter::Triangles];
+
+	instance.readbackBuffers[slot]->Unmap();
+
+	instance.latest = frame;
+	instance.hasData = true;
+
+	if (instance.csvFile.is_open())
+		instance.WriteCSVRow(frame);
+}
+
+void CullingStatistics::WriteCSVRow(const CullingStatisticsFrame& frame)
+{
+	csvFile << frame.frameIndex << ','
+		<< frame.instancesTested << ','
+		<< frame.instancesVisible << ','
+		<< frame.meshletsAfterInstanceCulling << ','
+		<< frame.meshletsAfterConeCulling << ','
+		<< frame.meshletsAfterFrustumCulling << ','
+		<< frame.meshletsVisible << ','
+		<< frame.trianglesEmitted << '\n';
+}
+
+void CullingStatistics::DrawImGUIStats()
+{
+	if (!ImGui::CollapsingHeader("Culling Statistics", ImGuiTreeNodeFlags_DefaultOpen))
+		return;
+
+	if (!instance.hasData)
+	{
+		ImGui::Text("Waiting for GPU data...");
+		return;
+	}
+
+	const auto& f = instance.latest;
+	ImGui::Text("Frame: %llu", (unsigned long long)f.frameIndex);
+	ImGui::Text("Instances visible: %u / %u", f.instancesVisible, f.instancesTested);
+	ImGui::Text("Meshlets after instance culling: %u", f.meshletsAfterInstanceCulling);
+	ImGui::Text("Meshlets after cone culling: %u", f.meshletsAfterConeCulling);
+	ImGui::Text("Meshlets after frustum culling: %u", f.meshletsAfterFrustumCulling);
+	ImGui::Text("Meshlets visible: %u", f.meshletsVisible);
+	ImGui::Text("Triangles emitted: %u", f.trianglesEmitted);
+}
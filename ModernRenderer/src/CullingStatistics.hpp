@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Instance/Instance.h"
+#include "FrameContext.hpp"
+#include <array>
+#include <fstream>
+
+// Slots of the visible meshlet count buffer filled by the culling passes
+// Keep in sync with CullingUtils.hlsl
+enum class CullingCounter
+{
+	MeshletsAfterInstanceCulling = 0,
+	VisibleInstances = 1,
+	TestedInstances = 2,
+	MeshletsAfterConeCulling = 3,
+	MeshletsAfterFrustumCulling = 4,
+	Triangles = 5,
+	VisibleMeshlets = 15,
+	Count = 16,
+};
+
+struct CullingStatisticsFrame
+{
+	uint64_t frameIndex = 0;
+	unsigned instancesTested = 0;
+	unsigned instancesVisible = 0;
+	unsigned meshletsAfterInstanceCulling = 0;
+	unsigned meshletsAfterConeCulling = 0;
+	unsigned meshletsAfterFrustumCulling = 0;
+	unsigned meshletsVisible = 0;
+	unsigned trianglesEmitted = 0;
+};
+
+// Copies the culling counters to a ring of readback buffers every frame and reads them back a few frames later,
+// once the GPU is guaranteed to be done with them, so that the CPU never waits on the GPU.
+class CullingStatistics
+{
+private:
+	// Must be greater than the number of frames in flight
+	static constexpr unsigned readbackLatency = FrameContext::readbackSlotCount;
+
+	static CullingStatistics instance;
+
+	std::shared_ptr<Device> device;
+	std::array<std::shared_ptr<Resource>, readbackLatency> readbackBuffers;
+	std::array<uint64_t, readbackLatency> readbackFrameIndices = {};
+	uint64_t frameIndex = 0;
+	bool hasData = false;
+	CullingStatisticsFrame latest;
+	std::ofstream csvFile;
+
+	CullingStatistics() = default;
+	~CullingStatistics() = default;
+
+	void WriteCSVRow(const CullingStatisticsFrame& frame);
+
+public:
+	static void Init(std::shared_ptr<Device> device);
+
+	// Record the copy of the counter buffer, must be called once per frame after the culling passes
+	// The counter buffer must be in the copy source state
+	static void EnqueueReadback(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> counterBuffer);
+
+	// Read the statistics of the oldest frame of the ring, must be called before EnqueueReadback
+	static void ReadbackStats();
+
+	static bool HasData() { return instance.hasData; }
+	static const CullingStatisticsFrame& GetLatest() { return instance.latest; }
+
+	static void DrawImGUIStats();
+};
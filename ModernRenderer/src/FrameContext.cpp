@@ -0,0 +1,96 @@
+#include "FrameContext.hpp"
+#include <Utilities/Common.h>
+
+FrameContext FrameContext::instance;
+
+void FrameContext::Init(std::shared_ptr<Device> device)
+{
+	instance.device = device;
+	instance.fence = device->CreateFence(instance.fenceValue);
+
+	for (unsigned i = 0; i < framesInFlight; i++)
+	{
+		Frame& frame = instance.frames[i];
+		frame.uploadArena = device->CreateBuffer(BindFlag::kCopySource, uploadArenaSize);
+		frame.uploadArena->CommitMemory(MemoryType::kUpload);
+		frame.uploadArena->SetName("Frame Upload Arena " + std::to_string(i));
+	}
+}
+
+std::shared_ptr<CommandList> FrameContext::BeginFrame()
+{
+	instance.frameIndex++;
+
+	Frame& frame = instance.GetFrame();
+	instance.fence->Wait(frame.fenceValue);
+
+	frame.uploadOffset = 0;
+	frame.overflowBuffers.clear();
+	frame.usedCommandLists = 0;
+
+	return AcquireCommandList();
+}
+
+std::shared_ptr<CommandList> FrameContext::AcquireCommandList()
+{
+	Frame& frame = instance.GetFrame();
+
+	// Lists are created the first time a frame needs them and reused afterwards
+	if (frame.usedCommandLists == frame.commandLists.size())
+	{
+		unsigned frameSlot = instance.frameIndex % framesInFlight;
+		auto commandList = instance.device->CreateCommandList(CommandListType::kGraphics);
+		commandList->SetName("Main Rendering " + std::to_string(frameSlot) + " " + std::to_string(frame.commandLists.size()));
+		frame.commandLists.push_back(commandList);
+	}
+
+	return frame.commandLists[frame.usedCommandLists++];
+}
+
+void FrameContext::Submit(std::shared_ptr<CommandQueue> queue)
+{
+	Frame& frame = instance.GetFrame();
+	std::vector<std::shared_ptr<CommandList>> commandLists(frame.commandLists.begin(), frame.commandLists.begin() + frame.usedCommandLists);
+	queue->ExecuteCommandLists(commandLists);
+}
+
+void FrameContext::EndFrame(std::shared_ptr<CommandQueue> queue)
+{
+	Frame& frame = instance.GetFrame();
+	frame.fenceValue = ++instance.fenceValue;
+	queue->Signal(instance.fence, frame.fenceValue);
+}
+
+void FrameContext::WaitIdle()
+{
+	instance.fence->Wait(instance.fenceValue);
+}
+
+FrameContext::UploadAllocation FrameContext::Upload(const void* data, uint64_t size, uint64_t alignment)
+{
+	std::lock_guard<std::mutex> lock(instance.uploadMutex);
+	Frame& frame = instance.GetFrame();
+
+	uint64_t offset = Align(frame.uploadOffset, alignment);
+	if (offset + size <= uploadArenaSize)
+	{
+		frame.uploadOffset = offset + size;
+		frame.uploadArena->UpdateUploadBuffer(offset, data, size);
+		return { frame.uploadArena, offset, size };
+	}
+
+	// The arena is full, fall back to a buffer of its own so that the frame is still correct
+	if (!instance.reportedOverflow)
+	{
+		printf("Frame upload arena overflow, %llu bytes requested, increase FrameContext::uploadArenaSize\n", (unsigned long long)size);
+		instance.reportedOverflow = true;
+	}
+
+	auto buffer = instance.device->CreateBuffer(BindFlag::kCopySource, size);
+	buffer->CommitMemory(MemoryType::kUpload);
+	buffer->SetName("Frame Upload Overflow");
+	buffer->UpdateUploadBuffer(0, data, size);
+	frame.overflowBuffers.push_back(buffer);
+
+	return { buffer, 0, size };
+}
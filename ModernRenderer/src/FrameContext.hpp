@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Instance/Instance.h"
+#include <array>
+#include <mutex>
+#include <vector>
+
+// Ring of per-frame resources that lets the CPU record the next frame while the GPU renders the previous ones.
+// Everything owned by a frame context (command lists, upload arena) is only reused once the GPU has finished
+// the frame that last used it, which BeginFrame waits for with the fence value recorded by EndFrame.
+class FrameContext
+{
+public:
+	// Number of frames the CPU can record ahead of the GPU
+	static constexpr unsigned framesInFlight = 2;
+	// Readback rings need one more slot than the frames in flight: at the start of frame N, after BeginFrame,
+	// frame N - framesInFlight is complete and its slot can be read while the other slots are still in use
+	static constexpr unsigned readbackSlotCount = framesInFlight + 1;
+
+	static constexpr uint64_t uploadArenaSize = 4 * 1024 * 1024;
+	static constexpr uint64_t constantBufferAlignment = 256;
+
+	// Location of data written to an upload arena, valid until the frame completes on the GPU
+	struct UploadAllocation
+	{
+		std::shared_ptr<Resource> buffer;
+		uint64_t offset = 0;
+		uint64_t size = 0;
+	};
+
+private:
+	struct Frame
+	{
+		// Command lists are acquired in execution order, the first one is returned by BeginFrame
+		std::vector<std::shared_ptr<CommandList>> commandLists;
+		unsigned usedCommandLists = 0;
+		uint64_t fenceValue = 0;
+
+		// Linear allocator reset every time the frame context is reused
+		std::shared_ptr<Resource> uploadArena;
+		uint64_t uploadOffset = 0;
+		// Dedicated buffers for the allocations that didn't fit in the arena, released when the frame is reused
+		std::vector<std::shared_ptr<Resource>> overflowBuffers;
+	};
+
+	static FrameContext instance;
+
+	std::shared_ptr<Device> device;
+	std::shared_ptr<Fence> fence;
+	uint64_t fenceValue = 0;
+	std::array<Frame, framesInFlight> frames;
+	uint64_t frameIndex = 0;
+	bool reportedOverflow = false;
+	// Uploads can be done by the jobs recording render passes
+	std::mutex uploadMutex;
+
+	FrameContext() = default;
+	~FrameContext() = default;
+
+	Frame& GetFrame() { return frames[frameIndex % framesInFlight]; }
+
+public:
+	static void Init(std::shared_ptr<Device> device);
+
+	// Waits for the GPU to be done with the frame context and resets it, returns the first command list of the frame
+	static std::shared_ptr<CommandList> BeginFrame();
+	// Returns an additional command list of the frame, executed after the lists acquired before it.
+	// Must be called from the main thread, the list can then be recorded from any thread.
+	static std::shared_ptr<CommandList> AcquireCommandList();
+	// Executes the command lists acquired during the frame in a single submission
+	static void Submit(std::shared_ptr<CommandQueue> queue);
+	// Signals the fence once the command lists of the frame have been submitted to the queue
+	static void EndFrame(std::shared_ptr<CommandQueue> queue);
+	// Waits for every frame in flight, must be called before releasing resources used by the GPU
+	static void WaitIdle();
+
+	// Copies data to the upload arena of the current frame
+	static UploadAllocation Upload(const void* data, uint64_t size, uint64_t alignment = constantBufferAlignment);
+
+	// Number of frames started since the beginning of the application
+	static uint64_t GetFrameIndex() { return instance.frameIndex; }
+};
@@ -0,0 +1,225 @@
+#include "InstanceStore.hpp"
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// MSVC compiles the AVX intrinsics without /arch:AVX, GCC and Clang only in functions targeting AVX. Either way the
+// batches only run once IsAVXSupported has checked the CPU.
+#ifdef _MSC_VER
+#define AVX_TARGET
+#else
+#define AVX_TARGET __attribute__((target("avx")))
+#endif
+
+void InstanceStore::Clear()
+{
+	transforms.clear();
+	meshletIndices.clear();
+	meshletCounts.clear();
+	materialIndices.clear();
+	for (unsigned i = 0; i < 3; i++)
+	{
+		localCenters[i].clear();
+		halfExtents[i].clear();
+		obbRights[i].clear();
+		obbUps[i].clear();
+		obbCenters[i].clear();
+		obbExtents[i].clear();
+	}
+}
+
+void InstanceStore::Reserve(size_t count)
+{
+	transforms.reserve(count);
+	meshletIndices.reserve(count);
+	meshletCounts.reserve(count);
+	materialIndices.reserve(count);
+	for (unsigned i = 0; i < 3; i++)
+	{
+		localCenters[i].reserve(count);
+		halfExtents[i].reserve(count);
+		obbRights[i].reserve(count);
+		obbUps[i].reserve(count);
+		obbCenters[i].reserve(count);
+		obbExtents[i].reserve(count);
+	}
+}
+
+unsigned InstanceStore::Add(const glm::mat4& transform, const AABB& localBounds, unsigned meshletIndex, unsigned meshletCount, unsigned materialIndex)
+{
+	transforms.push_back(transform);
+	meshletIndices.push_back(meshletIndex);
+	meshletCounts.push_back(meshletCount);
+	materialIndices.push_back(materialIndex);
+
+	glm::vec3 center = (localBounds.min + localBounds.max) * 0.5f;
+	glm::vec3 extents = (localBounds.max - localBounds.min) * 0.5f;
+	for (unsigned i = 0; i < 3; i++)
+	{
+		localCenters[i].push_back(center[i]);
+		halfExtents[i].push_back(extents[i]);
+		obbRights[i].push_back(0.0f);
+		obbUps[i].push_back(0.0f);
+		obbCenters[i].push_back(0.0f);
+		obbExtents[i].push_back(0.0f);
+	}
+
+	return (unsigned)transforms.size() - 1;
+}
+
+void InstanceStore::SetTransform(size_t index, const glm::mat4& transform)
+{
+	transforms[index] = transform;
+}
+
+OBB InstanceStore::GetOBB(size_t index) const
+{
+	OBB obb;
+	obb.right = glm::vec3(obbRights[0][index], obbRights[1][index], obbRights[2][index]);
+	obb.up = glm::vec3(obbUps[0][index], obbUps[1][index], obbUps[2][index]);
+	obb.center = glm::vec3(obbCenters[0][index], obbCenters[1][index], obbCenters[2][index]);
+	obb.extentRight = obbExtents[0][index];
+	obb.extentUp = obbExtents[1][index];
+	obb.extentForward = obbExtents[2][index];
+	return obb;
+}
+
+void InstanceStore::ComputeBoundsScalar(size_t first, size_t count)
+{
+	for (size_t i = first; i < first + count; i++)
+	{
+		const glm::mat4& transform = transforms[i];
+		glm::vec4 center = glm::vec4(localCenters[0][i], localCenters[1][i], localCenters[2][i], 1.0f);
+
+		for (unsigned k = 0; k < 3; k++)
+		{
+			obbCenters[k][i] = glm::dot(center, transform[k]);
+
+			glm::vec3 axis = glm::vec3(transform[k]);
+			obbExtents[k][i] = glm::length(axis) * halfExtents[k][i];
+		}
+
+		glm::vec3 right = glm::vec3(transform[0]) / glm::length(glm::vec3(transform[0]));
+		glm::vec3 up = glm::vec3(transform[1]) / glm::length(glm::vec3(transform[1]));
+		for (unsigned k = 0; k < 3; k++)
+		{
+			obbRights[k][i] = right[k];
+			obbUps[k][i] = up[k];
+		}
+	}
+}
+
+AVX_TARGET static __m256 LoadColumnPair(const glm::mat4* matrices, unsigned column, unsigned i, unsigned j)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&matrices[i][column][0])), _mm_loadu_ps(&matrices[j][column][0]), 1);
+}
+
+// Loads the same column of 8 matrices, each output register holds one row of the column for the 8 matrices
+AVX_TARGET static void LoadColumn8(const glm::mat4* matrices, unsigned column, __m256& x, __m256& y, __m256& z, __m256& w)
+{
+	__m256 r04 = LoadColumnPair(matrices, column, 0, 4);
+	__m256 r15 = LoadColumnPair(matrices, column, 1, 5);
+	__m256 r26 = LoadColumnPair(matrices, column, 2, 6);
+	__m256 r37 = LoadColumnPair(matrices, column, 3, 7);
+
+	// x0 x1 y0 y1 | x4 x5 y4 y5 and z0 z1 w0 w1 | z4 z5 w4 w5, same for the odd pairs
+	__m256 xy01 = _mm256_unpacklo_ps(r04, r15);
+	__m256 zw01 = _mm256_unpackhi_ps(r04, r15);
+	__m256 xy23 = _mm256_unpacklo_ps(r26, r37);
+	__m256 zw23 = _mm256_unpackhi_ps(r26, r37);
+
+	x = _mm256_shuffle_ps(xy01, xy23, _MM_SHUFFLE(1, 0, 1, 0));
+	y = _mm256_shuffle_ps(xy01, xy23, _MM_SHUFFLE(3, 2, 3, 2));
+	z = _mm256_shuffle_ps(zw01, zw23, _MM_SHUFFLE(1, 0, 1, 0));
+	w = _mm256_shuffle_ps(zw01, zw23, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+AVX_TARGET void InstanceStore::ComputeBoundsBatch(size_t first)
+{
+	// columns[k][j]: component j of column k for the 8 instances
+	__m256 columns[3][4];
+	for (unsigned k = 0; k < 3; k++)
+		LoadColumn8(&transforms[first], k, columns[k][0], columns[k][1], columns[k][2], columns[k][3]);
+
+	__m256 center[3];
+	__m256 extents[3];
+	for (unsigned j = 0; j < 3; j++)
+	{
+		center[j] = _mm256_loadu_ps(&localCenters[j][first]);
+		extents[j] = _mm256_loadu_ps(&halfExtents[j][first]);
+	}
+
+	__m256 lengths[3];
+	for (unsigned k = 0; k < 3; k++)
+	{
+		__m256 worldCenter = _mm256_add_ps(
+			_mm256_add_ps(_mm256_mul_ps(columns[k][0], center[0]), _mm256_mul_ps(columns[k][1], center[1])),
+			_mm256_add_ps(_mm256_mul_ps(columns[k][2], center[2]), columns[k][3]));
+		_mm256_storeu_ps(&obbCenters[k][first], worldCenter);
+
+		__m256 squaredLength = _mm256_add_ps(
+			_mm256_add_ps(_mm256_mul_ps(columns[k][0], columns[k][0]), _mm256_mul_ps(columns[k][1], columns[k][1])),
+			_mm256_mul_ps(columns[k][2], columns[k][2]));
+		lengths[k] = _mm256_sqrt_ps(squaredLength);
+		_mm256_storeu_ps(&obbExtents[k][first], _mm256_mul_ps(lengths[k], extents[k]));
+	}
+
+	for (unsigned j = 0; j < 3; j++)
+	{
+		_mm256_storeu_ps(&obbRights[j][first], _mm256_div_ps(columns[0][j], lengths[0]));
+		_mm256_storeu_ps(&obbUps[j][first], _mm256_div_ps(columns[1][j], lengths[1]));
+	}
+}
+
+bool InstanceStore::IsAVXSupported()
+{
+	static const bool supported = []()
+	{
+#ifdef _MSC_VER
+		// AVX and OSXSAVE, then the OS must save the YMM registers
+		int info[4];
+		__cpuid(info, 1);
+		bool avx = (info[2] & (1 << 28)) != 0 && (info[2] & (1 << 27)) != 0;
+		return avx && (_xgetbv(0) & 6) == 6;
+#else
+		return __builtin_cpu_supports("avx") != 0;
+#endif
+	}();
+	return supported;
+}
+
+void InstanceStore::ComputeBounds(size_t first, size_t count)
+{
+	if (!IsAVXSupported())
+	{
+		ComputeBoundsScalar(first, count);
+		return;
+	}
+
+	size_t batchEnd = first + count - count % batchSize;
+	for (size_t i = first; i < batchEnd; i += batchSize)
+		ComputeBoundsBatch(i);
+
+	ComputeBoundsScalar(batchEnd, first + count - batchEnd);
+}
+
+void InstanceStore::Pack(size_t first, size_t count, GPUInstanceData* output) const
+{
+	for (size_t i = first; i < first + count; i++)
+	{
+		GPUInstanceData& data = *output++;
+		data.objectToWorld = transforms[i];
+		data.meshletIndex = meshletIndices[i];
+		data.materialIndex = materialIndices[i];
+		data.meshletCount = meshletCounts[i];
+		data.obb = GetOBB(i);
+	}
+}
+
+std::vector<GPUInstanceData> InstanceStore::Pack() const
+{
+	std::vector<GPUInstanceData> packed(GetCount());
+	Pack(0, GetCount(), packed.data());
+	return packed;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "BoundingVolumes.hpp"
+
+// Keep in sync with InstanceData in Common.hlsl
+struct GPUInstanceData
+{
+	glm::mat4x4 objectToWorld;
+	unsigned meshletIndex;
+	unsigned materialIndex;
+	unsigned meshletCount;
+	OBB obb;
+};
+
+// CPU copy of the scene instances stored as a structure of arrays. Transforms, mesh and material indices and bounds
+// live in separate arrays so that each loop only reads what it needs, and the OBBs are computed 8 instances at a
+// time with AVX. Instances are packed in the GPU layout (GPUInstanceData) when they are uploaded.
+class InstanceStore
+{
+public:
+	static constexpr size_t batchSize = 8;
+
+private:
+	// Stored transposed, like ModelInstance::transform
+	std::vector<glm::mat4> transforms;
+	std::vector<uint32_t> meshletIndices;
+	std::vector<uint32_t> meshletCounts;
+	std::vector<uint32_t> materialIndices;
+
+	// Object space bounds of the meshes, one array per component
+	std::array<std::vector<float>, 3> localCenters;
+	std::array<std::vector<float>, 3> halfExtents;
+
+	// World space OBBs, one array per component. The extents are along right, up and forward.
+	std::array<std::vector<float>, 3> obbRights;
+	std::array<std::vector<float>, 3> obbUps;
+	std::array<std::vector<float>, 3> obbCenters;
+	std::array<std::vector<float>, 3> obbExtents;
+
+	void ComputeBoundsBatch(size_t first);
+
+public:
+	size_t GetCount() const { return transforms.size(); }
+	void Clear();
+	void Reserve(size_t count);
+
+	// Returns the index of the instance, its OBB is only valid once ComputeBounds is called
+	unsigned Add(const glm::mat4& transform, const AABB& localBounds, unsigned meshletIndex, unsigned meshletCount, unsigned materialIndex);
+	void SetTransform(size_t index, const glm::mat4& transform);
+	const glm::mat4& GetTransform(size_t index) const { return transforms[index]; }
+	// The meshlets of a mesh move when the MeshPool heaps are compacted
+	void SetMeshletIndex(size_t index, unsigned meshletIndex) { meshletIndices[index] = meshletIndex; }
+	OBB GetOBB(size_t index) const;
+
+	// Transforms the object space bounds of the instances to world space OBBs, same result as the OBB constructor.
+	// Full batches of 8 instances use AVX, the remaining ones ComputeBoundsScalar. Without AVX every instance uses
+	// ComputeBoundsScalar.
+	void ComputeBounds(size_t first, size_t count);
+	void ComputeBoundsScalar(size_t first, size_t count);
+	static bool IsAVXSupported();
+
+	void Pack(size_t first, size_t count, GPUInstanceData* output) const;
+	std::vector<GPUInstanceData> Pack() const;
+};
@@ -0,0 +1,190 @@
+#include "InstanceUpdater.hpp"
+#include "FrameContext.hpp"
+#include "PipelineRegistry.hpp"
+#include "Timer.hpp"
+#include <algorithm>
+
+static const BindKey instanceUpdatesKey = { ShaderType::kCompute, ViewType::kStructuredBuffer, 0, 0 };
+static const BindKey instanceUpdateIndicesKey = { ShaderType::kCompute, ViewType::kBuffer, 1, 0 };
+static const BindKey instancesKey = { ShaderType::kCompute, ViewType::kRWStructuredBuffer, 0, 0 };
+
+InstanceUpdater::InstanceUpdater(std::shared_ptr<Device> device, Camera& camera)
+{
+	this->device = device;
+	this->camera = &camera;
+
+	scatterLayoutSet = RenderUtils::CreateLayoutSet(device, camera, { instanceUpdatesKey, instanceUpdateIndicesKey, instancesKey }, 0, RenderUtils::Compute);
+	CreatePipeline();
+
+	// Edited shaders are recompiled in the background, the pipeline is created again once they are ready
+	PipelineRegistry::AddReloadListener(this, [this]() { CreatePipeline(); });
+}
+
+InstanceUpdater::~InstanceUpdater()
+{
+	PipelineRegistry::RemoveReloadListener(this);
+}
+
+void InstanceUpdater::RequestShaders()
+{
+	PipelineRegistry::Request(RenderUtils::GetComputeShaderDesc("shaders/InstanceScatterUpdate.hlsl", "main"));
+}
+
+void InstanceUpdater::CreatePipeline()
+{
+	scatterProgram = RenderUtils::CreateComputePipeline(device, "shaders/InstanceScatterUpdate.hlsl", "main", scatterLayoutSet);
+}
+
+void InstanceUpdater::ReserveStaging(unsigned instanceCount)
+{
+	if (instanceCount <= stagingCapacity)
+		return;
+
+	// Rare, the previous buffers can still be read by the frames in flight
+	if (stagingBuffer)
+		FrameContext::WaitIdle();
+	RenderUtils::InvalidateBindingSets(scatterBindings);
+	scatterSet = nullptr;
+
+	stagingCapacity = std::max({ instanceCount, stagingCapacity * 2, minStagingCapacity });
+
+	stagingBuffer = device->CreateBuffer(BindFlag::kShaderResource | BindFlag::kCopyDest, sizeof(Scene::InstanceData) * stagingCapacity);
+	stagingBuffer->CommitMemory(MemoryType::kDefault);
+	stagingBuffer->SetName("Instance Update Staging");
+
+	ViewDesc viewDesc = {};
+	viewDesc.view_type = ViewType::kStructuredBuffer;
+	viewDesc.dimension = ViewDimension::kBuffer;
+	viewDesc.buffer_size = sizeof(Scene::InstanceData) * stagingCapacity;
+	viewDesc.structure_stride = sizeof(Scene::InstanceData);
+	stagingView = device->CreateView(stagingBuffer, viewDesc);
+
+	stagingIndexBuffer = device->CreateBuffer(BindFlag::kShaderResource | BindFlag::kCopyDest, sizeof(uint32_t) * (stagingCapacity + 1));
+	stagingIndexBuffer->CommitMemory(MemoryType::kDefault);
+	stagingIndexBuffer->SetName("Instance Update Indices");
+
+	viewDesc = {};
+	viewDesc.view_type = ViewType::kBuffer;
+	viewDesc.dimension = ViewDimension::kBuffer;
+	viewDesc.buffer_format = gli::FORMAT_R32_UINT_PACK32;
+	viewDesc.buffer_size = sizeof(uint32_t) * (stagingCapacity + 1);
+	viewDesc.structure_stride = sizeof(uint32_t);
+	stagingIndexView = device->CreateView(stagingIndexBuffer, viewDesc);
+}
+
+void InstanceUpdater::UpdateBindingSet()
+{
+	if (scatterSet && boundInstanceBuffer == Scene::instanceDataBuffer.get())
+		return;
+
+	if (boundInstanceBuffer != Scene::instanceDataBuffer.get())
+	{
+		ViewDesc viewDesc = {};
+		viewDesc.view_type = ViewType::kRWStructuredBuffer;
+		viewDesc.dimension = ViewDimension::kBuffer;
+		viewDesc.buffer_size = Scene::instanceDataBuffer->GetWidth();
+		viewDesc.structure_stride = sizeof(Scene::InstanceData);
+		instanceBufferUAV = device->CreateView(Scene::instanceDataBuffer, viewDesc);
+		boundInstanceBuffer = Scene::instanceDataBuffer.get();
+	}
+
+	RenderUtils::InvalidateBindingSets(scatterBindings);
+	scatterBindings = {
+		{ instanceUpdatesKey, stagingView },
+		{ instanceUpdateIndicesKey, stagingIndexView },
+		{ instancesKey, instanceBufferUAV },
+	};
+	scatterSet = RenderUtils::CreateBindingSet(device, scatterLayoutSet, *camera, scatterBindings, 0, RenderUtils::Compute);
+}
+
+void InstanceUpdater::Record(std::shared_ptr<CommandList> cmd, Scene& scene)
+{
+	statistics = {};
+	if (scene.dirtyInstanceCount == 0)
+		return;
+
+	uint64_t startTicks = Timer::GetTicks();
+
+	ranges.clear();
+	scene.ConsumeDirtyInstanceRanges(ranges);
+
+	// Only the dirty instances are uploaded, their bounds are computed and they are packed in the order of their ranges
+	unsigned updateCount = 0;
+	for (const auto& range : ranges)
+		updateCount += range.count;
+
+	packedInstances.resize(updateCount);
+	Scene::InstanceData* packed = packedInstances.data();
+	for (const auto& range : ranges)
+	{
+		scene.instanceStore.ComputeBounds(range.first, range.count);
+		scene.instanceStore.Pack(range.first, range.count, packed);
+		packed += range.count;
+	}
+
+	uint64_t dataSize = sizeof(Scene::InstanceData) * updateCount;
+	auto dataUpload = FrameContext::Upload(packedInstances.data(), dataSize);
+	std::shared_ptr<Resource> instanceBuffer = Scene::instanceDataBuffer;
+
+	statistics.updatedInstances = updateCount;
+	statistics.rangeCount = (unsigned)ranges.size();
+	statistics.uploadBytes = dataSize;
+	statistics.scattered = UsesScatter(ranges.size());
+
+	if (!statistics.scattered)
+	{
+		std::vector<BufferCopyRegion> regions;
+		uint64_t sourceOffset = dataUpload.offset;
+		for (const auto& range : ranges)
+		{
+			uint64_t size = sizeof(Scene::InstanceData) * range.count;
+			regions.push_back({ sourceOffset, sizeof(Scene::InstanceData) * range.first, size });
+			sourceOffset += size;
+		}
+
+		cmd->ResourceBarrier({ { instanceBuffer, ResourceState::kCommon, ResourceState::kCopyDest } });
+		cmd->CopyBuffer(dataUpload.buffer, instanceBuffer, regions);
+		cmd->ResourceBarrier({ { instanceBuffer, ResourceState::kCopyDest, ResourceState::kCommon } });
+	}
+	else
+	{
+		ReserveStaging(updateCount);
+		UpdateBindingSet();
+
+		packedIndices.clear();
+		packedIndices.push_back(updateCount);
+		for (const auto& range : ranges)
+		{
+			for (unsigned i = 0; i < range.count; i++)
+				packedIndices.push_back(range.first + i);
+		}
+
+		uint64_t indicesSize = sizeof(uint32_t) * packedIndices.size();
+		auto indicesUpload = FrameContext::Upload(packedIndices.data(), indicesSize);
+		statistics.uploadBytes += indicesSize;
+
+		cmd->ResourceBarrier({
+			{ stagingBuffer, ResourceState::kCommon, ResourceState::kCopyDest },
+			{ stagingIndexBuffer, ResourceState::kCommon, ResourceState::kCopyDest },
+		});
+		cmd->CopyBuffer(dataUpload.buffer, stagingBuffer, { { dataUpload.offset, 0, dataSize } });
+		cmd->CopyBuffer(indicesUpload.buffer, stagingIndexBuffer, { { indicesUpload.offset, 0, indicesSize } });
+		cmd->ResourceBarrier({
+			{ stagingBuffer, ResourceState::kCopyDest, ResourceState::kNonPixelShaderResource },
+			{ stagingIndexBuffer, ResourceState::kCopyDest, ResourceState::kNonPixelShaderResource },
+			{ instanceBuffer, ResourceState::kCommon, ResourceState::kUnorderedAccess },
+		});
+
+		cmd->BindPipeline(scatterProgram.pipeline);
+		cmd->BindBindingSet(scatterSet);
+		cmd->Dispatch((updateCount + threadGroupSize - 1) / threadGroupSize, 1, 1);
+
+		cmd->ResourceBarrier({
+			{ stagingBuffer, ResourceState::kNonPixelShaderResource, ResourceState::kCommon },
+			{ stagingIndexBuffer, ResourceState::kNonPixelShaderResource, ResourceState::kCommon },
+			{ instanceBuffer, ResourceState::kUnorderedAccess, ResourceState::kCommon },
+		});
+	}
+
+	statistics.cpuMillis = Timer::TicksToSeconds(Timer::GetTicks() - startTicks) * 1000.0;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Instance/Instance.h"
+#include "Camera.hpp"
+#include "Scene.hpp"
+#include "RenderUtils.hpp"
+
+// Uploads the InstanceData modified on the CPU since the previous frame (see Scene::SetInstanceTransform), so the
+// cost of a frame depends on the number of moved instances and not on the size of the scene. The dirty instances
+// are packed in the frame upload arena, then:
+// - a few ranges of consecutive instances are copied directly to the instance buffer
+// - otherwise they are copied to a staging buffer and scattered to their index by InstanceScatterUpdate.hlsl
+class InstanceUpdater
+{
+public:
+	// Above this number of ranges a single scatter dispatch is cheaper than one copy region per range
+	static constexpr size_t maxCopyRanges = 16;
+	static constexpr unsigned minStagingCapacity = 1024;
+	// Keep in sync with InstanceScatterUpdate.hlsl
+	static constexpr unsigned threadGroupSize = 64;
+
+	// Work done for the last frame
+	struct Statistics
+	{
+		unsigned updatedInstances = 0;
+		unsigned rangeCount = 0;
+		uint64_t uploadBytes = 0;
+		bool scattered = false;
+		// Packing and recording of the update on the CPU
+		double cpuMillis = 0;
+	};
+
+private:
+	std::shared_ptr<Device> device;
+	Camera* camera;
+
+	// Packed dirty instances, the first index is the update count followed by the destination of each update
+	unsigned stagingCapacity = 0;
+	std::shared_ptr<Resource> stagingBuffer;
+	std::shared_ptr<View> stagingView;
+	std::shared_ptr<Resource> stagingIndexBuffer;
+	std::shared_ptr<View> stagingIndexView;
+
+	// The instance buffer is created again when the scene is uploaded, the view follows it
+	Resource* boundInstanceBuffer = nullptr;
+	std::shared_ptr<View> instanceBufferUAV;
+
+	std::shared_ptr<BindingSetLayout> scatterLayoutSet;
+	std::shared_ptr<BindingSet> scatterSet;
+	std::vector<BindingDesc> scatterBindings;
+	RenderUtils::ComputeProgram scatterProgram;
+
+	// Reused every frame to avoid allocations
+	std::vector<Scene::InstanceRange> ranges;
+	std::vector<Scene::InstanceData> packedInstances;
+	std::vector<uint32_t> packedIndices;
+
+	Statistics statistics;
+
+	void CreatePipeline();
+	void ReserveStaging(unsigned instanceCount);
+	void UpdateBindingSet();
+
+public:
+	InstanceUpdater(std::shared_ptr<Device> device, Camera& camera);
+	~InstanceUpdater();
+
+	static void RequestShaders();
+
+	// Records the upload of the dirty instances of the scene and clears their dirty bits. The instance buffer is
+	// in the common state before and after the update.
+	void Record(std::shared_ptr<CommandList> cmd, Scene& scene);
+
+	// True when the ranges of a frame are scattered by a dispatch instead of copied with one region each
+	static bool UsesScatter(size_t rangeCount) { return rangeCount > maxCopyRanges; }
+
+	const Statistics& GetStatistics() const { return statistics; }
+};
@@ -0,0 +1,178 @@
+#include "JobSystem.hpp"
+#include <algorithm>
+#include <cstdio>
+
+JobSystem JobSystem::instance;
+thread_local unsigned JobSystem::workerIndex = 0;
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+void JobSystem::Init(unsigned threadCount)
+{
+	if (instance.running)
+		return;
+
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+
+	instance.running = true;
+	for (unsigned i = 0; i < threadCount + 1; i++)
+		instance.workers.push_back(std::make_unique<Worker>());
+	for (unsigned i = 1; i < threadCount + 1; i++)
+		instance.threads.emplace_back([i]() { instance.WorkerLoop(i); });
+
+	printf("Job system: %u worker threads\n", threadCount);
+}
+
+void JobSystem::Shutdown()
+{
+	if (!instance.running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(instance.sleepMutex);
+		instance.running = false;
+	}
+	instance.wakeCondition.notify_all();
+
+	for (auto& thread : instance.threads)
+		thread.join();
+	instance.threads.clear();
+	instance.workers.clear();
+	instance.background.jobs.clear();
+	instance.queuedJobs = 0;
+}
+
+void JobSystem::WorkerLoop(unsigned index)
+{
+	workerIndex = index;
+
+	while (running)
+	{
+		if (TryRunJob(index))
+			continue;
+
+		// queuedJobs is incremented before the notification, a job scheduled in between is never missed
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wakeCondition.wait(lock, [this]() { return queuedJobs > 0 || !running; });
+	}
+}
+
+bool JobSystem::TryRunJob(unsigned index)
+{
+	ScheduledJob scheduled;
+	bool found = false;
+
+	// Newest job of the own queue first, it is the most likely to use data still in the cache
+	{
+		Worker& worker = *workers[index];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (!worker.jobs.empty())
+		{
+			scheduled = std::move(worker.jobs.back());
+			worker.jobs.pop_back();
+			found = true;
+		}
+	}
+
+	// Otherwise steal the oldest job of another worker
+	for (unsigned i = 1; i < workers.size() && !found; i++)
+	{
+		Worker& victim = *workers[(index + i) % workers.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.jobs.empty())
+		{
+			scheduled = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			found = true;
+		}
+	}
+
+	// Background jobs last, and only on the worker threads
+	if (!found && index != 0)
+	{
+		std::lock_guard<std::mutex> lock(background.mutex);
+		if (!background.jobs.empty())
+		{
+			scheduled = std::move(background.jobs.front());
+			background.jobs.pop_front();
+			found = true;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	queuedJobs--;
+	scheduled.job();
+	scheduled.counter->fetch_sub(1);
+	return true;
+}
+
+void JobSystem::Schedule(Job job, Counter& counter)
+{
+	counter++;
+
+	if (instance.workers.empty())
+	{
+		job();
+		counter--;
+		return;
+	}
+
+	// Threads that are not workers push to the queue of the main thread, the workers steal from it
+	Worker& worker = *instance.workers[workerIndex < instance.workers.size() ? workerIndex : 0];
+	instance.queuedJobs++;
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.jobs.push_back({ std::move(job), &counter });
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(instance.sleepMutex);
+	}
+	instance.wakeCondition.notify_one();
+}
+
+void JobSystem::ScheduleBackground(Job job, Counter& counter)
+{
+	counter++;
+
+	if (instance.workers.size() < 2)
+	{
+		job();
+		counter--;
+		return;
+	}
+
+	instance.queuedJobs++;
+	{
+		std::lock_guard<std::mutex> lock(instance.background.mutex);
+		instance.background.jobs.push_back({ std::move(job), &counter });
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(instance.sleepMutex);
+	}
+	instance.wakeCondition.notify_one();
+}
+
+void JobSystem::Wait(Counter& counter)
+{
+	while (counter > 0)
+	{
+		if (instance.workers.empty() || !instance.TryRunJob(workerIndex))
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::ParallelFor(unsigned count, const std::function<void(unsigned index)>& function)
+{
+	Counter counter = 0;
+	for (unsigned i = 0; i < count; i++)
+		Schedule([&function, i]() { function(i); }, counter);
+	Wait(counter);
+}
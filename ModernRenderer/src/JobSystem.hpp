@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// CPU job scheduler with work stealing. Every worker owns a queue of jobs: it takes the newest job of its own
+// queue and steals the oldest job of the other queues once its queue is empty, so the jobs spread over the
+// threads without a shared queue. The main thread is worker 0 and runs jobs while it waits for them.
+// Background jobs go to a separate queue that only the worker threads take from, once they have no other job, so
+// long jobs scheduled outside of the frame never run on the main thread.
+// Without Init, jobs run immediately on the calling thread.
+class JobSystem
+{
+public:
+	using Job = std::function<void()>;
+	// Number of unfinished jobs of a group, incremented by Schedule and waited on by Wait
+	using Counter = std::atomic<unsigned>;
+
+private:
+	struct ScheduledJob
+	{
+		Job job;
+		Counter* counter;
+	};
+
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<ScheduledJob> jobs;
+	};
+
+	static JobSystem instance;
+	static thread_local unsigned workerIndex;
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	Worker background;
+	std::vector<std::thread> threads;
+	std::atomic<bool> running = false;
+
+	// Idle workers sleep until jobs are scheduled
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+	std::atomic<unsigned> queuedJobs = 0;
+
+	JobSystem() = default;
+	~JobSystem();
+
+	void WorkerLoop(unsigned index);
+	bool TryRunJob(unsigned index);
+
+public:
+	// Starts threadCount worker threads in addition to the main thread, 0 uses one thread per core
+	static void Init(unsigned threadCount = 0);
+	// Waits for the worker threads to finish their current job and stops them
+	static void Shutdown();
+
+	static void Schedule(Job job, Counter& counter);
+	// Low priority job that is never run by the main thread, runs immediately on the calling thread when there is no
+	// worker thread. Waiting for it from the main thread doesn't help it progress.
+	static void ScheduleBackground(Job job, Counter& counter);
+	// Runs queued jobs on the calling thread until every job of the counter is finished
+	static void Wait(Counter& counter);
+	// Calls function(i) for every i in [0, count) from all the workers and waits for the calls to finish
+	static void ParallelFor(unsigned count, const std::function<void(unsigned index)>& function);
+
+	// Number of threads running jobs, including the main thread
+	static unsigned GetWorkerCount() { return std::max<unsigned>((unsigned)instance.workers.size(), 1); }
+};
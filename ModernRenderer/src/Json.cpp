@@ -0,0 +1,341 @@
+#include "Json.hpp"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cstdio>
+
+const JsonValue* JsonValue::Find(const std::string& key) const
+{
+	if (type != Type::Object)
+		return nullptr;
+
+	for (const auto& member : object)
+		if (member.first == key)
+			return &member.second;
+	return nullptr;
+}
+
+bool JsonValue::GetBool(const std::string& key, bool defaultValue) const
+{
+	const JsonValue* value = Find(key);
+	return value != nullptr && value->IsBool() ? value->boolean : defaultValue;
+}
+
+double JsonValue::GetNumber(const std::string& key, double defaultValue) const
+{
+	const JsonValue* value = Find(key);
+	return value != nullptr && value->IsNumber() ? value->number : defaultValue;
+}
+
+std::string JsonValue::GetString(const std::string& key, const std::string& defaultValue) const
+{
+	const JsonValue* value = Find(key);
+	return value != nullptr && value->IsString() ? value->string : defaultValue;
+}
+
+// Recursive descent parser, the nesting depth is limited to avoid stack overflows on malformed files
+class JsonParser
+{
+private:
+	static constexpr int maxDepth = 256;
+
+	const std::string& text;
+	size_t position = 0;
+	std::string error;
+
+	bool Fail(const std::string& reason)
+	{
+		if (error.empty())
+		{
+			size_t line = 1 + std::count(text.begin(), text.begin() + std::min(position, text.size()), '\n');
+			error = "line " + std::to_string(line) + ": " + reason;
+		}
+		return false;
+	}
+
+	void SkipWhitespace()
+	{
+		while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+			position++;
+	}
+
+	bool Consume(char c)
+	{
+		SkipWhitespace();
+		if (position < text.size() && text[position] == c)
+		{
+			position++;
+			return true;
+		}
+		return false;
+	}
+
+	bool ConsumeLiteral(const char* literal)
+	{
+		size_t length = strlen(literal);
+		if (text.compare(position, length, literal) != 0)
+			return false;
+		position += length;
+		return true;
+	}
+
+	static void AppendUTF8(std::string& out, uint32_t codepoint)
+	{
+		if (codepoint < 0x80)
+			out += (char)codepoint;
+		else if (codepoint < 0x800)
+		{
+			out += (char)(0xC0 | (codepoint >> 6));
+			out += (char)(0x80 | (codepoint & 0x3F));
+		}
+		else if (codepoint < 0x10000)
+		{
+			out += (char)(0xE0 | (codepoint >> 12));
+			out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+			out += (char)(0x80 | (codepoint & 0x3F));
+		}
+		else
+		{
+			out += (char)(0xF0 | (codepoint >> 18));
+			out += (char)(0x80 | ((codepoint >> 12) & 0x3F));
+			out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+			out += (char)(0x80 | (codepoint & 0x3F));
+		}
+	}
+
+	bool ParseHex4(uint32_t& value)
+	{
+		if (position + 4 > text.size())
+			return Fail("truncated unicode escape");
+
+		value = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			char c = text[position++];
+			value <<= 4;
+			if (c >= '0' && c <= '9') value |= c - '0';
+			else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+			else return Fail("invalid unicode escape");
+		}
+		return true;
+	}
+
+	bool ParseString(std::string& out)
+	{
+		if (!Consume('"'))
+			return Fail("expected string");
+
+		out.clear();
+		while (position < text.size())
+		{
+			char c = text[position++];
+			if (c == '"')
+				return true;
+			if ((unsigned char)c < 0x20)
+				return Fail("control character in string");
+			if (c != '\\')
+			{
+				out += c;
+				continue;
+			}
+
+			if (position >= text.size())
+				break;
+			char escape = text[position++];
+			switch (escape)
+			{
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u':
+				{
+					uint32_t codepoint;
+					if (!ParseHex4(codepoint))
+						return false;
+					// Surrogate pair
+					if (codepoint >= 0xD800 && codepoint < 0xDC00 && ConsumeLiteral("\\u"))
+					{
+						uint32_t low;
+						if (!ParseHex4(low))
+							return false;
+						if (low >= 0xDC00 && low < 0xE000)
+							codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+					}
+					AppendUTF8(out, codepoint);
+					break;
+				}
+				default:
+					return Fail(std::string("invalid escape \\") + escape);
+			}
+		}
+		return Fail("unterminated string");
+	}
+
+	bool ParseNumber(double& out)
+	{
+		size_t start = position;
+		if (position < text.size() && text[position] == '-')
+			position++;
+		while (position < text.size() && (isdigit((unsigned char)text[position]) || text[position] == '.' || text[position] == 'e' || text[position] == 'E' || text[position] == '+' || text[position] == '-'))
+			position++;
+
+		std::string number = text.substr(start, position - start);
+		char* end = nullptr;
+		out = strtod(number.c_str(), &end);
+		if (number.empty() || end != number.c_str() + number.size())
+		{
+			position = start;
+			return Fail("invalid number");
+		}
+		return true;
+	}
+
+	bool ParseValue(JsonValue& value, int depth)
+	{
+		if (depth > maxDepth)
+			return Fail("too many nested values");
+
+		SkipWhitespace();
+		if (position >= text.size())
+			return Fail("unexpected end of file");
+
+		char c = text[position];
+		if (c == '{')
+		{
+			position++;
+			value.type = JsonValue::Type::Object;
+			if (Consume('}'))
+				return true;
+			do
+			{
+				std::pair<std::string, JsonValue> member;
+				SkipWhitespace();
+				if (!ParseString(member.first))
+					return false;
+				if (!Consume(':'))
+					return Fail("expected ':' after key \"" + member.first + "\"");
+				if (!ParseValue(member.second, depth + 1))
+					return false;
+				value.object.push_back(std::move(member));
+			} while (Consume(','));
+			return Consume('}') ? true : Fail("expected ',' or '}'");
+		}
+		if (c == '[')
+		{
+			position++;
+			value.type = JsonValue::Type::Array;
+			if (Consume(']'))
+				return true;
+			do
+			{
+				value.array.emplace_back();
+				if (!ParseValue(value.array.back(), depth + 1))
+					return false;
+			} while (Consume(','));
+			return Consume(']') ? true : Fail("expected ',' or ']'");
+		}
+		if (c == '"')
+		{
+			value.type = JsonValue::Type::String;
+			return ParseString(value.string);
+		}
+		if (ConsumeLiteral("true"))
+		{
+			value.type = JsonValue::Type::Bool;
+			value.boolean = true;
+			return true;
+		}
+		if (ConsumeLiteral("false"))
+		{
+			value.type = JsonValue::Type::Bool;
+			value.boolean = false;
+			return true;
+		}
+		if (ConsumeLiteral("null"))
+		{
+			value.type = JsonValue::Type::Null;
+			return true;
+		}
+		if (c == '-' || isdigit((unsigned char)c))
+		{
+			value.type = JsonValue::Type::Number;
+			return ParseNumber(value.number);
+		}
+
+		return Fail(std::string("unexpected character '") + c + "'");
+	}
+
+public:
+	JsonParser(const std::string& text) : text(text) {}
+
+	bool Parse(JsonValue& result, std::string& outError)
+	{
+		result = JsonValue();
+		bool success = ParseValue(result, 0);
+		SkipWhitespace();
+		if (success && position != text.size())
+			success = Fail("unexpected data after the end of the document");
+		outError = error;
+		return success;
+	}
+};
+
+bool JsonValue::Parse(const std::string& text, JsonValue& result, std::string& error)
+{
+	JsonParser parser(text);
+	return parser.Parse(result, error);
+}
+
+bool JsonValue::ParseFile(const std::string& path, JsonValue& result)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		printf("Failed to open %s\n", path.c_str());
+		return false;
+	}
+
+	std::stringstream content;
+	content << file.rdbuf();
+
+	std::string error;
+	if (!Parse(content.str(), result, error))
+	{
+		printf("Failed to parse %s, %s\n", path.c_str(), error.c_str());
+		return false;
+	}
+	return true;
+}
+
+std::string EscapeJSON(const std::string& value)
+{
+	std::string escaped;
+	escaped.reserve(value.size());
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\')
+		{
+			escaped += '\\';
+			escaped += c;
+		}
+		else if ((unsigned char)c < 0x20)
+		{
+			char code[8];
+			snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+			escaped += code;
+		}
+		else
+		{
+			escaped += c;
+		}
+	}
+	return escaped;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+// Minimal JSON document used by the data files of the renderer (scenes, reports are only written).
+// Objects keep the order of their keys, numbers are stored as double.
+class JsonValue
+{
+public:
+	enum class Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object,
+	};
+
+	Type type = Type::Null;
+	bool boolean = false;
+	double number = 0;
+	std::string string;
+	std::vector<JsonValue> array;
+	std::vector<std::pair<std::string, JsonValue>> object;
+
+	bool IsNull() const { return type == Type::Null; }
+	bool IsBool() const { return type == Type::Bool; }
+	bool IsNumber() const { return type == Type::Number; }
+	bool IsString() const { return type == Type::String; }
+	bool IsArray() const { return type == Type::Array; }
+	bool IsObject() const { return type == Type::Object; }
+
+	// Returns nullptr if this is not an object or if the key doesn't exist
+	const JsonValue* Find(const std::string& key) const;
+
+	// Typed accessors of object members, return the default value when the member is missing or has another type
+	bool GetBool(const std::string& key, bool defaultValue) const;
+	double GetNumber(const std::string& key, double defaultValue) const;
+	std::string GetString(const std::string& key, const std::string& defaultValue) const;
+
+	// Parses a whole document, on failure error contains the line and the reason
+	static bool Parse(const std::string& text, JsonValue& result, std::string& error);
+	static bool ParseFile(const std::string& path, JsonValue& result);
+};
+
+// Escapes a string written between quotes in a JSON document (reports, traces)
+std::string EscapeJSON(const std::string& value);
@@ -0,0 +1,122 @@
+#include "MaterialClassification.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+MaterialClassification::TileLists MaterialClassification::ClassifyTiles(const std::vector<uint32_t>& visibility, const std::vector<float>& depth, unsigned width, unsigned height,
+    VisibilityBuffer::Format format, const std::vector<SoftwareRasterizer::VisibleMeshlet>& visibleMeshlets,
+    const std::vector<Scene::InstanceData>& instances, unsigned materialCount)
+{
+    TileLists lists;
+    lists.tileCountX = (width + tileSize - 1) / tileSize;
+    lists.tileCountY = (height + tileSize - 1) / tileSize;
+    lists.materialTiles.resize(materialCount);
+
+    unsigned componentCount = VisibilityBuffer::GetComponentCount(format);
+    std::vector<uint32_t> tileMaterials;
+
+    for (unsigned tileY = 0; tileY < lists.tileCountY; tileY++)
+    {
+        for (unsigned tileX = 0; tileX < lists.tileCountX; tileX++)
+        {
+            tileMaterials.clear();
+
+            for (unsigned y = tileY * tileSize; y < std::min((tileY + 1) * tileSize, height); y++)
+            {
+                for (unsigned x = tileX * tileSize; x < std::min((tileX + 1) * tileSize, width); x++)
+                {
+                    unsigned pixel = y * width + x;
+                    if (depth[pixel] >= 1.0f)
+                        continue;
+
+                    uint32_t visibleMeshletID, triangleID;
+                    if (format == VisibilityBuffer::Format::R32G32)
+                    {
+                        uint32_t instanceID;
+                        uint64_t packed = visibility[pixel * componentCount] | ((uint64_t)visibility[pixel * componentCount + 1] << 32);
+                        VisibilityBuffer::DecodeVisibility64(packed, instanceID, visibleMeshletID, triangleID);
+                    }
+                    else
+                        VisibilityBuffer::DecodeVisibility(visibility[pixel], visibleMeshletID, triangleID);
+
+                    if (visibleMeshletID >= visibleMeshlets.size() || visibleMeshlets[visibleMeshletID].instanceIndex >= instances.size())
+                    {
+                        lists.invalidPixelCount++;
+                        continue;
+                    }
+                    uint32_t material = instances[visibleMeshlets[visibleMeshletID].instanceIndex].materialIndex;
+                    if (material >= materialCount)
+                    {
+                        lists.invalidPixelCount++;
+                        continue;
+                    }
+                    if (std::find(tileMaterials.begin(), tileMaterials.end(), material) == tileMaterials.end())
+                        tileMaterials.push_back(material);
+                }
+            }
+
+            for (uint32_t material : tileMaterials)
+                lists.materialTiles[material].push_back(PackTile(tileX, tileY));
+        }
+    }
+
+    return lists;
+}
+
+MaterialClassification::TileLists MaterialClassification::FromGPUBuffers(const std::vector<uint32_t>& tileCounts, const std::vector<uint32_t>& tiles, unsigned tileCountX, unsigned tileCountY)
+{
+    TileLists lists;
+    lists.tileCountX = tileCountX;
+    lists.tileCountY = tileCountY;
+    lists.materialTiles.resize(tileCounts.size());
+
+    size_t listCapacity = (size_t)tileCountX * tileCountY;
+    for (size_t material = 0; material < tileCounts.size(); material++)
+    {
+        size_t count = std::min<size_t>(tileCounts[material], listCapacity);
+        auto begin = tiles.begin() + material * listCapacity;
+        lists.materialTiles[material].assign(begin, begin + count);
+    }
+
+    return lists;
+}
+
+MaterialClassification::Comparison MaterialClassification::CompareTileLists(const TileLists& reference, const TileLists& other)
+{
+    Comparison comparison;
+    if (reference.tileCountX != other.tileCountX || reference.tileCountY != other.tileCountY || reference.materialTiles.size() != other.materialTiles.size())
+    {
+        comparison.layoutMismatch = true;
+        return comparison;
+    }
+
+    std::vector<uint32_t> difference;
+    for (size_t material = 0; material < reference.materialTiles.size(); material++)
+    {
+        std::vector<uint32_t> a = reference.materialTiles[material];
+        std::vector<uint32_t> b = other.materialTiles[material];
+        std::sort(a.begin(), a.end());
+        std::sort(b.begin(), b.end());
+
+        // Duplicates are counted once as duplicated and not as extra tiles
+        size_t size = b.size();
+        b.erase(std::unique(b.begin(), b.end()), b.end());
+        unsigned duplicatedTileCount = (unsigned)(size - b.size());
+
+        difference.clear();
+        std::set_difference(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(difference));
+        unsigned missingTileCount = (unsigned)difference.size();
+
+        difference.clear();
+        std::set_difference(b.begin(), b.end(), a.begin(), a.end(), std::back_inserter(difference));
+        unsigned extraTileCount = (unsigned)difference.size();
+
+        if (duplicatedTileCount != 0 || missingTileCount != 0 || extraTileCount != 0)
+            comparison.mismatchedMaterialCount++;
+        comparison.missingTileCount += missingTileCount;
+        comparison.extraTileCount += extraTileCount;
+        comparison.duplicatedTileCount += duplicatedTileCount;
+    }
+
+    return comparison;
+}
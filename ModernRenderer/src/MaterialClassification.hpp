@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "Scene.hpp"
+#include "SoftwareRasterizer.hpp"
+#include "VisibilityBuffer.hpp"
+
+// CPU reference of the tile classification done in MaterialResolve.hlsl.
+// Operates on a visibility image (the output of the SoftwareRasterizer or the GPU visibility texture read back) to
+// validate the GPU tile lists.
+class MaterialClassification
+{
+public:
+    // Keep in sync with MATERIAL_TILE_SIZE in MaterialResolve.hlsl
+    static constexpr unsigned tileSize = 8;
+
+    struct TileLists
+    {
+        unsigned tileCountX = 0;
+        unsigned tileCountY = 0;
+        // Packed tile coordinates (x | y << 16) for each material, see PackTile
+        std::vector<std::vector<uint32_t>> materialTiles;
+        // Pixels referencing a visible meshlet, instance or material out of range, they aren't classified
+        unsigned invalidPixelCount = 0;
+    };
+
+    // Differences between two classifications, summed over the materials
+    struct Comparison
+    {
+        // The tile grids or the material counts differ, the lists aren't compared
+        bool layoutMismatch = false;
+        unsigned mismatchedMaterialCount = 0;
+        // Tiles of the reference missing from the other lists, and tiles of the other lists not in the reference
+        unsigned missingTileCount = 0;
+        unsigned extraTileCount = 0;
+        unsigned duplicatedTileCount = 0;
+
+        bool IsIdentical() const { return !layoutMismatch && mismatchedMaterialCount == 0; }
+    };
+
+    static uint32_t PackTile(unsigned tileX, unsigned tileY) { return tileX | (tileY << 16); }
+
+    // Pixels with a depth of 1 are considered empty, same as the GPU classification
+    static TileLists ClassifyTiles(const std::vector<uint32_t>& visibility, const std::vector<float>& depth, unsigned width, unsigned height,
+        VisibilityBuffer::Format format, const std::vector<SoftwareRasterizer::VisibleMeshlet>& visibleMeshlets,
+        const std::vector<Scene::InstanceData>& instances, unsigned materialCount);
+
+    // Builds the tile lists from the GPU buffers, tileCounts holds one count per material and tiles the fixed size lists
+    static TileLists FromGPUBuffers(const std::vector<uint32_t>& tileCounts, const std::vector<uint32_t>& tiles, unsigned tileCountX, unsigned tileCountY);
+
+    // The order of the tiles in a list depends on the GPU scheduling so lists are compared as sets
+    static Comparison CompareTileLists(const TileLists& reference, const TileLists& other);
+};
@@ -0,0 +1,189 @@
+#include "MaterialTileValidation.hpp"
+#include "MaterialClassification.hpp"
+#include "FrameContext.hpp"
+#include <CommandList/DXCommandList.h>
+#include <Resource/DXResource.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+MaterialTileValidation MaterialTileValidation::instance;
+
+bool MaterialTileValidation::ParseArgs(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::string(argv[i]) != "--validate-material-tiles")
+			continue;
+
+		instance.interval = defaultInterval;
+		if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0]))
+			instance.interval = std::max(1, std::atoi(argv[++i]));
+	}
+
+	if (IsEnabled())
+		printf("Material tile validation: every %u frames\n", instance.interval);
+
+	return IsEnabled();
+}
+
+static uint32_t AlignRowPitch(uint32_t rowBytes)
+{
+	return (rowBytes + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+}
+
+static std::shared_ptr<Resource> CreateReadbackBuffer(std::shared_ptr<Device> device, uint64_t size, const std::string& name)
+{
+	std::shared_ptr<Resource> buffer = device->CreateBuffer(BindFlag::kCopyDest, size);
+	buffer->CommitMemory(MemoryType::kReadback);
+	buffer->SetName(name);
+	return buffer;
+}
+
+// FlyCube doesn't copy textures to buffers, the copy is recorded on the D3D12 command list. Subresource 0 of a depth
+// stencil texture is its depth plane, copied with the R32_TYPELESS footprint.
+static void CopyTextureToReadback(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> texture, std::shared_ptr<Resource> readback,
+	DXGI_FORMAT footprintFormat, unsigned width, unsigned height, uint32_t rowPitch)
+{
+	D3D12_TEXTURE_COPY_LOCATION source = {};
+	source.pResource = ((DXResource*)texture.get())->resource.Get();
+	source.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
+	source.SubresourceIndex = 0;
+
+	D3D12_TEXTURE_COPY_LOCATION destination = {};
+	destination.pResource = ((DXResource*)readback.get())->resource.Get();
+	destination.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
+	destination.PlacedFootprint.Footprint = { footprintFormat, width, height, 1, rowPitch };
+
+	auto dxCmd = ((DXCommandList*)cmd.get())->GetCommandList();
+	dxCmd->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+}
+
+// Copies the rows of a texture readback buffer without the pitch padding
+template<typename T>
+static std::vector<T> ReadTexture(std::shared_ptr<Resource> readback, unsigned height, uint32_t rowPitch, size_t rowElements)
+{
+	std::vector<T> data(rowElements * height);
+	const uint8_t* mapped = readback->Map();
+	for (unsigned y = 0; y < height; y++)
+		memcpy(data.data() + y * rowElements, mapped + (size_t)y * rowPitch, rowElements * sizeof(T));
+	readback->Unmap();
+	return data;
+}
+
+void MaterialTileValidation::Init(std::shared_ptr<Device> device, unsigned width, unsigned height, VisibilityBuffer::Format format,
+	unsigned tileCountX, unsigned tileCountY, unsigned materialCount)
+{
+	if (!IsEnabled())
+		return;
+
+	instance.device = device;
+	instance.width = width;
+	instance.height = height;
+	instance.format = format;
+	instance.tileCountX = tileCountX;
+	instance.tileCountY = tileCountY;
+	instance.materialCount = materialCount;
+
+	instance.tileCountsReadback = CreateReadbackBuffer(device, sizeof(uint32_t) * materialCount, "Material Tile Counts Readback");
+	instance.tilesReadback = CreateReadbackBuffer(device, sizeof(uint32_t) * (uint64_t)materialCount * tileCountX * tileCountY, "Material Tile Lists Readback");
+
+	instance.visibilityRowPitch = AlignRowPitch(width * VisibilityBuffer::GetComponentCount(format) * sizeof(uint32_t));
+	instance.depthRowPitch = AlignRowPitch(width * sizeof(float));
+	instance.visibilityReadback = CreateReadbackBuffer(device, (uint64_t)instance.visibilityRowPitch * height, "Material Tile Validation Visibility Readback");
+	instance.depthReadback = CreateReadbackBuffer(device, (uint64_t)instance.depthRowPitch * height, "Material Tile Validation Depth Readback");
+	instance.visibleMeshletsReadback = nullptr;
+}
+
+void MaterialTileValidation::BeginFrame()
+{
+	instance.readbackRequested = IsEnabled() && instance.tilesReadback != nullptr && FrameContext::GetFrameIndex() % instance.interval == 0;
+}
+
+void MaterialTileValidation::EnqueueReadback(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> tileCountsBuffer, std::shared_ptr<Resource> tilesBuffer,
+	std::shared_ptr<Resource> visibilityTexture, std::shared_ptr<Resource> depthTexture, std::shared_ptr<Resource> visibleMeshlets)
+{
+	// The whole list is copied since its count is only known on the GPU
+	uint64_t visibleMeshletsSize = visibleMeshlets->GetWidth();
+	if (!instance.visibleMeshletsReadback || instance.visibleMeshletsReadback->GetWidth() != visibleMeshletsSize)
+		instance.visibleMeshletsReadback = CreateReadbackBuffer(instance.device, visibleMeshletsSize, "Material Tile Validation Visible Meshlets Readback");
+
+	cmd->BeginEvent("Material Tile Validation Readback");
+	cmd->CopyBuffer(tileCountsBuffer, instance.tileCountsReadback, { { 0, 0, sizeof(uint32_t) * instance.materialCount } });
+	cmd->CopyBuffer(tilesBuffer, instance.tilesReadback, { { 0, 0, sizeof(uint32_t) * (uint64_t)instance.materialCount * instance.tileCountX * instance.tileCountY } });
+	cmd->CopyBuffer(visibleMeshlets, instance.visibleMeshletsReadback, { { 0, 0, visibleMeshletsSize } });
+	DXGI_FORMAT visibilityFormat = instance.format == VisibilityBuffer::Format::R32G32 ? DXGI_FORMAT_R32G32_UINT : DXGI_FORMAT_R32_UINT;
+	CopyTextureToReadback(cmd, visibilityTexture, instance.visibilityReadback, visibilityFormat, instance.width, instance.height, instance.visibilityRowPitch);
+	CopyTextureToReadback(cmd, depthTexture, instance.depthReadback, DXGI_FORMAT_R32_TYPELESS, instance.width, instance.height, instance.depthRowPitch);
+	cmd->EndEvent();
+
+	instance.readbackPending = true;
+	instance.readbackFrameIndex = FrameContext::GetFrameIndex();
+}
+
+bool MaterialTileValidation::ValidateFrame(const Scene& scene)
+{
+	instance.readbackRequested = false;
+	if (!instance.readbackPending)
+		return true;
+	instance.readbackPending = false;
+
+	// The instances are read from the current state of the scene, which is only valid for the frame just submitted
+	FrameContext::WaitIdle();
+
+	std::vector<uint32_t> tileCounts(instance.materialCount);
+	std::vector<uint32_t> tiles((size_t)instance.materialCount * instance.tileCountX * instance.tileCountY);
+	memcpy(tileCounts.data(), instance.tileCountsReadback->Map(), tileCounts.size() * sizeof(uint32_t));
+	instance.tileCountsReadback->Unmap();
+	memcpy(tiles.data(), instance.tilesReadback->Map(), tiles.size() * sizeof(uint32_t));
+	instance.tilesReadback->Unmap();
+	auto gpuLists = MaterialClassification::FromGPUBuffers(tileCounts, tiles, instance.tileCountX, instance.tileCountY);
+
+	unsigned componentCount = VisibilityBuffer::GetComponentCount(instance.format);
+	std::vector<uint32_t> visibility = ReadTexture<uint32_t>(instance.visibilityReadback, instance.height, instance.visibilityRowPitch, (size_t)instance.width * componentCount);
+	std::vector<float> depth = ReadTexture<float>(instance.depthReadback, instance.height, instance.depthRowPitch, instance.width);
+
+	std::vector<SoftwareRasterizer::VisibleMeshlet> visibleMeshlets(instance.visibleMeshletsReadback->GetWidth() / sizeof(SoftwareRasterizer::VisibleMeshlet));
+	memcpy(visibleMeshlets.data(), instance.visibleMeshletsReadback->Map(), visibleMeshlets.size() * sizeof(SoftwareRasterizer::VisibleMeshlet));
+	instance.visibleMeshletsReadback->Unmap();
+
+	std::vector<Scene::InstanceData> instances = scene.instanceStore.Pack();
+	auto reference = MaterialClassification::ClassifyTiles(visibility, depth, instance.width, instance.height, instance.format, visibleMeshlets, instances, instance.materialCount);
+
+	MaterialClassification::Comparison comparison = MaterialClassification::CompareTileLists(reference, gpuLists);
+	Statistics& statistics = instance.statistics;
+	statistics.validatedFrames++;
+	statistics.missingTiles += comparison.missingTileCount;
+	statistics.extraTiles += comparison.extraTileCount;
+	statistics.duplicatedTiles += comparison.duplicatedTileCount;
+	statistics.invalidPixels += reference.invalidPixelCount;
+	bool valid = comparison.IsIdentical() && reference.invalidPixelCount == 0;
+	if (!valid)
+	{
+		if (statistics.mismatchedFrames == 0)
+			statistics.firstMismatchedFrame = instance.readbackFrameIndex;
+		statistics.mismatchedFrames++;
+	}
+
+	return valid;
+}
+
+unsigned MaterialTileValidation::ReportMismatches()
+{
+	if (!IsEnabled())
+		return 0;
+
+	const Statistics& statistics = instance.statistics;
+	if (statistics.mismatchedFrames == 0)
+	{
+		printf("Material tile validation: %u frames identical to the CPU classification\n", statistics.validatedFrames);
+		return 0;
+	}
+
+	printf("Material tile validation: %u/%u frames mismatched (first at frame %llu), %u missing tiles, %u extra tiles, %u duplicated tiles, %u invalid pixels\n",
+		statistics.mismatchedFrames, statistics.validatedFrames, (unsigned long long)statistics.firstMismatchedFrame,
+		statistics.missingTiles, statistics.extraTiles, statistics.duplicatedTiles, statistics.invalidPixels);
+	return statistics.mismatchedFrames;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Instance/Instance.h"
+#include "Scene.hpp"
+#include "VisibilityBuffer.hpp"
+#include <memory>
+
+// Debug mode checking the GPU material classification against the CPU reference, enabled with
+// --validate-material-tiles [interval]. Every interval frames the tile lists are copied to readback buffers together
+// with the inputs of the classification: the visibility and depth textures and the visible meshlets. Once the GPU is
+// idle the CPU classifies the same visibility image, so only the binning is validated and the differences between
+// the GPU rasterization and the SoftwareRasterizer don't matter.
+class MaterialTileValidation
+{
+public:
+	static constexpr unsigned defaultInterval = 30;
+
+	struct Statistics
+	{
+		unsigned validatedFrames = 0;
+		unsigned mismatchedFrames = 0;
+		// Index of the first mismatched frame, see FrameContext::GetFrameIndex
+		uint64_t firstMismatchedFrame = 0;
+		unsigned missingTiles = 0;
+		unsigned extraTiles = 0;
+		unsigned duplicatedTiles = 0;
+		// Pixels of the visibility texture referencing a visible meshlet, instance or material out of range
+		unsigned invalidPixels = 0;
+	};
+
+private:
+	static MaterialTileValidation instance;
+
+	std::shared_ptr<Device> device;
+	unsigned interval = 0;
+	bool readbackRequested = false;
+	bool readbackPending = false;
+	uint64_t readbackFrameIndex = 0;
+
+	unsigned width = 0;
+	unsigned height = 0;
+	VisibilityBuffer::Format format = VisibilityBuffer::Format::R32;
+	unsigned tileCountX = 0;
+	unsigned tileCountY = 0;
+	unsigned materialCount = 0;
+	std::shared_ptr<Resource> tileCountsReadback;
+	std::shared_ptr<Resource> tilesReadback;
+	// The texture rows are aligned to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT in the readback buffers
+	uint32_t visibilityRowPitch = 0;
+	uint32_t depthRowPitch = 0;
+	std::shared_ptr<Resource> visibilityReadback;
+	std::shared_ptr<Resource> depthReadback;
+	// Recreated when the scene buffer grows
+	std::shared_ptr<Resource> visibleMeshletsReadback;
+
+	Statistics statistics;
+
+	MaterialTileValidation() = default;
+	~MaterialTileValidation() = default;
+
+public:
+	// Returns true if --validate-material-tiles is in the arguments, must be parsed before the renderer is created
+	static bool ParseArgs(int argc, char* argv[]);
+	static bool IsEnabled() { return instance.interval != 0; }
+
+	// Creates the readback buffers for the tile lists and textures of the render pipeline, does nothing when the
+	// validation is disabled
+	static void Init(std::shared_ptr<Device> device, unsigned width, unsigned height, VisibilityBuffer::Format format,
+		unsigned tileCountX, unsigned tileCountY, unsigned materialCount);
+
+	// Must be called at the start of every frame, requests the readback of the tile lists every interval frames
+	static void BeginFrame();
+	// The render pipeline records EnqueueReadback during the frames that request it
+	static bool IsReadbackRequested() { return instance.readbackRequested; }
+	// Every resource must be in the copy source state, visibleMeshlets is the list indexed by the visibility texture
+	static void EnqueueReadback(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> tileCountsBuffer, std::shared_ptr<Resource> tilesBuffer,
+		std::shared_ptr<Resource> visibilityTexture, std::shared_ptr<Resource> depthTexture, std::shared_ptr<Resource> visibleMeshlets);
+
+	// Must be called after the frame is submitted, with the instances of the frame. Waits for the GPU when the frame
+	// copied its tile lists and compares them with the reference, returns false on a mismatch.
+	static bool ValidateFrame(const Scene& scene);
+
+	static const Statistics& GetStatistics() { return instance.statistics; }
+	// Prints the result of the validation and returns the number of mismatched frames
+	static unsigned ReportMismatches();
+};
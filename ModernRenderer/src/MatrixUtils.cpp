@@ -1,4 +1,6 @@
 #include "MatrixUtils.hpp"
+#include <algorithm>
+#include <cfloat>
 
 glm::mat4x4 MatrixUtils::Translation(const glm::vec3& translation)
 {
@@ -199,3 +201,40 @@ Frustum MatrixUtils::GetFrustum(const glm::mat4x4& vp)
 
 	return frustum;
 }
+
+bool MatrixUtils::ProjectSphere(const glm::vec3& centerVS, float radius, float nearPlane, float p00, float p11, glm::vec4& boundsNDC)
+{
+	boundsNDC = glm::vec4(0);
+
+	// The sphere intersects the near plane, the projection is unbounded
+	if (centerVS.z < radius + nearPlane)
+		return false;
+
+	glm::vec3 cr = centerVS * radius;
+	float czr2 = centerVS.z * centerVS.z - radius * radius;
+
+	// Tangent lines from the eye to the sphere in the XZ and YZ planes
+	float vx = sqrt(centerVS.x * centerVS.x + czr2);
+	float minX = (vx * centerVS.x - cr.z) / (vx * centerVS.z + cr.x);
+	float maxX = (vx * centerVS.x + cr.z) / (vx * centerVS.z - cr.x);
+
+	float vy = sqrt(centerVS.y * centerVS.y + czr2);
+	float minY = (vy * centerVS.y - cr.z) / (vy * centerVS.z + cr.y);
+	float maxY = (vy * centerVS.y + cr.z) / (vy * centerVS.z - cr.y);
+
+	boundsNDC = glm::vec4(minX * p00, minY * p11, maxX * p00, maxY * p11);
+	return true;
+}
+
+float MatrixUtils::GetProjectedSphereSizeInPixels(const glm::vec3& centerVS, float radius, float nearPlane, float p00, float p11, const glm::vec2& resolution)
+{
+	glm::vec4 boundsNDC;
+	if (!ProjectSphere(centerVS, radius, nearPlane, p00, p11, boundsNDC))
+		return FLT_MAX;
+
+	// NDC covers [-1, 1] so half the NDC extent maps to the resolution
+	float width = (boundsNDC.z - boundsNDC.x) * 0.5f * resolution.x;
+	float height = (boundsNDC.w - boundsNDC.y) * 0.5f * resolution.y;
+
+	return std::max(width, height);
+}
@@ -22,4 +22,8 @@ public:
 	static glm::mat4x4 Mul(const glm::mat4x4& left, const glm::mat4x4& right);
 
 	static Frustum GetFrustum(const glm::mat4x4& viewProjectionMatrix);
+
+	// Screen space bounds of a view space sphere, must match ProjectSphere in GeometryUtils.hlsl
+	static bool ProjectSphere(const glm::vec3& centerVS, float radius, float nearPlane, float p00, float p11, glm::vec4& boundsNDC);
+	static float GetProjectedSphereSizeInPixels(const glm::vec3& centerVS, float radius, float nearPlane, float p00, float p11, const glm::vec2& resolution);
 };
\ No newline at end of file
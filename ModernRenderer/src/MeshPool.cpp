@@ -1,7 +1,9 @@
 #include "MeshPool.hpp"
 #include "RenderUtils.hpp"
+#include "FrameContext.hpp"
+#include <algorithm>
 
-std::unordered_map<std::shared_ptr<Mesh>, unsigned> MeshPool::meshes;
+std::unordered_map<std::shared_ptr<Mesh>, MeshPool::MeshAllocation> MeshPool::meshes;
 
 std::vector<meshopt_Meshlet> MeshPool::meshlets;
 std::vector<uint32_t> MeshPool::meshletIndices;
@@ -10,6 +12,12 @@ std::vector<Mesh::Vertex> MeshPool::vertices;
 std::vector<uint32_t> MeshPool::indices;
 std::vector<meshopt_Bounds> MeshPool::bounds;
 
+RangeAllocator MeshPool::vertexAllocator(defaultVertexCapacity);
+RangeAllocator MeshPool::indexAllocator(defaultIndexCapacity);
+RangeAllocator MeshPool::meshletAllocator(defaultMeshletCapacity);
+RangeAllocator MeshPool::meshletIndexAllocator(defaultMeshletIndexCapacity);
+RangeAllocator MeshPool::meshletTriangleAllocator(defaultMeshletTriangleCapacity);
+
 std::shared_ptr<Resource> MeshPool::vertexPool = nullptr;
 std::shared_ptr<Resource> MeshPool::indicesPool = nullptr;
 std::shared_ptr<Resource> MeshPool::meshletIndicesPool = nullptr;
@@ -27,60 +35,194 @@ std::shared_ptr<View> MeshPool::meshletBoundsPoolView;
 std::vector<BindingDesc> MeshPool::bindingDescs;
 std::vector<BindKey> MeshPool::bindKeys;
 
+std::vector<MeshPool::PendingUpload> MeshPool::pendingUploads;
+std::vector<MeshPool::PendingRelease> MeshPool::pendingReleases;
+std::vector<uint32_t> MeshPool::unpackedTriangles;
+
+std::unique_ptr<MeshPool::Compaction> MeshPool::compaction;
+bool MeshPool::compactionRequested = false;
+uint64_t MeshPool::lastCompactionCheck = 0;
+MeshPool::CompactionStatistics MeshPool::compactionStatistics;
+std::unordered_set<Mesh*> MeshPool::relocatedMeshes;
+std::vector<MeshPool::RelocationListener> MeshPool::relocationListeners;
+
+// Returns the CPU copy of an allocated range, the heap is resized to contain it
+template<typename T>
+static T* GetRange(std::vector<T>& heap, const RangeAllocator::Allocation& allocation)
+{
+    if (heap.size() < allocation.offset + allocation.size)
+        heap.resize(allocation.offset + allocation.size);
+    return heap.data() + allocation.offset;
+}
+
+RangeAllocator& MeshPool::GetAllocator(Heap heap)
+{
+    switch (heap)
+    {
+    case VertexHeap: return vertexAllocator;
+    case IndexHeap: return indexAllocator;
+    case MeshletHeap: return meshletAllocator;
+    case MeshletIndexHeap: return meshletIndexAllocator;
+    default: return meshletTriangleAllocator;
+    }
+}
+
+// Size of an element on the GPU
+uint64_t MeshPool::GetElementSize(Heap heap)
+{
+    switch (heap)
+    {
+    case VertexHeap: return sizeof(Mesh::Vertex);
+    case MeshletHeap: return sizeof(meshopt_Meshlet) + sizeof(meshopt_Bounds);
+    default: return sizeof(uint32_t);
+    }
+}
+
+RangeAllocator::Allocation MeshPool::AllocateRange(RangeAllocator& allocator, size_t size)
+{
+    RangeAllocator::Allocation allocation = allocator.Allocate((uint32_t)size);
+
+    // The capacity is fixed once the heaps are created on the GPU
+    if (!allocation.IsValid() && !IsResident())
+    {
+        allocator.Grow(std::max(allocator.GetCapacity() * 2, allocator.GetCapacity() + (uint32_t)size));
+        allocation = allocator.Allocate((uint32_t)size);
+    }
+
+    return allocation;
+}
+
+void MeshPool::FreeMeshAllocation(const MeshAllocation& allocation)
+{
+    for (unsigned heap = 0; heap < HeapCount; heap++)
+        GetAllocator((Heap)heap).Free(allocation.*heapRanges[heap]);
+}
+
+uint64_t MeshPool::QueueUpload(std::shared_ptr<Mesh> mesh, Heap heap)
+{
+    // Before the heaps are resident, the whole CPU copy is uploaded when they are created
+    if (!IsResident())
+        return 0;
+
+    pendingUploads.push_back({ mesh, heap });
+    return GetElementSize(heap) * (meshes[mesh].*heapRanges[heap]).size;
+}
+
 unsigned MeshPool::PushNewMesh(std::shared_ptr<Mesh> mesh)
 {
-    unsigned meshletOffset = meshlets.size();
+    if (meshes.find(mesh) != meshes.end())
+        return mesh->meshletOffset;
+
+    MeshAllocation allocation;
+    allocation.vertices = AllocateRange(vertexAllocator, mesh->vertices.size());
+    allocation.indices = AllocateRange(indexAllocator, mesh->indices.size());
+    allocation.meshlets = AllocateRange(meshletAllocator, mesh->meshlets.size());
+    allocation.meshletIndices = AllocateRange(meshletIndexAllocator, mesh->meshletIndices.size());
+    allocation.meshletTriangles = AllocateRange(meshletTriangleAllocator, mesh->meshletTriangles.size());
+
+    if (!allocation.vertices.IsValid() || !allocation.indices.IsValid() || !allocation.meshlets.IsValid()
+        || !allocation.meshletIndices.IsValid() || !allocation.meshletTriangles.IsValid())
+    {
+        printf("MeshPool: not enough space in the heaps for mesh %s\n", mesh->name.c_str());
+        FreeMeshAllocation(allocation);
+        return invalidMeshletOffset;
+    }
+
+    meshes.insert({ mesh, allocation });
 
+    // The plan of the compaction doesn't know about the new ranges
+    compaction = nullptr;
+
+    // Copy the mesh to its ranges, storing the offsets of the ranges in the indices and meshlets
+    uint32_t vertexOffset = allocation.vertices.offset;
+    std::copy(mesh->vertices.begin(), mesh->vertices.end(), GetRange(vertices, allocation.vertices));
+    std::copy(mesh->meshletTriangles.begin(), mesh->meshletTriangles.end(), GetRange(meshletTriangles, allocation.meshletTriangles));
+    std::copy(mesh->meshletBounds.begin(), mesh->meshletBounds.end(), GetRange(bounds, allocation.meshlets));
+
+    uint32_t* meshIndices = GetRange(indices, allocation.indices);
+    for (size_t i = 0; i < mesh->indices.size(); i++)
+        meshIndices[i] = mesh->indices[i] + vertexOffset;
+
+    uint32_t* meshMeshletIndices = GetRange(meshletIndices, allocation.meshletIndices);
+    for (size_t i = 0; i < mesh->meshletIndices.size(); i++)
+        meshMeshletIndices[i] = mesh->meshletIndices[i] + vertexOffset;
+
+    meshopt_Meshlet* meshMeshlets = GetRange(meshlets, allocation.meshlets);
+    for (size_t i = 0; i < mesh->meshlets.size(); i++)
+    {
+        meshopt_Meshlet newMeshlet = mesh->meshlets[i];
+        newMeshlet.vertex_offset += allocation.meshletIndices.offset;
+        newMeshlet.triangle_offset += allocation.meshletTriangles.offset;
+        meshMeshlets[i] = newMeshlet;
+    }
+
+    mesh->meshletOffset = allocation.meshlets.offset;
+    mesh->raytracedPrimitiveIndex = allocation.indices.offset;
+
+    if (IsResident())
+    {
+        for (unsigned heap = 0; heap < HeapCount; heap++)
+            QueueUpload(mesh, (Heap)heap);
+        // A mesh pushed again after its removal has new ranges, the instances using it must be updated
+        relocatedMeshes.insert(mesh.get());
+    }
+
+    return allocation.meshlets.offset;
+}
+
+void MeshPool::RemoveMesh(std::shared_ptr<Mesh> mesh)
+{
     auto f = meshes.find(mesh);
     if (f == meshes.end())
-        meshes.insert({ mesh, meshletOffset });
-	else
-		return f->second;
-
-    // Append vertices to the pool, storing the index offset to update meshlet data
-    int vertexOffset = vertices.size();
-	vertices.insert(vertices.end(), mesh->vertices.begin(), mesh->vertices.end());
-    int triangleOffset = meshletTriangles.size();
-	meshletTriangles.insert(meshletTriangles.end(), mesh->meshletTriangles.begin(), mesh->meshletTriangles.end());
-    int indexOffset = meshletIndices.size();
-    bounds.insert(bounds.end(), mesh->meshletBounds.begin(), mesh->meshletBounds.end());
-    int indicesOffset = indices.size();
-    indices.reserve(indices.size() + mesh->indices.size());
-    for (int i = 0; i < mesh->indices.size(); i++)
-        indices.push_back(mesh->indices[i] + vertexOffset);
-
-    for (const auto& index : mesh->meshletIndices)
-		meshletIndices.push_back(index + vertexOffset);
-
-    for (const auto& meshet : mesh->meshlets)
-	{
-		meshopt_Meshlet newMeshlet = meshet;
-		newMeshlet.vertex_offset += indexOffset;
-        newMeshlet.triangle_offset += triangleOffset;
-		meshlets.push_back(newMeshlet);
-	}
-
-    mesh->meshletOffset = meshletOffset;
-    mesh->raytracedPrimitiveIndex = indicesOffset;
-
-    return meshletOffset;
+        return;
+
+    // The pending uploads of the mesh are skipped once it isn't in the pool anymore
+    MeshAllocation allocation = f->second;
+    meshes.erase(f);
+    compaction = nullptr;
+
+    if (IsResident())
+        pendingReleases.push_back({ allocation, FrameContext::GetFrameIndex() });
+    else
+        FreeMeshAllocation(allocation);
 }
 
 void MeshPool::AllocateMeshPoolBuffers(std::shared_ptr<Device> device)
 {
-	RenderUtils::AllocateVertexBufer(device, vertices, ViewType::kStructuredBuffer, gli::FORMAT_UNDEFINED, "Vertex Pool", vertexPool, vertexPoolView);
-	RenderUtils::AllocateVertexBufer(device, meshlets, ViewType::kStructuredBuffer, gli::FORMAT_UNDEFINED, "Meshlet Pool", meshletsPool, meshletsPoolView);
-	RenderUtils::AllocateVertexBufer(device, meshletIndices, ViewType::kStructuredBuffer, gli::FORMAT_UNDEFINED, "Meshlet Vertices", meshletIndicesPool, meshletIndicesPoolView);
-    RenderUtils::AllocateVertexBufer(device, bounds, ViewType::kStructuredBuffer, gli::FORMAT_UNDEFINED, "Meshlet Bounds", meshletBoundsPool, meshletBoundsPoolView);
-    RenderUtils::AllocateVertexBufer(device, indices, ViewType::kBuffer, gli::FORMAT_R32_UINT_PACK32, "Vertex Indices", indicesPool, indicesPoolView);
+	// The binding sets writing the previous pool views must not be reused
+	RenderUtils::InvalidateBindingSets(bindingDescs);
+
+    // The heaps are sized from the end of their last range
+    Compact();
 
-    // TODO: pack 3 meshelet indices (triangle) into a single uint 
+    // The capacity doesn't change once the heaps are resident, leave room for the meshes streamed in later
+    auto reserve = [](RangeAllocator& allocator, uint32_t defaultCapacity)
+    {
+        uint32_t usedEnd = allocator.GetStatistics().usedEnd;
+        allocator.Grow(std::max(defaultCapacity, usedEnd + (uint32_t)(usedEnd * streamingHeadroom)));
+    };
+    reserve(vertexAllocator, defaultVertexCapacity);
+    reserve(indexAllocator, defaultIndexCapacity);
+    reserve(meshletAllocator, defaultMeshletCapacity);
+    reserve(meshletIndexAllocator, defaultMeshletIndexCapacity);
+    reserve(meshletTriangleAllocator, defaultMeshletTriangleCapacity);
+
+	RenderUtils::AllocateVertexBufer(device, vertices, ViewType::kStructuredBuffer, gli::FORMAT_UNDEFINED, "Vertex Pool", vertexPool, vertexPoolView, vertexAllocator.GetCapacity());
+	RenderUtils::AllocateVertexBufer(device, meshlets, ViewType::kStructuredBuffer, gli::FORMAT_UNDEFINED, "Meshlet Pool", meshletsPool, meshletsPoolView, meshletAllocator.GetCapacity());
+	RenderUtils::AllocateVertexBufer(device, meshletIndices, ViewType::kStructuredBuffer, gli::FORMAT_UNDEFINED, "Meshlet Vertices", meshletIndicesPool, meshletIndicesPoolView, meshletIndexAllocator.GetCapacity());
+    RenderUtils::AllocateVertexBufer(device, bounds, ViewType::kStructuredBuffer, gli::FORMAT_UNDEFINED, "Meshlet Bounds", meshletBoundsPool, meshletBoundsPoolView, meshletAllocator.GetCapacity());
+    RenderUtils::AllocateVertexBufer(device, indices, ViewType::kBuffer, gli::FORMAT_R32_UINT_PACK32, "Vertex Indices", indicesPool, indicesPoolView, indexAllocator.GetCapacity());
+
+    // TODO: pack 3 meshelet indices (triangle) into a single uint
     std::vector<uint32_t> unpackedMeshletTriangles(meshletTriangles.size());
     for (int i = 0; i < meshletTriangles.size(); i++)
         unpackedMeshletTriangles[i] = meshletTriangles[i];
 
     //RenderUtils::AllocateVertexBufer(device, packedMeshletTriangles, ViewType::kBuffer, gli::FORMAT_R32_UINT_PACK32, meshletTrianglesBuffer, meshletTrianglesBufferView);
-	RenderUtils::AllocateVertexBufer(device, unpackedMeshletTriangles, ViewType::kBuffer, gli::FORMAT_R32_UINT_PACK32, "Meshlet Triangles", meshletTrianglesPool, meshletTrianglesPoolView);
+	RenderUtils::AllocateVertexBufer(device, unpackedMeshletTriangles, ViewType::kBuffer, gli::FORMAT_R32_UINT_PACK32, "Meshlet Triangles", meshletTrianglesPool, meshletTrianglesPoolView, meshletTriangleAllocator.GetCapacity());
+
+    // Everything pushed until now is part of the initial upload
+    pendingUploads.clear();
 
     auto vertexPoolBindKeyMesh = BindKey{ ShaderType::kMesh, ViewType::kStructuredBuffer, 0, 4 };
     auto meshletsPoolBindKey = BindKey{ ShaderType::kMesh, ViewType::kStructuredBuffer, 1, 4 };
@@ -107,3 +249,325 @@ void MeshPool::AllocateMeshPoolBuffers(std::shared_ptr<Device> device)
         indicesBindKey,
     };
 }
+
+void MeshPool::RecordRangeUpload(std::shared_ptr<CommandList> cmd, Heap heap, const RangeAllocator::Allocation& range)
+{
+    if (range.size == 0)
+        return;
+
+    auto copyRange = [&](std::shared_ptr<Resource> pool, const void* data, uint64_t elementSize)
+    {
+        uint64_t size = elementSize * range.size;
+        auto upload = FrameContext::Upload(data, size);
+        cmd->CopyBuffer(upload.buffer, pool, { { upload.offset, elementSize * range.offset, size } });
+    };
+
+    switch (heap)
+    {
+    case VertexHeap:
+        copyRange(vertexPool, vertices.data() + range.offset, sizeof(Mesh::Vertex));
+        break;
+    case IndexHeap:
+        copyRange(indicesPool, indices.data() + range.offset, sizeof(uint32_t));
+        break;
+    case MeshletHeap:
+        copyRange(meshletsPool, meshlets.data() + range.offset, sizeof(meshopt_Meshlet));
+        copyRange(meshletBoundsPool, bounds.data() + range.offset, sizeof(meshopt_Bounds));
+        break;
+    case MeshletIndexHeap:
+        copyRange(meshletIndicesPool, meshletIndices.data() + range.offset, sizeof(uint32_t));
+        break;
+    case MeshletTriangleHeap:
+    {
+        auto triangles = meshletTriangles.begin() + range.offset;
+        unpackedTriangles.assign(triangles, triangles + range.size);
+        copyRange(meshletTrianglesPool, unpackedTriangles.data(), sizeof(uint32_t));
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void MeshPool::RecordUploads(std::shared_ptr<CommandList> cmd)
+{
+    // The frames recorded before the removal of a mesh are complete framesInFlight frames later
+    uint64_t frameIndex = FrameContext::GetFrameIndex();
+    std::erase_if(pendingReleases, [&](const PendingRelease& release)
+    {
+        if (frameIndex < release.frameIndex + FrameContext::framesInFlight)
+            return false;
+        FreeMeshAllocation(release.allocation);
+        return true;
+    });
+
+    if (!IsResident())
+        return;
+
+    UpdateCompaction();
+
+    if (!pendingUploads.empty())
+    {
+        // A range is uploaded once even if it was written several times, the copies never overlap
+        std::sort(pendingUploads.begin(), pendingUploads.end(), [](const PendingUpload& a, const PendingUpload& b)
+        {
+            return a.mesh != b.mesh ? a.mesh < b.mesh : a.heap < b.heap;
+        });
+
+        std::vector<std::shared_ptr<Resource>> pools = { vertexPool, indicesPool, meshletIndicesPool, meshletTrianglesPool, meshletsPool, meshletBoundsPool };
+        std::vector<ResourceBarrierDesc> copyBarriers;
+        std::vector<ResourceBarrierDesc> commonBarriers;
+        for (const auto& pool : pools)
+        {
+            copyBarriers.push_back({ pool, ResourceState::kCommon, ResourceState::kCopyDest });
+            commonBarriers.push_back({ pool, ResourceState::kCopyDest, ResourceState::kCommon });
+        }
+        cmd->ResourceBarrier(copyBarriers);
+
+        for (size_t i = 0; i < pendingUploads.size(); i++)
+        {
+            const PendingUpload& upload = pendingUploads[i];
+            if (i > 0 && upload.mesh == pendingUploads[i - 1].mesh && upload.heap == pendingUploads[i - 1].heap)
+                continue;
+
+            auto f = meshes.find(upload.mesh);
+            if (f != meshes.end())
+                RecordRangeUpload(cmd, upload.heap, f->second.*heapRanges[upload.heap]);
+        }
+        pendingUploads.clear();
+
+        cmd->ResourceBarrier(commonBarriers);
+    }
+
+    // Moved meshes are visible to the passes of this frame, the references to them must be updated before
+    if (!relocatedMeshes.empty())
+    {
+        for (const auto& listener : relocationListeners)
+            listener.callback(cmd, relocatedMeshes);
+        relocatedMeshes.clear();
+    }
+}
+
+void MeshPool::PlanCompaction()
+{
+    auto plan = std::make_unique<Compaction>();
+    for (const auto& mesh : meshes)
+        plan->meshes.push_back(mesh.first);
+
+    size_t moveCount = 0;
+    for (unsigned heap = 0; heap < HeapCount; heap++)
+    {
+        std::vector<CompactionPlanner::Range> ranges;
+        for (uint32_t id = 0; id < plan->meshes.size(); id++)
+        {
+            const RangeAllocator::Allocation& range = meshes[plan->meshes[id]].*heapRanges[heap];
+            ranges.push_back({ id, range.offset, range.size });
+        }
+
+        // Removed meshes can still be read by the frames in flight
+        for (const auto& release : pendingReleases)
+        {
+            const RangeAllocator::Allocation& range = release.allocation.*heapRanges[heap];
+            ranges.push_back({ UINT32_MAX, range.offset, range.size, true });
+        }
+
+        plan->moves[heap] = CompactionPlanner::Plan(ranges);
+        moveCount += plan->moves[heap].size();
+    }
+
+    if (moveCount == 0)
+        return;
+
+    compaction = std::move(plan);
+    compactionStatistics.compactionCount++;
+    printf("MeshPool: compacting the heaps, %zu ranges to move\n", moveCount);
+}
+
+bool MeshPool::ApplyMove(Heap heap, const CompactionPlanner::Move& move, uint64_t& uploadBytes)
+{
+    std::shared_ptr<Mesh> mesh = compaction->meshes[move.id];
+    MeshAllocation& allocation = meshes[mesh];
+    RangeAllocator& allocator = GetAllocator(heap);
+    RangeAllocator::Allocation& range = allocation.*heapRanges[heap];
+
+    allocator.Free(range);
+    RangeAllocator::Allocation moved = allocator.AllocateAt(move.to, move.size);
+    if (!moved.IsValid())
+    {
+        allocator.AllocateAt(range.offset, range.size);
+        printf("MeshPool: failed to move mesh %s during the compaction\n", mesh->name.c_str());
+        return false;
+    }
+    range = moved;
+
+    // The ranges only move towards the start of the heap, copying forward is correct when they overlap
+    auto moveElements = [&](auto& heapData)
+    {
+        std::copy(heapData.begin() + move.from, heapData.begin() + move.from + move.size, heapData.begin() + move.to);
+    };
+
+    // Data of the mesh in the other heaps storing offsets into the moved range
+    switch (heap)
+    {
+    case VertexHeap:
+        moveElements(vertices);
+        CompactionPlanner::Relocate(indices.data() + allocation.indices.offset, allocation.indices.size, move);
+        CompactionPlanner::Relocate(meshletIndices.data() + allocation.meshletIndices.offset, allocation.meshletIndices.size, move);
+        uploadBytes += QueueUpload(mesh, IndexHeap);
+        uploadBytes += QueueUpload(mesh, MeshletIndexHeap);
+        break;
+    case IndexHeap:
+        moveElements(indices);
+        mesh->raytracedPrimitiveIndex = move.to;
+        relocatedMeshes.insert(mesh.get());
+        break;
+    case MeshletHeap:
+        moveElements(meshlets);
+        moveElements(bounds);
+        mesh->meshletOffset = move.to;
+        relocatedMeshes.insert(mesh.get());
+        break;
+    case MeshletIndexHeap:
+        moveElements(meshletIndices);
+        for (uint32_t i = 0; i < allocation.meshlets.size; i++)
+        {
+            meshopt_Meshlet& meshlet = meshlets[allocation.meshlets.offset + i];
+            meshlet.vertex_offset = CompactionPlanner::Relocate(meshlet.vertex_offset, move);
+        }
+        uploadBytes += QueueUpload(mesh, MeshletHeap);
+        break;
+    case MeshletTriangleHeap:
+        moveElements(meshletTriangles);
+        for (uint32_t i = 0; i < allocation.meshlets.size; i++)
+        {
+            meshopt_Meshlet& meshlet = meshlets[allocation.meshlets.offset + i];
+            meshlet.triangle_offset = CompactionPlanner::Relocate(meshlet.triangle_offset, move);
+        }
+        uploadBytes += QueueUpload(mesh, MeshletHeap);
+        break;
+    default:
+        break;
+    }
+
+    uploadBytes += QueueUpload(mesh, heap);
+    compactionStatistics.moveCount++;
+    return true;
+}
+
+void MeshPool::UpdateCompaction()
+{
+    if (!compaction)
+    {
+        uint64_t frameIndex = FrameContext::GetFrameIndex();
+        if (!compactionRequested && frameIndex < lastCompactionCheck + compactionCheckInterval)
+            return;
+        lastCompactionCheck = frameIndex;
+
+        bool fragmented = compactionRequested;
+        compactionRequested = false;
+        for (unsigned heap = 0; heap < HeapCount; heap++)
+            fragmented |= GetAllocator((Heap)heap).GetStatistics().fragmentation > compactionFragmentationThreshold;
+
+        if (!fragmented)
+            return;
+
+        PlanCompaction();
+        if (!compaction)
+            return;
+    }
+
+    // Moves are applied in order in each heap until the budget of the frame is spent
+    uint64_t uploadBytes = 0;
+    bool complete = true;
+    for (unsigned heap = 0; heap < HeapCount; heap++)
+    {
+        const auto& moves = compaction->moves[heap];
+        size_t& nextMove = compaction->nextMove[heap];
+        while (nextMove < moves.size() && uploadBytes < compactionBudgetBytes)
+        {
+            if (!ApplyMove((Heap)heap, moves[nextMove++], uploadBytes))
+            {
+                compaction = nullptr;
+                compactionStatistics.uploadedBytes += uploadBytes;
+                return;
+            }
+        }
+        complete &= nextMove == moves.size();
+    }
+
+    compactionStatistics.uploadedBytes += uploadBytes;
+    if (complete)
+        compaction = nullptr;
+}
+
+bool MeshPool::Compact()
+{
+    if (IsResident())
+        return false;
+
+    PlanCompaction();
+    if (!compaction)
+        return true;
+
+    // Nothing is uploaded yet, all the moves are applied at once
+    uint64_t uploadBytes = 0;
+    for (unsigned heap = 0; heap < HeapCount; heap++)
+    {
+        for (const auto& move : compaction->moves[heap])
+        {
+            if (!ApplyMove((Heap)heap, move, uploadBytes))
+            {
+                compaction = nullptr;
+                return false;
+            }
+        }
+    }
+    compaction = nullptr;
+
+    // The data after the last range is stale, the heaps can now be smaller than their CPU copy
+    auto shrink = [](auto& heapData, const RangeAllocator& allocator)
+    {
+        heapData.resize(std::min<size_t>(heapData.size(), allocator.GetStatistics().usedEnd));
+    };
+    shrink(vertices, vertexAllocator);
+    shrink(indices, indexAllocator);
+    shrink(meshlets, meshletAllocator);
+    shrink(bounds, meshletAllocator);
+    shrink(meshletIndices, meshletIndexAllocator);
+    shrink(meshletTriangles, meshletTriangleAllocator);
+    return true;
+}
+
+void MeshPool::AddRelocationListener(void* owner, RelocationCallback callback)
+{
+    relocationListeners.push_back({ owner, callback });
+}
+
+void MeshPool::RemoveRelocationListener(void* owner)
+{
+    std::erase_if(relocationListeners, [owner](const RelocationListener& listener) { return listener.owner == owner; });
+}
+
+std::vector<MeshPool::HeapStatistics> MeshPool::GetHeapStatistics()
+{
+    return {
+        { "vertices", sizeof(Mesh::Vertex), vertexAllocator.GetStatistics() },
+        { "indices", sizeof(uint32_t), indexAllocator.GetStatistics() },
+        { "meshlets", sizeof(meshopt_Meshlet) + sizeof(meshopt_Bounds), meshletAllocator.GetStatistics() },
+        { "meshletIndices", sizeof(uint32_t), meshletIndexAllocator.GetStatistics() },
+        { "meshletTriangles", sizeof(uint32_t), meshletTriangleAllocator.GetStatistics() },
+    };
+}
+
+void MeshPool::PrintStatistics()
+{
+    printf("Mesh pool: %zu meshes, %u compactions (%u ranges moved, %.1f MB uploaded)\n", meshes.size(), compactionStatistics.compactionCount,
+        compactionStatistics.moveCount, compactionStatistics.uploadedBytes / (1024.0 * 1024.0));
+    for (const auto& heap : GetHeapStatistics())
+    {
+        const RangeAllocator::Statistics& statistics = heap.allocator;
+        printf("  %-16s %u / %u used (%.1f MB), %u free blocks, largest %u, fragmentation %.1f%%\n", heap.name,
+            statistics.usedSize, statistics.capacity, (double)statistics.capacity * heap.elementSize / (1024.0 * 1024.0),
+            statistics.freeBlockCount, statistics.largestFreeBlock, statistics.fragmentation * 100.0f);
+    }
+}
@@ -1,16 +1,84 @@
 #pragma once
 
 #include <vector>
+#include <array>
+#include <memory>
 #include "Instance/Instance.h"
 #include "meshoptimizer.h"
 #include "Mesh.hpp"
+#include "RangeAllocator.hpp"
+#include "CompactionPlanner.hpp"
 #include <unordered_set>
+#include <climits>
+#include <functional>
 
+// Vertex, index and meshlet heaps shared by all the meshes. Each heap is a GPU buffer of fixed capacity with a
+// RangeAllocator, so meshes can be streamed in and out at runtime without creating the buffers again (which would
+// invalidate every binding set using them). Until the heaps are resident, the allocators grow with the loaded meshes.
+// Removed meshes leave holes in the heaps, once they are fragmented enough the live ranges are compacted a few at a
+// time every frame (see CompactionPlanner) and the owners of references to the moved meshes are notified.
 class MeshPool
 {
 public:
-    static std::unordered_map<std::shared_ptr<Mesh>, unsigned> meshes;
+    // Initial capacity of the heaps in elements
+    static constexpr uint32_t defaultVertexCapacity = 1 << 20;
+    static constexpr uint32_t defaultIndexCapacity = 4 << 20;
+    static constexpr uint32_t defaultMeshletCapacity = 1 << 16;
+    static constexpr uint32_t defaultMeshletIndexCapacity = 1 << 20;
+    static constexpr uint32_t defaultMeshletTriangleCapacity = 4 << 20;
+    // Space kept free for streaming when the heaps are created, relative to the meshes already loaded
+    static constexpr float streamingHeadroom = 0.5f;
+    static constexpr unsigned invalidMeshletOffset = UINT_MAX;
+    // A compaction starts when the free space of a heap is split enough that its largest free block is less than
+    // half of it, the heaps are checked every compactionCheckInterval frames
+    static constexpr float compactionFragmentationThreshold = 0.5f;
+    static constexpr unsigned compactionCheckInterval = 60;
+    // Bytes copied by the compaction per frame, at least one range is moved every frame
+    static constexpr uint64_t compactionBudgetBytes = 1024 * 1024;
 
+    enum Heap
+    {
+        VertexHeap,
+        IndexHeap,
+        // Meshlets and their bounds
+        MeshletHeap,
+        MeshletIndexHeap,
+        MeshletTriangleHeap,
+        HeapCount,
+    };
+
+    // Ranges of a mesh in the heaps, the meshlet bounds use the range of the meshlets
+    struct MeshAllocation
+    {
+        RangeAllocator::Allocation vertices;
+        RangeAllocator::Allocation indices;
+        RangeAllocator::Allocation meshlets;
+        RangeAllocator::Allocation meshletIndices;
+        RangeAllocator::Allocation meshletTriangles;
+    };
+
+    struct HeapStatistics
+    {
+        const char* name;
+        uint32_t elementSize;
+        RangeAllocator::Statistics allocator;
+    };
+
+    struct CompactionStatistics
+    {
+        unsigned compactionCount = 0;
+        unsigned moveCount = 0;
+        uint64_t uploadedBytes = 0;
+    };
+
+    // Called at the end of RecordUploads when meshes moved or were pushed again once the heaps are resident, with
+    // their new meshletOffset and raytracedPrimitiveIndex.
+    // The references must be updated in the same command list, before the first pass reading them.
+    using RelocationCallback = std::function<void(std::shared_ptr<CommandList> cmd, const std::unordered_set<Mesh*>& meshes)>;
+
+    static std::unordered_map<std::shared_ptr<Mesh>, MeshAllocation> meshes;
+
+    // CPU copy of the heaps up to the end of the last allocation, the free ranges contain stale data
     static std::vector<meshopt_Meshlet> meshlets;
     static std::vector<uint32_t> meshletIndices;
     static std::vector<uint8_t> meshletTriangles;
@@ -18,6 +86,12 @@ public:
     static std::vector<meshopt_Bounds> bounds;
     static std::vector<uint32_t> indices;
 
+    static RangeAllocator vertexAllocator;
+    static RangeAllocator indexAllocator;
+    static RangeAllocator meshletAllocator;
+    static RangeAllocator meshletIndexAllocator;
+    static RangeAllocator meshletTriangleAllocator;
+
     static std::shared_ptr<Resource> vertexPool;
     static std::shared_ptr<Resource> indicesPool;
     static std::shared_ptr<Resource> meshletIndicesPool;
@@ -35,6 +109,92 @@ public:
     static std::vector<BindingDesc> bindingDescs;
     static std::vector<BindKey> bindKeys;
 
+private:
+    struct PendingRelease
+    {
+        MeshAllocation allocation;
+        // Frame during which the mesh was removed, it can be read until the GPU completes it
+        uint64_t frameIndex;
+    };
+
+    // The range is the one of the mesh when the upload is recorded, it can move in the meantime
+    struct PendingUpload
+    {
+        std::shared_ptr<Mesh> mesh;
+        Heap heap;
+    };
+
+    struct RelocationListener
+    {
+        void* owner;
+        RelocationCallback callback;
+    };
+
+    // Compaction in progress, the moves of each heap are applied in order
+    struct Compaction
+    {
+        std::vector<std::shared_ptr<Mesh>> meshes;
+        std::array<std::vector<CompactionPlanner::Move>, HeapCount> moves;
+        std::array<size_t, HeapCount> nextMove = {};
+    };
+
+    static constexpr RangeAllocator::Allocation MeshAllocation::* heapRanges[HeapCount] =
+    {
+        &MeshAllocation::vertices,
+        &MeshAllocation::indices,
+        &MeshAllocation::meshlets,
+        &MeshAllocation::meshletIndices,
+        &MeshAllocation::meshletTriangles,
+    };
+
+    // Ranges written since the heaps are resident, copied at the start of the next frame
+    static std::vector<PendingUpload> pendingUploads;
+    static std::vector<PendingRelease> pendingReleases;
+    // Reused by RecordUploads, the triangles are unpacked to one uint per index on the GPU
+    static std::vector<uint32_t> unpackedTriangles;
+
+    static std::unique_ptr<Compaction> compaction;
+    static bool compactionRequested;
+    static uint64_t lastCompactionCheck;
+    static CompactionStatistics compactionStatistics;
+    static std::unordered_set<Mesh*> relocatedMeshes;
+    static std::vector<RelocationListener> relocationListeners;
+
+    static bool IsResident() { return vertexPool != nullptr; }
+    static RangeAllocator& GetAllocator(Heap heap);
+    static uint64_t GetElementSize(Heap heap);
+    static RangeAllocator::Allocation AllocateRange(RangeAllocator& allocator, size_t size);
+    static void FreeMeshAllocation(const MeshAllocation& allocation);
+    static uint64_t QueueUpload(std::shared_ptr<Mesh> mesh, Heap heap);
+    static void RecordRangeUpload(std::shared_ptr<CommandList> cmd, Heap heap, const RangeAllocator::Allocation& range);
+
+    static void PlanCompaction();
+    // Moves a range of a mesh in the CPU copy of the heaps and updates the data pointing to it, the bytes to upload
+    // are added to uploadBytes. Returns false if the destination isn't free.
+    static bool ApplyMove(Heap heap, const CompactionPlanner::Move& move, uint64_t& uploadBytes);
+    static void UpdateCompaction();
+
+public:
+    // Returns the meshlet offset of the mesh, or invalidMeshletOffset if the heaps are full
     static unsigned PushNewMesh(std::shared_ptr<Mesh> mesh);
+    // The ranges of the mesh are reused once the frames in flight that can read them are complete
+    static void RemoveMesh(std::shared_ptr<Mesh> mesh);
     static void AllocateMeshPoolBuffers(std::shared_ptr<Device> device);
-};
\ No newline at end of file
+    // Copies the meshes pushed since the previous frame to the heaps and releases the removed ones that the GPU
+    // doesn't use anymore. The heaps are in the common state before and after the copies.
+    static void RecordUploads(std::shared_ptr<CommandList> cmd);
+
+    // Starts a compaction at the next frame even if the heaps aren't fragmented enough
+    static void RequestCompaction() { compactionRequested = true; }
+    // Compacts the CPU copy of the heaps at once, only possible before they are resident so that the holes left by
+    // the meshes removed while loading aren't uploaded. Returns false if the heaps are resident or a move failed.
+    static bool Compact();
+    static bool IsCompacting() { return compaction != nullptr; }
+
+    static void AddRelocationListener(void* owner, RelocationCallback callback);
+    static void RemoveRelocationListener(void* owner);
+
+    static std::vector<HeapStatistics> GetHeapStatistics();
+    static const CompactionStatistics& GetCompactionStatistics() { return compactionStatistics; }
+    static void PrintStatistics();
+};
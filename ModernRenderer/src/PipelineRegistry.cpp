@@ -0,0 +1,205 @@
+#include "PipelineRegistry.hpp"
+#include "ShaderCache.hpp"
+#include "Timer.hpp"
+#include <algorithm>
+#include <filesystem>
+
+PipelineRegistry PipelineRegistry::instance;
+
+std::string PipelineRegistry::GetKey(const ShaderDesc& desc)
+{
+	std::string key = desc.shader_path + "|" + desc.entrypoint + "|" + std::to_string((int)desc.type) + "|" + desc.model;
+	for (const auto& [name, value] : desc.define)
+		key += "|" + name + "=" + value;
+	return key;
+}
+
+void PipelineRegistry::CompileEntry(Entry& entry)
+{
+	uint64_t startTicks = Timer::GetTicks();
+	entry.shader = ShaderCache::Compile(entry.desc, &entry.timing.cacheHit);
+	entry.timing.seconds = Timer::TicksToSeconds(Timer::GetTicks() - startTicks);
+	entry.dependencies = ShaderCache::GetDependencies(entry.desc.shader_path);
+}
+
+static bool IsValidShader(const std::shared_ptr<Shader>& shader)
+{
+	// Compilation errors are reported by the compiler and give an empty bytecode
+	return shader && !shader->GetBlob().empty();
+}
+
+PipelineRegistry::Entry* PipelineRegistry::FindOrAdd(const ShaderDesc& desc, bool& added)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::string key = GetKey(desc);
+	auto it = entries.find(key);
+	added = it == entries.end();
+	if (!added)
+		return it->second.get();
+
+	auto entry = std::make_unique<Entry>();
+	entry->desc = desc;
+	entry->timing.name = std::filesystem::path(desc.shader_path).filename().string() + (desc.entrypoint.empty() ? "" : ":" + desc.entrypoint);
+	for (const auto& [name, value] : desc.define)
+		entry->timing.name += " " + name + "=" + value;
+
+	// Counted before the entry is visible so that GetShader never sees a requested shader as finished
+	entry->pending = 1;
+	Entry* entryPointer = entry.get();
+	entries.emplace(key, std::move(entry));
+	order.push_back(entryPointer);
+	return entryPointer;
+}
+
+void PipelineRegistry::Request(const ShaderDesc& desc)
+{
+	bool added;
+	Entry* entry = instance.FindOrAdd(desc, added);
+	if (!added)
+		return;
+
+	// Schedule increments the counter again, the initial count is released once the job is queued
+	JobSystem::Schedule([entry]() { CompileEntry(*entry); }, entry->pending);
+	entry->pending--;
+}
+
+std::shared_ptr<Shader> PipelineRegistry::GetShader(const ShaderDesc& desc)
+{
+	bool added;
+	Entry* entry = instance.FindOrAdd(desc, added);
+	if (added)
+	{
+		printf("Pipeline registry: %s was not requested up front, compiling it on first use\n", entry->timing.name.c_str());
+		entry->timing.requested = false;
+		CompileEntry(*entry);
+		entry->pending--;
+	}
+
+	JobSystem::Wait(entry->pending);
+	return entry->shader;
+}
+
+void PipelineRegistry::WaitAll()
+{
+	std::vector<Entry*> entries;
+	{
+		std::lock_guard<std::mutex> lock(instance.mutex);
+		entries = instance.order;
+	}
+
+	for (Entry* entry : entries)
+		JobSystem::Wait(entry->pending);
+}
+
+void PipelineRegistry::Reload(const std::vector<std::string>& changedFiles)
+{
+	std::lock_guard<std::mutex> lock(instance.mutex);
+
+	for (Entry* entry : instance.order)
+	{
+		// Shaders still compiling for the first time or already reloading are left alone
+		if (entry->pending > 0 || entry->reloadQueued)
+			continue;
+
+		bool affected = std::any_of(changedFiles.begin(), changedFiles.end(), [&](const std::string& file)
+		{
+			return std::find(entry->dependencies.begin(), entry->dependencies.end(), file) != entry->dependencies.end();
+		});
+		if (!affected)
+			continue;
+
+		// Reload runs on the ShaderWatcher thread: Schedule would queue the compilation to the main thread, which runs it
+		// when the frame waits for its own jobs
+		entry->reloadQueued = true;
+		JobSystem::ScheduleBackground([entry]()
+		{
+			entry->reloadedShader = ShaderCache::Compile(entry->desc);
+			entry->reloadedDependencies = ShaderCache::GetDependencies(entry->desc.shader_path);
+		}, entry->reloadPending);
+	}
+}
+
+bool PipelineRegistry::HasFinishedReloads()
+{
+	std::lock_guard<std::mutex> lock(instance.mutex);
+	return std::any_of(instance.order.begin(), instance.order.end(), [](Entry* entry) { return entry->reloadQueued && entry->reloadPending == 0; });
+}
+
+void PipelineRegistry::ApplyReloads()
+{
+	bool swapped = false;
+	std::vector<ReloadListener> listeners;
+	{
+		std::lock_guard<std::mutex> lock(instance.mutex);
+		for (Entry* entry : instance.order)
+		{
+			if (!entry->reloadQueued || entry->reloadPending > 0)
+				continue;
+
+			if (IsValidShader(entry->reloadedShader))
+			{
+				entry->shader = entry->reloadedShader;
+				entry->dependencies = entry->reloadedDependencies;
+				swapped = true;
+				printf("Pipeline registry: reloaded %s\n", entry->timing.name.c_str());
+			}
+			else
+			{
+				printf("Pipeline registry: %s failed to compile, keeping the previous version\n", entry->timing.name.c_str());
+			}
+
+			entry->reloadQueued = false;
+			entry->reloadedShader = nullptr;
+		}
+		listeners = instance.reloadListeners;
+	}
+
+	// Listeners fetch their shaders with GetShader, the lock must be released
+	if (swapped)
+	{
+		for (const auto& listener : listeners)
+			listener.callback();
+	}
+}
+
+void PipelineRegistry::AddReloadListener(void* owner, std::function<void()> callback)
+{
+	std::lock_guard<std::mutex> lock(instance.mutex);
+	instance.reloadListeners.push_back({ owner, callback });
+}
+
+void PipelineRegistry::RemoveReloadListener(void* owner)
+{
+	std::lock_guard<std::mutex> lock(instance.mutex);
+	auto& listeners = instance.reloadListeners;
+	listeners.erase(std::remove_if(listeners.begin(), listeners.end(), [owner](const ReloadListener& listener) { return listener.owner == owner; }), listeners.end());
+}
+
+std::vector<PipelineRegistry::ShaderTiming> PipelineRegistry::GetTimings()
+{
+	WaitAll();
+
+	std::lock_guard<std::mutex> lock(instance.mutex);
+	std::vector<ShaderTiming> timings;
+	for (Entry* entry : instance.order)
+		timings.push_back(entry->timing);
+	return timings;
+}
+
+void PipelineRegistry::PrintTimings()
+{
+	std::vector<ShaderTiming> timings = GetTimings();
+	std::stable_sort(timings.begin(), timings.end(), [](const ShaderTiming& a, const ShaderTiming& b) { return a.seconds > b.seconds; });
+
+	double totalSeconds = 0;
+	for (const auto& timing : timings)
+		totalSeconds += timing.seconds;
+
+	printf("Pipeline registry: %zu shaders, %.2f s of compilation over %u workers\n", timings.size(), totalSeconds, JobSystem::GetWorkerCount());
+	for (const auto& timing : timings)
+	{
+		printf("    %7.1f ms  %s%s%s\n", timing.seconds * 1000.0, timing.name.c_str(),
+			timing.cacheHit ? " (cached)" : "", timing.requested ? "" : " (not requested)");
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Instance/Instance.h"
+#include "JobSystem.hpp"
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Compiles the shaders of every pipeline up front on the JobSystem workers, e.g. while the scene is imported.
+// Each system requests its shaders at startup (see Renderer::RequestShaders) and fetches them with GetShader
+// when it creates its pipelines, which only waits for the shaders of that pipeline. The calling thread runs
+// queued jobs while it waits, the startup is never slower than compiling serially.
+//
+// Shaders can be reloaded while the application runs (see ShaderWatcher): the shaders depending on an edited
+// file are recompiled in the background, then ApplyReloads swaps them and calls the reload listeners, which
+// create their pipelines again. A shader that fails to compile keeps its previous version.
+class PipelineRegistry
+{
+public:
+	struct ShaderTiming
+	{
+		std::string name;
+		double seconds = 0;
+		bool cacheHit = false;
+		// False when the shader was compiled on first use because it wasn't requested up front
+		bool requested = true;
+	};
+
+private:
+	struct Entry
+	{
+		ShaderDesc desc;
+		std::shared_ptr<Shader> shader;
+		JobSystem::Counter pending = 0;
+		ShaderTiming timing;
+		// Canonical paths of the source and its includes
+		std::vector<std::string> dependencies;
+
+		// Background recompilation, the shader in use is only replaced by ApplyReloads
+		bool reloadQueued = false;
+		JobSystem::Counter reloadPending = 0;
+		std::shared_ptr<Shader> reloadedShader;
+		std::vector<std::string> reloadedDependencies;
+	};
+
+	struct ReloadListener
+	{
+		void* owner;
+		std::function<void()> callback;
+	};
+
+	static PipelineRegistry instance;
+
+	std::mutex mutex;
+	std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+	// Request order, used for the timing report
+	std::vector<Entry*> order;
+	std::vector<ReloadListener> reloadListeners;
+
+	PipelineRegistry() = default;
+	~PipelineRegistry() = default;
+
+	static std::string GetKey(const ShaderDesc& desc);
+	static void CompileEntry(Entry& entry);
+	Entry* FindOrAdd(const ShaderDesc& desc, bool& added);
+
+public:
+	// Starts compiling the shader in the background, requesting the same shader twice compiles it once
+	static void Request(const ShaderDesc& desc);
+	// Returns the shader once it is compiled, shaders that weren't requested are compiled on the calling thread
+	static std::shared_ptr<Shader> GetShader(const ShaderDesc& desc);
+	// Waits for every requested shader
+	static void WaitAll();
+
+	// Recompiles in the background the shaders depending on one of the files, files are canonical paths
+	static void Reload(const std::vector<std::string>& changedFiles);
+	// True once at least one of the recompilations started by Reload is finished
+	static bool HasFinishedReloads();
+	// Swaps the recompiled shaders and calls the reload listeners if one of them changed. Must be called
+	// when the GPU is done with the current pipelines, e.g. after FrameContext::WaitIdle.
+	static void ApplyReloads();
+	// Listeners are called on the thread calling ApplyReloads, the owner is used to remove them
+	static void AddReloadListener(void* owner, std::function<void()> callback);
+	static void RemoveReloadListener(void* owner);
+
+	static std::vector<ShaderTiming> GetTimings();
+	// Prints the compile time of each shader, slowest first
+	static void PrintTimings();
+};
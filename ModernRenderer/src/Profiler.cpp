@@ -2,8 +2,16 @@
 #include <CommandList/DXCommandList.h>
 #include <Resource/DXResource.h>
 #include <CommandQueue/DXCommandQueue.h>
+#include "Timer.hpp"
+#include "Json.hpp"
+#include <imgui.h>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <cstdlib>
 
 Profiler Profiler::instance;
+thread_local std::stack<unsigned> Profiler::markerIndexStack;
 
 void Profiler::Init(std::shared_ptr<Device> device)
 {
@@ -13,12 +21,16 @@ void Profiler::Init(std::shared_ptr<Device> device)
 
 	D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
 	queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
-	queryHeapDesc.Count = 1024;
+	queryHeapDesc.Count = readbackSlotCount * maxQueriesPerFrame;
 	nativeDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&instance.queryHeap));
 
-	instance.readbackBuffer = device->CreateBuffer(BindFlag::kCopyDest, 1024 * sizeof(uint64_t));
-	instance.readbackBuffer->CommitMemory(MemoryType::kReadback);
-	instance.readbackBuffer->SetName("Timings Readback Buffer");
+	for (unsigned i = 0; i < readbackSlotCount; i++)
+	{
+		auto& readbackBuffer = instance.frames[i].readbackBuffer;
+		readbackBuffer = device->CreateBuffer(BindFlag::kCopyDest, maxQueriesPerFrame * sizeof(uint64_t));
+		readbackBuffer->CommitMemory(MemoryType::kReadback);
+		readbackBuffer->SetName("Timings Readback Buffer " + std::to_string(i));
+	}
 
 	instance.profilersWindow = new ImGuiUtils::ProfilersWindow();
 	instance.profilersWindow->frameWidth = 1;
@@ -33,57 +45,85 @@ Profiler::~Profiler()
 void Profiler::DrawImGUIPanel()
 {
 	instance.profilersWindow->Render();
+	instance.DrawStatisticsWindow();
 }
 
 void Profiler::BeginFrame()
 {
-	instance.frameQueryIndex = 0;
-	instance.frameMarkers.clear();
-	instance.frameGPUTimes.clear();
-	instance.frameCPUTimes.clear();
+	instance.frameIndex++;
+
+	FrameData& frame = instance.GetCurrentFrame();
+	frame.frameID = instance.frameIndex;
+	frame.markers.clear();
+	frame.queryCount = 0;
+	frame.droppedMarkers = 0;
+	frame.resolved = false;
 }
 
 void Profiler::EndFrame(std::shared_ptr<CommandList> cmd)
 {
-	auto buf = instance.readbackBuffer->As<DXResource>().resource.Get();
-	cmd->As<DXCommandList>().GetCommandList()->ResolveQueryData(instance.queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, instance.frameQueryIndex, buf, 0);
+	FrameData& frame = instance.GetCurrentFrame();
+	unsigned slot = instance.frameIndex % readbackSlotCount;
+
+	if (frame.queryCount > 0)
+	{
+		auto buf = frame.readbackBuffer->As<DXResource>().resource.Get();
+		cmd->As<DXCommandList>().GetCommandList()->ResolveQueryData(instance.queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, slot * maxQueriesPerFrame, frame.queryCount, buf, 0);
+		frame.resolved = true;
+	}
+
+	if (frame.droppedMarkers > 0)
+	{
+		// Only report the first overflow, the total is visible in the statistics window and the summary
+		if (instance.totalDroppedMarkers == 0)
+			printf("Profiler: %u markers of frame %llu exceed the %u timestamp queries per frame, their GPU timings are dropped\n", frame.droppedMarkers, (unsigned long long)frame.frameID, maxQueriesPerFrame);
+		instance.totalDroppedMarkers += frame.droppedMarkers;
+	}
 }
 
-double getCurrentTimeInSeconds()
+int Profiler::AllocateQuery(std::shared_ptr<CommandList> cmd)
 {
-	LARGE_INTEGER frequency, counter;
-	QueryPerformanceFrequency(&frequency);
-	QueryPerformanceCounter(&counter);
-	return static_cast<double>(counter.QuadPart) / frequency.QuadPart;
+	FrameData& frame = GetCurrentFrame();
+	if (frame.queryCount >= maxQueriesPerFrame)
+		return -1;
+
+	unsigned slot = frameIndex % readbackSlotCount;
+	cmd->As<DXCommandList>().GetCommandList()->EndQuery(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, slot * maxQueriesPerFrame + frame.queryCount);
+	return frame.queryCount++;
 }
 
 void Profiler::BeginMarker(std::shared_ptr<CommandList> cmd, const std::string& name)
 {
 	cmd->BeginEvent(name);
 
-	cmd->As<DXCommandList>().GetCommandList()->EndQuery(instance.queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, instance.frameQueryIndex);
+	std::lock_guard<std::mutex> lock(instance.markerMutex);
+	FrameData& frame = instance.GetCurrentFrame();
 	Marker marker;
 	marker.name = name;
-	marker.startIndex = instance.frameQueryIndex;
-	marker.startCPUTime = getCurrentTimeInSeconds();
+	marker.startIndex = instance.AllocateQuery(cmd);
+	marker.endIndex = -1;
+	marker.startCPUTime = Timer::GetTimeInSeconds();
+	marker.threadID = TraceWriter::GetCurrentThreadID();
 
-	instance.markerIndexStack.push(instance.frameMarkers.size());
-	instance.frameMarkers.push_back(marker);
-	instance.frameQueryIndex++;
+	markerIndexStack.push(frame.markers.size());
+	frame.markers.push_back(marker);
 }
 
 void Profiler::EndMarker(std::shared_ptr<CommandList> cmd)
 {
 	cmd->EndEvent();
-	if (instance.frameMarkers.empty()) return;
-	unsigned index = instance.markerIndexStack.top();
-	instance.markerIndexStack.pop();
-	auto& marker = instance.frameMarkers[index];
-	cmd->As<DXCommandList>().GetCommandList()->EndQuery(instance.queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, instance.frameQueryIndex);
-	marker.endIndex = instance.frameQueryIndex;
-	marker.endCPUTime = getCurrentTimeInSeconds();
 
-	instance.frameQueryIndex++;
+	std::lock_guard<std::mutex> lock(instance.markerMutex);
+	FrameData& frame = instance.GetCurrentFrame();
+	if (frame.markers.empty() || markerIndexStack.empty()) return;
+	unsigned index = markerIndexStack.top();
+	markerIndexStack.pop();
+	auto& marker = frame.markers[index];
+	marker.endIndex = instance.AllocateQuery(cmd);
+	marker.endCPUTime = Timer::GetTimeInSeconds();
+
+	if (marker.startIndex < 0 || marker.endIndex < 0)
+		frame.droppedMarkers++;
 }
 
 uint32_t GetColorFromString(const std::string& input)
@@ -111,20 +151,46 @@ uint32_t GetColorFromString(const std::string& input)
 
 void Profiler::ReadbackStats(std::shared_ptr<CommandQueue> cmdQueue)
 {
-	if (instance.frameMarkers.size() == 0)
+	// Called before BeginFrame, once FrameContext::BeginFrame guaranteed that frame N - framesInFlight is complete
+	uint64_t nextFrameID = instance.frameIndex + 1;
+	if (nextFrameID <= FrameContext::framesInFlight)
+		return;
+	uint64_t readbackFrameID = nextFrameID - FrameContext::framesInFlight;
+	FrameData& frame = instance.frames[readbackFrameID % readbackSlotCount];
+
+	// The slot must still contain the expected frame, otherwise the timings would mix different frames
+	if (frame.frameID != readbackFrameID || !frame.resolved || frame.markers.empty())
 		return;
+	frame.resolved = false;
+
+	instance.frameGPUTimes.clear();
+	instance.frameCPUTimes.clear();
 
-	uint64_t* timings = (uint64_t*)instance.readbackBuffer->Map();
+	uint64_t* timings = (uint64_t*)frame.readbackBuffer->Map();
 	uint64_t frequency;
 	DXCommandQueue* dxQueue = (DXCommandQueue*)cmdQueue.get();
 	auto nativeQueue = dxQueue->GetQueue();
 	nativeQueue->GetTimestampFrequency(&frequency);
 
-	uint64_t firstMarkerGPUFrameSec = timings[0];
-	auto firstMarkerCPUTime = instance.frameMarkers[0].startCPUTime;
+	uint64_t firstMarkerGPUFrameSec = frame.markers[0].startIndex >= 0 ? timings[frame.markers[0].startIndex] : 0;
+	auto firstMarkerCPUTime = frame.markers[0].startCPUTime;
 
-	for (auto& marker : instance.frameMarkers)
+	for (auto& marker : frame.markers)
 	{
+		double startCPUTime = marker.startCPUTime - firstMarkerCPUTime;
+		double endCPUTime = marker.endCPUTime - firstMarkerCPUTime;
+
+		legit::ProfilerTask taskCPU = { startCPUTime, endCPUTime, marker.name, GetColorFromString(marker.name) };
+		instance.frameCPUTimes.push_back(taskCPU);
+
+		// Markers past the query budget of the frame have no GPU timing
+		if (marker.startIndex < 0 || marker.endIndex < 0)
+		{
+			marker.startGPUTime = marker.endGPUTime = 0;
+			marker.elapsedTimeMillis = 0;
+			continue;
+		}
+
 		marker.startGPUTime = timings[marker.startIndex];
 		marker.endGPUTime = timings[marker.endIndex];
 		marker.elapsedTimeMillis = (double)(marker.endGPUTime - marker.startGPUTime) / frequency * 1000.0;
@@ -132,15 +198,258 @@ void Profiler::ReadbackStats(std::shared_ptr<CommandQueue> cmdQueue)
 		double endGPUTimeSec = (double)(marker.endGPUTime - firstMarkerGPUFrameSec) / frequency;
 		legit::ProfilerTask taskGPU = { startGPUTimeSec, endGPUTimeSec, marker.name, GetColorFromString(marker.name) };
 		instance.frameGPUTimes.push_back(taskGPU);
+	}
+	frame.readbackBuffer->Unmap();
 
-		double startCPUTime = marker.startCPUTime - firstMarkerCPUTime;
-		double endCPUTime = marker.endCPUTime - firstMarkerCPUTime;
+	instance.UpdateStatistics(frame.markers);
 
-		legit::ProfilerTask taskCPU = { startCPUTime, endCPUTime, marker.name, GetColorFromString(marker.name) };
-		instance.frameCPUTimes.push_back(taskCPU);
-	}
-	instance.readbackBuffer->Unmap();
+	if (instance.traceWriter.IsOpen())
+		instance.WriteTraceEvents(cmdQueue, frequency, frame);
 
 	instance.profilersWindow->gpuGraph.LoadFrameData(instance.frameGPUTimes.data(), instance.frameGPUTimes.size());
 	instance.profilersWindow->cpuGraph.LoadFrameData(instance.frameCPUTimes.data(), instance.frameCPUTimes.size());
 }
+
+void Profiler::WriteTraceEvents(std::shared_ptr<CommandQueue> cmdQueue, uint64_t frequency, const FrameData& frame)
+{
+	// Map GPU timestamps to the CPU timer: the clock calibration gives the current GPU timestamp,
+	// which is sampled right before the CPU time so both describe the same instant.
+	uint64_t gpuTimestamp, cpuTimestamp;
+	((DXCommandQueue*)cmdQueue.get())->GetQueue()->GetClockCalibration(&gpuTimestamp, &cpuTimestamp);
+	double cpuNow = Timer::GetTimeInSeconds();
+
+	for (const auto& marker : frame.markers)
+	{
+		traceWriter.AddEvent(marker.name, TraceWriter::CPU, marker.threadID, marker.startCPUTime, marker.endCPUTime - marker.startCPUTime, frame.frameID);
+		if (marker.startIndex < 0 || marker.endIndex < 0)
+			continue;
+
+		double gpuStart = cpuNow - ((double)gpuTimestamp - (double)marker.startGPUTime) / frequency;
+		traceWriter.AddEvent(marker.name, TraceWriter::GPU, 0, gpuStart, marker.elapsedTimeMillis / 1000.0, frame.frameID);
+	}
+}
+
+bool Profiler::BeginTrace(const std::string& path)
+{
+	if (!instance.traceWriter.Open(path))
+		return false;
+
+	instance.traceWriter.SetThreadName(TraceWriter::CPU, TraceWriter::GetCurrentThreadID(), "Main Thread");
+	instance.traceWriter.SetThreadName(TraceWriter::GPU, 0, "Graphics Queue");
+	return true;
+}
+
+void Profiler::EndTrace()
+{
+	instance.traceWriter.Close();
+}
+
+void Profiler::UpdateStatistics(const std::vector<Marker>& markers)
+{
+	for (const auto& marker : markers)
+	{
+		auto it = markerStatistics.find(marker.name);
+		if (it == markerStatistics.end())
+		{
+			it = markerStatistics.emplace(marker.name, MarkerStatistics()).first;
+			statisticsOrder.push_back(marker.name);
+		}
+
+		if (marker.startIndex >= 0 && marker.endIndex >= 0)
+			it->second.gpuMillis.AddSample(marker.elapsedTimeMillis);
+		it->second.cpuMillis.AddSample((marker.endCPUTime - marker.startCPUTime) * 1000.0);
+	}
+}
+
+bool Profiler::IsOverBudget(const std::string& name) const
+{
+	auto budget = budgets.find(name);
+	auto statistics = markerStatistics.find(name);
+	if (budget == budgets.end() || statistics == markerStatistics.end())
+		return false;
+
+	return statistics->second.gpuMillis.GetP95() > budget->second;
+}
+
+void Profiler::DrawStatisticsWindow()
+{
+	ImGui::Begin("Profiler Statistics");
+	if (!statisticsOrder.empty())
+		ImGui::Text("GPU recent: mean of the last %zu frames, other columns: all the frames", markerStatistics[statisticsOrder.front()].gpuMillis.GetWindowSize());
+
+	if (ImGui::BeginTable("MarkerStatistics", 9, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		ImGui::TableSetupColumn("Marker");
+		ImGui::TableSetupColumn("GPU recent");
+		ImGui::TableSetupColumn("GPU mean");
+		ImGui::TableSetupColumn("GPU min/max");
+		ImGui::TableSetupColumn("GPU p50");
+		ImGui::TableSetupColumn("GPU p95");
+		ImGui::TableSetupColumn("GPU p99");
+		ImGui::TableSetupColumn("CPU mean");
+		ImGui::TableSetupColumn("Budget");
+		ImGui::TableHeadersRow();
+
+		for (const auto& name : statisticsOrder)
+		{
+			const auto& statistics = markerStatistics[name];
+			const auto& gpu = statistics.gpuMillis;
+			bool overBudget = IsOverBudget(name);
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			if (overBudget)
+				ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "%s", name.c_str());
+			else
+				ImGui::TextUnformatted(name.c_str());
+			ImGui::TableNextColumn(); ImGui::Text("%.3f ms", gpu.GetWindowMean());
+			ImGui::TableNextColumn(); ImGui::Text("%.3f ms", gpu.GetMean());
+			ImGui::TableNextColumn(); ImGui::Text("%.3f / %.3f", gpu.GetMin(), gpu.GetMax());
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", gpu.GetP50());
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", gpu.GetP95());
+			ImGui::TableNextColumn(); ImGui::Text("%.3f", gpu.GetP99());
+			ImGui::TableNextColumn(); ImGui::Text("%.3f ms", statistics.cpuMillis.GetMean());
+			ImGui::TableNextColumn();
+			auto budget = budgets.find(name);
+			if (budget != budgets.end())
+				ImGui::Text("%.3f ms", budget->second);
+			else
+				ImGui::TextUnformatted("-");
+		}
+
+		ImGui::EndTable();
+	}
+
+	if (totalDroppedMarkers > 0)
+		ImGui::TextColored(ImVec4(1, 0.3f, 0.3f, 1), "%llu markers dropped: more than %u timestamp queries in a frame", (unsigned long long)totalDroppedMarkers, maxQueriesPerFrame);
+
+	if (ImGui::Button("Reset Statistics"))
+		ResetStatistics();
+
+	ImGui::End();
+}
+
+void Profiler::ResetStatistics()
+{
+	for (auto& statistics : instance.markerStatistics)
+	{
+		statistics.second.gpuMillis.Reset();
+		statistics.second.cpuMillis.Reset();
+	}
+}
+
+void Profiler::SetBudget(const std::string& markerName, double gpuMillis)
+{
+	instance.budgets[markerName] = gpuMillis;
+}
+
+bool Profiler::LoadBudgets(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		printf("Failed to open profiler budget file %s\n", path.c_str());
+		return false;
+	}
+
+	auto trim = [](const std::string& s)
+	{
+		size_t start = s.find_first_not_of(" \t\r");
+		size_t end = s.find_last_not_of(" \t\r");
+		return start == std::string::npos ? std::string() : s.substr(start, end - start + 1);
+	};
+
+	// Invalid lines are reported and skipped, the other budgets of the file are still loaded
+	std::string line;
+	unsigned lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty())
+			continue;
+
+		size_t separator = line.find('=');
+		std::string name = separator != std::string::npos ? trim(line.substr(0, separator)) : std::string();
+		if (name.empty())
+		{
+			printf("%s(%u): invalid profiler budget line, expected \"Marker Name = milliseconds\": %s\n", path.c_str(), lineNumber, line.c_str());
+			continue;
+		}
+
+		std::string value = trim(line.substr(separator + 1));
+		char* end = nullptr;
+		double millis = strtod(value.c_str(), &end);
+		if (value.empty() || *end != '\0' || !std::isfinite(millis) || millis < 0.0)
+		{
+			printf("%s(%u): invalid profiler budget for %s: \"%s\"\n", path.c_str(), lineNumber, name.c_str(), value.c_str());
+			continue;
+		}
+
+		SetBudget(name, millis);
+	}
+
+	return true;
+}
+
+static void WriteStatisticsJSON(std::ostream& out, const RollingStatistics& statistics)
+{
+	out << "{ \"mean\": " << statistics.GetMean()
+		<< ", \"min\": " << statistics.GetMin()
+		<< ", \"max\": " << statistics.GetMax()
+		<< ", \"p50\": " << statistics.GetP50()
+		<< ", \"p95\": " << statistics.GetP95()
+		<< ", \"p99\": " << statistics.GetP99()
+		<< ", \"samples\": " << statistics.GetSampleCount() << " }";
+}
+
+void Profiler::WriteMarkerStatistics(std::ostream& out, const std::string& indent)
+{
+	out << "[";
+	for (size_t i = 0; i < instance.statisticsOrder.size(); i++)
+	{
+		const auto& name = instance.statisticsOrder[i];
+		const auto& statistics = instance.markerStatistics[name];
+
+		out << (i == 0 ? "\n" : ",\n") << indent << "  { \"name\": \"" << EscapeJSON(name) << "\", \"gpuMillis\": ";
+		WriteStatisticsJSON(out, statistics.gpuMillis);
+		out << ", \"cpuMillis\": ";
+		WriteStatisticsJSON(out, statistics.cpuMillis);
+
+		auto budget = instance.budgets.find(name);
+		if (budget != instance.budgets.end())
+			out << ", \"budgetMillis\": " << budget->second << ", \"overBudget\": " << (instance.IsOverBudget(name) ? "true" : "false");
+		out << " }";
+	}
+	out << "\n" << indent << "]";
+}
+
+bool Profiler::WriteSummary(const std::string& path)
+{
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+	{
+		printf("Failed to write profiler summary %s\n", path.c_str());
+		return false;
+	}
+
+	file << "{\n  \"frames\": " << instance.frameIndex << ",\n  \"droppedMarkers\": " << instance.totalDroppedMarkers << ",\n  \"markers\": ";
+	WriteMarkerStatistics(file, "  ");
+	file << "\n}\n";
+
+	return true;
+}
+
+unsigned Profiler::ReportBudgetViolations()
+{
+	unsigned violations = 0;
+	for (const auto& name : instance.statisticsOrder)
+	{
+		if (instance.IsOverBudget(name))
+		{
+			printf("Profiler budget exceeded: %s p95 %.3f ms > %.3f ms\n", name.c_str(), instance.markerStatistics[name].gpuMillis.GetP95(), instance.budgets[name]);
+			violations++;
+		}
+	}
+	return violations;
+}
@@ -7,9 +7,21 @@
 #include <Device/DXDevice.h>
 #include <stack>
 #include <ctime>
+#include "TraceWriter.hpp"
+#include "RollingStatistics.hpp"
+#include "FrameContext.hpp"
+#include <unordered_map>
+#include <array>
+#include <mutex>
 
 class Profiler
 {
+public:
+	// Timestamps of each frame use their own query range and readback buffer, stamped with the frame ID.
+	// Frame N is read at the start of frame N + FrameContext::framesInFlight, when the GPU is guaranteed to be done with it.
+	static constexpr unsigned readbackSlotCount = FrameContext::readbackSlotCount;
+	static constexpr unsigned maxQueriesPerFrame = 512;
+
 private:
 	struct Marker
 	{
@@ -21,6 +33,23 @@ private:
 		double startCPUTime;
 		double endCPUTime;
 		double elapsedTimeMillis;
+		uint32_t threadID;
+	};
+
+	struct FrameData
+	{
+		uint64_t frameID = 0;
+		std::vector<Marker> markers;
+		std::shared_ptr<Resource> readbackBuffer;
+		unsigned queryCount = 0;
+		unsigned droppedMarkers = 0;
+		bool resolved = false;
+	};
+
+	struct MarkerStatistics
+	{
+		RollingStatistics gpuMillis;
+		RollingStatistics cpuMillis;
 	};
 
 	static Profiler instance;
@@ -30,10 +59,28 @@ private:
 	std::vector<legit::ProfilerTask> frameGPUTimes;
 	std::vector<legit::ProfilerTask> frameCPUTimes;
 	ComPtr<ID3D12QueryHeap> queryHeap;
-	std::shared_ptr<Resource> readbackBuffer;
-	int frameQueryIndex = 0;
-	std::vector<Marker> frameMarkers;
-	std::stack<unsigned> markerIndexStack;
+	std::array<FrameData, readbackSlotCount> frames;
+	// Markers can be recorded from several threads at once, each one nests its own markers
+	static thread_local std::stack<unsigned> markerIndexStack;
+	std::mutex markerMutex;
+	uint64_t frameIndex = 0;
+	uint64_t totalDroppedMarkers = 0;
+
+	FrameData& GetCurrentFrame() { return frames[frameIndex % readbackSlotCount]; }
+	int AllocateQuery(std::shared_ptr<CommandList> cmd);
+	TraceWriter traceWriter;
+
+	// Statistics per marker name, in the order the markers were first seen
+	std::vector<std::string> statisticsOrder;
+	std::unordered_map<std::string, MarkerStatistics> markerStatistics;
+	// GPU time budget in milliseconds per marker name, compared against the p95
+	std::unordered_map<std::string, double> budgets;
+
+	void UpdateStatistics(const std::vector<Marker>& markers);
+	void DrawStatisticsWindow();
+	bool IsOverBudget(const std::string& name) const;
+
+	void WriteTraceEvents(std::shared_ptr<CommandQueue> cmdQueue, uint64_t frequency, const FrameData& frame);
 
 	Profiler() = default;
 	~Profiler();
@@ -50,4 +97,20 @@ public:
 	static void EndMarker(std::shared_ptr<CommandList> cmd);
 
 	static void ReadbackStats(std::shared_ptr<CommandQueue> cmdQueue);
+
+	// Streams the CPU and GPU markers of every frame to a Chrome trace JSON file until EndTrace is called
+	static bool BeginTrace(const std::string& path);
+	static void EndTrace();
+
+	static void SetBudget(const std::string& markerName, double gpuMillis);
+	// Reads budgets from a text file with one "Marker Name = milliseconds" per line, # starts a comment
+	static bool LoadBudgets(const std::string& path);
+	// Writes the statistics of every marker as JSON
+	static bool WriteSummary(const std::string& path);
+	// Writes the JSON array of the marker statistics, used to embed them in other reports
+	static void WriteMarkerStatistics(std::ostream& out, const std::string& indent);
+	// Restarts the statistics of every marker, for example to ignore warmup frames
+	static void ResetStatistics();
+	// Prints the markers exceeding their budget and returns their count
+	static unsigned ReportBudgetViolations();
 };
\ No newline at end of file
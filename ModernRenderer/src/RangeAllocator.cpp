@@ -0,0 +1,200 @@
+#include "RangeAllocator.hpp"
+#include <bit>
+#include <algorithm>
+#include <cstdio>
+
+RangeAllocator::RangeAllocator(uint32_t capacity)
+{
+	Reset(capacity);
+}
+
+unsigned RangeAllocator::GetSizeClass(uint32_t size)
+{
+	return std::bit_width(size) - 1;
+}
+
+void RangeAllocator::AddFreeBlock(uint32_t offset, uint32_t size)
+{
+	unsigned sizeClass = GetSizeClass(size);
+	freeBlocks[offset] = size;
+	freeLists[sizeClass].insert(offset);
+	nonEmptyClasses |= 1u << sizeClass;
+}
+
+void RangeAllocator::RemoveFreeBlock(uint32_t offset, uint32_t size)
+{
+	unsigned sizeClass = GetSizeClass(size);
+	freeBlocks.erase(offset);
+	freeLists[sizeClass].erase(offset);
+	if (freeLists[sizeClass].empty())
+		nonEmptyClasses &= ~(1u << sizeClass);
+}
+
+void RangeAllocator::Reset(uint32_t capacity)
+{
+	this->capacity = capacity;
+	usedSize = 0;
+	allocations.clear();
+	freeBlocks.clear();
+	for (auto& list : freeLists)
+		list.clear();
+	nonEmptyClasses = 0;
+
+	if (capacity > 0)
+		AddFreeBlock(0, capacity);
+}
+
+RangeAllocator::Allocation RangeAllocator::Allocate(uint32_t size)
+{
+	if (size == 0)
+		return { 0, 0 };
+
+	// Every block of the classes above the one of the size is large enough, unless the size is a power of two
+	// which the blocks of its own class always fit
+	unsigned sizeClass = GetSizeClass(size);
+	unsigned fitClass = std::has_single_bit(size) ? sizeClass : sizeClass + 1;
+	uint32_t offset = invalidOffset;
+	uint32_t blockSize = 0;
+
+	uint32_t candidates = fitClass < sizeClassCount ? nonEmptyClasses & (~0u << fitClass) : 0;
+	if (candidates != 0)
+	{
+		offset = *freeLists[std::countr_zero(candidates)].begin();
+		blockSize = freeBlocks[offset];
+	}
+	else
+	{
+		// Only the blocks of the same class can still fit, take the first one that does
+		for (uint32_t blockOffset : freeLists[sizeClass])
+		{
+			uint32_t candidateSize = freeBlocks[blockOffset];
+			if (candidateSize >= size)
+			{
+				offset = blockOffset;
+				blockSize = candidateSize;
+				break;
+			}
+		}
+	}
+
+	if (offset == invalidOffset)
+		return {};
+
+	RemoveFreeBlock(offset, blockSize);
+	if (blockSize > size)
+		AddFreeBlock(offset + size, blockSize - size);
+
+	usedSize += size;
+	allocations.emplace(offset, size);
+	return { offset, size };
+}
+
+RangeAllocator::Allocation RangeAllocator::AllocateAt(uint32_t offset, uint32_t size)
+{
+	if (size == 0)
+		return { offset, 0 };
+
+	// The free block starting at or before the offset is the only one that can contain the range
+	auto block = freeBlocks.upper_bound(offset);
+	if (block == freeBlocks.begin())
+		return {};
+	--block;
+
+	uint32_t blockOffset = block->first;
+	uint32_t blockSize = block->second;
+	if ((uint64_t)blockOffset + blockSize < (uint64_t)offset + size)
+		return {};
+
+	RemoveFreeBlock(blockOffset, blockSize);
+	if (offset > blockOffset)
+		AddFreeBlock(blockOffset, offset - blockOffset);
+	if (blockOffset + blockSize > offset + size)
+		AddFreeBlock(offset + size, blockOffset + blockSize - offset - size);
+
+	usedSize += size;
+	allocations.emplace(offset, size);
+	return { offset, size };
+}
+
+bool RangeAllocator::Free(const Allocation& allocation)
+{
+	if (!allocation.IsValid() || allocation.size == 0)
+		return true;
+
+	auto allocated = allocations.find(allocation.offset);
+	if (allocated == allocations.end() || allocated->second != allocation.size)
+	{
+		printf("RangeAllocator: free of the range [%u, %llu) that isn't allocated\n", allocation.offset, (unsigned long long)allocation.offset + allocation.size);
+		return false;
+	}
+	allocations.erase(allocated);
+
+	uint32_t offset = allocation.offset;
+	uint32_t size = allocation.size;
+
+	// Merge with the free blocks right after and right before the range
+	auto next = freeBlocks.lower_bound(offset);
+	if (next != freeBlocks.end() && next->first == offset + size)
+	{
+		uint32_t nextSize = next->second;
+		RemoveFreeBlock(next->first, nextSize);
+		size += nextSize;
+	}
+
+	auto previous = freeBlocks.lower_bound(offset);
+	if (previous != freeBlocks.begin())
+	{
+		--previous;
+		if (previous->first + previous->second == offset)
+		{
+			uint32_t previousOffset = previous->first;
+			uint32_t previousSize = previous->second;
+			RemoveFreeBlock(previousOffset, previousSize);
+			offset = previousOffset;
+			size += previousSize;
+		}
+	}
+
+	AddFreeBlock(offset, size);
+	usedSize -= allocation.size;
+	return true;
+}
+
+void RangeAllocator::Grow(uint32_t newCapacity)
+{
+	if (newCapacity <= capacity)
+		return;
+
+	uint32_t oldCapacity = capacity;
+	capacity = newCapacity;
+	// Reuses the merge of Free, the new space is counted as used until then
+	usedSize += newCapacity - oldCapacity;
+	allocations.emplace(oldCapacity, newCapacity - oldCapacity);
+	Free({ oldCapacity, newCapacity - oldCapacity });
+}
+
+RangeAllocator::Statistics RangeAllocator::GetStatistics() const
+{
+	Statistics statistics;
+	statistics.capacity = capacity;
+	statistics.usedSize = usedSize;
+	statistics.freeSize = capacity - usedSize;
+	statistics.freeBlockCount = (uint32_t)freeBlocks.size();
+	statistics.allocationCount = (uint32_t)allocations.size();
+
+	for (const auto& block : freeBlocks)
+		statistics.largestFreeBlock = std::max(statistics.largestFreeBlock, block.second);
+
+	statistics.usedEnd = capacity;
+	if (!freeBlocks.empty())
+	{
+		const auto& last = *freeBlocks.rbegin();
+		if (last.first + last.second == capacity)
+			statistics.usedEnd = last.first;
+	}
+
+	if (statistics.freeSize > 0)
+		statistics.fragmentation = 1.0f - (float)statistics.largestFreeBlock / statistics.freeSize;
+
+	return statistics;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <set>
+
+// Allocates ranges of elements in a buffer of fixed capacity, the GPU buffer itself is managed by the owner and
+// the allocations are plain offsets into it. Free blocks are stored in one free list per power of two size class:
+// a class whose blocks all fit is found with a bit scan, and only when none is left the blocks of the class of the
+// size are scanned linearly for one large enough. Released ranges are merged with the free blocks around them to
+// limit fragmentation.
+class RangeAllocator
+{
+public:
+	static constexpr uint32_t invalidOffset = UINT32_MAX;
+	// Class i contains the free blocks of size [2^i, 2^(i+1))
+	static constexpr unsigned sizeClassCount = 32;
+
+	struct Allocation
+	{
+		uint32_t offset = invalidOffset;
+		uint32_t size = 0;
+
+		bool IsValid() const { return offset != invalidOffset; }
+	};
+
+	struct Statistics
+	{
+		uint32_t capacity = 0;
+		uint32_t usedSize = 0;
+		uint32_t freeSize = 0;
+		uint32_t largestFreeBlock = 0;
+		uint32_t freeBlockCount = 0;
+		uint32_t allocationCount = 0;
+		// Elements after the end of the last allocation are all free
+		uint32_t usedEnd = 0;
+		// 0 when the free space is a single block, close to 1 when it is split into many small blocks
+		float fragmentation = 0;
+	};
+
+private:
+	uint32_t capacity = 0;
+	uint32_t usedSize = 0;
+
+	// Allocated ranges, offset -> size, to reject the release of a range that isn't allocated
+	std::map<uint32_t, uint32_t> allocations;
+
+	// Free blocks by offset to find the neighbors of a released range, offset -> size
+	std::map<uint32_t, uint32_t> freeBlocks;
+	// Offsets of the free blocks of each size class, the lowest offset is used first to keep the buffer compact
+	std::array<std::set<uint32_t>, sizeClassCount> freeLists;
+	// Bit i is set when freeLists[i] isn't empty
+	uint32_t nonEmptyClasses = 0;
+
+	static unsigned GetSizeClass(uint32_t size);
+
+	void AddFreeBlock(uint32_t offset, uint32_t size);
+	void RemoveFreeBlock(uint32_t offset, uint32_t size);
+
+public:
+	RangeAllocator() = default;
+	RangeAllocator(uint32_t capacity);
+
+	// Returns an invalid allocation when there is no free block large enough, empty allocations are always valid
+	Allocation Allocate(uint32_t size);
+	// Allocates a given range, used to move an allocation, returns an invalid allocation if the range isn't free
+	Allocation AllocateAt(uint32_t offset, uint32_t size);
+	// Returns false and leaves the allocator unchanged when the range isn't allocated, e.g. on a double free
+	bool Free(const Allocation& allocation);
+	// Adds free space at the end, used while the pool isn't resident on the GPU yet
+	void Grow(uint32_t newCapacity);
+	void Reset(uint32_t capacity);
+
+	uint32_t GetCapacity() const { return capacity; }
+	uint32_t GetUsedSize() const { return usedSize; }
+	Statistics GetStatistics() const;
+};
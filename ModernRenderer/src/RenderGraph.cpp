@@ -0,0 +1,383 @@
+#include "RenderGraph.hpp"
+#include "Profiler.hpp"
+#include "JobSystem.hpp"
+#include <algorithm>
+
+static constexpr unsigned invalidPass = UINT32_MAX;
+
+bool RenderGraph::IsReadOnlyState(ResourceState state)
+{
+	uint32_t readOnlyMask = (uint32_t)ResourceState::kVertexAndConstantBuffer | (uint32_t)ResourceState::kIndexBuffer
+		| (uint32_t)ResourceState::kNonPixelShaderResource | (uint32_t)ResourceState::kPixelShaderResource
+		| (uint32_t)ResourceState::kIndirectArgument | (uint32_t)ResourceState::kCopySource | (uint32_t)ResourceState::kDepthStencilRead;
+
+	return (uint32_t)state != 0 && ((uint32_t)state & ~readOnlyMask) == 0;
+}
+
+ResourceState RenderGraph::CombineStates(ResourceState a, ResourceState b)
+{
+	return (ResourceState)((uint32_t)a | (uint32_t)b);
+}
+
+unsigned RenderGraph::CompiledGraph::GetBarrierCount() const
+{
+	unsigned count = (unsigned)finalBarriers.size();
+	for (const auto& pass : passes)
+		count += (unsigned)pass.barriers.size();
+	return count;
+}
+
+void RenderGraph::PassBuilder::Read(ResourceHandle resource, ResourceState state)
+{
+	graph.AddUsage(passIndex, resource, state, true, false);
+}
+
+void RenderGraph::PassBuilder::Write(ResourceHandle resource, ResourceState state)
+{
+	graph.AddUsage(passIndex, resource, state, false, true);
+}
+
+void RenderGraph::PassBuilder::ReadWrite(ResourceHandle resource, ResourceState state)
+{
+	graph.AddUsage(passIndex, resource, state, true, true);
+}
+
+void RenderGraph::PassBuilder::SetSideEffect()
+{
+	graph.passes[passIndex].sideEffect = true;
+}
+
+RenderGraph::ResourceHandle RenderGraph::Import(const std::string& name, std::shared_ptr<Resource> resource, ResourceState initialState, ResourceState finalState, bool output)
+{
+	resources.push_back({ name, resource, initialState, finalState, output });
+	return (ResourceHandle)resources.size() - 1;
+}
+
+void RenderGraph::AddPass(const std::string& name, std::function<void(PassBuilder& builder)> setup, ExecuteFunction execute)
+{
+	passes.push_back({ name, {}, false, execute });
+
+	PassBuilder builder(*this, (unsigned)passes.size() - 1);
+	setup(builder);
+}
+
+void RenderGraph::AddUsage(unsigned passIndex, ResourceHandle resource, ResourceState state, bool read, bool write)
+{
+	auto& pass = passes[passIndex];
+
+	if (resource >= resources.size())
+	{
+		printf("Render graph: pass '%s' uses an invalid resource handle\n", pass.name.c_str());
+		return;
+	}
+
+	// A resource can only be in a single state during a pass, multiple reads are combined
+	for (auto& usage : pass.usages)
+	{
+		if (usage.resource != resource)
+			continue;
+
+		if (usage.state != state)
+		{
+			if (IsReadOnlyState(usage.state) && IsReadOnlyState(state))
+				usage.state = CombineStates(usage.state, state);
+			else
+				printf("Render graph: pass '%s' uses '%s' in two incompatible states\n", pass.name.c_str(), resources[resource].name.c_str());
+		}
+		usage.read |= read;
+		usage.write |= write;
+		return;
+	}
+
+	pass.usages.push_back({ resource, state, read, write });
+}
+
+std::vector<bool> RenderGraph::CullPasses() const
+{
+	std::vector<bool> alive(passes.size(), false);
+	std::vector<std::vector<unsigned>> producers(passes.size());
+	std::vector<unsigned> lastWriter(resources.size(), invalidPass);
+
+	for (unsigned i = 0; i < passes.size(); i++)
+	{
+		for (const auto& usage : passes[i].usages)
+			if (usage.read && lastWriter[usage.resource] != invalidPass)
+				producers[i].push_back(lastWriter[usage.resource]);
+
+		for (const auto& usage : passes[i].usages)
+			if (usage.write)
+				lastWriter[usage.resource] = i;
+
+		alive[i] = passes[i].sideEffect;
+	}
+
+	for (unsigned r = 0; r < resources.size(); r++)
+		if (resources[r].output && lastWriter[r] != invalidPass)
+			alive[lastWriter[r]] = true;
+
+	// Producers are always declared before their consumers, a single backward walk reaches all of them
+	for (unsigned i = (unsigned)passes.size(); i-- > 0;)
+	{
+		if (!alive[i])
+			continue;
+
+		for (unsigned producer : producers[i])
+			alive[producer] = true;
+	}
+
+	return alive;
+}
+
+std::vector<unsigned> RenderGraph::SchedulePasses(const std::vector<bool>& alive) const
+{
+	std::vector<std::vector<unsigned>> dependencies(passes.size());
+	std::vector<std::vector<unsigned>> dependents(passes.size());
+	std::vector<unsigned> lastWriter(resources.size(), invalidPass);
+	std::vector<std::vector<unsigned>> readersSinceWrite(resources.size());
+
+	auto addDependency = [&](unsigned pass, unsigned dependency)
+	{
+		if (dependency == invalidPass || dependency == pass)
+			return;
+		if (std::find(dependencies[pass].begin(), dependencies[pass].end(), dependency) != dependencies[pass].end())
+			return;
+
+		dependencies[pass].push_back(dependency);
+		dependents[dependency].push_back(pass);
+	};
+
+	// Read after write, write after write and write after read hazards in declaration order
+	for (unsigned i = 0; i < passes.size(); i++)
+	{
+		if (!alive[i])
+			continue;
+
+		for (const auto& usage : passes[i].usages)
+		{
+			addDependency(i, lastWriter[usage.resource]);
+			if (usage.write)
+			{
+				for (unsigned reader : readersSinceWrite[usage.resource])
+					addDependency(i, reader);
+			}
+		}
+
+		for (const auto& usage : passes[i].usages)
+		{
+			if (usage.write)
+			{
+				lastWriter[usage.resource] = i;
+				readersSinceWrite[usage.resource].clear();
+			}
+			else
+			{
+				readersSinceWrite[usage.resource].push_back(i);
+			}
+		}
+	}
+
+	std::vector<unsigned> remainingDependencies(passes.size());
+	std::vector<unsigned> ready;
+	for (unsigned i = 0; i < passes.size(); i++)
+	{
+		remainingDependencies[i] = (unsigned)dependencies[i].size();
+		if (alive[i] && remainingDependencies[i] == 0)
+			ready.push_back(i);
+	}
+
+	// Topological sort that prefers a pass independent from the one just scheduled, this moves work in
+	// between a producer and its consumer so that the GPU doesn't idle on the barrier separating them.
+	// Otherwise the declaration order is kept.
+	std::vector<unsigned> order;
+	unsigned previous = invalidPass;
+	while (!ready.empty())
+	{
+		std::sort(ready.begin(), ready.end());
+
+		auto next = std::find_if(ready.begin(), ready.end(), [&](unsigned pass)
+		{
+			return std::find(dependencies[pass].begin(), dependencies[pass].end(), previous) == dependencies[pass].end();
+		});
+		if (next == ready.end())
+			next = ready.begin();
+
+		unsigned pass = *next;
+		ready.erase(next);
+		order.push_back(pass);
+		previous = pass;
+
+		for (unsigned dependent : dependents[pass])
+		{
+			if (--remainingDependencies[dependent] == 0)
+				ready.push_back(dependent);
+		}
+	}
+
+	return order;
+}
+
+RenderGraph::CompiledGraph RenderGraph::Compile() const
+{
+	CompiledGraph compiled;
+
+	std::vector<bool> alive = CullPasses();
+	for (unsigned i = 0; i < passes.size(); i++)
+		if (!alive[i])
+			compiled.culledPasses.push_back(i);
+
+	std::vector<unsigned> order = SchedulePasses(alive);
+
+	// Usages of each resource in execution order, used to look ahead when combining read states
+	std::vector<std::vector<const Usage*>> resourceUsages(resources.size());
+	for (unsigned passIndex : order)
+		for (const auto& usage : passes[passIndex].usages)
+			resourceUsages[usage.resource].push_back(&usage);
+
+	compiled.firstUse.resize(resources.size(), CompiledGraph::invalidPosition);
+	compiled.lastUse.resize(resources.size(), CompiledGraph::invalidPosition);
+
+	std::vector<ResourceState> states(resources.size());
+	std::vector<bool> lastAccessWasWrite(resources.size(), false);
+	std::vector<unsigned> nextUsage(resources.size(), 0);
+	for (unsigned r = 0; r < resources.size(); r++)
+		states[r] = resources[r].initialState;
+
+	for (unsigned position = 0; position < order.size(); position++)
+	{
+		CompiledPass compiledPass;
+		compiledPass.passIndex = order[position];
+
+		for (const auto& usage : passes[order[position]].usages)
+		{
+			ResourceHandle r = usage.resource;
+			unsigned usageIndex = nextUsage[r]++;
+
+			if (compiled.firstUse[r] == CompiledGraph::invalidPosition)
+				compiled.firstUse[r] = position;
+			compiled.lastUse[r] = position;
+			ResourceState target = usage.state;
+
+			// Transition once to all the states needed by the following reads instead of once per pass
+			if (!usage.write && IsReadOnlyState(target))
+			{
+				for (unsigned i = usageIndex + 1; i < resourceUsages[r].size(); i++)
+				{
+					const Usage* next = resourceUsages[r][i];
+					if (next->write || !IsReadOnlyState(next->state))
+						break;
+					target = CombineStates(target, next->state);
+				}
+
+				if (IsReadOnlyState(states[r]) && CombineStates(states[r], target) == states[r])
+					target = states[r];
+			}
+
+			if (states[r] != target)
+				compiledPass.barriers.push_back({ Barrier::Type::Transition, r, states[r], target });
+			else if (target == ResourceState::kUnorderedAccess && (usage.write || lastAccessWasWrite[r]))
+				compiledPass.barriers.push_back({ Barrier::Type::UAV, r, target, target });
+
+			states[r] = target;
+			lastAccessWasWrite[r] = usage.write;
+		}
+
+		compiled.passes.push_back(std::move(compiledPass));
+	}
+
+	for (unsigned r = 0; r < resources.size(); r++)
+	{
+		ResourceState finalState = resources[r].finalState;
+		if (finalState != ResourceState::kUnknown && states[r] != finalState)
+		{
+			compiled.finalBarriers.push_back({ Barrier::Type::Transition, r, states[r], finalState });
+			states[r] = finalState;
+		}
+	}
+	compiled.finalStates = std::move(states);
+
+	return compiled;
+}
+
+static void RecordBarriers(std::shared_ptr<CommandList> cmd, const std::vector<RenderGraph::Barrier>& barriers, const std::vector<std::shared_ptr<Resource>>& resources)
+{
+	std::vector<ResourceBarrierDesc> transitions;
+	for (const auto& barrier : barriers)
+	{
+		if (barrier.type == RenderGraph::Barrier::Type::UAV)
+			cmd->UAVResourceBarrier(resources[barrier.resource]);
+		else
+			transitions.push_back({ resources[barrier.resource], barrier.before, barrier.after });
+	}
+
+	if (!transitions.empty())
+		cmd->ResourceBarrier(transitions);
+}
+
+void RenderGraph::RecordPasses(std::shared_ptr<CommandList> cmd, const CompiledGraph& compiled, unsigned begin, unsigned end, const std::vector<std::shared_ptr<Resource>>& graphResources) const
+{
+	for (unsigned position = begin; position < end; position++)
+	{
+		const auto& compiledPass = compiled.passes[position];
+		const auto& pass = passes[compiledPass.passIndex];
+
+		Profiler::BeginMarker(cmd, pass.name);
+		RecordBarriers(cmd, compiledPass.barriers, graphResources);
+		pass.execute(cmd);
+		Profiler::EndMarker(cmd);
+	}
+}
+
+void RenderGraph::Execute(std::shared_ptr<CommandList> cmd)
+{
+	CompiledGraph compiled = Compile();
+
+	std::vector<std::shared_ptr<Resource>> graphResources;
+	for (const auto& resource : resources)
+		graphResources.push_back(resource.resource);
+
+	RecordPasses(cmd, compiled, 0, (unsigned)compiled.passes.size(), graphResources);
+
+	RecordBarriers(cmd, compiled.finalBarriers, graphResources);
+	executedStates = std::move(compiled.finalStates);
+}
+
+void RenderGraph::ExecuteParallel(const std::function<std::shared_ptr<CommandList>()>& acquireCommandList, const ExecuteFunction& beginCommandList)
+{
+	CompiledGraph compiled = Compile();
+
+	std::vector<std::shared_ptr<Resource>> graphResources;
+	for (const auto& resource : resources)
+		graphResources.push_back(resource.resource);
+
+	// One range of passes per worker, the barriers are already known so the ranges don't depend on each other
+	unsigned passCount = (unsigned)compiled.passes.size();
+	unsigned listCount = std::min(JobSystem::GetWorkerCount(), (passCount + minPassesPerCommandList - 1) / minPassesPerCommandList);
+	listCount = std::max(listCount, 1u);
+
+	std::vector<std::shared_ptr<CommandList>> commandLists;
+	for (unsigned i = 0; i < listCount; i++)
+		commandLists.push_back(acquireCommandList());
+
+	JobSystem::ParallelFor(listCount, [&](unsigned list)
+	{
+		auto cmd = commandLists[list];
+		unsigned begin = passCount * list / listCount;
+		unsigned end = passCount * (list + 1) / listCount;
+
+		cmd->Reset();
+		beginCommandList(cmd);
+		RecordPasses(cmd, compiled, begin, end, graphResources);
+		if (list == listCount - 1)
+			RecordBarriers(cmd, compiled.finalBarriers, graphResources);
+		cmd->Close();
+	});
+
+	executedStates = std::move(compiled.finalStates);
+}
+
+void RenderGraph::Reset()
+{
+	passes.clear();
+	resources.clear();
+	executedStates.clear();
+}
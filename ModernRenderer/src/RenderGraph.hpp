@@ -0,0 +1,148 @@
+#pragma once
+
+#include "Instance/Instance.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// Frame graph of GPU passes: each pass declares the resources it reads and writes and in which state,
+// the graph then culls the passes that don't contribute to an output, orders the remaining ones and
+// generates the barriers between them. Resources stay in the state of their last use between passes,
+// only the imported resources are transitioned back to their final state at the end of the graph.
+//
+// Compile() doesn't touch the device, the resources can be null which allows to check the generated
+// barriers of a graph on the CPU.
+class RenderGraph
+{
+public:
+	using ResourceHandle = unsigned;
+	using ExecuteFunction = std::function<void(std::shared_ptr<CommandList> cmd)>;
+
+	static constexpr ResourceHandle invalidHandle = UINT32_MAX;
+	// Fewer passes per command list are not worth the cost of an additional list in the submission
+	static constexpr unsigned minPassesPerCommandList = 2;
+
+	// States that can be combined when consecutive passes only read a resource
+	static bool IsReadOnlyState(ResourceState state);
+	static ResourceState CombineStates(ResourceState a, ResourceState b);
+
+	struct Barrier
+	{
+		enum class Type
+		{
+			Transition,
+			// Wait for the previous unordered accesses when the state doesn't change
+			UAV,
+		};
+
+		Type type = Type::Transition;
+		ResourceHandle resource = invalidHandle;
+		ResourceState before = ResourceState::kCommon;
+		ResourceState after = ResourceState::kCommon;
+
+		bool operator==(const Barrier& other) const = default;
+	};
+
+	struct CompiledPass
+	{
+		unsigned passIndex = 0;
+		// Recorded before the execution of the pass
+		std::vector<Barrier> barriers;
+	};
+
+	struct CompiledGraph
+	{
+		// Passes in execution order, culled passes are not included
+		std::vector<CompiledPass> passes;
+		std::vector<unsigned> culledPasses;
+		// Transitions of the imported resources to their final state
+		std::vector<Barrier> finalBarriers;
+		// State of every resource once the graph has been executed
+		std::vector<ResourceState> finalStates;
+		// Position of the first and last pass using each resource in the execution order, invalidPosition when unused
+		std::vector<unsigned> firstUse;
+		std::vector<unsigned> lastUse;
+
+		static constexpr unsigned invalidPosition = UINT32_MAX;
+
+		unsigned GetBarrierCount() const;
+	};
+
+	class PassBuilder
+	{
+	private:
+		RenderGraph& graph;
+		unsigned passIndex;
+
+	public:
+		PassBuilder(RenderGraph& graph, unsigned passIndex) : graph(graph), passIndex(passIndex) {}
+
+		void Read(ResourceHandle resource, ResourceState state);
+		void Write(ResourceHandle resource, ResourceState state);
+		// Partial updates or atomics, the previous content of the resource is kept
+		void ReadWrite(ResourceHandle resource, ResourceState state);
+		// The pass is never culled, for example when it copies data for the CPU
+		void SetSideEffect();
+	};
+
+private:
+	struct Usage
+	{
+		ResourceHandle resource;
+		ResourceState state;
+		bool read;
+		bool write;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::vector<Usage> usages;
+		bool sideEffect = false;
+		ExecuteFunction execute;
+	};
+
+	struct ResourceEntry
+	{
+		std::string name;
+		std::shared_ptr<Resource> resource;
+		ResourceState initialState;
+		ResourceState finalState;
+		bool output;
+	};
+
+	std::vector<Pass> passes;
+	std::vector<ResourceEntry> resources;
+	std::vector<ResourceState> executedStates;
+
+	void RecordPasses(std::shared_ptr<CommandList> cmd, const CompiledGraph& compiled, unsigned begin, unsigned end, const std::vector<std::shared_ptr<Resource>>& graphResources) const;
+	void AddUsage(unsigned passIndex, ResourceHandle resource, ResourceState state, bool read, bool write);
+	std::vector<bool> CullPasses() const;
+	std::vector<unsigned> SchedulePasses(const std::vector<bool>& alive) const;
+
+public:
+	// Registers a resource created outside of the graph, it is in initialState when the graph starts and is
+	// transitioned to finalState at the end. The last pass writing an output resource is never culled.
+	// A kUnknown final state leaves the resource in the state of its last use, see GetFinalState.
+	ResourceHandle Import(const std::string& name, std::shared_ptr<Resource> resource, ResourceState initialState = ResourceState::kCommon, ResourceState finalState = ResourceState::kCommon, bool output = false);
+
+	void AddPass(const std::string& name, std::function<void(PassBuilder& builder)> setup, ExecuteFunction execute);
+
+	CompiledGraph Compile() const;
+	// Compiles the graph and records the passes with their barriers, each pass is wrapped in a profiler marker
+	void Execute(std::shared_ptr<CommandList> cmd);
+	// Same as Execute but the passes are split in contiguous ranges recorded by the jobs of the JobSystem, each
+	// in its own command list. The lists are acquired in execution order on the calling thread, they must be
+	// executed in that order. Every list is reset, prepared with beginCommandList (viewport, scissor...) and closed.
+	void ExecuteParallel(const std::function<std::shared_ptr<CommandList>()>& acquireCommandList, const ExecuteFunction& beginCommandList);
+
+	// State of the resource at the end of the last execution, to import it in the same state the next frame
+	ResourceState GetFinalState(ResourceHandle resource) const { return executedStates[resource]; }
+
+	// Removes all passes and resources so that the graph can be declared again for the next frame
+	void Reset();
+
+	const std::string& GetPassName(unsigned passIndex) const { return passes[passIndex].name; }
+	const std::string& GetResourceName(ResourceHandle resource) const { return resources[resource].name; }
+	unsigned GetPassCount() const { return (unsigned)passes.size(); }
+};
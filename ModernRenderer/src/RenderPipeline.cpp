@@ -1,10 +1,15 @@
 #include "RenderPipeline.hpp"
 #include "RenderSettings.hpp"
 #include "Profiler.hpp"
+#include "FrameContext.hpp"
+#include "CullingStatistics.hpp"
+#include "MaterialClassification.hpp"
+#include "MaterialTileValidation.hpp"
+#include "PipelineRegistry.hpp"
 
 RenderPipeline::RenderPipeline(std::shared_ptr<Device> device, const AppSize& appSize,
     Camera& camera, std::shared_ptr<Resource> colorTexture, std::shared_ptr<View> colorTextureView,
-    std::shared_ptr<Resource> depthTexture, std::shared_ptr<View> depthTextureView)
+    std::shared_ptr<Resource> depthTexture, std::shared_ptr<View> depthTextureView, TransientResourceAllocator& transientResources, VisibilityBuffer::Format visibilityFormat)
 {
     this->camera = &camera;
     this->device = device;
@@ -13,10 +18,22 @@ RenderPipeline::RenderPipeline(std::shared_ptr<Device> device, const AppSize& ap
     this->depthTexture = depthTexture;
     this->depthTextureView = depthTextureView;
     this->appSize = appSize;
+    this->visibilityFormat = visibilityFormat;
+
+    // The visibility texture is only alive between the visibility pass and the material resolve, its memory
+    // is bound by the transient allocator using the lifetime computed by the render graph
+    visibilityTexture = device->CreateTexture(TextureType::k2D, BindFlag::kRenderTarget | BindFlag::kUnorderedAccess | BindFlag::kShaderResource | BindFlag::kCopySource, GetVisibilityTextureFormat(), 1, appSize.width(), appSize.height(), 1, 1);
+
+    GraphResources resources = DeclareGraph();
+    RenderGraph::CompiledGraph compiledGraph = graph.Compile();
+    unsigned firstPass = transientResources.ReserveTimeline((unsigned)compiledGraph.passes.size());
+    transientResources.Declare("Visibility Texture", visibilityTexture,
+        firstPass + compiledGraph.firstUse[resources.visibility], firstPass + compiledGraph.lastUse[resources.visibility]);
+    graph.Reset();
+}
 
-    visibilityTexture = device->CreateTexture(TextureType::k2D, BindFlag::kRenderTarget | BindFlag::kUnorderedAccess | BindFlag::kShaderResource | BindFlag::kCopySource, gli::format::FORMAT_R32_UINT_PACK32, 1, appSize.width(), appSize.height(), 1, 1);
-    visibilityTexture->CommitMemory(MemoryType::kDefault);
-    visibilityTexture->SetName("Visibility Texture");
+void RenderPipeline::CreateResources()
+{
     ViewDesc outputTextureViewDesc = {};
     outputTextureViewDesc.view_type = ViewType::kRenderTarget;
     outputTextureViewDesc.dimension = ViewDimension::kTexture2D;
@@ -24,408 +41,605 @@ RenderPipeline::RenderPipeline(std::shared_ptr<Device> device, const AppSize& ap
     outputTextureViewDesc.view_type = ViewType::kTexture;
     visibilityTextureView = device->CreateView(visibilityTexture, outputTextureViewDesc);
 
+    // The material resolve is a compute pass, it writes the color through an UAV and reads depth to skip empty pixels
+    outputTextureViewDesc.view_type = ViewType::kRWTexture;
+    colorTextureUAV = device->CreateView(colorTexture, outputTextureViewDesc);
+    outputTextureViewDesc.view_type = ViewType::kTexture;
+    depthTextureSRV = device->CreateView(depthTexture, outputTextureViewDesc);
+
     // Compute stage allows to bind to every shader stages
     BindKey drawRootConstant = { ShaderType::kCompute, ViewType::kConstantBuffer, 1, 0, 3, UINT32_MAX, true };
-    objectLayoutSet = RenderUtils::CreateLayoutSet(device, camera, { drawRootConstant }, RenderUtils::All, RenderUtils::Mesh | RenderUtils::Fragment);
-    objectBindingSet = RenderUtils::CreateBindingSet(device, objectLayoutSet, camera, { { drawRootConstant, nullptr } }, RenderUtils::All, RenderUtils::Mesh | RenderUtils::Fragment);
-}
-
-void RenderPipeline::FrustumCulling(std::shared_ptr<CommandList> cmd)
-{
-    Profiler::BeginMarker(cmd, "Frustum Culling");
-    auto dxCmd = ((DXCommandList*)cmd.get())->GetCommandList();
-
-    if (!meshletCullingIndirectCountBuffer)
-    {
-        meshletCullingIndirectCountBuffer = device->CreateBuffer(BindFlag::kUnorderedAccess | BindFlag::kCopyDest, sizeof(uint32_t));
-		meshletCullingIndirectCountBuffer->CommitMemory(MemoryType::kDefault);
-		meshletCullingIndirectCountBuffer->SetName("Meshlet Culling Indirect Count");
-    }
-
-    if (!meshletCullingIndirectCountView)
-    {
-        ViewDesc viewDesc = {};
-        viewDesc.view_type = ViewType::kRWBuffer;
-        viewDesc.buffer_format = gli::FORMAT_R32_UINT_PACK32;
-        viewDesc.dimension = ViewDimension::kBuffer;
-        viewDesc.buffer_size = sizeof(uint32_t);
-        viewDesc.structure_stride = sizeof(uint32_t);
-        meshletCullingIndirectCountView = device->CreateView(meshletCullingIndirectCountBuffer, viewDesc);
-    }
-
-    if (!visibleMeshletsCountBuffer)
-    {
-        visibleMeshletsCountBuffer = device->CreateBuffer(BindFlag::kUnorderedAccess | BindFlag::kCopyDest, sizeof(uint32_t) * 16);
-        visibleMeshletsCountBuffer->CommitMemory(MemoryType::kDefault);
-        visibleMeshletsCountBuffer->SetName("Visible Meshlet Count");
-    }
-
-    if (!visibleMeshletsCountView)
-    {
-        ViewDesc viewDesc = {};
-        viewDesc.view_type = ViewType::kRWBuffer;
-        viewDesc.buffer_format = gli::FORMAT_R32_UINT_PACK32;
-        viewDesc.dimension = ViewDimension::kBuffer;
-        viewDesc.buffer_size = sizeof(uint32_t) * 16;
-        viewDesc.structure_stride = sizeof(uint32_t);
-        visibleMeshletsCountView = device->CreateView(visibleMeshletsCountBuffer, viewDesc);
-    }
-
-    if (!meshletCullingIndirectArgsBuffer)
-    {
-        meshletCullingIndirectArgsBuffer = device->CreateBuffer(BindFlag::kIndirectBuffer | BindFlag::kUnorderedAccess, sizeof(IndirectDispatchCommand) * MAX_VISIBLE_MESHLETS);
-        meshletCullingIndirectArgsBuffer->CommitMemory(MemoryType::kDefault);
-        meshletCullingIndirectArgsBuffer->SetName("Meshlet Culling Indirect Args");
-    }
-
-    if (!meshletCullingIndirectArgsView)
-    {
-        ViewDesc viewDesc = {};
-        viewDesc.view_type = ViewType::kRWStructuredBuffer;
-        viewDesc.dimension = ViewDimension::kBuffer;
-        viewDesc.buffer_size = sizeof(IndirectDispatchCommand) * MAX_VISIBLE_MESHLETS;
-        viewDesc.structure_stride = sizeof(IndirectDispatchCommand);
-        meshletCullingIndirectArgsView = device->CreateView(meshletCullingIndirectArgsBuffer, viewDesc);
-    }
-
-    if (!instanceFrustumCullingLayoutSet)
-    {
-        BindKey indirectCountKey = { ShaderType::kCompute, ViewType::kRWBuffer, 1, 0 };
-        BindKey indirectBindKey = { ShaderType::kCompute, ViewType::kRWStructuredBuffer, 2, 0 };
-        BindKey meshletCountKey = { ShaderType::kCompute, ViewType::kRWBuffer, 3, 0 };
-        BindKey drawRootConstant = { ShaderType::kCompute, ViewType::kConstantBuffer, 1, 0, 3, UINT32_MAX, true };
-
-        instanceFrustumCullingLayoutSet = RenderUtils::CreateLayoutSet(device, *camera,
-            { drawRootConstant, indirectBindKey, indirectCountKey, meshletCountKey },
-            RenderUtils::CameraData | RenderUtils::SceneInstances | RenderUtils::MeshPool,
-            RenderUtils::Compute
-        );
-        instanceFrustumCullingSet = RenderUtils::CreateBindingSet(device, instanceFrustumCullingLayoutSet, *camera,
-            { { drawRootConstant, nullptr }, { indirectBindKey, meshletCullingIndirectArgsView }, { indirectCountKey, meshletCullingIndirectCountView }, { meshletCountKey, visibleMeshletsCountView } },
-            RenderUtils::CameraData | RenderUtils::SceneInstances | RenderUtils::MeshPool,
-            RenderUtils::Compute
-        );
-    }
-
-    if (!frustumCullingProgram.program)
-    {
-        frustumCullingProgram = RenderUtils::CreateComputePipeline(device, "shaders/InstanceFrustumCulling.hlsl", "main", instanceFrustumCullingLayoutSet);
-        frustumCullingClearProgram = RenderUtils::CreateComputePipeline(device, "shaders/InstanceFrustumCulling.hlsl", "clear", instanceFrustumCullingLayoutSet);
-        frustumCullingIndirectArgsProgram = RenderUtils::CreateComputePipeline(device, "shaders/InstanceFrustumCulling.hlsl", "updateIndirectArguments", instanceFrustumCullingLayoutSet);
-    }
-
-    // Clear previous frame culling data
-    cmd->BeginEvent("Reset Visible Meshlet Counter");
-    cmd->ResourceBarrier({ { visibleMeshletsCountBuffer, ResourceState::kCommon, ResourceState::kUnorderedAccess } });
-
-    cmd->BindPipeline(frustumCullingClearProgram.pipeline);
-    cmd->BindBindingSet(instanceFrustumCullingSet);
-    cmd->Dispatch(1, 1, 1);
-
-    cmd->ResourceBarrier({ { visibleMeshletsCountBuffer, ResourceState::kUnorderedAccess, ResourceState::kCommon } });
-    cmd->EndEvent();
-
-    cmd->BeginEvent("Frustum Culling");
-    cmd->ResourceBarrier({ { Scene::visibleMeshletsBuffer0, ResourceState::kCommon, ResourceState::kUnorderedAccess } });
-    cmd->ResourceBarrier({ { visibleMeshletsCountBuffer, ResourceState::kCommon, ResourceState::kUnorderedAccess } });
-
-    cmd->BindPipeline(frustumCullingProgram.pipeline);
-    cmd->BindBindingSet(instanceFrustumCullingSet);
-    // TODO: multiple dispatch if the instance count is too big
-    int dispatchCount = (scene->instanceData.size() + 63) / 64;
-    cmd->Dispatch(dispatchCount, 1, 1);
-
-    cmd->ResourceBarrier({ { Scene::visibleMeshletsBuffer0, ResourceState::kUnorderedAccess, ResourceState::kCommon } });
-    cmd->ResourceBarrier({ { visibleMeshletsCountBuffer, ResourceState::kUnorderedAccess, ResourceState::kCommon } });
-    cmd->EndEvent();
-
-    cmd->BeginEvent("Update Indirect Args");
-    cmd->ResourceBarrier({ { meshletCullingIndirectArgsBuffer, ResourceState::kIndirectArgument, ResourceState::kUnorderedAccess } });
-    cmd->ResourceBarrier({ { meshletCullingIndirectCountBuffer, ResourceState::kIndirectArgument, ResourceState::kUnorderedAccess } });
-    cmd->ResourceBarrier({ { visibleMeshletsCountBuffer, ResourceState::kCommon, ResourceState::kGenericRead } });
+    objectLayoutSet = RenderUtils::CreateLayoutSet(device, *camera, { drawRootConstant }, RenderUtils::All, RenderUtils::Mesh | RenderUtils::Fragment);
+    objectBindingSet = RenderUtils::CreateBindingSet(device, objectLayoutSet, *camera, { { drawRootConstant, nullptr } }, RenderUtils::All, RenderUtils::Mesh | RenderUtils::Fragment);
 
-    cmd->BindPipeline(frustumCullingIndirectArgsProgram.pipeline);
-    cmd->BindBindingSet(instanceFrustumCullingSet);
-    cmd->Dispatch(1, 1, 1);
+    CullingStatistics::Init(device);
 
-    cmd->ResourceBarrier({ { meshletCullingIndirectArgsBuffer, ResourceState::kUnorderedAccess, ResourceState::kIndirectArgument } });
-    cmd->ResourceBarrier({ { meshletCullingIndirectCountBuffer, ResourceState::kUnorderedAccess, ResourceState::kIndirectArgument } });
-    cmd->ResourceBarrier({ { visibleMeshletsCountBuffer, ResourceState::kGenericRead, ResourceState::kCommon } });
-    cmd->EndEvent();
+    CreateCullingResources();
+    CreateVisibilityResources();
+    CreateMaterialResolveResources();
+    CreatePipelines();
 
-    Profiler::EndMarker(cmd);
+    // Edited shaders are recompiled in the background, the pipelines are created again once they are ready
+    PipelineRegistry::AddReloadListener(this, [this]() { CreatePipelines(); });
 }
 
-void RenderPipeline::MeshletCulling(std::shared_ptr<CommandList> cmd)
+RenderPipeline::~RenderPipeline()
 {
-    Profiler::BeginMarker(cmd, "Meshlet Culling");
-    auto dxCmd = ((DXCommandList*)cmd.get())->GetCommandList();
-
-    if (!meshletCullingProgram.program)
-    {
-        meshletCullingProgram = RenderUtils::CreateComputePipeline(device, "shaders/MeshletCulling.hlsl", "main", instanceFrustumCullingLayoutSet);
-        meshletCullingClearProgram = RenderUtils::CreateComputePipeline(device, "shaders/MeshletCulling.hlsl", "clear", instanceFrustumCullingLayoutSet);
-        meshletCullingIndirectArgsProgram = RenderUtils::CreateComputePipeline(device, "shaders/MeshletCulling.hlsl", "updateIndirectArguments", instanceFrustumCullingLayoutSet);
-    }
+    PipelineRegistry::RemoveReloadListener(this);
+}
 
-    if (!meshletCullingCommandSignature)
-        meshletCullingCommandSignature = RenderUtils::CreateIndirectRootConstantCommandSignature(device, instanceFrustumCullingLayoutSet, true);
+void RenderPipeline::CreatePipelines()
+{
+    frustumCullingProgram = RenderUtils::CreateComputePipeline(device, "shaders/InstanceFrustumCulling.hlsl", "main", instanceFrustumCullingLayoutSet);
+    frustumCullingClearProgram = RenderUtils::CreateComputePipeline(device, "shaders/InstanceFrustumCulling.hlsl", "clear", instanceFrustumCullingLayoutSet);
+    frustumCullingIndirectArgsProgram = RenderUtils::CreateComputePipeline(device, "shaders/InstanceFrustumCulling.hlsl", "updateIndirectArguments", instanceFrustumCullingLayoutSet);
+
+    meshletCullingProgram = RenderUtils::CreateComputePipeline(device, "shaders/MeshletCulling.hlsl", "main", instanceFrustumCullingLayoutSet);
+    meshletCullingClearProgram = RenderUtils::CreateComputePipeline(device, "shaders/MeshletCulling.hlsl", "clear", instanceFrustumCullingLayoutSet);
+    meshletCullingIndirectArgsProgram = RenderUtils::CreateComputePipeline(device, "shaders/MeshletCulling.hlsl", "updateIndirectArguments", instanceFrustumCullingLayoutSet);
+
+    visibilityMeshShader = PipelineRegistry::GetShader(GetVisibilityShaderDesc("mesh", ShaderType::kMesh, visibilityFormat));
+    visibilityFragmentShader = PipelineRegistry::GetShader(GetVisibilityShaderDesc("fragment", ShaderType::kPixel, visibilityFormat));
+
+    visibilityProgram = device->CreateProgram({ visibilityMeshShader, visibilityFragmentShader });
+
+    GraphicsPipelineDesc meshShaderPipelineDesc = {
+        visibilityProgram,
+        indirectVisibilityLayoutSet,
+        {},
+        visibilityRenderPass,
+    };
+    meshShaderPipelineDesc.rasterizer_desc = { FillMode::kSolid, CullMode::kBack, 0 };
+
+    visibilityPipeline = device->CreateGraphicsPipeline(meshShaderPipelineDesc);
+
+    auto defines = GetVisibilityFormatDefines();
+    materialClassificationClearProgram = RenderUtils::CreateComputePipeline(device, "shaders/MaterialResolve.hlsl", "clear", materialResolveLayoutSet, defines);
+    materialClassificationProgram = RenderUtils::CreateComputePipeline(device, "shaders/MaterialResolve.hlsl", "classify", materialResolveLayoutSet, defines);
+    materialResolveIndirectArgsProgram = RenderUtils::CreateComputePipeline(device, "shaders/MaterialResolve.hlsl", "updateIndirectArguments", materialResolveLayoutSet, defines);
+    materialResolveProgram = RenderUtils::CreateComputePipeline(device, "shaders/MaterialResolve.hlsl", "resolve", materialResolveLayoutSet, defines);
+}
 
-    // Clear previous frame culling data
-    cmd->BeginEvent("Reset Visible Meshlet Counter");
-    cmd->ResourceBarrier({ { visibleMeshletsCountBuffer, ResourceState::kCommon, ResourceState::kUnorderedAccess } });
+gli::format RenderPipeline::GetVisibilityTextureFormat() const
+{
+    return visibilityFormat == VisibilityBuffer::Format::R32G32 ? gli::FORMAT_RG32_UINT_PACK32 : gli::FORMAT_R32_UINT_PACK32;
+}
 
-    cmd->BindPipeline(meshletCullingClearProgram.pipeline);
-    cmd->BindBindingSet(instanceFrustumCullingSet);
-    cmd->Dispatch(1, 1, 1);
+std::map<std::string, std::string> RenderPipeline::GetVisibilityFormatDefines() const
+{
+    return GetVisibilityFormatDefines(visibilityFormat);
+}
 
-    cmd->ResourceBarrier({ { visibleMeshletsCountBuffer, ResourceState::kUnorderedAccess, ResourceState::kCommon } });
-    cmd->EndEvent();
+std::map<std::string, std::string> RenderPipeline::GetVisibilityFormatDefines(VisibilityBuffer::Format visibilityFormat)
+{
+    // Shaders reading or writing the visibility buffer select the encoding with this define, see Common.hlsl
+    if (visibilityFormat == VisibilityBuffer::Format::R32G32)
+        return { { "VISIBILITY_BUFFER_64BIT", "1" } };
+    return {};
+}
 
-    cmd->BeginEvent("Meshlet Culling");
-    cmd->ResourceBarrier({ { Scene::visibleMeshletsBuffer1, ResourceState::kCommon, ResourceState::kUnorderedAccess } });
-    cmd->ResourceBarrier({ { Scene::visibleMeshletsBuffer0, ResourceState::kCommon, ResourceState::kGenericRead } });
+ShaderDesc RenderPipeline::GetVisibilityShaderDesc(const std::string& entryPoint, ShaderType type, VisibilityBuffer::Format visibilityFormat)
+{
+    ShaderDesc desc = { MODERN_RENDERER_ASSETS_PATH "shaders/VisibilityPass.hlsl", entryPoint, type, "6_5" };
+    desc.define = GetVisibilityFormatDefines(visibilityFormat);
+    return desc;
+}
 
-    DXBindingSetLayout* l = (DXBindingSetLayout*)instanceFrustumCullingLayoutSet.get();
-    dxCmd->SetComputeRootSignature(l->GetRootSignature().Get());
-    cmd->BindPipeline(meshletCullingProgram.pipeline);
-    cmd->BindBindingSet(instanceFrustumCullingSet);
+void RenderPipeline::RequestShaders(VisibilityBuffer::Format visibilityFormat)
+{
+    // In the order the passes are created so that the first pipelines are ready first
+    for (const char* kernel : { "main", "clear", "updateIndirectArguments" })
+        PipelineRegistry::Request(RenderUtils::GetComputeShaderDesc("shaders/InstanceFrustumCulling.hlsl", kernel));
+    for (const char* kernel : { "main", "clear", "updateIndirectArguments" })
+        PipelineRegistry::Request(RenderUtils::GetComputeShaderDesc("shaders/MeshletCulling.hlsl", kernel));
+
+    PipelineRegistry::Request(GetVisibilityShaderDesc("mesh", ShaderType::kMesh, visibilityFormat));
+    PipelineRegistry::Request(GetVisibilityShaderDesc("fragment", ShaderType::kPixel, visibilityFormat));
+
+    auto defines = GetVisibilityFormatDefines(visibilityFormat);
+    for (const char* kernel : { "clear", "classify", "updateIndirectArguments", "resolve" })
+        PipelineRegistry::Request(RenderUtils::GetComputeShaderDesc("shaders/MaterialResolve.hlsl", kernel, defines));
+}
 
-    DXResource* dxIndirectArgsBuffer = (DXResource*)meshletCullingIndirectArgsBuffer.get();
-    DXResource* dxIndirectCountBuffer = (DXResource*)meshletCullingIndirectCountBuffer.get();
+void RenderPipeline::CreateCullingResources()
+{
+    meshletCullingIndirectCountBuffer = device->CreateBuffer(BindFlag::kUnorderedAccess | BindFlag::kCopyDest, sizeof(uint32_t));
+    meshletCullingIndirectCountBuffer->CommitMemory(MemoryType::kDefault);
+    meshletCullingIndirectCountBuffer->SetName("Meshlet Culling Indirect Count");
+
+    ViewDesc viewDesc = {};
+    viewDesc.view_type = ViewType::kRWBuffer;
+    viewDesc.buffer_format = gli::FORMAT_R32_UINT_PACK32;
+    viewDesc.dimension = ViewDimension::kBuffer;
+    viewDesc.buffer_size = sizeof(uint32_t);
+    viewDesc.structure_stride = sizeof(uint32_t);
+    meshletCullingIndirectCountView = device->CreateView(meshletCullingIndirectCountBuffer, viewDesc);
+
+    visibleMeshletsCountBuffer = device->CreateBuffer(BindFlag::kUnorderedAccess | BindFlag::kCopyDest | BindFlag::kCopySource, sizeof(uint32_t) * (unsigned)CullingCounter::Count);
+    visibleMeshletsCountBuffer->CommitMemory(MemoryType::kDefault);
+    visibleMeshletsCountBuffer->SetName("Visible Meshlet Count");
+
+    viewDesc.buffer_size = sizeof(uint32_t) * (unsigned)CullingCounter::Count;
+    visibleMeshletsCountView = device->CreateView(visibleMeshletsCountBuffer, viewDesc);
+
+    meshletCullingIndirectArgsBuffer = device->CreateBuffer(BindFlag::kIndirectBuffer | BindFlag::kUnorderedAccess, sizeof(IndirectDispatchCommand) * MAX_VISIBLE_MESHLETS);
+    meshletCullingIndirectArgsBuffer->CommitMemory(MemoryType::kDefault);
+    meshletCullingIndirectArgsBuffer->SetName("Meshlet Culling Indirect Args");
+
+    viewDesc = {};
+    viewDesc.view_type = ViewType::kRWStructuredBuffer;
+    viewDesc.dimension = ViewDimension::kBuffer;
+    viewDesc.buffer_size = sizeof(IndirectDispatchCommand) * MAX_VISIBLE_MESHLETS;
+    viewDesc.structure_stride = sizeof(IndirectDispatchCommand);
+    meshletCullingIndirectArgsView = device->CreateView(meshletCullingIndirectArgsBuffer, viewDesc);
+
+    BindKey indirectCountKey = { ShaderType::kCompute, ViewType::kRWBuffer, 1, 0 };
+    BindKey indirectBindKey = { ShaderType::kCompute, ViewType::kRWStructuredBuffer, 2, 0 };
+    BindKey meshletCountKey = { ShaderType::kCompute, ViewType::kRWBuffer, 3, 0 };
+    BindKey drawRootConstant = { ShaderType::kCompute, ViewType::kConstantBuffer, 1, 0, 3, UINT32_MAX, true };
 
-    // Instead of drawing objects one by one here, we can use the culling results to render only visible objects
-    dxCmd->ExecuteIndirect(
-        meshletCullingCommandSignature.Get(),
-        MAX_VISIBLE_MESHLETS,
-        dxIndirectArgsBuffer->resource.Get(),
-        0,
-        dxIndirectCountBuffer->resource.Get(),
-        0
+    instanceFrustumCullingLayoutSet = RenderUtils::CreateLayoutSet(device, *camera,
+        { drawRootConstant, indirectBindKey, indirectCountKey, meshletCountKey },
+        RenderUtils::CameraData | RenderUtils::SceneInstances | RenderUtils::MeshPool,
+        RenderUtils::Compute
+    );
+    instanceFrustumCullingSet = RenderUtils::CreateBindingSet(device, instanceFrustumCullingLayoutSet, *camera,
+        { { drawRootConstant, nullptr }, { indirectBindKey, meshletCullingIndirectArgsView }, { indirectCountKey, meshletCullingIndirectCountView }, { meshletCountKey, visibleMeshletsCountView } },
+        RenderUtils::CameraData | RenderUtils::SceneInstances | RenderUtils::MeshPool,
+        RenderUtils::Compute
     );
 
-    cmd->ResourceBarrier({ { Scene::visibleMeshletsBuffer0, ResourceState::kGenericRead, ResourceState::kCommon } });
-    cmd->ResourceBarrier({ { Scene::visibleMeshletsBuffer1, ResourceState::kUnorderedAccess, ResourceState::kCommon } });
-    cmd->EndEvent();
-
-    cmd->BeginEvent("Update Indirect Args");
-    cmd->ResourceBarrier({ { meshletCullingIndirectArgsBuffer, ResourceState::kIndirectArgument, ResourceState::kUnorderedAccess } });
-    cmd->ResourceBarrier({ { meshletCullingIndirectCountBuffer, ResourceState::kIndirectArgument, ResourceState::kUnorderedAccess } });
-    cmd->ResourceBarrier({ { visibleMeshletsCountBuffer, ResourceState::kCommon, ResourceState::kGenericRead } });
-
-    cmd->BindPipeline(meshletCullingIndirectArgsProgram.pipeline);
-    cmd->BindBindingSet(instanceFrustumCullingSet);
-    cmd->Dispatch(1, 1, 1);
-
-    cmd->ResourceBarrier({ { visibleMeshletsCountBuffer, ResourceState::kGenericRead, ResourceState::kCommon } });
-    cmd->ResourceBarrier({ { meshletCullingIndirectCountBuffer, ResourceState::kUnorderedAccess, ResourceState::kIndirectArgument } });
-    cmd->ResourceBarrier({ { meshletCullingIndirectArgsBuffer, ResourceState::kUnorderedAccess, ResourceState::kIndirectArgument } });
-    cmd->EndEvent();
-    Profiler::EndMarker(cmd);
+    meshletCullingCommandSignature = RenderUtils::CreateIndirectRootConstantCommandSignature(device, instanceFrustumCullingLayoutSet, true);
 }
 
-void RenderPipeline::RenderVisibility(std::shared_ptr<CommandList> cmd)
+void RenderPipeline::CreateVisibilityResources()
 {
-    auto dxCmd = ((DXCommandList*)cmd.get())->GetCommandList();
+    RenderPassDepthStencilDesc depthStencilDesc = {
+        gli::FORMAT_D32_SFLOAT_S8_UINT_PACK64,
+        RenderPassLoadOp::kClear, RenderPassStoreOp::kStore,
+        RenderPassLoadOp::kClear, RenderPassStoreOp::kStore
+    };
+    RenderPassColorDesc visibilityDesc = { GetVisibilityTextureFormat(), RenderPassLoadOp::kClear, RenderPassStoreOp::kStore };
+    RenderPassDesc renderPassDesc = {
+        { visibilityDesc },
+        depthStencilDesc
+    };
+    visibilityRenderPass = device->CreateRenderPass(renderPassDesc);
+
+    FramebufferDesc desc = {};
+    desc.render_pass = visibilityRenderPass;
+    desc.width = appSize.width();
+    desc.height = appSize.height();
+    desc.colors = { visibilityRenderTargetView };
+    desc.depth_stencil = depthTextureView;
+    visibilityFrameBuffer = device->CreateFramebuffer(desc);
+
+    BindKey indirectCountKey = { ShaderType::kCompute, ViewType::kRWBuffer, 1, 0 };
+    BindKey instanceIDKey = { ShaderType::kCompute, ViewType::kConstantBuffer, 1, 0, 3, UINT32_MAX, true };
+
+    indirectVisibilityLayoutSet = RenderUtils::CreateLayoutSet(device, *camera, { instanceIDKey, indirectCountKey }, RenderUtils::CameraData | RenderUtils::SceneInstances | RenderUtils::MeshPool, RenderUtils::Mesh | RenderUtils::Amplification | RenderUtils::Fragment);
+    indirectVisibilitySet = RenderUtils::CreateBindingSet(device, indirectVisibilityLayoutSet, *camera,
+        { { instanceIDKey, nullptr }, { indirectCountKey, meshletCullingIndirectCountView } },
+        RenderUtils::CameraData | RenderUtils::SceneInstances | RenderUtils::MeshPool, RenderUtils::Mesh | RenderUtils::Amplification | RenderUtils::Fragment
+    );
 
-    if (!visibilityRenderPass)
-    {
-        // Create Visibility Render passes
-        RenderPassDepthStencilDesc depthStencilDesc = {
-            gli::FORMAT_D32_SFLOAT_S8_UINT_PACK64,
-            RenderPassLoadOp::kClear, RenderPassStoreOp::kStore,
-            RenderPassLoadOp::kClear, RenderPassStoreOp::kStore
-        };
-        RenderPassColorDesc visibilityDesc = { gli::FORMAT_R32_UINT_PACK32, RenderPassLoadOp::kClear, RenderPassStoreOp::kStore };
-        RenderPassDesc renderPassDesc = {
-            { visibilityDesc },
-            depthStencilDesc
-        };
-        visibilityRenderPass = device->CreateRenderPass(renderPassDesc);
-    }
+    frustumCullingCommandSignature = RenderUtils::CreateIndirectRootConstantCommandSignature(device, indirectVisibilityLayoutSet, false);
+}
 
-    if (!visibilityFrameBuffer)
-    {
-        FramebufferDesc desc = {};
-        desc.render_pass = visibilityRenderPass;
-        desc.width = appSize.width();
-        desc.height = appSize.height();
-        desc.colors = { visibilityRenderTargetView };
-        desc.depth_stencil = depthTextureView;
-
-        visibilityFrameBuffer = device->CreateFramebuffer(desc);
-    }
+void RenderPipeline::CreateMaterialResolveResources()
+{
+    materialCount = (unsigned)Material::materialBuffer.size();
+    materialTileCountX = (appSize.width() + MaterialClassification::tileSize - 1) / MaterialClassification::tileSize;
+    materialTileCountY = (appSize.height() + MaterialClassification::tileSize - 1) / MaterialClassification::tileSize;
+
+    materialTileCountsBuffer = device->CreateBuffer(BindFlag::kUnorderedAccess, sizeof(uint32_t) * materialCount);
+    materialTileCountsBuffer->CommitMemory(MemoryType::kDefault);
+    materialTileCountsBuffer->SetName("Material Tile Counts");
+
+    ViewDesc viewDesc = {};
+    viewDesc.view_type = ViewType::kRWBuffer;
+    viewDesc.buffer_format = gli::FORMAT_R32_UINT_PACK32;
+    viewDesc.dimension = ViewDimension::kBuffer;
+    viewDesc.buffer_size = sizeof(uint32_t) * materialCount;
+    viewDesc.structure_stride = sizeof(uint32_t);
+    materialTileCountsView = device->CreateView(materialTileCountsBuffer, viewDesc);
+
+    // Every material can reference all the tiles of the screen
+    uint64_t tileListsSize = sizeof(uint32_t) * (uint64_t)materialCount * materialTileCountX * materialTileCountY;
+    materialTilesBuffer = device->CreateBuffer(BindFlag::kUnorderedAccess, tileListsSize);
+    materialTilesBuffer->CommitMemory(MemoryType::kDefault);
+    materialTilesBuffer->SetName("Material Tile Lists");
+
+    viewDesc.buffer_size = tileListsSize;
+    materialTilesView = device->CreateView(materialTilesBuffer, viewDesc);
+
+    MaterialTileValidation::Init(device, appSize.width(), appSize.height(), visibilityFormat, materialTileCountX, materialTileCountY, materialCount);
+
+    materialResolveIndirectArgsBuffer = device->CreateBuffer(BindFlag::kIndirectBuffer | BindFlag::kUnorderedAccess, sizeof(IndirectDispatchCommand) * materialCount);
+    materialResolveIndirectArgsBuffer->CommitMemory(MemoryType::kDefault);
+    materialResolveIndirectArgsBuffer->SetName("Material Resolve Indirect Args");
+
+    viewDesc = {};
+    viewDesc.view_type = ViewType::kRWStructuredBuffer;
+    viewDesc.dimension = ViewDimension::kBuffer;
+    viewDesc.buffer_size = sizeof(IndirectDispatchCommand) * materialCount;
+    viewDesc.structure_stride = sizeof(IndirectDispatchCommand);
+    materialResolveIndirectArgsView = device->CreateView(materialResolveIndirectArgsBuffer, viewDesc);
 
-    if (!indirectVisibilitySet)
-    {
-        BindKey indirectCountKey = { ShaderType::kCompute, ViewType::kRWBuffer, 1, 0 };
-        BindKey instanceIDKey = { ShaderType::kCompute, ViewType::kConstantBuffer, 1, 0, 3, UINT32_MAX, true };
+    BindKey drawRootConstant = { ShaderType::kCompute, ViewType::kConstantBuffer, 1, 0, 3, UINT32_MAX, true };
+    BindKey visibilityTextureKey = { ShaderType::kCompute, ViewType::kTexture, 1, 2 };
+    BindKey depthTextureKey = { ShaderType::kCompute, ViewType::kTexture, 2, 2 };
+    BindKey outputColorKey = { ShaderType::kCompute, ViewType::kRWTexture, 0, 0 };
+    BindKey tileCountsKey = { ShaderType::kCompute, ViewType::kRWBuffer, 1, 0 };
+    BindKey tilesKey = { ShaderType::kCompute, ViewType::kRWBuffer, 2, 0 };
+    BindKey indirectArgsKey = { ShaderType::kCompute, ViewType::kRWStructuredBuffer, 3, 0 };
+
+    materialResolveLayoutSet = RenderUtils::CreateLayoutSet(device, *camera,
+        { drawRootConstant, visibilityTextureKey, depthTextureKey, outputColorKey, tileCountsKey, tilesKey, indirectArgsKey },
+        RenderUtils::All, RenderUtils::Compute
+    );
+    materialResolveSet = RenderUtils::CreateBindingSet(device, materialResolveLayoutSet, *camera,
+        {
+            { drawRootConstant, nullptr }, { visibilityTextureKey, visibilityTextureView }, { depthTextureKey, depthTextureSRV },
+            { outputColorKey, colorTextureUAV }, { tileCountsKey, materialTileCountsView }, { tilesKey, materialTilesView },
+            { indirectArgsKey, materialResolveIndirectArgsView }
+        },
+        RenderUtils::All, RenderUtils::Compute
+    );
 
-        indirectVisibilityLayoutSet = RenderUtils::CreateLayoutSet(device, *camera, { instanceIDKey, indirectCountKey }, RenderUtils::CameraData | RenderUtils::SceneInstances | RenderUtils::MeshPool, RenderUtils::Mesh | RenderUtils::Amplification | RenderUtils::Fragment);
-        indirectVisibilitySet = RenderUtils::CreateBindingSet(device, indirectVisibilityLayoutSet, *camera,
-            { { instanceIDKey, nullptr }, { indirectCountKey, meshletCullingIndirectCountView } },
-            RenderUtils::CameraData | RenderUtils::SceneInstances | RenderUtils::MeshPool, RenderUtils::Mesh | RenderUtils::Amplification | RenderUtils::Fragment
-        );
-    }
+    materialResolveCommandSignature = RenderUtils::CreateIndirectRootConstantCommandSignature(device, materialResolveLayoutSet, true);
+}
 
-    if (!visibilityPipeline)
-    {
-        ShaderDesc visibilityMeshShaderDesc = { MODERN_RENDERER_ASSETS_PATH "shaders/VisibilityPass.hlsl", "mesh", ShaderType::kMesh, "6_5" };
-        visibilityMeshShader = device->CompileShader(visibilityMeshShaderDesc);
-        ShaderDesc visibilityFragmentShaderDesc = { MODERN_RENDERER_ASSETS_PATH "shaders/VisibilityPass.hlsl", "fragment", ShaderType::kPixel, "6_5" };
-        visibilityFragmentShader = device->CompileShader(visibilityFragmentShaderDesc);
-
-        visibilityProgram = device->CreateProgram({ visibilityMeshShader, visibilityFragmentShader });
-
-        GraphicsPipelineDesc meshShaderPipelineDesc = {
-            visibilityProgram,
-            indirectVisibilityLayoutSet,
-            {},
-            visibilityRenderPass,
-        };
-        meshShaderPipelineDesc.rasterizer_desc = { FillMode::kSolid, CullMode::kBack, 0 };
-
-        visibilityPipeline = device->CreateGraphicsPipeline(meshShaderPipelineDesc);
-    }
+RenderGraph::ResourceHandle RenderPipeline::ImportPipelineResource(const std::string& name, std::shared_ptr<Resource> resource)
+{
+    // Resources only used by the pipeline stay in the state of their last use from one frame to the next
+    auto state = resourceStates.find(resource.get());
+    RenderGraph::ResourceHandle handle = graph.Import(name, resource, state != resourceStates.end() ? state->second : ResourceState::kCommon, ResourceState::kUnknown);
+    pipelineResources.push_back({ handle, resource.get() });
+    return handle;
+}
 
-    if (!frustumCullingCommandSignature)
-        frustumCullingCommandSignature = RenderUtils::CreateIndirectRootConstantCommandSignature(device, indirectVisibilityLayoutSet, false);
+void RenderPipeline::AddCullingPasses(const GraphResources& resources)
+{
+    // Counters are accessed through UAVs in every culling pass, the graph only inserts UAV barriers between them
+    graph.AddPass("Reset Instance Culling Counters",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.Write(resources.visibleMeshletsCount, ResourceState::kUnorderedAccess);
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            cmd->BindPipeline(frustumCullingClearProgram.pipeline);
+            cmd->BindBindingSet(instanceFrustumCullingSet);
+            cmd->Dispatch(1, 1, 1);
+        }
+    );
 
-    Profiler::BeginMarker(cmd, "Visibility Pass");
-    cmd->ResourceBarrier({ { visibilityTexture, ResourceState::kCommon, ResourceState::kRenderTarget } });
-    cmd->ResourceBarrier({ { depthTexture, ResourceState::kCommon, ResourceState::kDepthStencilWrite}});
+    // Frustum cull instances of the scene using their OBB
+    // Outputs a buffer of visible meshlets
+    graph.AddPass("Frustum Culling",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.ReadWrite(resources.visibleMeshletsCount, ResourceState::kUnorderedAccess);
+            builder.Write(resources.visibleMeshlets0, ResourceState::kUnorderedAccess);
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            cmd->BindPipeline(frustumCullingProgram.pipeline);
+            cmd->BindBindingSet(instanceFrustumCullingSet);
+            // TODO: multiple dispatch if the instance count is too big
+            int dispatchCount = (scene->instanceStore.GetCount() + 63) / 64;
+            cmd->Dispatch(dispatchCount, 1, 1);
+        }
+    );
 
-    cmd->BeginRenderPass(visibilityRenderPass, visibilityFrameBuffer, {});
+    graph.AddPass("Update Meshlet Culling Args",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.Read(resources.visibleMeshletsCount, ResourceState::kUnorderedAccess);
+            builder.Write(resources.meshletCullingIndirectArgs, ResourceState::kUnorderedAccess);
+            builder.Write(resources.meshletCullingIndirectCount, ResourceState::kUnorderedAccess);
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            cmd->BindPipeline(frustumCullingIndirectArgsProgram.pipeline);
+            cmd->BindBindingSet(instanceFrustumCullingSet);
+            cmd->Dispatch(1, 1, 1);
+        }
+    );
 
-    cmd->BindPipeline(visibilityPipeline);
-    cmd->BindBindingSet(indirectVisibilitySet);
+    // Only clears the meshlet counters, the instance counters are kept for the statistics
+    graph.AddPass("Reset Meshlet Culling Counters",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.ReadWrite(resources.visibleMeshletsCount, ResourceState::kUnorderedAccess);
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            cmd->BindPipeline(meshletCullingClearProgram.pipeline);
+            cmd->BindBindingSet(instanceFrustumCullingSet);
+            cmd->Dispatch(1, 1, 1);
+        }
+    );
 
-    //DrawOpaqueObjects(cmd, objectBindingSet, visibilityPipeline);
+    // Cull the meshlets usig frustum and cone culling
+    // Outputs a reduced list of visible meshlets for the next render passes
+    graph.AddPass("Meshlet Culling",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.Read(resources.meshletCullingIndirectArgs, ResourceState::kIndirectArgument);
+            builder.Read(resources.meshletCullingIndirectCount, ResourceState::kIndirectArgument);
+            builder.Read(resources.visibleMeshlets0, ResourceState::kUnorderedAccess);
+            builder.ReadWrite(resources.visibleMeshletsCount, ResourceState::kUnorderedAccess);
+            builder.Write(resources.visibleMeshlets1, ResourceState::kUnorderedAccess);
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            auto dxCmd = ((DXCommandList*)cmd.get())->GetCommandList();
+
+            DXBindingSetLayout* l = (DXBindingSetLayout*)instanceFrustumCullingLayoutSet.get();
+            dxCmd->SetComputeRootSignature(l->GetRootSignature().Get());
+            cmd->BindPipeline(meshletCullingProgram.pipeline);
+            cmd->BindBindingSet(instanceFrustumCullingSet);
+
+            DXResource* dxIndirectArgsBuffer = (DXResource*)meshletCullingIndirectArgsBuffer.get();
+            DXResource* dxIndirectCountBuffer = (DXResource*)meshletCullingIndirectCountBuffer.get();
+
+            // Instead of drawing objects one by one here, we can use the culling results to render only visible objects
+            dxCmd->ExecuteIndirect(
+                meshletCullingCommandSignature.Get(),
+                MAX_VISIBLE_MESHLETS,
+                dxIndirectArgsBuffer->resource.Get(),
+                0,
+                dxIndirectCountBuffer->resource.Get(),
+                0
+            );
+        }
+    );
 
-    DXResource* dxIndirectArgsBuffer = (DXResource*)meshletCullingIndirectArgsBuffer.get();
-    DXResource* dxIndirectCountBuffer = (DXResource*)meshletCullingIndirectCountBuffer.get();
+    graph.AddPass("Update Visibility Args",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.Read(resources.visibleMeshletsCount, ResourceState::kUnorderedAccess);
+            builder.Write(resources.meshletCullingIndirectArgs, ResourceState::kUnorderedAccess);
+            builder.Write(resources.meshletCullingIndirectCount, ResourceState::kUnorderedAccess);
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            cmd->BindPipeline(meshletCullingIndirectArgsProgram.pipeline);
+            cmd->BindBindingSet(instanceFrustumCullingSet);
+            cmd->Dispatch(1, 1, 1);
+        }
+    );
 
-    // Instead of drawing objects one by one here, we can use the culling results to render only visible objects
-    dxCmd->ExecuteIndirect(
-        frustumCullingCommandSignature.Get(),
-        MAX_VISIBLE_MESHLETS,
-        dxIndirectArgsBuffer->resource.Get(),
-        0,
-        dxIndirectCountBuffer->resource.Get(),
-        0
+    // All the culling counters are final at this point
+    graph.AddPass("Culling Statistics Readback",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.Read(resources.visibleMeshletsCount, ResourceState::kCopySource);
+            builder.SetSideEffect();
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            CullingStatistics::EnqueueReadback(cmd, visibleMeshletsCountBuffer);
+        }
     );
+}
 
-    cmd->EndRenderPass();
-    
-    cmd->ResourceBarrier({ { visibilityTexture, ResourceState::kRenderTarget, ResourceState::kCommon } });
-    cmd->ResourceBarrier({ { depthTexture, ResourceState::kDepthStencilWrite, ResourceState::kCommon } });
-    Profiler::EndMarker(cmd);
+void RenderPipeline::AddVisibilityPass(const GraphResources& resources)
+{
+    graph.AddPass("Visibility Pass",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.Read(resources.meshletCullingIndirectArgs, ResourceState::kIndirectArgument);
+            builder.Read(resources.meshletCullingIndirectCount, ResourceState::kIndirectArgument);
+            builder.Read(resources.visibleMeshlets1, ResourceState::kUnorderedAccess);
+            builder.Write(resources.visibility, ResourceState::kRenderTarget);
+            builder.Write(resources.depth, ResourceState::kDepthStencilWrite);
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            auto dxCmd = ((DXCommandList*)cmd.get())->GetCommandList();
+
+            cmd->BeginRenderPass(visibilityRenderPass, visibilityFrameBuffer, {});
+
+            cmd->BindPipeline(visibilityPipeline);
+            cmd->BindBindingSet(indirectVisibilitySet);
+
+            DXResource* dxIndirectArgsBuffer = (DXResource*)meshletCullingIndirectArgsBuffer.get();
+            DXResource* dxIndirectCountBuffer = (DXResource*)meshletCullingIndirectCountBuffer.get();
+
+            // Instead of drawing objects one by one here, we can use the culling results to render only visible objects
+            dxCmd->ExecuteIndirect(
+                frustumCullingCommandSignature.Get(),
+                MAX_VISIBLE_MESHLETS,
+                dxIndirectArgsBuffer->resource.Get(),
+                0,
+                dxIndirectCountBuffer->resource.Get(),
+                0
+            );
+
+            cmd->EndRenderPass();
+        }
+    );
 }
 
-void RenderPipeline::RenderForwardOpaque(std::shared_ptr<CommandList> cmd)
+void RenderPipeline::AddMaterialResolvePasses(const GraphResources& resources)
 {
-    if (!forwardRenderPass)
-    {
-        RenderPassDepthStencilDesc depthStencilDesc = {
-            gli::FORMAT_D32_SFLOAT_S8_UINT_PACK64,
-            RenderPassLoadOp::kLoad, RenderPassStoreOp::kStore,
-            RenderPassLoadOp::kLoad, RenderPassStoreOp::kStore
-        };
-        RenderPassColorDesc colorDesc = { gli::FORMAT_RGBA8_UNORM_PACK8, RenderPassLoadOp::kLoad, RenderPassStoreOp::kStore };
-        RenderPassDesc renderPassDesc = {
-            { colorDesc },
-            depthStencilDesc
-        };
-        forwardRenderPass = device->CreateRenderPass(renderPassDesc);
-    }
+    graph.AddPass("Reset Material Tile Counts",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.Write(resources.materialTileCounts, ResourceState::kUnorderedAccess);
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            cmd->BindPipeline(materialClassificationClearProgram.pipeline);
+            cmd->BindBindingSet(materialResolveSet);
+            cmd->Dispatch((materialCount + 63) / 64, 1, 1);
+        }
+    );
 
-    if (!forwardFrameBuffer)
-    {
-        FramebufferDesc desc = {};
-        desc.render_pass = forwardRenderPass;
-        desc.width = appSize.width();
-        desc.height = appSize.height();
-        desc.colors = { colorTextureView };
-        desc.depth_stencil = depthTextureView;
-
-        forwardFrameBuffer = device->CreateFramebuffer(desc);
-    }
+    // Append every 8x8 tile to the list of each material it contains
+    graph.AddPass("Material Classification",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.Read(resources.visibility, ResourceState::kNonPixelShaderResource);
+            builder.Read(resources.depth, ResourceState::kNonPixelShaderResource);
+            builder.ReadWrite(resources.materialTileCounts, ResourceState::kUnorderedAccess);
+            builder.Write(resources.materialTiles, ResourceState::kUnorderedAccess);
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            cmd->BindPipeline(materialClassificationProgram.pipeline);
+            cmd->BindBindingSet(materialResolveSet);
+            cmd->Dispatch(materialTileCountX, materialTileCountY, 1);
+        }
+    );
 
-    if (!forwardLayoutSet)
-    {
-        // Compute stage allows to bind to every shader stages
-        BindKey drawRootConstant = { ShaderType::kCompute, ViewType::kConstantBuffer, 1, 0, 3, UINT32_MAX, true };
-        BindKey visibilityTexture = { ShaderType::kPixel, ViewType::kTexture, 1, 2 };
-        forwardLayoutSet = RenderUtils::CreateLayoutSet(device, *camera, { drawRootConstant, visibilityTexture }, RenderUtils::All, RenderUtils::Mesh | RenderUtils::Fragment);
-        forwardBindingSet = RenderUtils::CreateBindingSet(device, forwardLayoutSet, *camera, { { drawRootConstant, nullptr }, { visibilityTexture, visibilityTextureView } }, RenderUtils::All, RenderUtils::Mesh | RenderUtils::Fragment);
-    }
+    graph.AddPass("Update Material Resolve Args",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.Read(resources.materialTileCounts, ResourceState::kUnorderedAccess);
+            builder.Write(resources.materialResolveIndirectArgs, ResourceState::kUnorderedAccess);
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            cmd->BindPipeline(materialResolveIndirectArgsProgram.pipeline);
+            cmd->BindBindingSet(materialResolveSet);
+            cmd->Dispatch((materialCount + 63) / 64, 1, 1);
+        }
+    );
+
+    // One dispatch per material over its tile list, the material index is patched in the root constants
+    graph.AddPass("Material Resolve",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.Read(resources.materialResolveIndirectArgs, ResourceState::kIndirectArgument);
+            builder.Read(resources.materialTiles, ResourceState::kUnorderedAccess);
+            builder.Read(resources.visibility, ResourceState::kNonPixelShaderResource);
+            builder.Read(resources.depth, ResourceState::kNonPixelShaderResource);
+            builder.Write(resources.color, ResourceState::kUnorderedAccess);
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            auto dxCmd = ((DXCommandList*)cmd.get())->GetCommandList();
+
+            DXBindingSetLayout* l = (DXBindingSetLayout*)materialResolveLayoutSet.get();
+            dxCmd->SetComputeRootSignature(l->GetRootSignature().Get());
+            cmd->BindPipeline(materialResolveProgram.pipeline);
+            cmd->BindBindingSet(materialResolveSet);
+
+            DXResource* dxIndirectArgsBuffer = (DXResource*)materialResolveIndirectArgsBuffer.get();
+            dxCmd->ExecuteIndirect(
+                materialResolveCommandSignature.Get(),
+                materialCount,
+                dxIndirectArgsBuffer->resource.Get(),
+                0,
+                nullptr,
+                0
+            );
+        }
+    );
 
-    if (!forwardPipeline)
+    // --validate-material-tiles compares the tile lists with the CPU classification of the same visibility image once
+    // the frame is complete
+    if (MaterialTileValidation::IsReadbackRequested())
     {
-        // TODO: transform that into a compute
-        ShaderDesc forwardMeshShaderDesc = { MODERN_RENDERER_ASSETS_PATH "shaders/ForwardPass.hlsl", "mesh", ShaderType::kMesh, "6_5" };
-        std::shared_ptr<Shader> forwardMeshShader = device->CompileShader(forwardMeshShaderDesc);
-        ShaderDesc forwardFragmentShaderDesc = { MODERN_RENDERER_ASSETS_PATH "shaders/ForwardPass.hlsl", "fragment", ShaderType::kPixel, "6_5" };
-        std::shared_ptr<Shader> forwardFragmentShader = device->CompileShader(forwardFragmentShaderDesc);
-
-        forwardProgram = device->CreateProgram({ forwardMeshShader, forwardFragmentShader });
-
-        GraphicsPipelineDesc meshShaderPipelineDesc = {
-            forwardProgram,
-            forwardLayoutSet,
-            {},
-            forwardRenderPass,
-        };
-        meshShaderPipelineDesc.rasterizer_desc = { FillMode::kSolid, CullMode::kBack, 0 };
-        meshShaderPipelineDesc.depth_stencil_desc = { true, ComparisonFunc::kAlways, false };
-
-        forwardPipeline = device->CreateGraphicsPipeline(meshShaderPipelineDesc);
+        graph.AddPass("Material Tile Validation Readback",
+            [&](RenderGraph::PassBuilder& builder)
+            {
+                builder.Read(resources.materialTileCounts, ResourceState::kCopySource);
+                builder.Read(resources.materialTiles, ResourceState::kCopySource);
+                builder.Read(resources.visibility, ResourceState::kCopySource);
+                builder.Read(resources.depth, ResourceState::kCopySource);
+                builder.Read(resources.visibleMeshlets1, ResourceState::kCopySource);
+                builder.SetSideEffect();
+            },
+            [this](std::shared_ptr<CommandList> cmd)
+            {
+                MaterialTileValidation::EnqueueReadback(cmd, materialTileCountsBuffer, materialTilesBuffer, visibilityTexture, depthTexture, Scene::visibleMeshletsBuffer1);
+            }
+        );
     }
-
-    Profiler::BeginMarker(cmd, "Forward Opaque Pass");
-    cmd->ResourceBarrier({ { colorTexture, ResourceState::kCommon, ResourceState::kRenderTarget } });
-    cmd->ResourceBarrier({ { depthTexture, ResourceState::kCommon, ResourceState::kDepthStencilWrite} });
-
-    cmd->BeginRenderPass(forwardRenderPass, forwardFrameBuffer, {});
-
-    // Draw fullscreen forward pass
-    cmd->BindPipeline(forwardPipeline);
-    cmd->BindBindingSet(forwardBindingSet);
-    cmd->DispatchMesh(1, 1, 1);
-
-    cmd->EndRenderPass();
-
-    cmd->ResourceBarrier({ { colorTexture, ResourceState::kRenderTarget, ResourceState::kCommon } });
-    cmd->ResourceBarrier({ { depthTexture, ResourceState::kDepthStencilWrite, ResourceState::kCommon } });
-    Profiler::EndMarker(cmd);
 }
 
-void RenderPipeline::Render(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> backBuffer, std::shared_ptr<Scene> scene)
+RenderPipeline::GraphResources RenderPipeline::DeclareGraph()
 {
-	this->scene = scene;
-
-    // Frustum cull instances of the scene using their OBB
-    // Outputs a buffer of visible meshlets
-    FrustumCulling(cmd);
-
-    // Cull the meshlets usig frustum and cone culling
-    // Outputs a reduced list of visible meshlets for the next render passes
-    MeshletCulling(cmd);
+    graph.Reset();
+    pipelineResources.clear();
+
+    GraphResources resources;
+    resources.visibleMeshletsCount = ImportPipelineResource("Visible Meshlet Count", visibleMeshletsCountBuffer);
+    resources.visibleMeshlets0 = ImportPipelineResource("Visible Meshlets 0", Scene::visibleMeshletsBuffer0);
+    resources.visibleMeshlets1 = ImportPipelineResource("Visible Meshlets 1", Scene::visibleMeshletsBuffer1);
+    resources.meshletCullingIndirectArgs = ImportPipelineResource("Meshlet Culling Indirect Args", meshletCullingIndirectArgsBuffer);
+    resources.meshletCullingIndirectCount = ImportPipelineResource("Meshlet Culling Indirect Count", meshletCullingIndirectCountBuffer);
+    resources.visibility = ImportPipelineResource("Visibility Texture", visibilityTexture);
+    resources.materialTileCounts = ImportPipelineResource("Material Tile Counts", materialTileCountsBuffer);
+    resources.materialTiles = ImportPipelineResource("Material Tile Lists", materialTilesBuffer);
+    resources.materialResolveIndirectArgs = ImportPipelineResource("Material Resolve Indirect Args", materialResolveIndirectArgsBuffer);
+    // Color and depth are used by the renderer after the pipeline, they are given back in the common state
+    resources.color = graph.Import("Color", colorTexture, ResourceState::kCommon, ResourceState::kCommon, true);
+    resources.depth = graph.Import("Depth", depthTexture, ResourceState::kCommon, ResourceState::kCommon, true);
+
+    // Frustum and meshlet culling
+    AddCullingPasses(resources);
 
     // Visibility pass:
     // Clears depth, draw into depth and visibility targets
     // TODO: two-pass occlusion culling
-    RenderVisibility(cmd);
+    AddVisibilityPass(resources);
 
     // TODO: build lighting structures + shadows
 
-    // Forward opaque pass:
-    // Transforms visibility information direclty into color
+    // Material resolve:
+    // Classifies screen tiles per material and shades each material with an indirect compute dispatch
     // TODO: Gbuffer path
-    RenderForwardOpaque(cmd);
+    AddMaterialResolvePasses(resources);
 
     // Render sky where no opaque objects are visible
-    scene->sky.Render(cmd, colorTexture, colorTextureView, depthTexture, depthTextureView);
+    graph.AddPass("Sky Pass",
+        [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.ReadWrite(resources.color, ResourceState::kRenderTarget);
+            builder.ReadWrite(resources.depth, ResourceState::kDepthStencilWrite);
+        },
+        [this](std::shared_ptr<CommandList> cmd)
+        {
+            scene->sky.Render(cmd, colorTexture, colorTextureView, depthTexture, depthTextureView);
+        }
+    );
 
     // TODO: transparency
+
+    return resources;
+}
+
+std::shared_ptr<CommandList> RenderPipeline::Render(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> backBuffer, std::shared_ptr<Scene> scene)
+{
+	this->scene = scene;
+
+    // Fetch the culling statistics of a previous frame, this never waits on the GPU
+    CullingStatistics::ReadbackStats();
+
+    // The graph is declared again every frame, passes that don't contribute to the color and depth outputs are culled
+    DeclareGraph();
+
+    // Passes are recorded in parallel in their own command lists, submitted after the commands already in cmd
+    cmd->Close();
+    graph.ExecuteParallel(FrameContext::AcquireCommandList, [this](std::shared_ptr<CommandList> passCmd)
+    {
+        passCmd->SetViewport(0, 0, appSize.width(), appSize.height());
+        passCmd->SetScissorRect(0, 0, appSize.width(), appSize.height());
+    });
+
+    for (const auto& [handle, resource] : pipelineResources)
+        resourceStates[resource] = graph.GetFinalState(handle);
+
+    // The rest of the frame is recorded in a new list submitted after the passes
+    auto nextCmd = FrameContext::AcquireCommandList();
+    nextCmd->Reset();
+    nextCmd->SetViewport(0, 0, appSize.width(), appSize.height());
+    nextCmd->SetScissorRect(0, 0, appSize.width(), appSize.height());
+    return nextCmd;
 }
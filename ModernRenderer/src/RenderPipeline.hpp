@@ -4,9 +4,13 @@
 #include "Camera.hpp"
 #include "Scene.hpp"
 #include "RenderUtils.hpp"
+#include "VisibilityBuffer.hpp"
+#include "RenderGraph.hpp"
+#include "TransientResourceAllocator.hpp"
 
 #include <CommandList/DXCommandList.h>
 #include <Resource/DXResource.h>
+#include <unordered_map>
 
 // Set the maximum number of visible meshlets for the different culling steps divided by 65k
 // 256 * 65k = 16.7M. This is a very high limit as most of them will get culled.
@@ -66,6 +70,7 @@ private:
 	std::shared_ptr<View> depthTextureView;
 
 	// Visibility Render Pass resources
+	VisibilityBuffer::Format visibilityFormat;
 	std::shared_ptr<Resource> visibilityTexture;
 	std::shared_ptr<View> visibilityRenderTargetView;
 	std::shared_ptr<View> visibilityTextureView;
@@ -79,25 +84,76 @@ private:
 	std::shared_ptr<BindingSetLayout> indirectVisibilityLayoutSet;
 	std::shared_ptr<BindingSet> indirectVisibilitySet;
 
-	// Forward Render Pass resources
-	std::shared_ptr<RenderPass> forwardRenderPass;
-	std::shared_ptr<Framebuffer> forwardFrameBuffer;
-	std::shared_ptr<Pipeline> forwardPipeline;
-	std::shared_ptr<Program> forwardProgram;
-	std::shared_ptr<BindingSetLayout> forwardLayoutSet;
-	std::shared_ptr<BindingSet> forwardBindingSet;
+	// Material Resolve resources
+	unsigned materialCount = 0;
+	unsigned materialTileCountX = 0;
+	unsigned materialTileCountY = 0;
+	std::shared_ptr<View> colorTextureUAV;
+	std::shared_ptr<View> depthTextureSRV;
+	std::shared_ptr<Resource> materialTileCountsBuffer;
+	std::shared_ptr<View> materialTileCountsView;
+	std::shared_ptr<Resource> materialTilesBuffer;
+	std::shared_ptr<View> materialTilesView;
+	std::shared_ptr<Resource> materialResolveIndirectArgsBuffer;
+	std::shared_ptr<View> materialResolveIndirectArgsView;
+	std::shared_ptr<BindingSetLayout> materialResolveLayoutSet;
+	std::shared_ptr<BindingSet> materialResolveSet;
+	ComPtr<ID3D12CommandSignature> materialResolveCommandSignature;
+	RenderUtils::ComputeProgram materialClassificationClearProgram;
+	RenderUtils::ComputeProgram materialClassificationProgram;
+	RenderUtils::ComputeProgram materialResolveIndirectArgsProgram;
+	RenderUtils::ComputeProgram materialResolveProgram;
 
 	std::shared_ptr<BindingSetLayout> objectLayoutSet;
 	std::shared_ptr<BindingSet> objectBindingSet;
 
-	void FrustumCulling(std::shared_ptr<CommandList> cmd);
-	void MeshletCulling(std::shared_ptr<CommandList> cmd);
-	void RenderVisibility(std::shared_ptr<CommandList> cmd);
-	void RenderForwardOpaque(std::shared_ptr<CommandList> cmd);
+	// Render graph of the frame and handles of the resources imported in it
+	struct GraphResources
+	{
+		RenderGraph::ResourceHandle visibleMeshletsCount;
+		RenderGraph::ResourceHandle visibleMeshlets0;
+		RenderGraph::ResourceHandle visibleMeshlets1;
+		RenderGraph::ResourceHandle meshletCullingIndirectArgs;
+		RenderGraph::ResourceHandle meshletCullingIndirectCount;
+		RenderGraph::ResourceHandle visibility;
+		RenderGraph::ResourceHandle depth;
+		RenderGraph::ResourceHandle color;
+		RenderGraph::ResourceHandle materialTileCounts;
+		RenderGraph::ResourceHandle materialTiles;
+		RenderGraph::ResourceHandle materialResolveIndirectArgs;
+	};
+	RenderGraph graph;
+	// State of the resources owned by the pipeline at the end of the previous frame
+	std::unordered_map<Resource*, ResourceState> resourceStates;
+	std::vector<std::pair<RenderGraph::ResourceHandle, Resource*>> pipelineResources;
+
+	void CreateCullingResources();
+	void CreateVisibilityResources();
+	void CreateMaterialResolveResources();
+	// Pipelines only depend on the layouts created with the resources, they are created again when their shaders are reloaded
+	void CreatePipelines();
+
+	GraphResources DeclareGraph();
+	RenderGraph::ResourceHandle ImportPipelineResource(const std::string& name, std::shared_ptr<Resource> resource);
+	void AddCullingPasses(const GraphResources& resources);
+	void AddVisibilityPass(const GraphResources& resources);
+	void AddMaterialResolvePasses(const GraphResources& resources);
+
+	gli::format GetVisibilityTextureFormat() const;
+	std::map<std::string, std::string> GetVisibilityFormatDefines() const;
+	static std::map<std::string, std::string> GetVisibilityFormatDefines(VisibilityBuffer::Format visibilityFormat);
+	static ShaderDesc GetVisibilityShaderDesc(const std::string& entryPoint, ShaderType type, VisibilityBuffer::Format visibilityFormat);
 
 public:
-	RenderPipeline(std::shared_ptr<Device> device, const AppSize& appSize, Camera& camera, std::shared_ptr<Resource> colorTexture, std::shared_ptr<View> colorTextureView, std::shared_ptr<Resource> depthTexture, std::shared_ptr<View> depthTextureView);
-	~RenderPipeline() = default;
+	// Declares the transient resources of the pipeline, CreateResources must be called once they are allocated
+	RenderPipeline(std::shared_ptr<Device> device, const AppSize& appSize, Camera& camera, std::shared_ptr<Resource> colorTexture, std::shared_ptr<View> colorTextureView, std::shared_ptr<Resource> depthTexture, std::shared_ptr<View> depthTextureView, TransientResourceAllocator& transientResources, VisibilityBuffer::Format visibilityFormat = VisibilityBuffer::Format::R32);
+	~RenderPipeline();
+
+	void CreateResources();
+
+	// Starts compiling every shader of the pipeline, see PipelineRegistry
+	static void RequestShaders(VisibilityBuffer::Format visibilityFormat);
 
-	void Render(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> backBuffer, std::shared_ptr<Scene> scene);
+	// Closes cmd and returns the command list in which the rest of the frame must be recorded
+	std::shared_ptr<CommandList> Render(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> backBuffer, std::shared_ptr<Scene> scene);
 };
\ No newline at end of file
@@ -1,11 +1,15 @@
 #include "RenderSettings.hpp"
 #include <imgui.h>
+#include "CullingStatistics.hpp"
 
 bool RenderSettings::frustumInstanceCullingDisabled = false;
 bool RenderSettings::frustumMeshletCullingDisabled = false;
 bool RenderSettings::backfacingMeshletCullingDisabled = false;
+bool RenderSettings::smallFeatureMeshletCullingDisabled = false;
+float RenderSettings::smallFeatureCullingPixelThreshold = 1.0f;
 bool RenderSettings::freezeFrustumCulling = false;
 bool RenderSettings::noUI = false;
+bool RenderSettings::visibilityBuffer64Bit = false;
 
 int RenderSettings::integrationCountPerFrame = 1;
 int RenderSettings::MaxAccumulationCount = 1024;
@@ -19,8 +23,12 @@ void RenderSettings::RenderImGUISettingsWindow()
     ImGui::Checkbox("Disable Instance Frustum culling", &frustumInstanceCullingDisabled);
     ImGui::Checkbox("Disable Meshlet Frustum culling", &frustumMeshletCullingDisabled);
     ImGui::Checkbox("Disable Backfacing Meshlet culling", &backfacingMeshletCullingDisabled);
+    ImGui::Checkbox("Disable Small Feature Meshlet culling", &smallFeatureMeshletCullingDisabled);
+    ImGui::SliderFloat("Small Feature Threshold (pixels)", &smallFeatureCullingPixelThreshold, 0.0f, 16.0f);
     ImGui::Checkbox("Freeze frustum culling", &freezeFrustumCulling);
 
+    CullingStatistics::DrawImGUIStats();
+
     ImGui::End();
 
     ImGui::Begin("Path Tracing Settings", nullptr, ImGuiWindowFlags_NoCollapse);
@@ -10,8 +10,12 @@ public:
 	static bool frustumInstanceCullingDisabled;
 	static bool frustumMeshletCullingDisabled;
 	static bool backfacingMeshletCullingDisabled;
+	static bool smallFeatureMeshletCullingDisabled;
+	static float smallFeatureCullingPixelThreshold;
 	static bool freezeFrustumCulling;
 	static bool noUI;
+	// Read when the render pipeline is created, switches the visibility buffer to the R32G32 encoding (--visibility-64)
+	static bool visibilityBuffer64Bit;
 
 	// Path tracing settings
 	static int integrationCountPerFrame;
@@ -2,9 +2,64 @@
 #include "Mesh.hpp"
 #include "MeshPool.hpp"
 #include "Scene.hpp"
+#include "PipelineRegistry.hpp"
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include "GLFW/glfw3native.h"
 #include <algorithm>
+#include <tuple>
+
+// Every BindKey field, shared by the hash, the equality and the sort of the caches. The structured binding fails to
+// compile if a field is added to BindKey, so that two keys differing by a new field never share a cache entry.
+static auto MakeTie(const BindKey& key)
+{
+	const auto& [shaderType, viewType, slot, space, count, remappedSlot, rootConstant] = key;
+	return std::make_tuple(shaderType, viewType, slot, space, count, remappedSlot, rootConstant);
+}
+
+static size_t HashCombine(size_t seed, size_t value)
+{
+	return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+static size_t HashBindKey(size_t seed, const BindKey& key)
+{
+	std::apply([&](const auto&... fields) { ((seed = HashCombine(seed, (size_t)fields)), ...); }, MakeTie(key));
+	return seed;
+}
+
+size_t RenderUtils::BindKeyListHash::operator()(const std::vector<BindKey>& keys) const
+{
+	size_t hash = keys.size();
+	for (const auto& key : keys)
+		hash = HashBindKey(hash, key);
+	return hash;
+}
+
+bool RenderUtils::BindKeyListEqual::operator()(const std::vector<BindKey>& a, const std::vector<BindKey>& b) const
+{
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const BindKey& x, const BindKey& y) { return MakeTie(x) == MakeTie(y); });
+}
+
+size_t RenderUtils::BindingSetKeyHash::operator()(const BindingSetKey& key) const
+{
+	size_t hash = std::hash<BindingSetLayout*>()(key.layout.get());
+	for (const auto& desc : key.descs)
+		hash = HashCombine(HashBindKey(hash, desc.bind_key), std::hash<View*>()(desc.view.get()));
+	return hash;
+}
+
+bool RenderUtils::BindingSetKey::operator==(const BindingSetKey& other) const
+{
+	return layout == other.layout && std::equal(descs.begin(), descs.end(), other.descs.begin(), other.descs.end(), [](const BindingDesc& a, const BindingDesc& b)
+	{
+		return MakeTie(a.bind_key) == MakeTie(b.bind_key) && a.view == b.view;
+	});
+}
+
+std::mutex RenderUtils::bindingCacheMutex;
+std::unordered_map<std::vector<BindKey>, std::shared_ptr<BindingSetLayout>, RenderUtils::BindKeyListHash, RenderUtils::BindKeyListEqual> RenderUtils::layoutCache;
+std::unordered_map<RenderUtils::BindingSetKey, std::shared_ptr<BindingSet>, RenderUtils::BindingSetKeyHash> RenderUtils::bindingSetCache;
+RenderUtils::BindingCacheStatistics RenderUtils::bindingCacheStatistics;
 
 static ShaderType GetShaderTypeFromStage(int stage)
 {
@@ -64,7 +119,17 @@ std::shared_ptr<BindingSetLayout> RenderUtils::CreateLayoutSet(std::shared_ptr<D
 		}
 	}
 
-	return device->CreateBindingSetLayout(allBindingsWithStages);
+	std::lock_guard<std::mutex> lock(bindingCacheMutex);
+	auto cached = layoutCache.find(allBindingsWithStages);
+	if (cached != layoutCache.end())
+	{
+		bindingCacheStatistics.layoutHits++;
+		return cached->second;
+	}
+
+	auto layout = device->CreateBindingSetLayout(allBindingsWithStages);
+	layoutCache.emplace(std::move(allBindingsWithStages), layout);
+	return layout;
 }
 
 void RenderUtils::UploadBufferData(std::shared_ptr<Device> device, std::shared_ptr<Resource> buffer, const void* data, size_t size)
@@ -129,12 +194,65 @@ std::shared_ptr<BindingSet> RenderUtils::CreateBindingSet(std::shared_ptr<Device
 		}
 	}
 
+	// Bindings are written by key, their order doesn't change the binding set
+	std::sort(allBindingsWithStages.begin(), allBindingsWithStages.end(), [](const BindingDesc& a, const BindingDesc& b)
+	{
+		return std::make_pair(MakeTie(a.bind_key), a.view.get()) < std::make_pair(MakeTie(b.bind_key), b.view.get());
+	});
+
+	std::lock_guard<std::mutex> lock(bindingCacheMutex);
+	BindingSetKey key = { layout, std::move(allBindingsWithStages) };
+	auto cached = bindingSetCache.find(key);
+	if (cached != bindingSetCache.end())
+	{
+		bindingCacheStatistics.bindingSetHits++;
+		return cached->second;
+	}
+
 	auto set = device->CreateBindingSet(layout);
-	set->WriteBindings(allBindingsWithStages);
+	set->WriteBindings(key.descs);
+	bindingSetCache.emplace(std::move(key), set);
 
 	return set;
 }
 
+void RenderUtils::InvalidateBindingSets(const std::vector<BindingDesc>& descs)
+{
+	std::lock_guard<std::mutex> lock(bindingCacheMutex);
+
+	for (auto it = bindingSetCache.begin(); it != bindingSetCache.end();)
+	{
+		bool usesView = std::any_of(it->first.descs.begin(), it->first.descs.end(), [&](const BindingDesc& cachedDesc)
+		{
+			return cachedDesc.view && std::any_of(descs.begin(), descs.end(), [&](const BindingDesc& desc) { return desc.view == cachedDesc.view; });
+		});
+
+		if (usesView)
+		{
+			it = bindingSetCache.erase(it);
+			bindingCacheStatistics.invalidatedBindingSets++;
+		}
+		else
+			++it;
+	}
+}
+
+RenderUtils::BindingCacheStatistics RenderUtils::GetBindingCacheStatistics()
+{
+	std::lock_guard<std::mutex> lock(bindingCacheMutex);
+	BindingCacheStatistics statistics = bindingCacheStatistics;
+	statistics.layoutCount = layoutCache.size();
+	statistics.bindingSetCount = bindingSetCache.size();
+	return statistics;
+}
+
+void RenderUtils::PrintBindingCacheStatistics()
+{
+	BindingCacheStatistics statistics = GetBindingCacheStatistics();
+	printf("Binding cache: %zu layouts (%u reused), %zu binding sets (%u reused, %u invalidated)\n", statistics.layoutCount, statistics.layoutHits,
+		statistics.bindingSetCount, statistics.bindingSetHits, statistics.invalidatedBindingSets);
+}
+
 void RenderUtils::SetBackgroundColor(GLFWwindow* window, COLORREF color)
 {
 	HWND hwnd = glfwGetWin32Window(window);
@@ -199,13 +317,19 @@ void RenderUtils::UploadTextureData(const std::shared_ptr<Resource>& resource, c
 	fence->Wait(1);
 }
 
-RenderUtils::ComputeProgram RenderUtils::CreateComputePipeline(std::shared_ptr<Device> device, const std::string& shaderPath, const std::string& kernelName, std::shared_ptr<BindingSetLayout> layoutSet)
+ShaderDesc RenderUtils::GetComputeShaderDesc(const std::string& shaderPath, const std::string& kernelName, const std::map<std::string, std::string>& defines)
+{
+	std::string path = MODERN_RENDERER_ASSETS_PATH + shaderPath;
+	ShaderDesc desc = { path.c_str(), kernelName.c_str(), ShaderType::kCompute, "6_5" };
+	desc.define = defines;
+	return desc;
+}
+
+RenderUtils::ComputeProgram RenderUtils::CreateComputePipeline(std::shared_ptr<Device> device, const std::string& shaderPath, const std::string& kernelName, std::shared_ptr<BindingSetLayout> layoutSet, const std::map<std::string, std::string>& defines)
 {
 	ComputeProgram c;
 
-	std::string path = MODERN_RENDERER_ASSETS_PATH + shaderPath;
-	ShaderDesc instanceFrustumCullingDesc = { path.c_str(), kernelName.c_str(), ShaderType::kCompute, "6_5"};
-	c.shader = device->CompileShader(instanceFrustumCullingDesc);
+	c.shader = PipelineRegistry::GetShader(GetComputeShaderDesc(shaderPath, kernelName, defines));
 	c.program = device->CreateProgram({ c.shader });
 
 	ComputePipelineDesc desc = {
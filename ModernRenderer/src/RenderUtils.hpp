@@ -1,5 +1,9 @@
 #pragma once
 #include <memory>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 #include "Instance/Instance.h"
 #include "Material.hpp"
 #include "Texture.hpp"
@@ -47,18 +51,70 @@ public:
 		std::shared_ptr<Shader> shader;
 	};
 
+	struct BindingCacheStatistics
+	{
+		size_t layoutCount = 0;
+		size_t bindingSetCount = 0;
+		unsigned layoutHits = 0;
+		unsigned bindingSetHits = 0;
+		unsigned invalidatedBindingSets = 0;
+	};
+
+private:
+	// Layouts and binding sets are cached by their bindings once the flags are expanded and the keys replicated per
+	// stage, passes declaring the same bindings share them. Layout keys keep their declaration order since it gives
+	// the root parameter indices (see CreateIndirectRootConstantCommandSignature), binding set keys are sorted.
+	struct BindKeyListHash
+	{
+		size_t operator()(const std::vector<BindKey>& keys) const;
+	};
+
+	struct BindKeyListEqual
+	{
+		bool operator()(const std::vector<BindKey>& a, const std::vector<BindKey>& b) const;
+	};
+
+	struct BindingSetKey
+	{
+		std::shared_ptr<BindingSetLayout> layout;
+		// Holding the views keeps their addresses from being reused by another view while the set is cached
+		std::vector<BindingDesc> descs;
+
+		bool operator==(const BindingSetKey& other) const;
+	};
+
+	struct BindingSetKeyHash
+	{
+		size_t operator()(const BindingSetKey& key) const;
+	};
+
+	static std::mutex bindingCacheMutex;
+	static std::unordered_map<std::vector<BindKey>, std::shared_ptr<BindingSetLayout>, BindKeyListHash, BindKeyListEqual> layoutCache;
+	static std::unordered_map<BindingSetKey, std::shared_ptr<BindingSet>, BindingSetKeyHash> bindingSetCache;
+	static BindingCacheStatistics bindingCacheStatistics;
+
+public:
 	static std::shared_ptr<BindingSetLayout> CreateLayoutSet(std::shared_ptr<Device> device, const Camera& camera, const std::vector<BindKey>& keys, const int flags, const int stages);
 	static std::shared_ptr<BindingSet> CreateBindingSet(std::shared_ptr<Device> device, std::shared_ptr<BindingSetLayout> layout, const Camera& camera, const std::vector<BindingDesc>& descs, const int flags, const int stages);
+	// Drops the cached binding sets using one of the views, must be called before the views are replaced (e.g. when
+	// the MeshPool buffers are allocated again) so that the next CreateBindingSet writes the new ones
+	static void InvalidateBindingSets(const std::vector<BindingDesc>& descs);
+	static BindingCacheStatistics GetBindingCacheStatistics();
+	static void PrintBindingCacheStatistics();
 	static void UploadBufferData(std::shared_ptr<Device> device, std::shared_ptr<Resource> buffer, const void* data, size_t size);
 	static void SetBackgroundColor(GLFWwindow* window, COLORREF color);
 	static void UploadTextureData(const std::shared_ptr<Resource>& resource, const std::shared_ptr<Device>& device, uint32_t subresource, const void* data, int width, int height, int channels, int bytePerChannel);
-	static ComputeProgram CreateComputePipeline(std::shared_ptr<Device> device, const std::string& shaderPath, const std::string& kernelName, std::shared_ptr<BindingSetLayout> layoutSet);
+	// Shader of a compute kernel, shaderPath is relative to the assets directory
+	static ShaderDesc GetComputeShaderDesc(const std::string& shaderPath, const std::string& kernelName, const std::map<std::string, std::string>& defines = {});
+	static ComputeProgram CreateComputePipeline(std::shared_ptr<Device> device, const std::string& shaderPath, const std::string& kernelName, std::shared_ptr<BindingSetLayout> layoutSet, const std::map<std::string, std::string>& defines = {});
 	static ComPtr<ID3D12CommandSignature> CreateIndirectRootConstantCommandSignature(std::shared_ptr<Device> device, std::shared_ptr<BindingSetLayout> layoutSet, bool compute);
 
+	// The buffer can have room for more elements than the data with capacity, the rest is uninitialized
 	template<typename T>
-	static void AllocateVertexBufer(std::shared_ptr<Device> device, const std::vector<T>& data, ViewType viewType, gli::format format, const std::string& name, std::shared_ptr<Resource>& resource, std::shared_ptr<View>& view)
+	static void AllocateVertexBufer(std::shared_ptr<Device> device, const std::vector<T>& data, ViewType viewType, gli::format format, const std::string& name, std::shared_ptr<Resource>& resource, std::shared_ptr<View>& view, size_t capacity = 0)
 	{
-		resource = device->CreateBuffer(BindFlag::kVertexBuffer | BindFlag::kCopyDest, sizeof(T) * data.size());
+		capacity = std::max(capacity, data.size());
+		resource = device->CreateBuffer(BindFlag::kVertexBuffer | BindFlag::kCopyDest, sizeof(T) * capacity);
 		resource->CommitMemory(MemoryType::kDefault);
 		RenderUtils::UploadBufferData(device, resource, data.data(), sizeof(T) * data.size());
 		resource->SetName(name);
@@ -70,7 +126,7 @@ public:
 		d.dimension = ViewDimension::kBuffer;
 		d.buffer_format = format;
 		d.structure_stride = sizeof(T);
-		d.buffer_size = sizeof(T) * data.size();
+		d.buffer_size = sizeof(T) * capacity;
 		view = device->CreateView(resource, d);
 	}
 };
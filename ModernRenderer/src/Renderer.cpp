@@ -4,6 +4,8 @@
 #include "RenderUtils.hpp"
 #include "RenderSettings.hpp"
 #include "Profiler.hpp"
+#include "PipelineRegistry.hpp"
+#include "MeshPool.hpp"
 
 Renderer::Renderer(std::shared_ptr<Device> device, AppBox& app, Camera& camera)
 {
@@ -16,15 +18,24 @@ Renderer::Renderer(std::shared_ptr<Device> device, AppBox& app, Camera& camera)
 
 	app.SubscribeEvents((InputEvents*)&controls, nullptr);
 
+    transientResources = std::make_shared<TransientResourceAllocator>(device);
+
     AllocateRenderTargets();
-    CompileShaders();
-    CreatePipelineObjects();
 
-    renderPipeline = std::make_shared<RenderPipeline>(device, app.GetAppSize(), camera, mainColorTexture, mainColorRenderTargetView, mainDepthTexture, mainDepthTextureView);
+    VisibilityBuffer::Format visibilityFormat = RenderSettings::visibilityBuffer64Bit ? VisibilityBuffer::Format::R32G32 : VisibilityBuffer::Format::R32;
+    renderPipeline = std::make_shared<RenderPipeline>(device, app.GetAppSize(), camera, mainColorTexture, mainColorRenderTargetView, mainDepthTexture, mainDepthTextureView, *transientResources, visibilityFormat);
+
+    // Every user has declared its transient resources, they can be placed before creating their views
+    transientResources->Allocate();
+
+    CreatePipelineObjects();
+    renderPipeline->CreateResources();
+    instanceUpdater = std::make_shared<InstanceUpdater>(device, camera);
 }
 
 Renderer::~Renderer()
 {
+    PipelineRegistry::RemoveReloadListener(this);
 }
 
 void Renderer::AllocateRenderTargets()
@@ -48,14 +59,11 @@ void Renderer::AllocateRenderTargets()
     depth2DDesc.dimension = ViewDimension::kTexture2D;
     mainDepthTextureView = device->CreateView(mainDepthTexture, depth2DDesc);
 
+    // The accumulation is kept from one path tracing frame to the next, it spans the whole path tracing part of the
+    // transient timeline and only shares its memory with the rasterization resources
     pathTracingAccumulationTexture = device->CreateTexture(TextureType::k2D, BindFlag::kRenderTarget | BindFlag::kUnorderedAccess | BindFlag::kShaderResource | BindFlag::kCopySource, gli::format::FORMAT_RGBA32_SFLOAT_PACK32, 1, appSize.width(), appSize.height(), 1, 1);
-    pathTracingAccumulationTexture->CommitMemory(MemoryType::kDefault);
-    pathTracingAccumulationTexture->SetName("Path Tracing Accumulation");
-
-    ViewDesc pathTracingAccumulationViewDesc = {};
-    pathTracingAccumulationViewDesc.view_type = ViewType::kRWTexture;
-    pathTracingAccumulationViewDesc.dimension = ViewDimension::kTexture2D;
-    pathTracingAccumulationView = device->CreateView(pathTracingAccumulationTexture, pathTracingAccumulationViewDesc);
+    unsigned pathTracingPass = transientResources->ReserveTimeline(1);
+    transientResources->Declare("Path Tracing Accumulation", pathTracingAccumulationTexture, pathTracingPass, pathTracingPass);
 
     // Create the framebuffer
     ViewDesc stencil2DDesc = {};
@@ -74,20 +82,35 @@ void Renderer::AllocateRenderTargets()
         imGUIPass = device->CreateRenderPass({ { { mainColorRenderTargetView->GetResource()->GetFormat(), RenderPassLoadOp::kLoad, RenderPassStoreOp::kStore}}});
 }
 
-void Renderer::CompileShaders()
+void Renderer::RequestShaders()
 {
-    // Create HW path tracing program
-    pathTracingLibrary = device->CompileShader(
-        { MODERN_RENDERER_ASSETS_PATH "shaders/RayTracing.hlsl", "", ShaderType::kLibrary, "6_5" });
-    pathTracingHitLibrary = device->CompileShader(
-        { MODERN_RENDERER_ASSETS_PATH "shaders/RayTracingHit.hlsl", "", ShaderType::kLibrary, "6_5" });
-    pathTracingMissLibrary = device->CompileShader(
-        { MODERN_RENDERER_ASSETS_PATH "shaders/RayTracingMiss.hlsl", "", ShaderType::kLibrary, "6_5" });
-    pathTracingProgram = device->CreateProgram({ pathTracingLibrary, pathTracingHitLibrary, pathTracingMissLibrary });
+    // Rasterization shaders first, they are needed by the first frame
+    VisibilityBuffer::Format visibilityFormat = RenderSettings::visibilityBuffer64Bit ? VisibilityBuffer::Format::R32G32 : VisibilityBuffer::Format::R32;
+    InstanceUpdater::RequestShaders();
+    RenderPipeline::RequestShaders(visibilityFormat);
+
+    for (const auto& desc : GetPathTracingLibraryDescs())
+        PipelineRegistry::Request(desc);
+    PipelineRegistry::Request(RenderUtils::GetComputeShaderDesc("shaders/PathTracingResolve.hlsl", "main"));
+    PipelineRegistry::Request(RenderUtils::GetComputeShaderDesc("shaders/PathTracingResolve.hlsl", "clear"));
+}
+
+std::vector<ShaderDesc> Renderer::GetPathTracingLibraryDescs()
+{
+    return {
+        { MODERN_RENDERER_ASSETS_PATH "shaders/RayTracing.hlsl", "", ShaderType::kLibrary, "6_5" },
+        { MODERN_RENDERER_ASSETS_PATH "shaders/RayTracingHit.hlsl", "", ShaderType::kLibrary, "6_5" },
+        { MODERN_RENDERER_ASSETS_PATH "shaders/RayTracingMiss.hlsl", "", ShaderType::kLibrary, "6_5" },
+    };
 }
 
 void Renderer::CreatePipelineObjects()
 {
+    ViewDesc pathTracingAccumulationViewDesc = {};
+    pathTracingAccumulationViewDesc.view_type = ViewType::kRWTexture;
+    pathTracingAccumulationViewDesc.dimension = ViewDimension::kTexture2D;
+    pathTracingAccumulationView = device->CreateView(pathTracingAccumulationTexture, pathTracingAccumulationViewDesc);
+
     // Create Render passes
     RenderPassDepthStencilDesc depthStencilDesc = {
         gli::FORMAT_D32_SFLOAT_S8_UINT_PACK64,
@@ -113,6 +136,32 @@ void Renderer::CreatePipelineObjects()
     pathTracerBindingSetLayout = RenderUtils::CreateLayoutSet(device, *camera, { drawRootConstant, pathTracerMainColorKey, Scene::accelerationStructureKey }, RenderUtils::All, RenderUtils::Compute);
     pathTracerBindingSet = RenderUtils::CreateBindingSet(device, pathTracerBindingSetLayout, *camera, { { drawRootConstant, nullptr }, { pathTracerMainColorKey, pathTracingAccumulationView }, Scene::accelerationStructureBinding }, RenderUtils::All, RenderUtils::Compute);
 
+    BindKey pathTracerAccumulationMainColorKey = { ShaderType::kCompute, ViewType::kTexture, 0, 0 };
+    BindKey mainColorKey = { ShaderType::kCompute, ViewType::kRWTexture, 0, 0 };
+    pathTracerResolveBindingSetLayout = RenderUtils::CreateLayoutSet(device, *camera, { pathTracerAccumulationMainColorKey, mainColorKey }, RenderUtils::All, RenderUtils::Compute);
+    pathTracerResolveBindingSet = RenderUtils::CreateBindingSet(device, pathTracerResolveBindingSetLayout, *camera, { { pathTracerAccumulationMainColorKey, pathTracingAccumulationView }, { mainColorKey, mainColorTextureView } }, RenderUtils::All, RenderUtils::Compute);
+
+    BindKey pathTracerClearMainColorKey = { ShaderType::kCompute, ViewType::kRWTexture, 0, 0 };
+    pathTracerClearBindingSetLayout = RenderUtils::CreateLayoutSet(device, *camera, { pathTracerClearMainColorKey }, RenderUtils::All, RenderUtils::Compute);
+    pathTracerClearBindingSet = RenderUtils::CreateBindingSet(device, pathTracerClearBindingSetLayout, *camera, { { pathTracerClearMainColorKey, pathTracingAccumulationView } }, RenderUtils::All, RenderUtils::Compute);
+
+    vec2BlueNoiseTexture = Texture::Create3D(device, MODERN_RENDERER_ASSETS_PATH "STBN/stbn_vec2_2Dx1D_128x128x64");
+
+    CreatePathTracingPipelines();
+
+    // Edited shaders are recompiled in the background, the pipelines are created again once they are ready
+    PipelineRegistry::AddReloadListener(this, [this]() { CreatePathTracingPipelines(); });
+}
+
+void Renderer::CreatePathTracingPipelines()
+{
+    // Create HW path tracing program
+    std::vector<ShaderDesc> libraryDescs = GetPathTracingLibraryDescs();
+    pathTracingLibrary = PipelineRegistry::GetShader(libraryDescs[0]);
+    pathTracingHitLibrary = PipelineRegistry::GetShader(libraryDescs[1]);
+    pathTracingMissLibrary = PipelineRegistry::GetShader(libraryDescs[2]);
+    pathTracingProgram = device->CreateProgram({ pathTracingLibrary, pathTracingHitLibrary, pathTracingMissLibrary });
+
     //Create HW path tracing pipeline
     std::vector<RayTracingShaderGroup> groups;
     groups.push_back({ RayTracingShaderGroupType::kGeneral, pathTracingLibrary->GetId("RayGen") });
@@ -152,18 +201,8 @@ void Renderer::CreatePipelineObjects()
         device->GetShaderTableAlignment(),
     };
 
-    BindKey pathTracerAccumulationMainColorKey = { ShaderType::kCompute, ViewType::kTexture, 0, 0 };
-    BindKey mainColorKey = { ShaderType::kCompute, ViewType::kRWTexture, 0, 0 };
-    pathTracerResolveBindingSetLayout = RenderUtils::CreateLayoutSet(device, *camera, { pathTracerAccumulationMainColorKey, mainColorKey }, RenderUtils::All, RenderUtils::Compute);
-    pathTracerResolveBindingSet = RenderUtils::CreateBindingSet(device, pathTracerResolveBindingSetLayout, *camera, { { pathTracerAccumulationMainColorKey, pathTracingAccumulationView }, { mainColorKey, mainColorTextureView } }, RenderUtils::All, RenderUtils::Compute);
     pathTracingResolve = RenderUtils::CreateComputePipeline(device, "shaders/PathTracingResolve.hlsl", "main", pathTracerResolveBindingSetLayout);
-
-    BindKey pathTracerClearMainColorKey = { ShaderType::kCompute, ViewType::kRWTexture, 0, 0 };
-    pathTracerClearBindingSetLayout = RenderUtils::CreateLayoutSet(device, *camera, { pathTracerClearMainColorKey }, RenderUtils::All, RenderUtils::Compute);
-    pathTracerClearBindingSet = RenderUtils::CreateBindingSet(device, pathTracerClearBindingSetLayout, *camera, { { pathTracerClearMainColorKey, pathTracingAccumulationView } }, RenderUtils::All, RenderUtils::Compute);
     pathTracingClear = RenderUtils::CreateComputePipeline(device, "shaders/PathTracingResolve.hlsl", "clear", pathTracerClearBindingSetLayout);
-
-    vec2BlueNoiseTexture = Texture::Create3D(device, MODERN_RENDERER_ASSETS_PATH "STBN/stbn_vec2_2Dx1D_128x128x64");
 }
 
 void Renderer::Controls::OnKey(int key, int action)
@@ -186,20 +225,41 @@ void Renderer::Controls::OnKey(int key, int action)
 void Renderer::UpdateCommandList(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> backBuffer, const Camera& camera, std::shared_ptr<Scene> scene)
 {
     cmd->Reset();
-    cmd->BeginEvent("RenderFrame");
 
     cmd->SetViewport(0, 0, appSize.width(), appSize.height());
     cmd->SetScissorRect(0, 0, appSize.width(), appSize.height());
 
     Profiler::BeginFrame();
+    // Ends in the last command list of the frame, markers can span the lists of a single submission
     Profiler::BeginMarker(cmd, "Total Frame");
 
+    camera.UploadCameraData(cmd);
+
+    // Meshes streamed in since the previous frame, before the instances that can reference them
+    Profiler::BeginMarker(cmd, "Mesh Pool Upload");
+    MeshPool::RecordUploads(cmd);
+    Profiler::EndMarker(cmd);
+
+    // Instances moved since the previous frame, before every pass reading the instance data
+    Profiler::BeginMarker(cmd, "Instance Update");
+    instanceUpdater->Record(cmd, *scene);
+    Profiler::EndMarker(cmd);
+
+    // Rasterization and path tracing resources share memory, the accumulation is lost when switching modes
+    if (controls.rendererMode != activeRendererMode)
+    {
+        transientResources->AliasingBarrier(cmd);
+        resetPathTracingAccumulation = true;
+        activeRendererMode = controls.rendererMode;
+    }
+
     if (camera.HasMoved())
         resetPathTracingAccumulation = true;
 
 	if (controls.rendererMode == RendererMode::Rasterization)
 	{
-		RenderRasterization(cmd, backBuffer, camera, scene);
+		// Render passes are recorded in parallel, the frame continues in a command list submitted after them
+		cmd = RenderRasterization(cmd, backBuffer, camera, scene);
 	}
 	else
 	{
@@ -218,29 +278,36 @@ void Renderer::UpdateCommandList(std::shared_ptr<CommandList> cmd, std::shared_p
         cmd->ResourceBarrier({ { mainDepthTexture, ResourceState::kDepthStencilWrite, ResourceState::kCommon } });
     }
 
-    // Copy final image to the backbuffer
+    // Copy final image to the backbuffer, there is none when rendering offscreen
     // TODO: tonemap color buffer to LDR backbuffer
-    cmd->ResourceBarrier({ { backBuffer, ResourceState::kPresent, ResourceState::kCopyDest } });
-    cmd->ResourceBarrier({ { mainColorTexture, ResourceState::kCommon, ResourceState::kCopySource } });
-    cmd->CopyTexture(mainColorTexture, backBuffer, { { appSize.width(), appSize.height(), 1 } });
-    cmd->ResourceBarrier({ { backBuffer, ResourceState::kCopyDest, ResourceState::kPresent } });
-    cmd->ResourceBarrier({ { mainColorTexture, ResourceState::kCopySource, ResourceState::kCommon } });
+    if (backBuffer)
+    {
+        cmd->ResourceBarrier({ { backBuffer, ResourceState::kPresent, ResourceState::kCopyDest } });
+        cmd->ResourceBarrier({ { mainColorTexture, ResourceState::kCommon, ResourceState::kCopySource } });
+        cmd->CopyTexture(mainColorTexture, backBuffer, { { appSize.width(), appSize.height(), 1 } });
+        cmd->ResourceBarrier({ { backBuffer, ResourceState::kCopyDest, ResourceState::kPresent } });
+        cmd->ResourceBarrier({ { mainColorTexture, ResourceState::kCopySource, ResourceState::kCommon } });
+    }
 
     Profiler::EndMarker(cmd);
     Profiler::EndFrame(cmd);
 
-    cmd->EndEvent();
     cmd->Close();
 }
 
-void Renderer::RenderRasterization(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> backBuffer, const Camera& camera, std::shared_ptr<Scene> scene)
+std::shared_ptr<CommandList> Renderer::RenderRasterization(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> backBuffer, const Camera& camera, std::shared_ptr<Scene> scene)
 {
-    renderPipeline->Render(cmd, backBuffer, scene);
+    return renderPipeline->Render(cmd, backBuffer, scene);
 }
 
 void Renderer::RenderPathTracing(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> backBuffer, const Camera& camera, std::shared_ptr<Scene> scene)
 {
     DXCommandList* dxCmd = (DXCommandList*)cmd.get();
+
+    // Instances moved since the last path traced frame, the accumulated samples are no longer valid
+    if (scene->UpdateTLAS(cmd))
+        resetPathTracingAccumulation = true;
+
     if (resetPathTracingAccumulation)
     {
         resetPathTracingAccumulation = false;
@@ -4,18 +4,21 @@
 #include "Camera.hpp"
 #include "Scene.hpp"
 #include "RenderPipeline.hpp"
+#include "TransientResourceAllocator.hpp"
 #include "ImGUIRenderPass.hpp"
+#include "InstanceUpdater.hpp"
 
 class Renderer
 {
-private:
-
+public:
+    // Toggled with the space key, the benchmark selects it with --renderer
     enum class RendererMode
     {
         Rasterization = 0,
         PathTracing = 1,
     };
 
+private:
     class Controls : InputEvents
     {
     public:
@@ -32,6 +35,9 @@ private:
     std::shared_ptr<Device> device;
     Camera* camera;
     std::shared_ptr<RenderPipeline> renderPipeline;
+    std::shared_ptr<TransientResourceAllocator> transientResources;
+    std::shared_ptr<InstanceUpdater> instanceUpdater;
+    RendererMode activeRendererMode = RendererMode::Rasterization;
     std::shared_ptr<ImGUIRenderPass> imGUI;
 
     // Render passes
@@ -73,10 +79,12 @@ private:
     std::shared_ptr<RenderPass> imGUIPass;
 
     void AllocateRenderTargets();
-    void CompileShaders();
+    static std::vector<ShaderDesc> GetPathTracingLibraryDescs();
     void CreatePipelineObjects();
+    // Created again when their shaders are reloaded
+    void CreatePathTracingPipelines();
 
-    void RenderRasterization(std::shared_ptr<CommandList> commandList, std::shared_ptr<Resource> backBuffer, const Camera& camera, std::shared_ptr<Scene> scene);
+    std::shared_ptr<CommandList> RenderRasterization(std::shared_ptr<CommandList> commandList, std::shared_ptr<Resource> backBuffer, const Camera& camera, std::shared_ptr<Scene> scene);
     void RenderPathTracing(std::shared_ptr<CommandList> commandList, std::shared_ptr<Resource> backBuffer, const Camera& camera, std::shared_ptr<Scene> scene);
 
 public:
@@ -84,5 +92,11 @@ public:
 
 	Renderer(std::shared_ptr<Device> device, AppBox& app, Camera& camera);
 	~Renderer();
+
+	// Starts compiling the shaders of the renderer and its pipeline before they are created, see PipelineRegistry
+	static void RequestShaders();
+
+	const TransientResourceAllocator& GetTransientResources() const { return *transientResources; }
+	const InstanceUpdater& GetInstanceUpdater() const { return *instanceUpdater; }
 	void UpdateCommandList(std::shared_ptr<CommandList> commandList, std::shared_ptr<Resource> backBuffer, const Camera& camera, std::shared_ptr<Scene> scene);
 };
@@ -0,0 +1,161 @@
+#include "RollingStatistics.hpp"
+#include <algorithm>
+
+P2Quantile::P2Quantile(double quantile) : quantile(quantile)
+{
+	Reset();
+}
+
+void P2Quantile::Reset()
+{
+	count = 0;
+	increments[0] = 0;
+	increments[1] = quantile / 2;
+	increments[2] = quantile;
+	increments[3] = (1 + quantile) / 2;
+	increments[4] = 1;
+}
+
+double P2Quantile::Parabolic(int i, double d) const
+{
+	return heights[i] + d / (positions[i + 1] - positions[i - 1]) * (
+		(positions[i] - positions[i - 1] + d) * (heights[i + 1] - heights[i]) / (positions[i + 1] - positions[i]) +
+		(positions[i + 1] - positions[i] - d) * (heights[i] - heights[i - 1]) / (positions[i] - positions[i - 1]));
+}
+
+double P2Quantile::Linear(int i, int d) const
+{
+	return heights[i] + d * (heights[i + d] - heights[i]) / (positions[i + d] - positions[i]);
+}
+
+void P2Quantile::AddSample(double value)
+{
+	// The first 5 samples initialize the markers
+	if (count < 5)
+	{
+		heights[count++] = value;
+		if (count == 5)
+		{
+			std::sort(heights, heights + 5);
+			for (int i = 0; i < 5; i++)
+				positions[i] = i;
+			desiredPositions[0] = 0;
+			desiredPositions[1] = 2 * quantile;
+			desiredPositions[2] = 4 * quantile;
+			desiredPositions[3] = 2 + 2 * quantile;
+			desiredPositions[4] = 4;
+		}
+		return;
+	}
+
+	// Find the cell containing the sample, extending the extreme markers if needed
+	int cell;
+	if (value < heights[0])
+	{
+		heights[0] = value;
+		cell = 0;
+	}
+	else if (value >= heights[4])
+	{
+		heights[4] = value;
+		cell = 3;
+	}
+	else
+	{
+		cell = 0;
+		while (value >= heights[cell + 1])
+			cell++;
+	}
+
+	for (int i = cell + 1; i < 5; i++)
+		positions[i]++;
+	for (int i = 0; i < 5; i++)
+		desiredPositions[i] += increments[i];
+
+	// Move the middle markers toward their desired position
+	for (int i = 1; i < 4; i++)
+	{
+		double d = desiredPositions[i] - positions[i];
+		if ((d >= 1 && positions[i + 1] - positions[i] > 1) || (d <= -1 && positions[i - 1] - positions[i] < -1))
+		{
+			int sign = d >= 0 ? 1 : -1;
+			double height = Parabolic(i, sign);
+			if (heights[i - 1] < height && height < heights[i + 1])
+				heights[i] = height;
+			else
+				heights[i] = Linear(i, sign);
+			positions[i] += sign;
+		}
+	}
+
+	count++;
+}
+
+double P2Quantile::GetValue() const
+{
+	if (count == 0)
+		return 0;
+
+	if (count < 5)
+	{
+		// Not enough samples for the markers, use the exact quantile
+		double sorted[5];
+		std::copy(heights, heights + count, sorted);
+		std::sort(sorted, sorted + count);
+		return sorted[std::min<size_t>((size_t)(quantile * count), count - 1)];
+	}
+
+	return heights[2];
+}
+
+RollingStatistics::RollingStatistics(size_t windowSize)
+{
+	window.resize(std::max<size_t>(1, windowSize));
+}
+
+void RollingStatistics::AddSample(double value)
+{
+	window[nextSample] = value;
+	nextSample = (nextSample + 1) % window.size();
+	windowCount = std::min(windowCount + 1, window.size());
+
+	min = sampleCount != 0 ? std::min(min, value) : value;
+	max = sampleCount != 0 ? std::max(max, value) : value;
+	sum += value;
+	sampleCount++;
+
+	p50.AddSample(value);
+	p95.AddSample(value);
+	p99.AddSample(value);
+}
+
+void RollingStatistics::Reset()
+{
+	nextSample = 0;
+	windowCount = 0;
+	sampleCount = 0;
+	sum = 0;
+	min = 0;
+	max = 0;
+	p50.Reset();
+	p95.Reset();
+	p99.Reset();
+}
+
+double RollingStatistics::GetWindowMean() const
+{
+	if (windowCount == 0)
+		return 0;
+
+	double windowSum = 0;
+	for (size_t i = 0; i < windowCount; i++)
+		windowSum += window[i];
+	return windowSum / windowCount;
+}
+
+double RollingStatistics::GetLatest() const
+{
+	if (windowCount == 0)
+		return 0;
+	return window[(nextSample + window.size() - 1) % window.size()];
+}
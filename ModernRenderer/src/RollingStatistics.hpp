@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Streaming estimation of a single quantile with the P-Square algorithm (Jain & Chlamtac 1985).
+// Uses 5 markers, so the memory and cost per sample is constant regardless of the number of samples.
+class P2Quantile
+{
+private:
+	double quantile;
+	uint64_t count = 0;
+	double heights[5] = {};
+	double positions[5] = {};
+	double desiredPositions[5] = {};
+	double increments[5] = {};
+
+	double Parabolic(int i, double d) const;
+	double Linear(int i, int d) const;
+
+public:
+	P2Quantile(double quantile);
+
+	void AddSample(double value);
+	double GetValue() const;
+	void Reset();
+};
+
+// Statistics of a value sampled every frame: mean, min, max and p50/p95/p99 estimated over all the samples since the
+// last reset, and the mean over a sliding window of the last samples for live display.
+class RollingStatistics
+{
+private:
+	std::vector<double> window;
+	size_t nextSample = 0;
+	size_t windowCount = 0;
+	uint64_t sampleCount = 0;
+	double sum = 0;
+	double min = 0;
+	double max = 0;
+	P2Quantile p50 = P2Quantile(0.50);
+	P2Quantile p95 = P2Quantile(0.95);
+	P2Quantile p99 = P2Quantile(0.99);
+
+public:
+	RollingStatistics(size_t windowSize = 256);
+
+	void AddSample(double value);
+	void Reset();
+
+	double GetMean() const { return sampleCount != 0 ? sum / sampleCount : 0; }
+	double GetMin() const { return min; }
+	double GetMax() const { return max; }
+	double GetWindowMean() const;
+	size_t GetWindowSize() const { return window.size(); }
+	double GetLatest() const;
+	double GetP50() const { return p50.GetValue(); }
+	double GetP95() const { return p95.GetValue(); }
+	double GetP99() const { return p99.GetValue(); }
+	uint64_t GetSampleCount() const { return sampleCount; }
+};
@@ -3,7 +3,15 @@
 #include "MeshPool.hpp"
 #include <Utilities/Common.h>
 #include "RenderUtils.hpp"
+#include "FrameContext.hpp"
 #include <CommandQueue/DXCommandQueue.h>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+#include "Json.hpp"
+#include "Timer.hpp"
+#include "RenderSettings.hpp"
+#include "VisibilityBuffer.hpp"
 
 std::shared_ptr<Resource> Scene::instanceDataBuffer;
 std::shared_ptr<View> Scene::instanceDataView;
@@ -18,6 +26,11 @@ std::vector<BindKey> Scene::bindKeys;
 BindKey Scene::accelerationStructureKey;
 BindingDesc Scene::accelerationStructureBinding;
 
+Scene::~Scene()
+{
+	MeshPool::RemoveRelocationListener(this);
+}
+
 void Scene::LoadSingleSphereScene(std::shared_ptr<Device> device, const Camera& camera)
 {
 	name = L"SingleSphere";
@@ -123,70 +136,287 @@ void Scene::LoadStanfordBunnyScene(std::shared_ptr<Device> device, const Camera&
 	instances.push_back(ModelInstance(importer.GetModel()));
 }
 
+const std::vector<std::pair<std::string, Scene::SceneLoader>> Scene::sceneLoaders =
+{
+	{ "RoughnessTest", &Scene::LoadRoughnessTestScene },
+	{ "SingleCube", &Scene::LoadSingleCubeScene },
+	{ "SingleSphere", &Scene::LoadSingleSphereScene },
+	{ "SinglePlane", &Scene::LoadSinglePlaneScene },
+	{ "MultiObjectSphere", &Scene::LoadMultiObjectSphereScene },
+	{ "StanfordBunny", &Scene::LoadStanfordBunnyScene },
+	{ "Chess", &Scene::LoadChessScene },
+	{ "TooMuchChess", &Scene::LoadTooMuchChessScene },
+	{ "Sponza", &Scene::LoadSponzaScene },
+};
+
+std::vector<std::string> Scene::GetSceneNames()
+{
+	std::vector<std::string> names;
+	for (const auto& loader : sceneLoaders)
+		names.push_back(loader.first);
+
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(sceneFileDirectory, error))
+		if (entry.path().extension() == ".json")
+			names.push_back(entry.path().stem().string());
+
+	return names;
+}
+
 std::shared_ptr<Scene> Scene::LoadHardcodedScene(std::shared_ptr<Device> device, Camera& camera)
+{
+	return LoadScene(device, camera, sceneLoaders[0].first);
+}
+
+std::shared_ptr<Scene> Scene::LoadScene(std::shared_ptr<Device> device, Camera& camera, const std::string& sceneName)
 {
 	std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+	double startTime = Timer::GetTimeInSeconds();
 
-	//scene->LoadSingleCubeScene(device, camera);
-	//scene->LoadSingleSphereScene(device, camera);
-	//scene->LoadSinglePlaneScene(device, camera);
-	scene->LoadRoughnessTestScene(device, camera);
-	//scene->LoadMultiObjectSphereScene(device, camera);
-	//scene->LoadStanfordBunnyScene(device, camera);
-	//scene->LoadChessScene(device, camera);
-	//scene->LoadTooMuchChessScene(device, camera);
-	//scene->LoadSponzaScene(device, camera);
+	// Either a path to a scene file, the name of a file in the scene directory or a hardcoded scene
+	std::string scenePath = sceneName;
+	if (std::filesystem::path(scenePath).extension() != ".json")
+		scenePath = sceneFileDirectory + sceneName + ".json";
 
+	auto loader = std::find_if(sceneLoaders.begin(), sceneLoaders.end(), [&](const auto& l) { return l.first == sceneName; });
+	if (loader != sceneLoaders.end())
+	{
+		(scene.get()->*loader->second)(device, camera);
+	}
+	else if (std::filesystem::exists(scenePath))
+	{
+		if (!scene->LoadSceneFile(scenePath, camera))
+			return nullptr;
+	}
+	else
+	{
+		printf("Unknown scene %s, available scenes:", sceneName.c_str());
+		for (const auto& name : GetSceneNames())
+			printf(" %s", name.c_str());
+		printf("\n");
+		return nullptr;
+	}
+
+	scene->buildStatistics.loadSeconds = Timer::GetTimeInSeconds() - startTime;
+	scene->Finalize(device, camera);
+
+	return scene;
+}
+
+std::shared_ptr<Scene> Scene::GenerateScene(std::shared_ptr<Device> device, Camera& camera, const SceneGenerator::Settings& settings)
+{
+	std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+
+	double startTime = Timer::GetTimeInSeconds();
+	SceneGenerator::Generate(*scene, camera, settings);
+	scene->buildStatistics.loadSeconds = Timer::GetTimeInSeconds() - startTime;
+
+	scene->Finalize(device, camera);
+
+	const BuildStatistics& stats = scene->buildStatistics;
+	printf("Generated %zu instances (seed %u): generation %.1f ms, mesh pool upload %.1f ms, RTAS build %.1f ms, instance upload %.1f ms, %.2f MB of instance data, %zu max visible meshlets (capacity %zu)\n",
+		stats.instanceCount, settings.seed, stats.loadSeconds * 1000.0, stats.meshPoolUploadSeconds * 1000.0, stats.rtasBuildSeconds * 1000.0,
+		stats.instanceUploadSeconds * 1000.0, stats.instanceUploadBytes / (1024.0 * 1024.0), stats.maxMeshletsVisible, stats.visibleMeshletsCapacity);
+
+	return scene;
+}
+
+void Scene::Finalize(std::shared_ptr<Device> device, Camera& camera)
+{
 	Texture::LoadAllMaterialTextures(device);
 	Material::AllocateMaterialBuffers(device);
-	scene->UploadInstancesToGPU(device);
+	UploadInstancesToGPU(device);
 
-	scene->sky.LoadHDRI(device, "assets/HDRIs/rogland_overcast_8k.hdr");
-	//scene->sky.LoadHDRI(device, "assets/HDRIs/lenong_2_8k.hdr");
-	//scene->sky.LoadHDRI(device, "assets/HDRIs/sunflowers_puresky_8k.hdr");
-	scene->sky.Initialize(device , &camera);
+	sky.LoadHDRI(device, hdriPath.c_str());
+	sky.Initialize(device , &camera);
+}
 
-	return scene;
+// Accepts either a single number applied to all the components or an array of 3 numbers
+static glm::vec3 ReadVec3(const JsonValue& object, const std::string& key, const glm::vec3& defaultValue)
+{
+	const JsonValue* value = object.Find(key);
+	if (value == nullptr)
+		return defaultValue;
+	if (value->IsNumber())
+		return glm::vec3((float)value->number);
+	if (value->IsArray() && value->array.size() == 3 && value->array[0].IsNumber() && value->array[1].IsNumber() && value->array[2].IsNumber())
+		return glm::vec3(value->array[0].number, value->array[1].number, value->array[2].number);
+
+	printf("Invalid vector %s in scene file\n", key.c_str());
+	return defaultValue;
+}
+
+static glm::vec2 ReadVec2(const JsonValue& object, const std::string& key, const glm::vec2& defaultValue)
+{
+	const JsonValue* value = object.Find(key);
+	if (value == nullptr)
+		return defaultValue;
+	if (value->IsArray() && value->array.size() == 2 && value->array[0].IsNumber() && value->array[1].IsNumber())
+		return glm::vec2(value->array[0].number, value->array[1].number);
+
+	printf("Invalid vector %s in scene file\n", key.c_str());
+	return defaultValue;
+}
+
+bool Scene::LoadSceneFile(const std::string& path, Camera& camera)
+{
+	JsonValue root;
+	if (!JsonValue::ParseFile(path, root))
+		return false;
+	if (!root.IsObject())
+	{
+		printf("Scene file %s must contain an object\n", path.c_str());
+		return false;
+	}
+
+	std::string sceneName = root.GetString("name", std::filesystem::path(path).stem().string());
+	name = std::wstring(sceneName.begin(), sceneName.end());
+	hdriPath = root.GetString("hdri", hdriPath);
+
+	if (const JsonValue* cameraValue = root.Find("camera"))
+	{
+		// Yaw and pitch in degrees
+		glm::vec2 rotation = glm::radians(ReadVec2(*cameraValue, "rotation", glm::degrees(camera.rotation)));
+		camera.SetPose(ReadVec3(*cameraValue, "position", camera.position), rotation);
+	}
+
+	// Models are imported once and shared by all their instances
+	std::unordered_map<std::string, Model> models;
+	if (const JsonValue* modelsValue = root.Find("models"))
+	{
+		for (const auto& [modelName, modelValue] : modelsValue->object)
+		{
+			std::string modelPath = modelValue.GetString("path", "");
+			if (modelPath.empty())
+			{
+				printf("Model %s has no path\n", modelName.c_str());
+				return false;
+			}
+			int flags = modelValue.GetBool("fastImport", true) ? aiProcessPreset_TargetRealtime_Fast : 0;
+			ModelImporter importer(modelPath, flags);
+			models[modelName] = importer.GetModel();
+		}
+	}
+
+	std::unordered_map<std::string, std::shared_ptr<Material>> materials;
+	if (const JsonValue* materialsValue = root.Find("materials"))
+	{
+		for (const auto& [materialName, materialValue] : materialsValue->object)
+		{
+			auto material = Material::CreateMaterial();
+			material->name = materialName;
+			material->baseColor = ReadVec3(materialValue, "baseColor", material->baseColor);
+			material->metalness = (float)materialValue.GetNumber("metalness", material->metalness);
+			material->roughness = (float)materialValue.GetNumber("roughness", material->roughness);
+			materials[materialName] = material;
+		}
+	}
+
+	const JsonValue* instancesValue = root.Find("instances");
+	if (instancesValue == nullptr || !instancesValue->IsArray())
+	{
+		printf("Scene file %s has no instances array\n", path.c_str());
+		return false;
+	}
+
+	for (const auto& instanceValue : instancesValue->array)
+	{
+		std::string modelName = instanceValue.GetString("model", "");
+		auto model = models.find(modelName);
+		if (model == models.end())
+		{
+			printf("Unknown model \"%s\" in scene file %s\n", modelName.c_str(), path.c_str());
+			return false;
+		}
+
+		// The material override replaces the material of every part of the model
+		Model instanceModel = model->second;
+		if (const JsonValue* materialValue = instanceValue.Find("material"))
+		{
+			auto material = materialValue->IsString() ? materials.find(materialValue->string) : materials.end();
+			if (material == materials.end())
+			{
+				printf("Unknown material \"%s\" in scene file %s\n", materialValue->string.c_str(), path.c_str());
+				return false;
+			}
+			for (auto& part : instanceModel.parts)
+				part.material = material->second;
+		}
+
+		glm::vec3 position = ReadVec3(instanceValue, "position", glm::vec3(0));
+		glm::mat4 rotationScale = MatrixUtils::Rotation(ReadVec3(instanceValue, "rotation", glm::vec3(0))) * MatrixUtils::Scale(ReadVec3(instanceValue, "scale", glm::vec3(1)));
+
+		// Optional array generator, repeats the instance on a 3D grid starting at position
+		glm::ivec3 count = glm::ivec3(1);
+		glm::vec3 spacing = glm::vec3(0);
+		if (const JsonValue* arrayValue = instanceValue.Find("array"))
+		{
+			count = glm::max(glm::ivec3(ReadVec3(*arrayValue, "count", glm::vec3(1))), glm::ivec3(1));
+			spacing = ReadVec3(*arrayValue, "spacing", glm::vec3(1));
+		}
+
+		instances.reserve(instances.size() + (size_t)count.x * count.y * count.z);
+		for (int z = 0; z < count.z; z++)
+			for (int y = 0; y < count.y; y++)
+				for (int x = 0; x < count.x; x++)
+				{
+					glm::vec3 offset = position + glm::vec3(x, y, z) * spacing;
+					instances.push_back(ModelInstance(instanceModel, transpose(MatrixUtils::Translation(offset) * rotationScale)));
+				}
+	}
+
+	printf("Loaded scene %s: %zu instances\n", sceneName.c_str(), instances.size());
+	return true;
 }
 
 void Scene::UploadInstancesToGPU(std::shared_ptr<Device> device)
 {
 	// Allocate and upload the mesh pool to the GPU
+	double startTime = Timer::GetTimeInSeconds();
 	MeshPool::AllocateMeshPoolBuffers(device);
+	double meshPoolTime = Timer::GetTimeInSeconds();
 
 	BuildRTAS(device);
+	double rtasTime = Timer::GetTimeInSeconds();
 
 	// Prepate and upload instance data
-	std::vector<RTInstanceData> rtInstanceData;
+	rtInstanceData.clear();
 	size_t maxMeshletsVisible = 0;
 	int index = 0;
+	instanceStore.Clear();
 	for (auto& instance : instances)
 	{
+		// Parts of an instance are consecutive, the offset is the one of the first part
+		instance.instanceDataOffset = index;
 		for (auto& p : instance.model.parts)
 		{
-			InstanceData data;
-			data.objectToWorld = instance.transform;
-			data.meshletIndex = p.mesh->meshletOffset;
-			data.materialIndex = p.material->materialIndex;
-			data.meshletCount = p.mesh->meshletCount;
-			data.obb = OBB(p.mesh->aabb, instance.transform);
-			instanceData.push_back(data);
+			instanceStore.Add(instance.transform, p.mesh->aabb, p.mesh->meshletOffset, p.mesh->meshletCount, p.material->materialIndex);
 
 			RTInstanceData rtData;
 			rtData.indexBufferOffset = p.mesh->raytracedPrimitiveIndex;
 			rtData.materialIndex = p.material->materialIndex;
 			rtInstanceData.push_back(rtData);
 
-			instance.instanceDataOffset = index++;
+			index++;
 			maxMeshletsVisible += p.mesh->meshletCount;
 		}
 	}
 
+	// The bounds are computed for all the instances at once and packed in the GPU layout only for the upload
+	instanceStore.ComputeBounds(0, instanceStore.GetCount());
+	std::vector<InstanceData> instanceData = instanceStore.Pack();
+
+	RenderUtils::InvalidateBindingSets(bindingDescs);
+
 	size_t instanceDataSize = sizeof(InstanceData) * instanceData.size();
-	instanceDataBuffer = device->CreateBuffer(BindFlag::kShaderResource | BindFlag::kCopyDest, instanceDataSize);
-	instanceDataBuffer->CommitMemory(MemoryType::kUpload);
-	instanceDataBuffer->UpdateUploadBuffer(0, instanceData.data(), instanceDataSize);
+	// In the default heap so that moved instances are written on the GPU timeline, see InstanceUpdater
+	instanceDataBuffer = device->CreateBuffer(BindFlag::kShaderResource | BindFlag::kUnorderedAccess | BindFlag::kCopyDest, instanceDataSize);
+	instanceDataBuffer->CommitMemory(MemoryType::kDefault);
 	instanceDataBuffer->SetName("Instance Data");
+	RenderUtils::UploadBufferData(device, instanceDataBuffer, instanceData.data(), instanceDataSize);
+
+	instanceDirtyBits.assign((instanceData.size() + 63) / 64, 0);
+	dirtyInstanceCount = 0;
 
 	ViewDesc viewDesc = {};
 	viewDesc.view_type = ViewType::kStructuredBuffer;
@@ -196,17 +426,33 @@ void Scene::UploadInstancesToGPU(std::shared_ptr<Device> device)
 	instanceDataView = device->CreateView(instanceDataBuffer, viewDesc);
 
 	size_t rtInstanceDataSize = sizeof(RTInstanceData) * rtInstanceData.size();
+	// In the default heap so that the offsets of relocated meshes are written on the GPU timeline, see RelocateMeshes
 	rtInstanceDataBuffer = device->CreateBuffer(BindFlag::kShaderResource | BindFlag::kCopyDest, rtInstanceDataSize);
-	rtInstanceDataBuffer->CommitMemory(MemoryType::kUpload);
-	rtInstanceDataBuffer->UpdateUploadBuffer(0, rtInstanceData.data(), rtInstanceDataSize);
+	rtInstanceDataBuffer->CommitMemory(MemoryType::kDefault);
 	rtInstanceDataBuffer->SetName("RT Instance Data");
+	RenderUtils::UploadBufferData(device, rtInstanceDataBuffer, rtInstanceData.data(), rtInstanceDataSize);
 
 	viewDesc.buffer_size = rtInstanceDataSize;
 	viewDesc.structure_stride = sizeof(RTInstanceData);
 	rtInstanceDataView = device->CreateView(rtInstanceDataBuffer, viewDesc);
 
+	// The R32 visibility buffer only addresses 2^25 visible meshlets, the 64 bit encoding stores the full index. The
+	// renderer is created after the scene and picks the format from the settings.
+	if (!RenderSettings::visibilityBuffer64Bit && maxMeshletsVisible > (size_t)VisibilityBuffer::meshletMask + 1)
+	{
+		printf("Scene: up to %zu visible meshlets, more than the %u of the R32 visibility buffer, switching to --visibility-64\n",
+			maxMeshletsVisible, VisibilityBuffer::meshletMask + 1);
+		RenderSettings::visibilityBuffer64Bit = true;
+	}
+
+	// The culling lists can't exceed the largest D3D12 resource, the culling shaders drop the meshlets past the capacity
+	size_t visibleMeshletsCapacity = std::min<size_t>(std::max<size_t>(maxMeshletsVisible, 1), maxVisibleMeshletsBufferSize / (sizeof(int) * 2));
+	if (visibleMeshletsCapacity < maxMeshletsVisible)
+		printf("Scene: up to %zu visible meshlets, the culling lists are limited to %zu (%llu MB per buffer), the meshlets past it aren't drawn\n",
+			maxMeshletsVisible, visibleMeshletsCapacity, (unsigned long long)(maxVisibleMeshletsBufferSize >> 20));
+
 	// Create 2 meshlet buffers for the culling results that have 2 passes
-	size_t visibleMeshletsSize = sizeof(int) * 2 * maxMeshletsVisible;
+	size_t visibleMeshletsSize = sizeof(int) * 2 * visibleMeshletsCapacity;
 	visibleMeshletsBuffer0 = device->CreateBuffer(BindFlag::kShaderResource | BindFlag::kUnorderedAccess, visibleMeshletsSize);
 	visibleMeshletsBuffer0->CommitMemory(MemoryType::kDefault);
 	visibleMeshletsBuffer0->SetName("Visible Meshlets 0");
@@ -240,6 +486,111 @@ void Scene::UploadInstancesToGPU(std::shared_ptr<Device> device)
 		visibleMeshletsBindKey0,
 		visibleMeshletsBindKey1,
 	};
+
+	buildStatistics.meshPoolUploadSeconds = meshPoolTime - startTime;
+	buildStatistics.rtasBuildSeconds = rtasTime - meshPoolTime;
+	buildStatistics.instanceUploadSeconds = Timer::GetTimeInSeconds() - rtasTime;
+	buildStatistics.instanceCount = instanceData.size();
+	buildStatistics.instanceUploadBytes = instanceDataSize + rtInstanceDataSize;
+	buildStatistics.maxMeshletsVisible = maxMeshletsVisible;
+	buildStatistics.visibleMeshletsCapacity = visibleMeshletsCapacity;
+
+	// The meshes move when the MeshPool heaps are compacted
+	MeshPool::RemoveRelocationListener(this);
+	MeshPool::AddRelocationListener(this, [this](std::shared_ptr<CommandList> cmd, const std::unordered_set<Mesh*>& meshes) { RelocateMeshes(cmd, meshes); });
+}
+
+void Scene::SetInstanceTransform(size_t instanceIndex, const glm::mat4& transform)
+{
+	ModelInstance& instance = instances[instanceIndex];
+	instance.transform = transform;
+
+	unsigned dataIndex = instance.instanceDataOffset;
+	for (size_t part = 0; part < instance.model.parts.size(); part++)
+	{
+		instanceStore.SetTransform(dataIndex, transform);
+		rtGeometryInstances[dataIndex].transform = glm::mat3x4(transform);
+		MarkInstanceDataDirty(dataIndex++);
+	}
+	rtInstancesDirty = true;
+
+	// The TLAS isn't updated in rasterization mode, the count stops once a rebuild is due instead of growing until
+	// the next path traced frame
+	if (!tlasRebuildNeeded)
+	{
+		tlasUpdatedInstances += instance.model.parts.size();
+		tlasRebuildNeeded = tlasUpdatedInstances >= tlasRebuildUpdateRatio * rtGeometryInstances.size();
+	}
+}
+
+void Scene::RelocateMeshes(std::shared_ptr<CommandList> cmd, const std::unordered_set<Mesh*>& meshes)
+{
+	// The instance data is uploaded by InstanceUpdater later in the frame
+	bool rtInstancesChanged = false;
+	for (const auto& instance : instances)
+	{
+		unsigned dataIndex = instance.instanceDataOffset;
+		for (const auto& p : instance.model.parts)
+		{
+			if (meshes.count(p.mesh.get()) != 0)
+			{
+				instanceStore.SetMeshletIndex(dataIndex, p.mesh->meshletOffset);
+				MarkInstanceDataDirty(dataIndex);
+				rtInstanceData[dataIndex].indexBufferOffset = p.mesh->raytracedPrimitiveIndex;
+				rtInstancesChanged = true;
+			}
+			dataIndex++;
+		}
+	}
+
+	if (!rtInstancesChanged)
+		return;
+
+	uint64_t size = sizeof(RTInstanceData) * rtInstanceData.size();
+	auto upload = FrameContext::Upload(rtInstanceData.data(), size);
+	cmd->ResourceBarrier({ { rtInstanceDataBuffer, ResourceState::kCommon, ResourceState::kCopyDest } });
+	cmd->CopyBuffer(upload.buffer, rtInstanceDataBuffer, { { upload.offset, 0, size } });
+	cmd->ResourceBarrier({ { rtInstanceDataBuffer, ResourceState::kCopyDest, ResourceState::kCommon } });
+}
+
+void Scene::MarkInstanceDataDirty(unsigned instanceDataIndex)
+{
+	uint64_t& word = instanceDirtyBits[instanceDataIndex / 64];
+	uint64_t bit = 1ull << (instanceDataIndex % 64);
+	if ((word & bit) == 0)
+	{
+		word |= bit;
+		dirtyInstanceCount++;
+	}
+}
+
+void Scene::ConsumeDirtyInstanceRanges(std::vector<InstanceRange>& ranges)
+{
+	if (dirtyInstanceCount == 0)
+		return;
+
+	// Clean words are skipped with a single test, runs of dirty bits are found with bit scans
+	for (size_t wordIndex = 0; wordIndex < instanceDirtyBits.size(); wordIndex++)
+	{
+		uint64_t bits = instanceDirtyBits[wordIndex];
+		instanceDirtyBits[wordIndex] = 0;
+
+		while (bits != 0)
+		{
+			unsigned bitIndex = (unsigned)_tzcnt_u64(bits);
+			// Number of consecutive set bits from bitIndex, 64 when all the bits of the word are set
+			unsigned length = (unsigned)_tzcnt_u64(~(bits >> bitIndex));
+			bits = length == 64 ? 0 : bits & ~(((1ull << length) - 1) << bitIndex);
+
+			unsigned first = (unsigned)(wordIndex * 64) + bitIndex;
+			if (!ranges.empty() && ranges.back().first + ranges.back().count == first)
+				ranges.back().count += length;
+			else
+				ranges.push_back({ first, length });
+		}
+	}
+
+	dirtyInstanceCount = 0;
 }
 
 void Scene::BuildRTAS(std::shared_ptr<Device> device)
@@ -271,13 +622,14 @@ void Scene::BuildRTAS(std::shared_ptr<Device> device)
 		for (auto& p : instance.model.parts)
 			instanceCount++;
 
-    auto tlasPrebuildInfo = device->GetTLASPrebuildInfo(instanceCount, BuildAccelerationStructureFlags::kNone);
+    // Animated instances refit the TLAS in place, see UpdateTLAS
+    auto tlasPrebuildInfo = device->GetTLASPrebuildInfo(instanceCount, BuildAccelerationStructureFlags::kAllowUpdate);
 	uint64_t tlasSize = Align(tlasPrebuildInfo.acceleration_structure_size, kAccelerationStructureAlignment);
 	tlasBuffer = device->CreateBuffer(BindFlag::kAccelerationStructure, tlasSize);
 	tlasBuffer->CommitMemory(MemoryType::kDefault);
 	tlasBuffer->SetName("Top Level Acceleration Structures");
 
-	scratchSize = std::max(scratchSize, tlasPrebuildInfo.build_scratch_data_size);
+	scratchSize = std::max({ scratchSize, tlasPrebuildInfo.build_scratch_data_size, tlasPrebuildInfo.update_scratch_data_size });
 	scratch = device->CreateBuffer(BindFlag::kRayTracing, scratchSize);
 	scratch->CommitMemory(MemoryType::kDefault);
 	scratch->SetName("scratch");
@@ -313,7 +665,7 @@ void Scene::BuildRTAS(std::shared_ptr<Device> device)
 	rtGeomInstanceDataBuffer->CommitMemory(MemoryType::kUpload);
 	rtGeomInstanceDataBuffer->SetName("Instance Data");
 	rtGeomInstanceDataBuffer->UpdateUploadBuffer(0, rtInstances.data(), rtInstances.size() * sizeof(RaytracingGeometryInstance));
-    cmd->BuildTopLevelAS({}, tlas, scratch, 0, rtGeomInstanceDataBuffer, 0, rtInstances.size(), BuildAccelerationStructureFlags::kNone);
+    cmd->BuildTopLevelAS({}, tlas, scratch, 0, rtGeomInstanceDataBuffer, 0, rtInstances.size(), BuildAccelerationStructureFlags::kAllowUpdate);
     cmd->UAVResourceBarrier(tlas);
 
     cmd->Close();
@@ -329,4 +681,40 @@ void Scene::BuildRTAS(std::shared_ptr<Device> device)
 
 	accelerationStructureKey = BindKey{ ShaderType::kLibrary, ViewType::kAccelerationStructure, 1, 0 };
 	accelerationStructureBinding = BindingDesc{ accelerationStructureKey, tlasView };
+
+	rtGeometryInstances = std::move(rtInstances);
+	rtInstancesDirty = false;
+	tlasRebuildNeeded = false;
+	tlasUpdatedInstances = 0;
+}
+
+bool Scene::UpdateTLAS(std::shared_ptr<CommandList> cmd)
+{
+	if (!rtInstancesDirty || !tlas)
+		return false;
+
+	// The arena of the frame keeps the instance descs alive until the GPU is done with the build
+	uint64_t size = sizeof(RaytracingGeometryInstance) * rtGeometryInstances.size();
+	auto upload = FrameContext::Upload(rtGeometryInstances.data(), size);
+
+	bool rebuild = tlasRebuildNeeded;
+	// Builds with a source acceleration structure are refits, done in place. The scratch buffer is shared with the
+	// previous frames, which is safe since they were submitted to the same queue.
+	std::shared_ptr<Resource> source = rebuild ? nullptr : tlas;
+	cmd->BuildTopLevelAS(source, tlas, scratch, 0, upload.buffer, upload.offset, rtGeometryInstances.size(), BuildAccelerationStructureFlags::kAllowUpdate);
+	cmd->UAVResourceBarrier(tlas);
+
+	if (rebuild)
+	{
+		tlasStatistics.rebuildCount++;
+		tlasUpdatedInstances = 0;
+		tlasRebuildNeeded = false;
+	}
+	else
+	{
+		tlasStatistics.refitCount++;
+	}
+
+	rtInstancesDirty = false;
+	return true;
 }
\ No newline at end of file
@@ -2,11 +2,14 @@
 
 #include <vector>
 #include <string>
+#include <unordered_set>
 
 #include "Camera.hpp"
 #include "Model.hpp"
 #include "Sky.hpp"
 #include "BoundingVolumes.hpp"
+#include "InstanceStore.hpp"
+#include "SceneGenerator.hpp"
 
 class ModelInstance
 {
@@ -36,15 +39,24 @@ private:
 	void LoadChessScene(std::shared_ptr<Device> device, const Camera& camera);
 	void LoadTooMuchChessScene(std::shared_ptr<Device> device, const Camera& camera);
 	void LoadStanfordBunnyScene(std::shared_ptr<Device> device, const Camera& camera);
+
+	// Scenes that can be selected by name, the first one is loaded by default
+	using SceneLoader = void (Scene::*)(std::shared_ptr<Device>, const Camera&);
+	static const std::vector<std::pair<std::string, SceneLoader>> sceneLoaders;
 	
+	// Parses a JSON scene file, see assets/scenes for examples
+	bool LoadSceneFile(const std::string& path, Camera& camera);
+
 	void UploadInstancesToGPU(std::shared_ptr<Device> device);
+	// Uploads everything to the GPU once the instances are loaded
+	void Finalize(std::shared_ptr<Device> device, Camera& camera);
 
 	void BuildRTAS(std::shared_ptr<Device> device);
 
 public:
 
 	Scene() = default;
-	~Scene() = default;
+	~Scene();
 
 	static std::shared_ptr<Resource> instanceDataBuffer;
 	static std::shared_ptr<View> instanceDataView;
@@ -57,6 +69,9 @@ public:
 
 	static std::shared_ptr<Resource> visibleMeshletsBuffer1;
 	static std::shared_ptr<View> visibleMeshletsView1;
+	// D3D12_REQ_RESOURCE_SIZE_IN_MEGABYTES_EXPRESSION_C_TERM, the largest resource size with at least 8 GB of video
+	// memory (a quarter of the memory below that)
+	static constexpr uint64_t maxVisibleMeshletsBufferSize = 2048ull << 20;
 
 	static std::vector<BindingDesc> bindingDescs;
 	static std::vector<BindKey> bindKeys;
@@ -64,15 +79,8 @@ public:
 	static BindKey accelerationStructureKey;
 	static BindingDesc accelerationStructureBinding;
 
-	// Keep in sync with InstanceData in common.hlsl
-	struct InstanceData
-	{
-		glm::mat4x4 objectToWorld;
-		unsigned meshletIndex;
-		unsigned materialIndex;
-		unsigned meshletCount;
-		OBB obb;
-	};
+	// GPU layout of the instances, the CPU copy is stored in instanceStore
+	using InstanceData = GPUInstanceData;
 
 	struct RTInstanceData
 	{
@@ -80,8 +88,20 @@ public:
 		unsigned materialIndex;
 	};
 
+	// Consecutive InstanceData to upload
+	struct InstanceRange
+	{
+		unsigned first;
+		unsigned count;
+	};
+
 	std::vector<ModelInstance> instances;
-	std::vector<InstanceData> instanceData;
+	InstanceStore instanceStore;
+	// CPU copy of rtInstanceDataBuffer, in the order of instanceStore
+	std::vector<RTInstanceData> rtInstanceData;
+	// One bit per instance of instanceStore, set when the CPU copy changed since the last upload, see InstanceUpdater
+	std::vector<uint64_t> instanceDirtyBits;
+	unsigned dirtyInstanceCount = 0;
 	std::wstring name;
 	std::shared_ptr<View> tlasView;
 	std::shared_ptr<Resource> tlas;
@@ -90,7 +110,61 @@ public:
 	std::shared_ptr<Resource> rtGeomInstanceDataBuffer;
 	std::shared_ptr<Resource> scratch;
 
+	// TLAS of animated scenes: a refit keeps the tree built for the previous transforms and only updates its bounds,
+	// the tree quality decreases as the instances move. The distance moved isn't measured, every transform set on a
+	// geometry instance counts as one update and the TLAS is rebuilt once the updates since the last build add up to
+	// tlasRebuildUpdateRatio times the instance count.
+	static constexpr float tlasRebuildUpdateRatio = 4.0f;
+
+	struct TLASStatistics
+	{
+		unsigned refitCount = 0;
+		unsigned rebuildCount = 0;
+	};
+
+	// Instance descs of the TLAS, in the order of instanceStore
+	std::vector<RaytracingGeometryInstance> rtGeometryInstances;
+	bool rtInstancesDirty = false;
+	// Set when a refit isn't possible, e.g. when the instance count changes, or once the updates reach the ratio
+	bool tlasRebuildNeeded = false;
+	uint64_t tlasUpdatedInstances = 0;
+	TLASStatistics tlasStatistics;
+
+	// Sizes and timings of the scene build, reported by the benchmark
+	struct BuildStatistics
+	{
+		double loadSeconds = 0; // Import or generation of the instances
+		double meshPoolUploadSeconds = 0;
+		double rtasBuildSeconds = 0;
+		double instanceUploadSeconds = 0;
+		size_t instanceCount = 0; // Number of model parts, each one is a GPU instance
+		size_t instanceUploadBytes = 0;
+		size_t maxMeshletsVisible = 0;
+		// Size of the culling lists, lower than maxMeshletsVisible when they would exceed maxVisibleMeshletsBufferSize
+		size_t visibleMeshletsCapacity = 0;
+	};
+
 	Sky sky;
+	BuildStatistics buildStatistics;
+	std::string hdriPath = "assets/HDRIs/rogland_overcast_8k.hdr";
+
+	static inline const std::string sceneFileDirectory = "assets/scenes/";
 
 	static std::shared_ptr<Scene> LoadHardcodedScene(std::shared_ptr<Device> device, Camera& camera);
+	// Loads one of the scenes listed by GetSceneNames or a scene file path, returns nullptr on failure
+	static std::shared_ptr<Scene> LoadScene(std::shared_ptr<Device> device, Camera& camera, const std::string& sceneName);
+	static std::vector<std::string> GetSceneNames();
+	static std::shared_ptr<Scene> GenerateScene(std::shared_ptr<Device> device, Camera& camera, const SceneGenerator::Settings& settings);
+
+	// Moves an instance once the scene is uploaded, the OBBs of its parts are computed again when they are uploaded
+	// at the start of the next frame
+	void SetInstanceTransform(size_t instanceIndex, const glm::mat4& transform);
+	void MarkInstanceDataDirty(unsigned instanceDataIndex);
+	// Updates the references of the instances to meshes moved in the MeshPool heaps, see MeshPool::RelocationCallback
+	void RelocateMeshes(std::shared_ptr<CommandList> cmd, const std::unordered_set<Mesh*>& meshes);
+	// Appends the ranges of dirty InstanceData in increasing order and clears the dirty bits
+	void ConsumeDirtyInstanceRanges(std::vector<InstanceRange>& ranges);
+	// Records the refit or the rebuild of the TLAS if instances moved, returns true if the TLAS changed.
+	// The instance descs are read from the frame upload arena, nothing waits for the GPU.
+	bool UpdateTLAS(std::shared_ptr<CommandList> cmd);
 };
\ No newline at end of file
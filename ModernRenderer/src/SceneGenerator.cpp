@@ -0,0 +1,212 @@
+#include "SceneGenerator.hpp"
+#include "Scene.hpp"
+#include "ModelImporter.hpp"
+#include "MatrixUtils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <glm/gtc/constants.hpp>
+
+// Models used by the generator, ordered from the cheapest to the most detailed
+static const char* generatorModelPaths[] =
+{
+	"assets/models/Cube.fbx",
+	"assets/models/sphere.fbx",
+	"assets/models/stanford-bunny.obj",
+	"assets/models/teapot.fbx",
+	"assets/models/DragonStatue.glb",
+};
+
+// Distance between instances, each model is scaled to fit in a unit cube
+static constexpr float instanceSpacing = 2.0f;
+static constexpr unsigned clusterSize = 2000;
+static constexpr unsigned cityBlockLots = 8;
+static constexpr unsigned cityStreetLots = 2;
+static constexpr unsigned cityMaxTowerHeight = 16;
+
+// SplitMix64, unlike the std distributions the sequence is the same with every compiler
+class GeneratorRandom
+{
+private:
+	uint64_t state;
+
+public:
+	GeneratorRandom(uint64_t seed) : state(seed) {}
+
+	uint64_t Next()
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// Uniform in [0, 1)
+	float NextFloat() { return (Next() >> 40) * (1.0f / (1 << 24)); }
+	float NextRange(float min, float max) { return min + (max - min) * NextFloat(); }
+	unsigned NextIndex(unsigned count) { return (unsigned)(Next() % count); }
+	// Approximation of a normal distribution with a standard deviation of 0.5
+	float NextGaussian() { return NextFloat() + NextFloat() + NextFloat() - 1.5f; }
+};
+
+bool SceneGenerator::ParseArgs(int argc, char* argv[], Settings& settings)
+{
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		std::string arg = argv[i];
+		std::string value = argv[i + 1];
+
+		if (arg == "--generate")
+		{
+			settings.enabled = true;
+			if (value == "uniform")
+				settings.distribution = Distribution::Uniform;
+			else if (value == "clustered")
+				settings.distribution = Distribution::Clustered;
+			else if (value == "citygrid")
+				settings.distribution = Distribution::CityGrid;
+			else
+				printf("Unknown scene distribution %s, expected uniform, clustered or citygrid\n", value.c_str());
+		}
+		else if (arg == "--instances")
+			settings.instanceCount = std::max(1, std::atoi(value.c_str()));
+		else if (arg == "--unique-meshes")
+			settings.uniqueMeshCount = std::max(1, std::atoi(value.c_str()));
+		else if (arg == "--materials")
+			settings.materialCount = std::max(1, std::atoi(value.c_str()));
+		else if (arg == "--seed")
+			settings.seed = (uint32_t)std::strtoul(value.c_str(), nullptr, 10);
+	}
+
+	return settings.enabled;
+}
+
+const char* SceneGenerator::GetDistributionName(Distribution distribution)
+{
+	switch (distribution)
+	{
+		case Distribution::Uniform: return "Uniform";
+		case Distribution::Clustered: return "Clustered";
+		case Distribution::CityGrid: return "CityGrid";
+	}
+	return "Unknown";
+}
+
+// Scale that fits all the parts of the model in a unit cube
+static float GetUnitScale(const Model& model)
+{
+	glm::vec3 min = glm::vec3(FLT_MAX);
+	glm::vec3 max = glm::vec3(-FLT_MAX);
+	for (const auto& part : model.parts)
+	{
+		min = glm::min(min, part.mesh->aabb.min);
+		max = glm::max(max, part.mesh->aabb.max);
+	}
+	glm::vec3 size = max - min;
+	float largest = std::max(size.x, std::max(size.y, size.z));
+	return largest > 0 ? 1.0f / largest : 1.0f;
+}
+
+void SceneGenerator::Generate(Scene& scene, Camera& camera, const Settings& settings)
+{
+	std::string name = std::string("Generated ") + GetDistributionName(settings.distribution) + " " + std::to_string(settings.instanceCount);
+	scene.name = std::wstring(name.begin(), name.end());
+
+	unsigned meshCount = std::min(settings.uniqueMeshCount, (unsigned)std::size(generatorModelPaths));
+	if (meshCount < settings.uniqueMeshCount)
+		printf("Scene generator: only %u unique meshes are available\n", meshCount);
+
+	GeneratorRandom random(settings.seed);
+
+	std::vector<std::shared_ptr<Material>> materials;
+	for (unsigned i = 0; i < settings.materialCount; i++)
+	{
+		auto material = Material::CreateMaterial();
+		material->name = "Generated " + std::to_string(i);
+		material->baseColor = glm::vec3(random.NextFloat(), random.NextFloat(), random.NextFloat());
+		material->metalness = random.NextFloat() < 0.3f ? 1.0f : 0.0f;
+		material->roughness = random.NextRange(0.05f, 1.0f);
+		materials.push_back(material);
+	}
+
+	// One model per mesh and material pair so that the instances only copy a model
+	std::vector<Model> variants;
+	std::vector<float> variantScales;
+	for (unsigned m = 0; m < meshCount; m++)
+	{
+		ModelImporter importer(generatorModelPaths[m], aiProcessPreset_TargetRealtime_Fast);
+		float scale = GetUnitScale(importer.GetModel());
+		for (const auto& material : materials)
+		{
+			Model variant = importer.GetModel();
+			for (auto& part : variant.parts)
+				part.material = material;
+			variants.push_back(variant);
+			variantScales.push_back(scale);
+		}
+	}
+
+	auto addInstance = [&](const glm::vec3& position, float yaw, float scale)
+	{
+		unsigned variant = random.NextIndex((unsigned)variants.size());
+		glm::mat4 transform = MatrixUtils::Translation(position) * MatrixUtils::RotateY(yaw) * MatrixUtils::Scale(glm::vec3(scale * variantScales[variant]));
+		scene.instances.push_back(ModelInstance(variants[variant], transpose(transform)));
+	};
+
+	unsigned count = settings.instanceCount;
+	scene.instances.reserve(count);
+	float side = instanceSpacing * std::sqrt((float)count);
+
+	switch (settings.distribution)
+	{
+		case Distribution::Uniform:
+		{
+			for (unsigned i = 0; i < count; i++)
+			{
+				glm::vec3 position = glm::vec3(random.NextFloat() * side, 0, random.NextFloat() * side);
+				addInstance(position, random.NextRange(0, glm::two_pi<float>()), random.NextRange(0.5f, 1.5f));
+			}
+			break;
+		}
+		case Distribution::Clustered:
+		{
+			// Clusters are spread over twice the area of the uniform distribution, leaving empty space between them
+			unsigned clusterCount = std::max(1u, count / clusterSize);
+			float clusterRadius = instanceSpacing * std::sqrt((float)count / clusterCount);
+			std::vector<glm::vec3> centers;
+			for (unsigned c = 0; c < clusterCount; c++)
+				centers.push_back(glm::vec3(random.NextFloat() * side * 2, 0, random.NextFloat() * side * 2));
+
+			for (unsigned i = 0; i < count; i++)
+			{
+				const glm::vec3& center = centers[i % clusterCount];
+				glm::vec3 offset = glm::vec3(random.NextGaussian(), std::abs(random.NextGaussian()) * 0.25f, random.NextGaussian()) * clusterRadius;
+				addInstance(center + offset, random.NextRange(0, glm::two_pi<float>()), random.NextRange(0.5f, 1.5f));
+			}
+			break;
+		}
+		case Distribution::CityGrid:
+		{
+			// Enough lots for towers of average height, blocks of lots are separated by streets
+			unsigned averageHeight = (cityMaxTowerHeight + 1) / 2;
+			unsigned lotsPerSide = std::max(1u, (unsigned)std::ceil(std::sqrt((float)count / averageHeight)));
+			unsigned emitted = 0;
+			for (unsigned lot = 0; emitted < count; lot++)
+			{
+				unsigned x = lot % lotsPerSide;
+				unsigned z = lot / lotsPerSide;
+				glm::vec3 lotPosition = glm::vec3(x + (x / cityBlockLots) * cityStreetLots, 0, z + (z / cityBlockLots) * cityStreetLots) * instanceSpacing;
+
+				unsigned height = 1 + random.NextIndex(cityMaxTowerHeight);
+				float yaw = random.NextIndex(4) * glm::half_pi<float>();
+				for (unsigned level = 0; level < height && emitted < count; level++, emitted++)
+					addInstance(lotPosition + glm::vec3(0, level * instanceSpacing * 0.5f, 0), yaw, 1.0f);
+			}
+			side = lotsPerSide * instanceSpacing * (1.0f + (float)cityStreetLots / cityBlockLots);
+			break;
+		}
+	}
+
+	// Look at the scene from one of its corners
+	camera.SetPose(glm::vec3(-side * 0.1f, side * 0.15f, -side * 0.1f), glm::vec2(glm::radians(45.0f), glm::radians(25.0f)));
+}
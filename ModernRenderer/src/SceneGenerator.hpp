@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+class Scene;
+class Camera;
+
+// Builds stress scenes with a configurable number of instances from the models of the assets folder,
+// to measure how culling, TLAS builds and uploads scale with the scene size.
+// Usage: --generate <uniform|clustered|citygrid> [--instances <count>] [--unique-meshes <count>] [--materials <count>] [--seed <value>]
+class SceneGenerator
+{
+public:
+	enum class Distribution
+	{
+		// Instances scattered on a square with a constant density
+		Uniform,
+		// Dense groups of about 2000 instances far apart from each other
+		Clustered,
+		// Towers of stacked instances on the lots of a street grid
+		CityGrid,
+	};
+
+	struct Settings
+	{
+		bool enabled = false;
+		Distribution distribution = Distribution::Uniform;
+		unsigned instanceCount = 1000;
+		unsigned uniqueMeshCount = 5;
+		unsigned materialCount = 16;
+		uint32_t seed = 1;
+	};
+
+	// Returns true if --generate is in the arguments, unknown arguments are ignored
+	static bool ParseArgs(int argc, char* argv[], Settings& settings);
+	static const char* GetDistributionName(Distribution distribution);
+
+	// Fills the instances of the scene and places the camera, the result only depends on the settings
+	static void Generate(Scene& scene, Camera& camera, const Settings& settings);
+};
@@ -0,0 +1,210 @@
+#include "ShaderCache.hpp"
+#include "Timer.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+ShaderCache ShaderCache::instance;
+
+static constexpr uint64_t fnvOffsetBasis = 14695981039346656037ull;
+static constexpr uint64_t fnvPrime = 1099511628211ull;
+
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= fnvPrime;
+	}
+	return hash;
+}
+
+static uint64_t HashString(uint64_t hash, const std::string& value)
+{
+	// The terminator separates consecutive strings, "ab" + "c" and "a" + "bc" don't collide
+	return HashBytes(hash, value.c_str(), value.size() + 1);
+}
+
+void ShaderCache::Init(std::shared_ptr<Device> device, const std::string& directory, bool enabled)
+{
+	instance.device = device;
+	instance.directory = directory;
+	instance.enabled = enabled;
+
+	if (enabled)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		if (error)
+		{
+			printf("Shader cache: can't create the directory '%s', shaders will always be compiled\n", directory.c_str());
+			instance.enabled = false;
+		}
+	}
+}
+
+bool ShaderCache::ReadFile(const std::string& path, std::vector<uint8_t>& data)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+bool ShaderCache::WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+{
+	// Written to a temporary file first so that a crash never leaves a truncated entry in the cache
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary);
+		if (!file)
+			return false;
+		file.write((const char*)data.data(), data.size());
+		if (!file)
+			return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, path, error);
+	return !error;
+}
+
+bool ShaderCache::ExpandIncludes(const std::string& path, std::vector<std::string>& includeStack, std::string& output, std::vector<std::string>* files)
+{
+	std::ifstream file(path);
+	if (!file)
+		return false;
+
+	// Recursive includes are an error for the compiler, stop here and let it report it
+	std::string normalizedPath = std::filesystem::path(path).lexically_normal().string();
+	if (std::find(includeStack.begin(), includeStack.end(), normalizedPath) != includeStack.end())
+		return true;
+	includeStack.push_back(normalizedPath);
+
+	if (files)
+	{
+		std::error_code error;
+		std::string canonicalPath = std::filesystem::weakly_canonical(path, error).generic_string();
+		if (std::find(files->begin(), files->end(), canonicalPath) == files->end())
+			files->push_back(canonicalPath);
+	}
+
+	std::filesystem::path directory = std::filesystem::path(path).parent_path();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		size_t start = line.find_first_not_of(" \t");
+		if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+		{
+			size_t open = line.find('"', start);
+			size_t close = open != std::string::npos ? line.find('"', open + 1) : std::string::npos;
+			if (close != std::string::npos)
+			{
+				std::string includePath = (directory / line.substr(open + 1, close - open - 1)).string();
+				if (!ExpandIncludes(includePath, includeStack, output, files))
+					output += line + "\n";
+				continue;
+			}
+		}
+
+		output += line;
+		output += '\n';
+	}
+
+	includeStack.pop_back();
+	return true;
+}
+
+uint64_t ShaderCache::ComputeKey(const ShaderDesc& desc)
+{
+	std::string source;
+	std::vector<std::string> includeStack;
+	if (!ExpandIncludes(desc.shader_path, includeStack, source, nullptr))
+		return 0;
+
+	uint64_t hash = fnvOffsetBasis;
+	hash = HashBytes(hash, &cacheVersion, sizeof(cacheVersion));
+	hash = HashString(hash, source);
+	hash = HashString(hash, desc.entrypoint);
+	uint32_t type = (uint32_t)desc.type;
+	hash = HashBytes(hash, &type, sizeof(type));
+	hash = HashString(hash, desc.model);
+	// Defines are stored in a map, they are always hashed in the same order
+	for (const auto& [name, value] : desc.define)
+	{
+		hash = HashString(hash, name);
+		hash = HashString(hash, value);
+	}
+
+	return hash;
+}
+
+std::vector<std::string> ShaderCache::GetDependencies(const std::string& shaderPath)
+{
+	std::string source;
+	std::vector<std::string> includeStack;
+	std::vector<std::string> files;
+	ExpandIncludes(shaderPath, includeStack, source, &files);
+	return files;
+}
+
+std::shared_ptr<Shader> ShaderCache::Compile(const ShaderDesc& desc, bool* cacheHit)
+{
+	if (cacheHit)
+		*cacheHit = false;
+
+	uint64_t key = instance.enabled ? ComputeKey(desc) : 0;
+
+	std::string entryPath;
+	if (key != 0)
+	{
+		char fileName[32];
+		snprintf(fileName, sizeof(fileName), "%016llx.dxil", (unsigned long long)key);
+		entryPath = (std::filesystem::path(instance.directory) / fileName).string();
+
+		uint64_t startTicks = Timer::GetTicks();
+		std::vector<uint8_t> blob;
+		if (ReadFile(entryPath, blob) && !blob.empty())
+		{
+			auto shader = instance.device->CreateShader(blob, ShaderBlobType::kDXIL, desc.type);
+			instance.loadMicroseconds += (uint64_t)(Timer::TicksToSeconds(Timer::GetTicks() - startTicks) * 1e6);
+			instance.hits++;
+			if (cacheHit)
+				*cacheHit = true;
+			return shader;
+		}
+	}
+
+	uint64_t startTicks = Timer::GetTicks();
+	auto shader = instance.device->CompileShader(desc);
+	instance.compileMicroseconds += (uint64_t)(Timer::TicksToSeconds(Timer::GetTicks() - startTicks) * 1e6);
+	instance.misses++;
+
+	if (!entryPath.empty() && shader && !shader->GetBlob().empty())
+	{
+		if (!WriteFile(entryPath, shader->GetBlob()))
+			printf("Shader cache: can't write '%s'\n", entryPath.c_str());
+	}
+
+	return shader;
+}
+
+ShaderCache::Statistics ShaderCache::GetStatistics()
+{
+	Statistics statistics;
+	statistics.hits = instance.hits;
+	statistics.misses = instance.misses;
+	statistics.loadSeconds = instance.loadMicroseconds / 1e6;
+	statistics.compileSeconds = instance.compileMicroseconds / 1e6;
+	return statistics;
+}
+
+void ShaderCache::PrintStatistics()
+{
+	Statistics statistics = GetStatistics();
+	printf("Shader cache: %u hits (%.2f s), %u misses (%.2f s compiling)%s\n", statistics.hits, statistics.loadSeconds,
+		statistics.misses, statistics.compileSeconds, instance.enabled ? "" : ", cache disabled");
+}
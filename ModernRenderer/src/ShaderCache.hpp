@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Instance/Instance.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Persistent cache of compiled shader bytecode, warm starts create the shaders from the cached DXIL instead of
+// running DXC. Entries are keyed by a hash of the source with its #include files expanded, the entry point,
+// the stage, the shader model and the defines, so editing any included file invalidates the shaders using it.
+// Includes are expanded textually, a file included inside a disabled #if block still changes the key.
+class ShaderCache
+{
+public:
+	struct Statistics
+	{
+		unsigned hits = 0;
+		unsigned misses = 0;
+		double loadSeconds = 0;
+		double compileSeconds = 0;
+	};
+
+private:
+	// Increment to invalidate every cache entry, e.g. when the compiler or its options change
+	static constexpr uint32_t cacheVersion = 1;
+
+	static ShaderCache instance;
+
+	std::shared_ptr<Device> device;
+	std::string directory;
+	bool enabled = false;
+
+	std::atomic<unsigned> hits = 0;
+	std::atomic<unsigned> misses = 0;
+	// Microseconds, atomics of doubles can't be incremented
+	std::atomic<uint64_t> loadMicroseconds = 0;
+	std::atomic<uint64_t> compileMicroseconds = 0;
+
+	ShaderCache() = default;
+	~ShaderCache() = default;
+
+	static bool ExpandIncludes(const std::string& path, std::vector<std::string>& includeStack, std::string& output, std::vector<std::string>* files);
+	static bool ReadFile(const std::string& path, std::vector<uint8_t>& data);
+	static bool WriteFile(const std::string& path, const std::vector<uint8_t>& data);
+
+public:
+	// A disabled cache always compiles, the statistics still count the compilations as misses
+	static void Init(std::shared_ptr<Device> device, const std::string& directory = "ShaderCache", bool enabled = true);
+
+	// Drop-in replacement of Device::CompileShader, can be called from any thread
+	static std::shared_ptr<Shader> Compile(const ShaderDesc& desc, bool* cacheHit = nullptr);
+
+	// Returns 0 when the source file can't be read
+	static uint64_t ComputeKey(const ShaderDesc& desc);
+	// The source file and every file it includes, directly or not, as canonical paths
+	static std::vector<std::string> GetDependencies(const std::string& shaderPath);
+
+	static Statistics GetStatistics();
+	static void PrintStatistics();
+};
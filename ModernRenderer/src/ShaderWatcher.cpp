@@ -0,0 +1,93 @@
+#include "ShaderWatcher.hpp"
+#include "PipelineRegistry.hpp"
+#include <algorithm>
+#include <cstdio>
+
+ShaderWatcher ShaderWatcher::instance;
+
+ShaderWatcher::~ShaderWatcher()
+{
+	Stop();
+}
+
+void ShaderWatcher::Start(const std::string& directory)
+{
+	if (instance.running)
+		return;
+
+	instance.directory = directory;
+	instance.writeTimes.clear();
+
+	// First scan on the calling thread so that the files present at startup aren't reported as changed
+	std::vector<std::string> changedFiles;
+	instance.Scan(changedFiles);
+
+	instance.running = true;
+	instance.thread = std::thread([]() { instance.WatchLoop(); });
+	printf("Shader watcher: watching %zu files in %s\n", instance.writeTimes.size(), directory.c_str());
+}
+
+void ShaderWatcher::Stop()
+{
+	if (!instance.running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(instance.stopMutex);
+		instance.running = false;
+	}
+	instance.stopCondition.notify_all();
+	instance.thread.join();
+}
+
+bool ShaderWatcher::Scan(std::vector<std::string>& changedFiles)
+{
+	bool changed = false;
+
+	std::error_code error;
+	for (auto it = std::filesystem::recursive_directory_iterator(directory, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+	{
+		if (!it->is_regular_file(error))
+			continue;
+
+		auto writeTime = it->last_write_time(error);
+		if (error)
+			continue;
+
+		std::string path = std::filesystem::weakly_canonical(it->path(), error).generic_string();
+		auto known = writeTimes.find(path);
+		if (known != writeTimes.end() && known->second == writeTime)
+			continue;
+
+		// New files can't be included by a compiled shader yet, they are only recorded
+		if (known != writeTimes.end() && std::find(changedFiles.begin(), changedFiles.end(), path) == changedFiles.end())
+			changedFiles.push_back(path);
+		writeTimes[path] = writeTime;
+		changed = true;
+	}
+
+	return changed;
+}
+
+void ShaderWatcher::WatchLoop()
+{
+	std::vector<std::string> changedFiles;
+
+	while (running)
+	{
+		{
+			std::unique_lock<std::mutex> lock(stopMutex);
+			stopCondition.wait_for(lock, pollInterval, [this]() { return !running; });
+		}
+		if (!running)
+			break;
+
+		if (Scan(changedFiles) || changedFiles.empty())
+			continue;
+
+		for (const auto& file : changedFiles)
+			printf("Shader watcher: %s changed\n", std::filesystem::path(file).filename().string().c_str());
+		PipelineRegistry::Reload(changedFiles);
+		changedFiles.clear();
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Watches the shader directory from a background thread and asks the PipelineRegistry to recompile the shaders
+// depending on the edited files. Modification times are polled with std::filesystem, which works on every
+// platform and doesn't need a handle per directory. Changes are reported once a poll finds no new change, so
+// editors writing a file in several steps trigger a single recompilation.
+class ShaderWatcher
+{
+public:
+	static constexpr std::chrono::milliseconds pollInterval = std::chrono::milliseconds(250);
+
+private:
+	static ShaderWatcher instance;
+
+	std::string directory;
+	std::thread thread;
+	std::atomic<bool> running = false;
+	std::mutex stopMutex;
+	std::condition_variable stopCondition;
+
+	// Canonical path to last write time
+	std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+
+	ShaderWatcher() = default;
+	~ShaderWatcher();
+
+	void WatchLoop();
+	// Adds the files modified since the last scan, returns false when nothing changed
+	bool Scan(std::vector<std::string>& changedFiles);
+
+public:
+	static void Start(const std::string& directory);
+	static void Stop();
+};
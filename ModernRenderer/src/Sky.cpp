@@ -1,7 +1,7 @@
 #include "Sky.hpp"
 #include <filesystem>
 #include "RenderUtils.hpp"
-#include "Profiler.hpp"
+#include "PipelineRegistry.hpp"
 
 BindKey Sky::bindKey;
 BindingDesc Sky::bindingDesc;
@@ -16,6 +16,17 @@ void ConvertFloatArrayToHalfInPlace(float* image, int width, int height)
     }
 }
 
+ShaderDesc Sky::GetShaderDesc(const std::string& entryPoint, ShaderType type)
+{
+    return { MODERN_RENDERER_ASSETS_PATH "shaders/Sky.hlsl", entryPoint, type, "6_5" };
+}
+
+void Sky::RequestShaders()
+{
+    PipelineRegistry::Request(GetShaderDesc("mesh", ShaderType::kMesh));
+    PipelineRegistry::Request(GetShaderDesc("fragment", ShaderType::kPixel));
+}
+
 void Sky::LoadHDRI(std::shared_ptr<Device> device, const char* filepath)
 {
     int width, height, channels;
@@ -56,13 +67,6 @@ void Sky::LoadHDRI(std::shared_ptr<Device> device, const char* filepath)
 
     stbi_image_free(image);
 
-    // Load HDRI Sky shader
-    std::shared_ptr<Shader> pixelMeshshader = device->CompileShader(
-        { MODERN_RENDERER_ASSETS_PATH "shaders/Sky.hlsl", "mesh", ShaderType::kMesh, "6_5" });
-    std::shared_ptr<Shader> meshShader = device->CompileShader(
-        { MODERN_RENDERER_ASSETS_PATH "shaders/Sky.hlsl", "fragment", ShaderType::kPixel, "6_5" });
-    skyProgram = device->CreateProgram({ meshShader, pixelMeshshader });
-
     // Create Render pass
     RenderPassDepthStencilDesc depthStencilDesc = {
         gli::FORMAT_D32_SFLOAT_S8_UINT_PACK64,
@@ -88,6 +92,24 @@ void Sky::Initialize(std::shared_ptr<Device> device, Camera* camera)
     skyLayout = RenderUtils::CreateLayoutSet(device, *camera, { bindKey }, RenderUtils::CameraData | RenderUtils::TextureList, RenderUtils::Mesh | RenderUtils::Fragment);
     skyBindingSet = RenderUtils::CreateBindingSet(device, skyLayout, *camera, { bindingDesc }, RenderUtils::CameraData | RenderUtils::TextureList, RenderUtils::Mesh | RenderUtils::Fragment);
 
+    CreatePipeline();
+
+    // Edited shaders are recompiled in the background, the pipeline is created again once they are ready
+    PipelineRegistry::AddReloadListener(this, [this]() { CreatePipeline(); });
+}
+
+Sky::~Sky()
+{
+    PipelineRegistry::RemoveReloadListener(this);
+}
+
+void Sky::CreatePipeline()
+{
+    // Load HDRI Sky shader
+    std::shared_ptr<Shader> pixelMeshshader = PipelineRegistry::GetShader(GetShaderDesc("mesh", ShaderType::kMesh));
+    std::shared_ptr<Shader> meshShader = PipelineRegistry::GetShader(GetShaderDesc("fragment", ShaderType::kPixel));
+    skyProgram = device->CreateProgram({ meshShader, pixelMeshshader });
+
     GraphicsPipelineDesc skyPipelineDesc = {
         skyProgram,
         skyLayout,
@@ -114,22 +136,14 @@ void Sky::Render(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> col
         skyFramebuffer = device->CreateFramebuffer(desc);
     }
 
-    Profiler::BeginMarker(cmd, "Sky Pass");
-
     ClearDesc clearDesc = { { { 0.0, 0.2, 0.4, 1.0 } } }; // Clear Color
     cmd->BindPipeline(skyPipeline);
     cmd->BindBindingSet(skyBindingSet);
-    cmd->ResourceBarrier({ { colorTexture, ResourceState::kCommon, ResourceState::kRenderTarget } });
-    cmd->ResourceBarrier({ { depthTexture, ResourceState::kCommon, ResourceState::kDepthStencilWrite } });
     cmd->BeginRenderPass(skyRenderPass, skyFramebuffer, clearDesc);
 
     // Fullscreen dispatch mesh
     cmd->DispatchMesh(1, 1, 1);
 
     cmd->EndRenderPass();
-    cmd->ResourceBarrier({ { colorTexture, ResourceState::kRenderTarget, ResourceState::kCommon } });
-    cmd->ResourceBarrier({ { depthTexture, ResourceState::kDepthStencilWrite, ResourceState::kCommon } });
     // TODO: render pass set, etc.
-
-    Profiler::EndMarker(cmd);
 }
@@ -28,10 +28,17 @@ public:
 	static BindingDesc bindingDesc;
 
 	Sky() = default;
-	~Sky() = default;
+	~Sky();
+
+	static ShaderDesc GetShaderDesc(const std::string& entryPoint, ShaderType type);
+	// Starts compiling the sky shaders before the scene is loaded, see PipelineRegistry
+	static void RequestShaders();
 
 	void LoadHDRI(std::shared_ptr<Device> device, const char* filepath);
 	void Initialize(std::shared_ptr<Device> device, Camera* camera);
+	// Created again when the sky shaders are reloaded
+	void CreatePipeline();
 
+	// Color must be in the render target state and depth in the depth write state, see the sky pass of RenderPipeline
 	void Render(std::shared_ptr<CommandList> cmd, std::shared_ptr<Resource> colorTexture, std::shared_ptr<View> colorTextureView, std::shared_ptr<Resource> depthTexture, std::shared_ptr<View> depthTextureView);
 };
\ No newline at end of file
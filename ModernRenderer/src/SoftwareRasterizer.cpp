@@ -0,0 +1,445 @@
+#include "SoftwareRasterizer.hpp"
+#include "MeshPool.hpp"
+#include "VisibilityBuffer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <emmintrin.h>
+
+// Triangles are clipped against this guard band (in pixels) so that edge function products fit in 64 bits
+static constexpr float guardBandPixels = (float)(1 << 20);
+
+// Runs func(index) for every index in [0, count) on threadCount threads, indices are distributed with an atomic counter
+template<typename Func>
+static void ParallelFor(unsigned threadCount, unsigned count, Func func)
+{
+    std::atomic<unsigned> next = 0;
+    auto worker = [&]()
+    {
+        for (unsigned i = next++; i < count; i = next++)
+            func(i);
+    };
+
+    std::vector<std::thread> threads;
+    unsigned workerCount = std::min(threadCount, count);
+    for (unsigned i = 1; i < workerCount; i++)
+        threads.emplace_back(worker);
+    worker();
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// Sutherland-Hodgman clipping of a polygon in homogeneous clip space against the plane dot(plane, v) >= 0
+static unsigned ClipPolygon(const glm::vec4* input, unsigned inputCount, const glm::vec4& plane, glm::vec4* output)
+{
+    unsigned outputCount = 0;
+    for (unsigned i = 0; i < inputCount; i++)
+    {
+        const glm::vec4& a = input[i];
+        const glm::vec4& b = input[(i + 1) % inputCount];
+        float da = glm::dot(plane, a);
+        float db = glm::dot(plane, b);
+
+        if (da >= 0)
+            output[outputCount++] = a;
+        if ((da >= 0) != (db >= 0))
+            output[outputCount++] = a + (b - a) * (da / (da - db));
+    }
+    return outputCount;
+}
+
+SoftwareRasterizer::SoftwareRasterizer(unsigned width, unsigned height, unsigned threadCount, VisibilityBuffer::Format format)
+    : width(width), height(height), format(format)
+{
+    tileCountX = (width + tileSize - 1) / tileSize;
+    tileCountY = (height + tileSize - 1) / tileSize;
+    stride = tileCountX * tileSize;
+
+    this->threadCount = threadCount != 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+
+    visibility.resize(stride * tileCountY * tileSize);
+    if (format == VisibilityBuffer::Format::R32G32)
+        visibilityHigh.resize(stride * tileCountY * tileSize);
+    depth.resize(stride * tileCountY * tileSize);
+    blockMaxDepth.resize((stride / blockSize) * (tileCountY * tileSize / blockSize));
+    tileBins.resize(tileCountX * tileCountY);
+}
+
+void SoftwareRasterizer::Clear()
+{
+    std::fill(visibility.begin(), visibility.end(), 0);
+    std::fill(visibilityHigh.begin(), visibilityHigh.end(), 0);
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    std::fill(blockMaxDepth.begin(), blockMaxDepth.end(), 1.0f);
+    for (auto& bin : tileBins)
+        bin.clear();
+    triangles.clear();
+}
+
+std::vector<SoftwareRasterizer::VisibleMeshlet> SoftwareRasterizer::GatherAllMeshlets(const std::vector<Scene::InstanceData>& instances)
+{
+    std::vector<VisibleMeshlet> visibleMeshlets;
+
+    for (unsigned i = 0; i < instances.size(); i++)
+    {
+        for (unsigned j = 0; j < instances[i].meshletCount; j++)
+            visibleMeshlets.push_back({ i, instances[i].meshletIndex + j });
+    }
+
+    return visibleMeshlets;
+}
+
+void SoftwareRasterizer::Rasterize(const std::vector<VisibleMeshlet>& visibleMeshlets, const std::vector<Scene::InstanceData>& instances, const GPUCameraData& camera)
+{
+    Clear();
+
+    // Transform and setup are done per meshlet in parallel, the results are then binned in submission order
+    // so that triangles with equal depth resolve the same way as the hardware rasterizer.
+    meshletTriangles.resize(visibleMeshlets.size());
+    ParallelFor(threadCount, (unsigned)visibleMeshlets.size(), [&](unsigned i)
+    {
+        meshletTriangles[i].clear();
+        SetupMeshlet(i, visibleMeshlets[i], instances, camera, meshletTriangles[i]);
+    });
+
+    BinTriangles();
+
+    ParallelFor(threadCount, tileCountX * tileCountY, [&](unsigned tileIndex)
+    {
+        RasterizeTile(tileIndex);
+    });
+}
+
+void SoftwareRasterizer::SetupMeshlet(unsigned visibleMeshletIndex, const VisibleMeshlet& visibleMeshlet, const std::vector<Scene::InstanceData>& instances, const GPUCameraData& camera, std::vector<SetupTriangle>& output) const
+{
+    const Scene::InstanceData& instance = instances[visibleMeshlet.instanceIndex];
+    const meshopt_Meshlet& meshlet = MeshPool::meshlets[visibleMeshlet.meshletIndex];
+
+    // Same transform as LoadVertexAttributes in MeshUtils.hlsl
+    glm::vec4 positionsCS[256];
+    for (unsigned i = 0; i < meshlet.vertex_count; i++)
+    {
+        uint32_t vertexIndex = MeshPool::meshletIndices[meshlet.vertex_offset + i];
+        glm::vec3 positionRWS = MeshPool::vertices[vertexIndex].position - glm::vec3(camera.cameraPosition);
+        glm::vec4 positionWS = glm::vec4(positionRWS, 1.0f) * instance.objectToWorld;
+        positionsCS[i] = glm::vec4(glm::vec3(positionWS), 1.0f) * camera.viewProjectionMatrix;
+    }
+
+    for (unsigned i = 0; i < meshlet.triangle_count; i++)
+    {
+        const uint8_t* indices = &MeshPool::meshletTriangles[meshlet.triangle_offset + i * 3];
+        glm::vec4 triangle[3] = { positionsCS[indices[0]], positionsCS[indices[1]], positionsCS[indices[2]] };
+
+        uint64_t triangleVisibility = format == VisibilityBuffer::Format::R32G32
+            ? VisibilityBuffer::EncodeVisibility64(visibleMeshlet.instanceIndex, visibleMeshletIndex, i)
+            : VisibilityBuffer::EncodeVisibility(visibleMeshletIndex, i);
+        SetupTriangleFromClipSpace(triangle, triangleVisibility, output);
+    }
+}
+
+void SoftwareRasterizer::SetupTriangleFromClipSpace(const glm::vec4* positionsCS, uint64_t triangleVisibility, std::vector<SetupTriangle>& output) const
+{
+    float guardBandX = guardBandPixels / (width * 0.5f);
+    float guardBandY = guardBandPixels / (height * 0.5f);
+    constexpr unsigned planeCount = 6;
+    const glm::vec4 planes[planeCount] =
+    {
+        { 0, 0, 1, 0 }, // near: z >= 0
+        { 0, 0, -1, 1 }, // far: z <= w
+        { -1, 0, 0, guardBandX },
+        { 1, 0, 0, guardBandX },
+        { 0, -1, 0, guardBandY },
+        { 0, 1, 0, guardBandY },
+    };
+
+    // Trivial reject and check if clipping is needed
+    unsigned outsideMask = 0;
+    for (unsigned p = 0; p < planeCount; p++)
+    {
+        unsigned outsideCount = 0;
+        for (unsigned v = 0; v < 3; v++)
+            outsideCount += glm::dot(planes[p], positionsCS[v]) < 0;
+        if (outsideCount == 3)
+            return;
+        if (outsideCount != 0)
+            outsideMask |= 1 << p;
+    }
+
+    // Each plane can add at most one vertex to the polygon
+    glm::vec4 polygon[3 + planeCount];
+    glm::vec4 clipped[3 + planeCount];
+    unsigned vertexCount = 3;
+    std::copy(positionsCS, positionsCS + 3, polygon);
+    for (unsigned p = 0; p < planeCount && vertexCount >= 3; p++)
+    {
+        if (outsideMask & (1 << p))
+        {
+            vertexCount = ClipPolygon(polygon, vertexCount, planes[p], clipped);
+            std::copy(clipped, clipped + vertexCount, polygon);
+        }
+    }
+
+    // Project to screen space and snap to the sub pixel grid
+    const double subPixelScale = (double)(1 << subPixelBits);
+    int64_t x[3 + planeCount];
+    int64_t y[3 + planeCount];
+    float z[3 + planeCount];
+    for (unsigned i = 0; i < vertexCount; i++)
+    {
+        double invW = 1.0 / polygon[i].w;
+        double screenX = (polygon[i].x * invW * 0.5 + 0.5) * width;
+        double screenY = (-polygon[i].y * invW * 0.5 + 0.5) * height;
+        x[i] = std::llround(screenX * subPixelScale);
+        y[i] = std::llround(screenY * subPixelScale);
+        z[i] = (float)(polygon[i].z * invW);
+    }
+
+    // Triangle fan of the clipped polygon
+    for (unsigned i = 1; i + 1 < vertexCount; i++)
+    {
+        const unsigned v[3] = { 0, i, i + 1 };
+
+        // Clockwise triangles in screen space (y down) are front facing, cull back faces and degenerate triangles
+        int64_t area = (x[v[1]] - x[v[0]]) * (y[v[2]] - y[v[0]]) - (x[v[2]] - x[v[0]]) * (y[v[1]] - y[v[0]]);
+        if (area <= 0)
+            continue;
+
+        SetupTriangle triangle;
+        triangle.visibility = (uint32_t)triangleVisibility;
+        triangle.visibilityHigh = (uint32_t)(triangleVisibility >> 32);
+
+        // Pixels are covered when their center is inside the fixed point bounding box
+        int64_t minX = std::min({ x[v[0]], x[v[1]], x[v[2]] });
+        int64_t maxX = std::max({ x[v[0]], x[v[1]], x[v[2]] });
+        int64_t minY = std::min({ y[v[0]], y[v[1]], y[v[2]] });
+        int64_t maxY = std::max({ y[v[0]], y[v[1]], y[v[2]] });
+        const int64_t halfPixel = 1 << (subPixelBits - 1);
+        triangle.minX = (int)std::max<int64_t>(0, (minX - halfPixel + (1 << subPixelBits) - 1) >> subPixelBits);
+        triangle.minY = (int)std::max<int64_t>(0, (minY - halfPixel + (1 << subPixelBits) - 1) >> subPixelBits);
+        triangle.maxX = (int)std::min<int64_t>(width - 1, (maxX - halfPixel) >> subPixelBits);
+        triangle.maxY = (int)std::min<int64_t>(height - 1, (maxY - halfPixel) >> subPixelBits);
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            continue;
+
+        for (unsigned e = 0; e < 3; e++)
+        {
+            unsigned i0 = v[e];
+            unsigned i1 = v[(e + 1) % 3];
+
+            // E(p) = A * px + B * py + C, positive inside the triangle
+            int64_t a = y[i0] - y[i1];
+            int64_t b = x[i1] - x[i0];
+            int64_t c = -a * x[i0] - b * y[i0];
+
+            // Top-left fill rule: pixels exactly on an edge are only covered for top and left edges
+            bool topLeft = a > 0 || (a == 0 && b > 0);
+            triangle.edgeA[e] = a;
+            triangle.edgeB[e] = b;
+            triangle.edgeC[e] = topLeft ? c : c - 1;
+        }
+
+        // Depth is interpolated linearly in screen space
+        float x0 = (float)(x[v[0]] / subPixelScale), y0 = (float)(y[v[0]] / subPixelScale);
+        float x1 = (float)(x[v[1]] / subPixelScale), y1 = (float)(y[v[1]] / subPixelScale);
+        float x2 = (float)(x[v[2]] / subPixelScale), y2 = (float)(y[v[2]] / subPixelScale);
+        float areaF = (float)(area / (subPixelScale * subPixelScale));
+        float dz1 = z[v[1]] - z[v[0]];
+        float dz2 = z[v[2]] - z[v[0]];
+        triangle.depthA = (dz1 * (y2 - y0) - dz2 * (y1 - y0)) / areaF;
+        triangle.depthB = (dz2 * (x1 - x0) - dz1 * (x2 - x0)) / areaF;
+        triangle.depthC = z[v[0]] - triangle.depthA * x0 - triangle.depthB * y0;
+        triangle.minDepth = std::max(0.0f, std::min({ z[v[0]], z[v[1]], z[v[2]] }));
+
+        output.push_back(triangle);
+    }
+}
+
+void SoftwareRasterizer::BinTriangles()
+{
+    size_t triangleCount = 0;
+    for (const auto& meshlet : meshletTriangles)
+        triangleCount += meshlet.size();
+    triangles.reserve(triangleCount);
+
+    for (const auto& meshlet : meshletTriangles)
+    {
+        for (const auto& triangle : meshlet)
+        {
+            uint32_t triangleIndex = (uint32_t)triangles.size();
+            triangles.push_back(triangle);
+
+            for (int ty = triangle.minY / tileSize; ty <= triangle.maxY / tileSize; ty++)
+                for (int tx = triangle.minX / tileSize; tx <= triangle.maxX / tileSize; tx++)
+                    tileBins[ty * tileCountX + tx].push_back(triangleIndex);
+        }
+    }
+}
+
+void SoftwareRasterizer::RasterizeTile(unsigned tileIndex)
+{
+    int tileMinX = (tileIndex % tileCountX) * tileSize;
+    int tileMinY = (tileIndex / tileCountX) * tileSize;
+    int tileMaxX = std::min<int>(tileMinX + tileSize, width) - 1;
+    int tileMaxY = std::min<int>(tileMinY + tileSize, height) - 1;
+
+    for (uint32_t triangleIndex : tileBins[tileIndex])
+    {
+        const SetupTriangle& triangle = triangles[triangleIndex];
+
+        int minX = std::max(triangle.minX, tileMinX);
+        int minY = std::max(triangle.minY, tileMinY);
+        int maxX = std::min(triangle.maxX, tileMaxX);
+        int maxY = std::min(triangle.maxY, tileMaxY);
+
+        for (int blockY = minY & ~(blockSize - 1); blockY <= maxY; blockY += blockSize)
+        {
+            for (int blockX = minX & ~(blockSize - 1); blockX <= maxX; blockX += blockSize)
+            {
+                // Hierarchical depth test: skip the block if the triangle is behind every pixel of the block
+                float& maxDepth = blockMaxDepth[(blockY / blockSize) * (stride / blockSize) + blockX / blockSize];
+                if (triangle.minDepth >= maxDepth)
+                    continue;
+
+                RasterizeBlock(triangle, blockX, blockY, minX, minY, maxX, maxY);
+            }
+        }
+    }
+}
+
+void SoftwareRasterizer::RasterizeBlock(const SetupTriangle& triangle, int blockX, int blockY, int minX, int minY, int maxX, int maxY)
+{
+    const int64_t pixelStep = 1 << subPixelBits;
+    const int64_t halfPixel = pixelStep / 2;
+
+    // Edge function values for the 4 pixels of a row group, 2 x 64 bit lanes per register
+    __m128i stepX[3];
+    int64_t rowStart[3];
+    for (int e = 0; e < 3; e++)
+    {
+        stepX[e] = _mm_set1_epi64x(triangle.edgeA[e] * pixelStep * 4);
+        rowStart[e] = triangle.edgeA[e] * (blockX * pixelStep + halfPixel)
+            + triangle.edgeB[e] * (blockY * pixelStep + halfPixel)
+            + triangle.edgeC[e];
+    }
+
+    const __m128 depthStepX = _mm_set1_ps(triangle.depthA * 4);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i visibilityValue = _mm_set1_epi32((int)triangle.visibility);
+    const __m128i visibilityHighValue = _mm_set1_epi32((int)triangle.visibilityHigh);
+
+    bool written = false;
+    int rowEnd = std::min(blockY + blockSize - 1, maxY);
+    for (int py = blockY; py <= rowEnd; py++)
+    {
+        if (py >= minY)
+        {
+            __m128i edge01[3];
+            __m128i edge23[3];
+            for (int e = 0; e < 3; e++)
+            {
+                int64_t a = triangle.edgeA[e] * pixelStep;
+                edge01[e] = _mm_set_epi64x(rowStart[e] + a, rowStart[e]);
+                edge23[e] = _mm_set_epi64x(rowStart[e] + a * 3, rowStart[e] + a * 2);
+            }
+
+            float pixelCenterY = py + 0.5f;
+            __m128 z = _mm_add_ps(
+                _mm_set1_ps(triangle.depthB * pixelCenterY + triangle.depthC),
+                _mm_mul_ps(_mm_set1_ps(triangle.depthA), _mm_set_ps(blockX + 3.5f, blockX + 2.5f, blockX + 1.5f, blockX + 0.5f)));
+
+            for (int px = blockX; px < blockX + blockSize; px += 4)
+            {
+                // A pixel is covered when all edge functions are positive, the sign bit of each 64 bit lane is extracted with movemask
+                __m128i or01 = _mm_or_si128(_mm_or_si128(edge01[0], edge01[1]), edge01[2]);
+                __m128i or23 = _mm_or_si128(_mm_or_si128(edge23[0], edge23[1]), edge23[2]);
+                int coverage = (~(_mm_movemask_pd(_mm_castsi128_pd(or01)) | (_mm_movemask_pd(_mm_castsi128_pd(or23)) << 2))) & 0xF;
+
+                // Discard pixels outside of the tile / screen bounds
+                int spanMask = 0;
+                for (int lane = 0; lane < 4; lane++)
+                    spanMask |= (px + lane >= minX && px + lane <= maxX) << lane;
+                coverage &= spanMask;
+
+                if (coverage != 0)
+                {
+                    float* depthRow = &depth[py * stride + px];
+                    uint32_t* visibilityRow = &visibility[py * stride + px];
+
+                    __m128 currentDepth = _mm_loadu_ps(depthRow);
+                    __m128 depthPass = _mm_and_ps(_mm_cmplt_ps(z, currentDepth), _mm_and_ps(_mm_cmpge_ps(z, zero), _mm_cmple_ps(z, one)));
+                    int writeMask = _mm_movemask_ps(depthPass) & coverage;
+
+                    if (writeMask != 0)
+                    {
+                        const __m128i laneBits = _mm_set_epi32(8, 4, 2, 1);
+                        __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(writeMask), laneBits), laneBits);
+                        __m128 maskF = _mm_castsi128_ps(mask);
+
+                        _mm_storeu_ps(depthRow, _mm_or_ps(_mm_and_ps(maskF, z), _mm_andnot_ps(maskF, currentDepth)));
+                        __m128i currentVisibility = _mm_loadu_si128((const __m128i*)visibilityRow);
+                        _mm_storeu_si128((__m128i*)visibilityRow, _mm_or_si128(_mm_and_si128(mask, visibilityValue), _mm_andnot_si128(mask, currentVisibility)));
+                        if (!visibilityHigh.empty())
+                        {
+                            uint32_t* visibilityHighRow = &visibilityHigh[py * stride + px];
+                            __m128i currentVisibilityHigh = _mm_loadu_si128((const __m128i*)visibilityHighRow);
+                            _mm_storeu_si128((__m128i*)visibilityHighRow, _mm_or_si128(_mm_and_si128(mask, visibilityHighValue), _mm_andnot_si128(mask, currentVisibilityHigh)));
+                        }
+                        written = true;
+                    }
+                }
+
+                for (int e = 0; e < 3; e++)
+                {
+                    edge01[e] = _mm_add_epi64(edge01[e], stepX[e]);
+                    edge23[e] = _mm_add_epi64(edge23[e], stepX[e]);
+                }
+                z = _mm_add_ps(z, depthStepX);
+            }
+        }
+
+        for (int e = 0; e < 3; e++)
+            rowStart[e] += triangle.edgeB[e] * pixelStep;
+    }
+
+    // Update the max depth of the block for the hierarchical test
+    if (written)
+    {
+        __m128 maxDepth = _mm_setzero_ps();
+        for (int py = blockY; py < blockY + blockSize; py++)
+        {
+            const float* depthRow = &depth[py * stride + blockX];
+            maxDepth = _mm_max_ps(maxDepth, _mm_max_ps(_mm_loadu_ps(depthRow), _mm_loadu_ps(depthRow + 4)));
+        }
+        maxDepth = _mm_max_ps(maxDepth, _mm_shuffle_ps(maxDepth, maxDepth, _MM_SHUFFLE(1, 0, 3, 2)));
+        maxDepth = _mm_max_ps(maxDepth, _mm_shuffle_ps(maxDepth, maxDepth, _MM_SHUFFLE(2, 3, 0, 1)));
+        blockMaxDepth[(blockY / blockSize) * (stride / blockSize) + blockX / blockSize] = _mm_cvtss_f32(maxDepth);
+    }
+}
+
+std::vector<uint32_t> SoftwareRasterizer::GetVisibility() const
+{
+    unsigned componentCount = VisibilityBuffer::GetComponentCount(format);
+    std::vector<uint32_t> result(width * height * componentCount);
+    for (unsigned y = 0; y < height; y++)
+    {
+        for (unsigned x = 0; x < width; x++)
+        {
+            result[(y * width + x) * componentCount] = visibility[y * stride + x];
+            if (componentCount == 2)
+                result[(y * width + x) * componentCount + 1] = visibilityHigh[y * stride + x];
+        }
+    }
+    return result;
+}
+
+std::vector<float> SoftwareRasterizer::GetDepth() const
+{
+    std::vector<float> result(width * height);
+    for (unsigned y = 0; y < height; y++)
+        std::copy_n(&depth[y * stride], width, &result[y * width]);
+    return result;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "Camera.hpp"
+#include "Scene.hpp"
+#include "VisibilityBuffer.hpp"
+
+// CPU implementation of the visibility pass (VisibilityPass.hlsl).
+// Consumes the same visible meshlet list and MeshPool data as the GPU and outputs an identical
+// R32 visibility image and D32 depth, which allows to validate the visibility buffer without mesh shader support.
+class SoftwareRasterizer
+{
+public:
+    // Keep in sync with VisibleMeshlet in MeshUtils.hlsl
+    struct VisibleMeshlet
+    {
+        unsigned instanceIndex;
+        unsigned meshletIndex;
+    };
+
+    static constexpr int tileSize = 64;
+    static constexpr int blockSize = 8;
+    static constexpr int subPixelBits = 8;
+
+private:
+    // Triangle after clipping and setup, edge functions are evaluated in 24.8 fixed point
+    struct SetupTriangle
+    {
+        int64_t edgeA[3];
+        int64_t edgeB[3];
+        int64_t edgeC[3];
+        // Depth plane equation in pixel space: z = depthA * x + depthB * y + depthC
+        float depthA, depthB, depthC;
+        float minDepth;
+        int minX, minY, maxX, maxY;
+        // Low and high 32 bits of the visibility, the high part is only used by the R32G32 format
+        uint32_t visibility;
+        uint32_t visibilityHigh;
+    };
+
+    unsigned width;
+    unsigned height;
+    unsigned stride; // Internal buffers are padded to a multiple of the tile size
+    unsigned tileCountX;
+    unsigned tileCountY;
+    unsigned threadCount;
+    VisibilityBuffer::Format format;
+
+    std::vector<uint32_t> visibility;
+    std::vector<uint32_t> visibilityHigh;
+    std::vector<float> depth;
+    std::vector<float> blockMaxDepth;
+
+    std::vector<std::vector<SetupTriangle>> meshletTriangles;
+    std::vector<SetupTriangle> triangles;
+    std::vector<std::vector<uint32_t>> tileBins;
+
+    void Clear();
+    void SetupMeshlet(unsigned visibleMeshletIndex, const VisibleMeshlet& visibleMeshlet, const std::vector<Scene::InstanceData>& instances, const GPUCameraData& camera, std::vector<SetupTriangle>& output) const;
+    void SetupTriangleFromClipSpace(const glm::vec4* positionsCS, uint64_t triangleVisibility, std::vector<SetupTriangle>& output) const;
+    void BinTriangles();
+    void RasterizeTile(unsigned tileIndex);
+    void RasterizeBlock(const SetupTriangle& triangle, int blockX, int blockY, int minX, int minY, int maxX, int maxY);
+
+public:
+    // threadCount = 0 uses the number of hardware threads
+    SoftwareRasterizer(unsigned width, unsigned height, unsigned threadCount = 0, VisibilityBuffer::Format format = VisibilityBuffer::Format::R32);
+
+    void Rasterize(const std::vector<VisibleMeshlet>& visibleMeshlets, const std::vector<Scene::InstanceData>& instances, const GPUCameraData& camera);
+
+    // Builds the list of all meshlets of the scene, equivalent to visibleMeshlets1 with every culling disabled
+    static std::vector<VisibleMeshlet> GatherAllMeshlets(const std::vector<Scene::InstanceData>& instances);
+
+    // Copy of the internal buffers without the tile padding, cleared to 0 for visibility and 1 for depth
+    // Visibility has the memory layout of the texture: one uint per pixel for R32, two interleaved uints for R32G32
+    std::vector<uint32_t> GetVisibility() const;
+    std::vector<float> GetDepth() const;
+
+    unsigned GetWidth() const { return width; }
+    unsigned GetHeight() const { return height; }
+    VisibilityBuffer::Format GetFormat() const { return format; }
+};
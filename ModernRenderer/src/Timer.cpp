@@ -0,0 +1,95 @@
+#include "Timer.hpp"
+#include <chrono>
+#include <thread>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define TIMER_X64
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
+Timer Timer::instance;
+
+static uint64_t GetSteadyClockNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool HasInvariantTSC()
+{
+#if defined(TIMER_X64)
+	// CPUID 0x80000007, EDX bit 8: the TSC runs at a constant rate across power states and cores
+#if defined(_MSC_VER)
+	int registers[4] = {};
+	__cpuid(registers, 0x80000000);
+	if ((unsigned)registers[0] < 0x80000007)
+		return false;
+	__cpuid(registers, 0x80000007);
+	return (registers[3] & (1 << 8)) != 0;
+#else
+	unsigned eax, ebx, ecx, edx;
+	if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+		return false;
+	return (edx & (1 << 8)) != 0;
+#endif
+#else
+	return false;
+#endif
+}
+
+Timer::Timer()
+{
+	useTSC = HasInvariantTSC();
+
+#if defined(TIMER_X64)
+	if (useTSC)
+	{
+		// Measure the TSC frequency against the steady clock
+		uint64_t clockStart = GetSteadyClockNanoseconds();
+		uint64_t tscStart = __rdtsc();
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		uint64_t clockEnd = GetSteadyClockNanoseconds();
+		uint64_t tscEnd = __rdtsc();
+
+		secondsPerTick = (double)(clockEnd - clockStart) * 1e-9 / (double)(tscEnd - tscStart);
+	}
+#endif
+
+	if (!useTSC)
+		secondsPerTick = 1e-9;
+
+	startTicks = ReadTicks();
+}
+
+uint64_t Timer::ReadTicks()
+{
+#if defined(TIMER_X64)
+	if (instance.useTSC)
+		return __rdtsc();
+#endif
+	return GetSteadyClockNanoseconds();
+}
+
+double Timer::GetTimeInSeconds()
+{
+	return TicksToSeconds(GetTicks());
+}
+
+uint64_t Timer::GetTicks()
+{
+	return ReadTicks() - instance.startTicks;
+}
+
+double Timer::TicksToSeconds(uint64_t ticks)
+{
+	return (double)ticks * instance.secondsPerTick;
+}
+
+bool Timer::IsUsingTSC()
+{
+	return instance.useTSC;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+// Portable high resolution CPU timer.
+// Uses the invariant TSC of x86 CPUs when available, calibrated against std::chrono::steady_clock, and falls back to steady_clock otherwise.
+class Timer
+{
+private:
+	static Timer instance;
+
+	bool useTSC = false;
+	double secondsPerTick = 0;
+	uint64_t startTicks = 0;
+
+	Timer();
+
+	static uint64_t ReadTicks();
+
+public:
+	// Time in seconds since the start of the application
+	static double GetTimeInSeconds();
+	static uint64_t GetTicks();
+	static double TicksToSeconds(uint64_t ticks);
+	static bool IsUsingTSC();
+};
@@ -0,0 +1,92 @@
+#include "TraceWriter.hpp"
+#include "Json.hpp"
+#include <atomic>
+
+TraceWriter::~TraceWriter()
+{
+	Close();
+}
+
+bool TraceWriter::Open(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (file != nullptr)
+		return false;
+
+	file = fopen(path.c_str(), "w");
+	if (file == nullptr)
+	{
+		printf("Failed to open trace file %s\n", path.c_str());
+		return false;
+	}
+
+	firstEvent = true;
+	buffer.reserve(bufferCapacity);
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	WriteMetadata(CPU, 0, "process_name", "CPU");
+	WriteMetadata(GPU, 0, "process_name", "GPU");
+	return true;
+}
+
+void TraceWriter::Close()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (file == nullptr)
+		return;
+
+	Flush();
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	file = nullptr;
+}
+
+void TraceWriter::WriteMetadata(Timeline timeline, uint32_t threadID, const char* metadataName, const std::string& value)
+{
+	fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+		firstEvent ? "" : ",\n", metadataName, (int)timeline, threadID, EscapeJSON(value).c_str());
+	firstEvent = false;
+}
+
+void TraceWriter::Flush()
+{
+	for (const auto& event : buffer)
+	{
+		// Timestamps are in microseconds
+		fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+			firstEvent ? "" : ",\n", EscapeJSON(event.name).c_str(), (int)event.timeline, event.threadID,
+			event.startSeconds * 1e6, event.durationSeconds * 1e6, (unsigned long long)event.frameIndex);
+		firstEvent = false;
+	}
+	buffer.clear();
+	fflush(file);
+}
+
+void TraceWriter::SetThreadName(Timeline timeline, uint32_t threadID, const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (file != nullptr)
+		WriteMetadata(timeline, threadID, "thread_name", name);
+}
+
+void TraceWriter::AddEvent(const std::string& name, Timeline timeline, uint32_t threadID, double startSeconds, double durationSeconds, uint64_t frameIndex)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (file == nullptr)
+		return;
+
+	buffer.push_back({ name, timeline, threadID, startSeconds, durationSeconds, frameIndex });
+	if (buffer.size() >= bufferCapacity)
+		Flush();
+}
+
+uint32_t TraceWriter::GetCurrentThreadID()
+{
+	static std::atomic<uint32_t> nextThreadID = 0;
+	thread_local uint32_t threadID = nextThreadID++;
+	return threadID;
+}
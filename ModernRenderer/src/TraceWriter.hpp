@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+
+// Writes events in the Chrome Trace Event JSON format, which can be opened in chrome://tracing or https://ui.perfetto.dev.
+// Events are accumulated in a bounded buffer which is flushed to disk when full, so long runs don't grow the memory usage.
+class TraceWriter
+{
+public:
+	// Process IDs used to separate the CPU and GPU timelines in the viewer
+	enum Timeline
+	{
+		CPU = 1,
+		GPU = 2,
+	};
+
+private:
+	struct Event
+	{
+		std::string name;
+		Timeline timeline;
+		uint32_t threadID;
+		double startSeconds;
+		double durationSeconds;
+		uint64_t frameIndex;
+	};
+
+	FILE* file = nullptr;
+	bool firstEvent = true;
+	size_t bufferCapacity;
+	std::vector<Event> buffer;
+	std::mutex mutex;
+
+	void WriteMetadata(Timeline timeline, uint32_t threadID, const char* metadataName, const std::string& value);
+	void Flush();
+
+public:
+	TraceWriter(size_t bufferCapacity = 4096) : bufferCapacity(bufferCapacity) {}
+	~TraceWriter();
+
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const { return file != nullptr; }
+
+	void SetThreadName(Timeline timeline, uint32_t threadID, const std::string& name);
+	// Adds a complete event, nesting is inferred by the viewer from the time ranges on the same thread
+	void AddEvent(const std::string& name, Timeline timeline, uint32_t threadID, double startSeconds, double durationSeconds, uint64_t frameIndex);
+
+	// Small sequential ID of the calling thread, stable for the lifetime of the thread
+	static uint32_t GetCurrentThreadID();
+};
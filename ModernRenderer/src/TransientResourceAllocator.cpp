@@ -0,0 +1,71 @@
+#include "TransientResourceAllocator.hpp"
+#include <CommandList/DXCommandList.h>
+#include <algorithm>
+
+TransientResourceAllocator::TransientResourceAllocator(std::shared_ptr<Device> device)
+{
+	this->device = device;
+}
+
+unsigned TransientResourceAllocator::ReserveTimeline(unsigned passCount)
+{
+	unsigned firstPass = timelineLength;
+	timelineLength += std::max(passCount, 1u);
+	return firstPass;
+}
+
+void TransientResourceAllocator::Declare(const std::string& name, std::shared_ptr<Resource> resource, unsigned firstPass, unsigned lastPass)
+{
+	if (heap)
+	{
+		printf("Transient resource '%s' declared after the allocation, it will not be placed\n", name.c_str());
+		return;
+	}
+
+	entries.push_back({ name, resource, firstPass, lastPass });
+}
+
+void TransientResourceAllocator::Allocate()
+{
+	if (entries.empty())
+		return;
+
+	std::vector<TransientResourcePlanner::Request> requests;
+	uint32_t memoryTypeBits = UINT32_MAX;
+	for (const auto& entry : entries)
+	{
+		MemoryRequirements requirements = entry.resource->GetMemoryRequirements();
+		requests.push_back({ requirements.size, requirements.alignment, entry.firstPass, entry.lastPass });
+		memoryTypeBits &= requirements.memory_type_bits;
+	}
+
+	plan = TransientResourcePlanner::Pack(requests);
+
+	heap = device->AllocateMemory(plan.heapSize, MemoryType::kDefault, memoryTypeBits);
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		entries[i].resource->BindMemory(heap, plan.offsets[i]);
+		entries[i].resource->SetName(entries[i].name);
+	}
+
+	const double megaByte = 1024.0 * 1024.0;
+	printf("Transient resources: %zu resources in a %.1f MB heap, %.1f MB without aliasing (%.1f MB saved)\n",
+		entries.size(), plan.heapSize / megaByte, plan.unaliasedSize / megaByte, plan.GetSavedBytes() / megaByte);
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		printf("    %s: offset %.1f MB, size %.1f MB, passes %u to %u\n", entries[i].name.c_str(),
+			plan.offsets[i] / megaByte, requests[i].size / megaByte, entries[i].firstPass, entries[i].lastPass);
+	}
+}
+
+void TransientResourceAllocator::AliasingBarrier(std::shared_ptr<CommandList> cmd)
+{
+	auto dxCmd = ((DXCommandList*)cmd.get())->GetCommandList();
+
+	// Null resources wait for all the accesses to placed resources, there are only a few transient resources
+	D3D12_RESOURCE_BARRIER barrier = {};
+	barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+	barrier.Aliasing.pResourceBefore = nullptr;
+	barrier.Aliasing.pResourceAfter = nullptr;
+	dxCmd->ResourceBarrier(1, &barrier);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Instance/Instance.h"
+#include "TransientResourcePlanner.hpp"
+#include <string>
+#include <vector>
+
+// Places resources that are only needed for a part of the frame in a shared heap instead of committing them.
+// Users reserve a range of a timeline for their passes and declare the lifetime of their resources inside it,
+// ranges of different users never overlap so e.g. the rasterization and path tracing resources, which are
+// never used in the same frame, can share the same memory. Resources are created without memory, Allocate()
+// binds them and must be called before creating their views.
+class TransientResourceAllocator
+{
+private:
+	struct Entry
+	{
+		std::string name;
+		std::shared_ptr<Resource> resource;
+		unsigned firstPass;
+		unsigned lastPass;
+	};
+
+	std::shared_ptr<Device> device;
+	std::vector<Entry> entries;
+	unsigned timelineLength = 0;
+	std::shared_ptr<Memory> heap;
+	TransientResourcePlanner::Plan plan;
+
+public:
+	TransientResourceAllocator(std::shared_ptr<Device> device);
+	~TransientResourceAllocator() = default;
+
+	// Returns the first pass index of the range reserved on the timeline
+	unsigned ReserveTimeline(unsigned passCount);
+	void Declare(const std::string& name, std::shared_ptr<Resource> resource, unsigned firstPass, unsigned lastPass);
+
+	// Plans the placements of all the declared resources, allocates the heap and binds the resources
+	void Allocate();
+
+	// Must be recorded before using resources that share memory with the resources used previously,
+	// e.g. when switching between rasterization and path tracing
+	void AliasingBarrier(std::shared_ptr<CommandList> cmd);
+
+	const TransientResourcePlanner::Plan& GetPlan() const { return plan; }
+};
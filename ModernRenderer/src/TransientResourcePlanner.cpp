@@ -0,0 +1,81 @@
+#include "TransientResourcePlanner.hpp"
+#include <algorithm>
+#include <numeric>
+
+bool TransientResourcePlanner::LifetimesOverlap(const Request& a, const Request& b)
+{
+	return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+}
+
+uint64_t TransientResourcePlanner::AlignUp(uint64_t value, uint64_t alignment)
+{
+	if (alignment <= 1)
+		return value;
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+TransientResourcePlanner::Plan TransientResourcePlanner::Pack(const std::vector<Request>& requests)
+{
+	Plan plan;
+	plan.offsets.resize(requests.size(), 0);
+
+	std::vector<uint64_t> unaliasedOffsets(requests.size());
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		unaliasedOffsets[i] = AlignUp(plan.unaliasedSize, requests[i].alignment);
+		plan.unaliasedSize = unaliasedOffsets[i] + requests[i].size;
+	}
+
+	std::vector<unsigned> order(requests.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b)
+	{
+		if (requests[a].size != requests[b].size)
+			return requests[a].size > requests[b].size;
+		return requests[a].firstPass < requests[b].firstPass;
+	});
+
+	struct MemoryRange
+	{
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	std::vector<unsigned> placed;
+	std::vector<MemoryRange> occupied;
+	for (unsigned index : order)
+	{
+		const Request& request = requests[index];
+
+		// Memory used by the placed requests alive at the same time, sorted by offset
+		occupied.clear();
+		for (unsigned other : placed)
+		{
+			if (LifetimesOverlap(request, requests[other]))
+				occupied.push_back({ plan.offsets[other], plan.offsets[other] + requests[other].size });
+		}
+		std::sort(occupied.begin(), occupied.end(), [](const MemoryRange& a, const MemoryRange& b) { return a.begin < b.begin; });
+
+		// First gap large enough for the request
+		uint64_t offset = 0;
+		for (const auto& range : occupied)
+		{
+			if (offset + request.size <= range.begin)
+				break;
+			offset = std::max(offset, AlignUp(range.end, request.alignment));
+		}
+
+		plan.offsets[index] = offset;
+		plan.heapSize = std::max(plan.heapSize, offset + request.size);
+		placed.push_back(index);
+	}
+
+	// Placing the largest requests first can waste more alignment padding than aliasing saves
+	if (plan.heapSize > plan.unaliasedSize)
+	{
+		plan.offsets = std::move(unaliasedOffsets);
+		plan.heapSize = plan.unaliasedSize;
+	}
+
+	return plan;
+}
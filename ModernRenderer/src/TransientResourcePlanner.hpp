@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Places resources in a single heap so that resources whose lifetimes don't overlap share the same memory.
+// Lifetimes are inclusive ranges of pass indices on a timeline, resources used in the same pass never alias.
+// The planner only works on sizes and lifetimes which allows to check the placements on the CPU.
+class TransientResourcePlanner
+{
+public:
+	struct Request
+	{
+		uint64_t size = 0;
+		uint64_t alignment = 1;
+		unsigned firstPass = 0;
+		unsigned lastPass = 0;
+	};
+
+	struct Plan
+	{
+		// Offset of each request in the heap, in the order of the requests
+		std::vector<uint64_t> offsets;
+		uint64_t heapSize = 0;
+		// Size of the heap if every request had its own memory
+		uint64_t unaliasedSize = 0;
+
+		uint64_t GetSavedBytes() const { return unaliasedSize - heapSize; }
+	};
+
+	// Greedy interval packing: the largest requests are placed first, each at the lowest aligned offset
+	// that doesn't overlap the memory of an already placed request alive at the same time. The heap is never
+	// larger than unaliasedSize, the requests are placed one after the other if aliasing doesn't save memory.
+	static Plan Pack(const std::vector<Request>& requests);
+
+	static bool LifetimesOverlap(const Request& a, const Request& b);
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment);
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <bit>
+
+// CPU version of the visibility buffer encoding
+// Keep in sync with the visibility functions in Common.hlsl
+namespace VisibilityBuffer
+{
+	enum class Format
+	{
+		// 25 bit visible meshlet index, 7 bit triangle index
+		R32,
+		// x: 32 bit visible meshlet index, y: 24 bit instance index and 8 bit triangle index
+		R32G32,
+	};
+
+	constexpr uint32_t meshletBits = 25;
+	constexpr uint32_t meshletMask = (1u << meshletBits) - 1;
+	constexpr uint32_t triangleMask = 0x7F;
+
+	constexpr uint32_t triangleBits64 = 8;
+	constexpr uint32_t triangleMask64 = (1u << triangleBits64) - 1;
+	constexpr uint32_t instanceMask64 = (1u << (32 - triangleBits64)) - 1;
+
+	constexpr unsigned GetComponentCount(Format format)
+	{
+		return format == Format::R32G32 ? 2 : 1;
+	}
+
+	constexpr uint32_t EncodeVisibility(uint32_t visibleMeshletID, uint32_t triangleID)
+	{
+		return (visibleMeshletID & meshletMask) | ((triangleID & triangleMask) << meshletBits);
+	}
+
+	constexpr void DecodeVisibility(uint32_t visibility, uint32_t& visibleMeshletID, uint32_t& triangleID)
+	{
+		visibleMeshletID = visibility & meshletMask;
+		triangleID = visibility >> meshletBits;
+	}
+
+	// The low 32 bits map to the x channel of the R32G32 texture and the high 32 bits to the y channel
+	constexpr uint64_t EncodeVisibility64(uint32_t instanceID, uint32_t visibleMeshletID, uint32_t triangleID)
+	{
+		uint32_t y = ((instanceID & instanceMask64) << triangleBits64) | (triangleID & triangleMask64);
+		return (uint64_t)visibleMeshletID | ((uint64_t)y << 32);
+	}
+
+	constexpr void DecodeVisibility64(uint64_t visibility, uint32_t& instanceID, uint32_t& visibleMeshletID, uint32_t& triangleID)
+	{
+		uint32_t y = (uint32_t)(visibility >> 32);
+		visibleMeshletID = (uint32_t)visibility;
+		instanceID = y >> triangleBits64;
+		triangleID = y & triangleMask64;
+	}
+
+	// Depth in the high bits so that an atomic min on the packed value performs a less depth test.
+	// Only valid for positive depth values, which have the same ordering as their bit pattern.
+	constexpr uint64_t PackDepthVisibility(float depth, uint32_t visibility)
+	{
+		return ((uint64_t)std::bit_cast<uint32_t>(depth) << 32) | visibility;
+	}
+
+	constexpr void UnpackDepthVisibility(uint64_t packed, float& depth, uint32_t& visibility)
+	{
+		depth = std::bit_cast<float>((uint32_t)(packed >> 32));
+		visibility = (uint32_t)packed;
+	}
+}
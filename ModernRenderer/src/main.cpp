@@ -12,6 +12,15 @@
 #include "GLFW/glfw3native.h"
 #include "RenderSettings.hpp"
 #include "Profiler.hpp"
+#include "Benchmark.hpp"
+#include "CameraPath.hpp"
+#include "FrameContext.hpp"
+#include "JobSystem.hpp"
+#include "ShaderCache.hpp"
+#include "PipelineRegistry.hpp"
+#include "ShaderWatcher.hpp"
+#include "MeshPool.hpp"
+#include "MaterialTileValidation.hpp"
 
 //#define LOAD_RENDERDOC
 //#define FORCE_BACKGROUND_BLACK
@@ -21,6 +30,22 @@ int main(int argc, char* argv[])
     _set_abort_behavior(_CALL_REPORTFAULT, _WRITE_ABORT_MSG | _CALL_REPORTFAULT);
 
     Settings settings = ParseArgs(argc, argv);
+
+    // The benchmark renders offscreen without UI, the window is only kept for the device and input setup
+    Benchmark::Settings benchmarkSettings;
+    if (Benchmark::ParseArgs(argc, argv, benchmarkSettings))
+        RenderSettings::noUI = true;
+
+    // --visibility-64 switches the visibility buffer to the R32G32 encoding, it must be set before the shaders are requested
+    for (int i = 1; i < argc; i++)
+        if (std::string(argv[i]) == "--visibility-64")
+            RenderSettings::visibilityBuffer64Bit = true;
+    MaterialTileValidation::ParseArgs(argc, argv);
+
+    // CPU only, exits before creating the window
+    if (benchmarkSettings.boundsBenchmarkInstances > 0)
+        return Benchmark::RunBoundsBenchmark(benchmarkSettings.boundsBenchmarkInstances);
+
     AppBox app("ModernRenderer", settings);
     AppSize appSize = app.GetAppSize();
 
@@ -34,72 +59,161 @@ int main(int argc, char* argv[])
     RenderDoc::LoadRenderDoc();
 #endif
 
-    glfwSetInputMode(app.GetWindow(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (benchmarkSettings.enabled)
+        glfwHideWindow(app.GetWindow());
+    else
+        glfwSetInputMode(app.GetWindow(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     std::shared_ptr<Instance> instance = CreateInstance(settings.api_type);
     std::shared_ptr<Adapter> adapter = std::move(instance->EnumerateAdapters()[settings.required_gpu_index]);
     app.SetGpuName(adapter->GetName());
     std::shared_ptr<Device> device = adapter->CreateDevice();
     std::shared_ptr<CommandQueue> commandQueue = device->GetCommandQueue(CommandListType::kGraphics);
-    constexpr uint32_t swapchainTextureCount = 2;
-    std::shared_ptr<Swapchain> swapchain = device->CreateSwapchain(app.GetNativeWindow(), appSize.width(),
-                                                                   appSize.height(), swapchainTextureCount, settings.vsync);
-    uint64_t fence_value = 0;
-    std::shared_ptr<Fence> fence = device->CreateFence(fence_value);
+    // One more image than frames in flight so that acquiring the next image doesn't wait for the GPU
+    constexpr uint32_t swapchainTextureCount = FrameContext::framesInFlight + 1;
+    FrameContext::Init(device);
+    // Worker threads recording the render passes, stopped once the GPU is idle before every return below
+    JobSystem::Init();
+
+    // Compiled shaders are cached on disk, --no-shader-cache always runs the compiler
+    bool shaderCacheEnabled = true;
+    for (int i = 1; i < argc; i++)
+        if (std::string(argv[i]) == "--no-shader-cache")
+            shaderCacheEnabled = false;
+    ShaderCache::Init(device, "ShaderCache", shaderCacheEnabled);
+
+    // Shaders compile on the worker threads while the scene is imported, the first pipelines only wait for their own shaders
+    Sky::RequestShaders();
+    Renderer::RequestShaders();
 
     Camera camera = Camera(device, app);
 
-    // Load scene
-    auto scene = Scene::LoadHardcodedScene(device, camera);
+    // Load scene, --generate replaces the scene by a procedural stress scene
+    SceneGenerator::Settings generatorSettings;
+    std::shared_ptr<Scene> scene;
+    if (SceneGenerator::ParseArgs(argc, argv, generatorSettings))
+        scene = Scene::GenerateScene(device, camera, generatorSettings);
+    else
+        scene = benchmarkSettings.sceneName.empty() ? Scene::LoadHardcodedScene(device, camera) : Scene::LoadScene(device, camera, benchmarkSettings.sceneName);
+    if (!scene)
+    {
+        FrameContext::WaitIdle();
+        JobSystem::Shutdown();
+        return 1;
+    }
 
     // Create renderer
     Renderer renderer = Renderer(device, app, camera);
+    ShaderCache::PrintStatistics();
+    PipelineRegistry::PrintTimings();
+    RenderUtils::PrintBindingCacheStatistics();
+    MeshPool::PrintStatistics();
+
+    // Profiling options:
+    // --trace <file.json>: Chrome trace of the CPU and GPU markers
+    // --profiler-budgets <file>: GPU budget per marker, "Marker Name = milliseconds" per line
+    // --profiler-summary <file.json>: statistics of every marker written at exit
+    std::string profilerSummaryPath;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--trace")
+            Profiler::BeginTrace(argv[i + 1]);
+        else if (arg == "--profiler-budgets")
+            Profiler::LoadBudgets(argv[i + 1]);
+        else if (arg == "--profiler-summary")
+            profilerSummaryPath = argv[i + 1];
+    }
+
+    if (benchmarkSettings.enabled)
+    {
+        Benchmark benchmark(benchmarkSettings, adapter);
+        int result = benchmark.Run(device, renderer, camera, scene, appSize);
+        FrameContext::WaitIdle();
+        JobSystem::Shutdown();
+        Profiler::EndTrace();
+        if (!profilerSummaryPath.empty())
+            Profiler::WriteSummary(profilerSummaryPath);
+        return result;
+    }
+
+    std::shared_ptr<Swapchain> swapchain = device->CreateSwapchain(app.GetNativeWindow(), appSize.width(),
+                                                                   appSize.height(), swapchainTextureCount, settings.vsync);
+    uint64_t fence_value = 0;
+    std::shared_ptr<Fence> fence = device->CreateFence(fence_value);
 
     InputController inputController;
     app.SubscribeEvents((InputEvents*)&inputController, nullptr);
 
     ScreenShotController screenShotController(glfwGetWin32Window(app.GetWindow()), scene->name);
 
+    // --camera-path <file> plays a recorded path in a loop, F5 records a new one and F6 toggles the playback
+    CameraPathControls cameraPathControls;
+    if (!benchmarkSettings.cameraPathFile.empty())
+        cameraPathControls.Play(benchmarkSettings.cameraPathFile);
+
     inputController.registeredEvents.push_back((InputEvents*)&camera.cameraControls);
     inputController.registeredEvents.push_back((InputEvents*)&renderer.controls);
     inputController.registeredEvents.push_back((InputEvents*)&screenShotController);
+    inputController.registeredEvents.push_back((InputEvents*)&cameraPathControls);
 
-    // Allocate command lists for each swapchain image
-    std::array<uint64_t, swapchainTextureCount> fence_values = {};
-    std::vector<std::shared_ptr<CommandList>> command_lists;
-    for (uint32_t i = 0; i < swapchainTextureCount; ++i)
-    {
-        auto cmd = device->CreateCommandList(CommandListType::kGraphics);
-        cmd->SetName("Main Rendering");
-        command_lists.emplace_back(cmd);
-    }
+    // Edited shaders are recompiled in the background and swapped between two frames, --no-shader-hot-reload disables it
+    bool shaderHotReload = true;
+    for (int i = 1; i < argc; i++)
+        if (std::string(argv[i]) == "--no-shader-hot-reload")
+            shaderHotReload = false;
+    if (shaderHotReload)
+        ShaderWatcher::Start(MODERN_RENDERER_ASSETS_PATH "shaders");
 
     while (!app.PollEvents())
     {
+        // Pipelines using reloaded shaders are created again, the GPU must be done with the previous ones
+        if (PipelineRegistry::HasFinishedReloads())
+        {
+            FrameContext::WaitIdle();
+            PipelineRegistry::ApplyReloads();
+        }
+
         // Wait for the driver to release the lock
         uint32_t frame_index = swapchain->NextImage(fence, ++fence_value);
         commandQueue->Wait(fence, fence_value);
-        fence->Wait(fence_values[frame_index]);
 
+        // Wait for the GPU to release the frame context, which also completes the frame the profiler reads back
+        auto cmd = FrameContext::BeginFrame();
         Profiler::ReadbackStats(commandQueue);
+        MaterialTileValidation::BeginFrame();
         
         RenderDoc::StartFrameCapture();
 
         // Update camera controls and GPU buffer
+        cameraPathControls.BeginFrame(camera);
         camera.UpdateCamera(appSize);
+        cameraPathControls.EndFrame(camera);
 
         auto currentSwapchain = swapchain->GetBackBuffer(frame_index);
-        renderer.UpdateCommandList(command_lists[frame_index], currentSwapchain, camera, scene);
+        renderer.UpdateCommandList(cmd, currentSwapchain, camera, scene);
         
         // Then execute the rendering commands on the GPU.
-        commandQueue->ExecuteCommandLists({ command_lists[frame_index] });
+        FrameContext::Submit(commandQueue);
+        FrameContext::EndFrame(commandQueue);
+        MaterialTileValidation::ValidateFrame(*scene);
 
-        commandQueue->Signal(fence, fence_values[frame_index] = ++fence_value);
-        swapchain->Present(fence, fence_values[frame_index]);
+        commandQueue->Signal(fence, ++fence_value);
+        swapchain->Present(fence, fence_value);
 
         RenderDoc::EndFrameCapture();
     }
-    commandQueue->Signal(fence, ++fence_value);
-    fence->Wait(fence_value);
-    return 0;
+    ShaderWatcher::Stop();
+    FrameContext::WaitIdle();
+    JobSystem::Shutdown();
+    Profiler::EndTrace();
+
+    if (!profilerSummaryPath.empty())
+        Profiler::WriteSummary(profilerSummaryPath);
+
+    // Headless runs fail when a pass exceeds its budget or the material tiles don't match the CPU reference,
+    // so that regressions can be caught automatically
+    unsigned budgetViolations = Profiler::ReportBudgetViolations();
+    unsigned materialTileMismatches = MaterialTileValidation::ReportMismatches();
+    return RenderSettings::noUI && budgetViolations + materialTileMismatches > 0 ? 1 : 0;
 }
@@ -0,0 +1,135 @@
+#include "Test.hpp"
+#include "CompactionPlanner.hpp"
+#include <algorithm>
+
+using Range = CompactionPlanner::Range;
+using Move = CompactionPlanner::Move;
+
+static bool IsMove(const Move& move, uint32_t id, uint32_t from, uint32_t to, uint32_t size)
+{
+	return move.id == id && move.from == from && move.to == to && move.size == size;
+}
+
+TEST(CompactionPlanner, SlidesRangesToTheStart)
+{
+	std::vector<Range> ranges =
+	{
+		{ 1, 30, 10 },
+		{ 0, 10, 5 },
+		// Empty ranges are never moved
+		{ 2, 20, 0 },
+		{ 3, 40, 4 },
+	};
+
+	auto moves = CompactionPlanner::Plan(ranges);
+	CHECK(moves.size() == 3);
+	CHECK(IsMove(moves[0], 0, 10, 0, 5));
+	CHECK(IsMove(moves[1], 1, 30, 5, 10));
+	CHECK(IsMove(moves[2], 3, 40, 15, 4));
+	CHECK(CompactionPlanner::Validate(ranges, moves));
+
+	// Already compact
+	CHECK(CompactionPlanner::Plan({ { 0, 0, 5 }, { 1, 5, 5 } }).empty());
+	CHECK(CompactionPlanner::Plan({}).empty());
+}
+
+TEST(CompactionPlanner, PinnedRangesStayInPlace)
+{
+	// The pinned ranges share an id like the removed meshes of the MeshPool
+	std::vector<Range> ranges =
+	{
+		{ 0, 10, 5 },
+		{ UINT32_MAX, 0, 3, true },
+		{ UINT32_MAX, 20, 5, true },
+		{ 1, 40, 10 },
+		{ 2, 12, 6 },
+	};
+
+	auto moves = CompactionPlanner::Plan(ranges);
+	CHECK(moves.size() == 3);
+	// The ranges slide up to the end of the pinned range before them
+	CHECK(IsMove(moves[0], 0, 10, 3, 5));
+	CHECK(IsMove(moves[1], 2, 12, 8, 6));
+	CHECK(IsMove(moves[2], 1, 40, 25, 10));
+	for (const auto& move : moves)
+		CHECK(move.id != UINT32_MAX);
+	CHECK(CompactionPlanner::Validate(ranges, moves));
+}
+
+TEST(CompactionPlanner, ValidateRejectsUnsafeMoves)
+{
+	std::vector<Range> ranges =
+	{
+		{ 0, 10, 5 },
+		{ 1, 20, 5, true },
+		{ 2, 30, 5 },
+	};
+
+	CHECK(CompactionPlanner::Validate(ranges, { { 0, 10, 0, 5 }, { 2, 30, 5, 5 } }));
+	// Over a live or a pinned range
+	CHECK(!CompactionPlanner::Validate(ranges, { { 2, 30, 12, 5 } }));
+	CHECK(!CompactionPlanner::Validate(ranges, { { 2, 30, 18, 5 } }));
+	// Over a range that moved before
+	CHECK(!CompactionPlanner::Validate(ranges, { { 0, 10, 0, 5 }, { 2, 30, 3, 5 } }));
+	// A pinned range, a range that doesn't exist or a move that doesn't match the range
+	CHECK(!CompactionPlanner::Validate(ranges, { { 1, 20, 0, 5 } }));
+	CHECK(!CompactionPlanner::Validate(ranges, { { 3, 40, 0, 5 } }));
+	CHECK(!CompactionPlanner::Validate(ranges, { { 0, 11, 0, 4 } }));
+	CHECK(!CompactionPlanner::Validate(ranges, { { 0, 10, 0, 5 }, { 0, 10, 15, 5 } }));
+}
+
+TEST(CompactionPlanner, Relocate)
+{
+	Move move = { 0, 100, 40, 20 };
+	CHECK(CompactionPlanner::Relocate(100, move) == 40);
+	CHECK(CompactionPlanner::Relocate(119, move) == 59);
+
+	uint32_t values[] = { 100, 105, 119 };
+	CompactionPlanner::Relocate(values, 3, move);
+	CHECK(values[0] == 40 && values[1] == 45 && values[2] == 59);
+}
+
+TEST(CompactionPlanner, RandomRanges)
+{
+	TestRandom random(11);
+	for (unsigned iteration = 0; iteration < 500; iteration++)
+	{
+		std::vector<Range> ranges;
+		uint32_t offset = 0;
+		unsigned rangeCount = random.NextIndex(30);
+		for (uint32_t id = 0; id < rangeCount; id++)
+		{
+			offset += random.NextIndex(3) == 0 ? random.NextIndex(50) : 0;
+			uint32_t size = random.NextIndex(10) == 0 ? 0 : 1 + random.NextIndex(40);
+			bool pinned = random.NextIndex(6) == 0;
+			ranges.push_back({ pinned ? UINT32_MAX : id, offset, size, pinned });
+			offset += size;
+		}
+		// The planner sorts the ranges
+		for (size_t i = ranges.size(); i > 1; i--)
+			std::swap(ranges[i - 1], ranges[random.NextIndex((uint32_t)i)]);
+
+		auto moves = CompactionPlanner::Plan(ranges);
+		CHECK(CompactionPlanner::Validate(ranges, moves));
+		for (size_t i = 1; i < moves.size(); i++)
+			CHECK(moves[i - 1].to < moves[i].to);
+
+		// Every range that isn't pinned ends up right after the previous range
+		std::vector<Range> result = ranges;
+		for (const auto& move : moves)
+		{
+			for (auto& range : result)
+				if (!range.pinned && range.id == move.id)
+					range.offset = move.to;
+		}
+		std::sort(result.begin(), result.end(), [](const Range& a, const Range& b) { return a.offset < b.offset; });
+		uint32_t end = 0;
+		for (const auto& range : result)
+		{
+			if (range.size == 0)
+				continue;
+			CHECK(range.pinned ? range.offset >= end : range.offset == end);
+			end = range.offset + range.size;
+		}
+	}
+}
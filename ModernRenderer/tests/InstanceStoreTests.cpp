@@ -0,0 +1,89 @@
+#include "Test.hpp"
+#include "InstanceStore.hpp"
+#include "MatrixUtils.hpp"
+#include <cmath>
+
+struct TestInstances
+{
+	InstanceStore store;
+	std::vector<glm::mat4> transforms;
+	std::vector<AABB> bounds;
+};
+
+// Random rotations, non uniform scales and translations, stored transposed like the scene transforms
+static TestInstances CreateInstances(unsigned count, uint64_t seed)
+{
+	TestRandom random(seed);
+	auto signedUnit = [&]() { return random.NextFloat() * 2.0f - 1.0f; };
+
+	TestInstances instances;
+	for (unsigned i = 0; i < count; i++)
+	{
+		glm::vec3 position = glm::vec3(signedUnit(), signedUnit(), signedUnit()) * 1000.0f;
+		glm::vec3 rotation = glm::vec3(signedUnit(), signedUnit(), signedUnit()) * 180.0f;
+		glm::vec3 scale = glm::vec3(0.1f) + glm::vec3(random.NextFloat(), random.NextFloat(), random.NextFloat()) * 10.0f;
+		glm::mat4 transform = glm::transpose(MatrixUtils::Translation(position) * MatrixUtils::Rotation(rotation) * MatrixUtils::Scale(scale));
+
+		glm::vec3 center = glm::vec3(signedUnit(), signedUnit(), signedUnit()) * 50.0f;
+		glm::vec3 extents = glm::vec3(0.01f) + glm::vec3(random.NextFloat(), random.NextFloat(), random.NextFloat()) * 20.0f;
+		instances.transforms.push_back(transform);
+		instances.bounds.push_back(AABB{ center - extents, center + extents });
+		instances.store.Add(transform, instances.bounds.back(), i, 1, 0);
+	}
+	return instances;
+}
+
+static bool Near(float a, float b)
+{
+	return std::abs(a - b) <= 1e-5f * std::max(1.0f, std::max(std::abs(a), std::abs(b)));
+}
+
+static bool Near(const glm::vec3& a, const glm::vec3& b)
+{
+	return Near(a.x, b.x) && Near(a.y, b.y) && Near(a.z, b.z);
+}
+
+static bool SameOBB(const OBB& a, const OBB& b)
+{
+	return Near(a.right, b.right) && Near(a.up, b.up) && Near(a.center, b.center)
+		&& Near(a.extentRight, b.extentRight) && Near(a.extentUp, b.extentUp) && Near(a.extentForward, b.extentForward);
+}
+
+static bool IsCleared(const OBB& obb)
+{
+	return obb.right == glm::vec3(0.0f) && obb.up == glm::vec3(0.0f) && obb.center == glm::vec3(0.0f)
+		&& obb.extentRight == 0.0f && obb.extentUp == 0.0f && obb.extentForward == 0.0f;
+}
+
+// A range starting in the middle of a batch with a count that isn't a multiple of the batch size: the AVX batches and
+// the scalar tail must match ComputeBoundsScalar, and the instances outside the range must not be written
+TEST(InstanceStore, BatchesMatchScalar)
+{
+	const unsigned count = 61;
+	const size_t first = 3;
+	const size_t rangeCount = 53;
+	CHECK(rangeCount % InstanceStore::batchSize != 0);
+
+	InstanceStore batched = CreateInstances(count, 48).store;
+	InstanceStore scalar = batched;
+	batched.ComputeBounds(first, rangeCount);
+	scalar.ComputeBoundsScalar(first, rangeCount);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (i < first || i >= first + rangeCount)
+			CHECK(IsCleared(batched.GetOBB(i)));
+		else
+			CHECK(SameOBB(batched.GetOBB(i), scalar.GetOBB(i)));
+	}
+}
+
+TEST(InstanceStore, MatchesOBBConstructor)
+{
+	const unsigned count = 45;
+	TestInstances instances = CreateInstances(count, 49);
+	instances.store.ComputeBounds(0, count);
+
+	for (unsigned i = 0; i < count; i++)
+		CHECK(SameOBB(instances.store.GetOBB(i), OBB(instances.bounds[i], instances.transforms[i])));
+}
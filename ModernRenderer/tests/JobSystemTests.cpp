@@ -0,0 +1,72 @@
+#include "Test.hpp"
+#include "JobSystem.hpp"
+#include <chrono>
+#include <thread>
+
+TEST(JobSystem, ParallelFor)
+{
+	JobSystem::Init(3);
+	std::vector<std::atomic<unsigned>> calls(1000);
+	JobSystem::ParallelFor((unsigned)calls.size(), [&](unsigned index) { calls[index]++; });
+	JobSystem::Shutdown();
+
+	bool calledOnce = true;
+	for (auto& count : calls)
+		calledOnce = calledOnce && count == 1;
+	CHECK(calledOnce);
+}
+
+// Background jobs are left to the worker threads: the main thread waiting for them while the only worker is busy
+// doesn't run them
+TEST(JobSystem, BackgroundJobsSkipMainThread)
+{
+	JobSystem::Init(1);
+	std::thread::id mainThread = std::this_thread::get_id();
+
+	std::atomic<bool> started = false;
+	std::atomic<bool> released = false;
+	JobSystem::Counter blockingCounter = 0;
+	JobSystem::Schedule([&]()
+	{
+		started = true;
+		while (!released)
+			std::this_thread::yield();
+	}, blockingCounter);
+	while (!started)
+		std::this_thread::yield();
+
+	JobSystem::Counter backgroundCounter = 0;
+	std::vector<std::thread::id> backgroundThreads(16);
+	for (unsigned i = 0; i < backgroundThreads.size(); i++)
+		JobSystem::ScheduleBackground([&, i]() { backgroundThreads[i] = std::this_thread::get_id(); }, backgroundCounter);
+
+	std::thread releaser([&]()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		released = true;
+	});
+	JobSystem::Wait(backgroundCounter);
+	releaser.join();
+	JobSystem::Wait(blockingCounter);
+	JobSystem::Shutdown();
+
+	bool mainThreadUsed = false;
+	for (std::thread::id id : backgroundThreads)
+		mainThreadUsed = mainThreadUsed || id == mainThread;
+	CHECK(!mainThreadUsed);
+}
+
+TEST(JobSystem, BackgroundWithoutWorkers)
+{
+	// Without worker thread the job runs immediately on the calling thread
+	JobSystem::Counter counter = 0;
+	bool ran = false;
+	JobSystem::ScheduleBackground([&]() { ran = true; }, counter);
+	CHECK(ran && counter == 0);
+
+	JobSystem::Init(0);
+	ran = false;
+	JobSystem::ScheduleBackground([&]() { ran = true; }, counter);
+	CHECK(ran && counter == 0);
+	JobSystem::Shutdown();
+}
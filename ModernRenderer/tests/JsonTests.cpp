@@ -0,0 +1,33 @@
+#include "Test.hpp"
+#include "Json.hpp"
+
+static bool RoundTrip(const std::string& value)
+{
+	JsonValue document;
+	std::string error;
+	if (!JsonValue::Parse("{ \"value\": \"" + EscapeJSON(value) + "\" }", document, error))
+		return false;
+	return document.GetString("value", "") == value;
+}
+
+TEST(Json, EscapeQuotesAndBackslashes)
+{
+	CHECK(EscapeJSON("plain") == "plain");
+	CHECK(EscapeJSON("a \"b\"") == "a \\\"b\\\"");
+	CHECK(EscapeJSON("C:\\scenes\\sponza.json") == "C:\\\\scenes\\\\sponza.json");
+}
+
+TEST(Json, EscapeControlCharacters)
+{
+	CHECK(EscapeJSON("a\nb") == "a\\u000ab");
+	CHECK(EscapeJSON(std::string("\t\x01", 2)) == "\\u0009\\u0001");
+}
+
+TEST(Json, EscapedStringsParseBack)
+{
+	CHECK(RoundTrip(""));
+	CHECK(RoundTrip("Sponza"));
+	CHECK(RoundTrip("C:\\paths\\\"quoted\" name.json"));
+	CHECK(RoundTrip("line\nbreak\ttab\r\x1f"));
+	CHECK(RoundTrip("\\u0041 is not an escape"));
+}
@@ -0,0 +1,192 @@
+#include "Test.hpp"
+#include "MaterialClassification.hpp"
+
+// Arguments of ClassifyTiles, the visible meshlet i belongs to the instance i
+struct ClassificationInput
+{
+	unsigned width = 0;
+	unsigned height = 0;
+	std::vector<uint32_t> visibility;
+	std::vector<float> depth;
+	std::vector<SoftwareRasterizer::VisibleMeshlet> visibleMeshlets;
+	std::vector<Scene::InstanceData> instances;
+};
+
+// getMeshlet returns the visible meshlet covering a pixel, UINT32_MAX for empty pixels
+static ClassificationInput CreateInput(VisibilityBuffer::Format format, const std::vector<unsigned>& materials, unsigned width, unsigned height,
+	unsigned (*getMeshlet)(unsigned x, unsigned y))
+{
+	ClassificationInput input;
+	input.width = width;
+	input.height = height;
+	for (unsigned i = 0; i < materials.size(); i++)
+	{
+		Scene::InstanceData instance = {};
+		instance.materialIndex = materials[i];
+		input.instances.push_back(instance);
+		// The meshlet index isn't read by the classification
+		input.visibleMeshlets.push_back({ i, 0 });
+	}
+
+	unsigned componentCount = VisibilityBuffer::GetComponentCount(format);
+	input.visibility.resize(width * height * componentCount, 0);
+	input.depth.resize(width * height, 1.0f);
+	for (unsigned y = 0; y < height; y++)
+	{
+		for (unsigned x = 0; x < width; x++)
+		{
+			unsigned meshlet = getMeshlet(x, y);
+			if (meshlet == UINT32_MAX)
+				continue;
+
+			unsigned pixel = y * width + x;
+			input.depth[pixel] = 0.5f;
+			if (format == VisibilityBuffer::Format::R32G32)
+			{
+				uint64_t visibility = VisibilityBuffer::EncodeVisibility64(meshlet, meshlet, 3);
+				input.visibility[pixel * 2] = (uint32_t)visibility;
+				input.visibility[pixel * 2 + 1] = (uint32_t)(visibility >> 32);
+			}
+			else
+				input.visibility[pixel] = VisibilityBuffer::EncodeVisibility(meshlet, 3);
+		}
+	}
+	return input;
+}
+
+// 20x12 pixels, 3x2 tiles with partial tiles on the right and bottom. Meshlet 0 covers the left half, meshlet 1
+// the bottom right corner and meshlet 2 a single pixel of the last partial tile.
+static unsigned GetTestMeshlet(unsigned x, unsigned y)
+{
+	if (x == 19 && y == 11)
+		return 2;
+	if (x < 10)
+		return 0;
+	if (y >= 8 && x >= 12)
+		return 1;
+	return UINT32_MAX;
+}
+
+static MaterialClassification::TileLists Classify(const ClassificationInput& input, VisibilityBuffer::Format format, unsigned materialCount)
+{
+	return MaterialClassification::ClassifyTiles(input.visibility, input.depth, input.width, input.height, format, input.visibleMeshlets, input.instances, materialCount);
+}
+
+TEST(MaterialClassification, ClassifyTiles)
+{
+	for (auto format : { VisibilityBuffer::Format::R32, VisibilityBuffer::Format::R32G32 })
+	{
+		// Meshlets 0 and 2 share material 1, material 0 isn't used
+		auto input = CreateInput(format, { 1, 2, 1 }, 20, 12, GetTestMeshlet);
+		auto lists = Classify(input, format, 3);
+
+		using MC = MaterialClassification;
+		CHECK(lists.tileCountX == 3 && lists.tileCountY == 2);
+		CHECK(lists.materialTiles.size() == 3);
+		CHECK(lists.materialTiles[0].empty());
+		CHECK((lists.materialTiles[1] == std::vector<uint32_t>{ MC::PackTile(0, 0), MC::PackTile(1, 0), MC::PackTile(0, 1), MC::PackTile(1, 1), MC::PackTile(2, 1) }));
+		CHECK((lists.materialTiles[2] == std::vector<uint32_t>{ MC::PackTile(1, 1), MC::PackTile(2, 1) }));
+	}
+}
+
+TEST(MaterialClassification, FromGPUBuffers)
+{
+	// Fixed size list per material, the counts can exceed the capacity when the classification overflows
+	const unsigned tileCountX = 2;
+	const unsigned tileCountY = 2;
+	std::vector<uint32_t> tileCounts = { 1, 0, 9 };
+	std::vector<uint32_t> tiles =
+	{
+		7, 0, 0, 0,
+		0, 0, 0, 0,
+		1, 2, 3, 4,
+	};
+
+	auto lists = MaterialClassification::FromGPUBuffers(tileCounts, tiles, tileCountX, tileCountY);
+	CHECK(lists.tileCountX == tileCountX && lists.tileCountY == tileCountY);
+	CHECK(lists.materialTiles.size() == 3);
+	CHECK((lists.materialTiles[0] == std::vector<uint32_t>{ 7 }));
+	CHECK(lists.materialTiles[1].empty());
+	CHECK((lists.materialTiles[2] == std::vector<uint32_t>{ 1, 2, 3, 4 }));
+}
+
+TEST(MaterialClassification, CompareTileLists)
+{
+	MaterialClassification::TileLists reference;
+	reference.tileCountX = 4;
+	reference.tileCountY = 4;
+	reference.materialTiles = { { 1, 2, 3 }, { 4 }, {} };
+
+	// The GPU appends the tiles in any order
+	MaterialClassification::TileLists other = reference;
+	other.materialTiles[0] = { 3, 1, 2 };
+	auto comparison = MaterialClassification::CompareTileLists(reference, other);
+	CHECK(comparison.IsIdentical());
+	CHECK(comparison.missingTileCount == 0 && comparison.extraTileCount == 0 && comparison.duplicatedTileCount == 0);
+
+	// One missing tile in material 0, an extra one in material 1 and a duplicated one in material 2
+	other.materialTiles = { { 3, 1 }, { 4, 5 }, { 6, 6 } };
+	reference.materialTiles[2] = { 6 };
+	comparison = MaterialClassification::CompareTileLists(reference, other);
+	CHECK(!comparison.IsIdentical());
+	CHECK(!comparison.layoutMismatch);
+	CHECK(comparison.mismatchedMaterialCount == 3);
+	CHECK(comparison.missingTileCount == 1);
+	CHECK(comparison.extraTileCount == 1);
+	CHECK(comparison.duplicatedTileCount == 1);
+
+	other = reference;
+	other.tileCountY = 5;
+	CHECK(MaterialClassification::CompareTileLists(reference, other).layoutMismatch);
+	other = reference;
+	other.materialTiles.pop_back();
+	CHECK(MaterialClassification::CompareTileLists(reference, other).layoutMismatch);
+}
+
+// Same comparison as MaterialTileValidation, with GPU buffers holding the reference tiles in reverse order
+TEST(MaterialClassification, GPUBuffersMatchReference)
+{
+	auto format = VisibilityBuffer::Format::R32;
+	auto input = CreateInput(format, { 0, 1, 2 }, 20, 12, GetTestMeshlet);
+	auto reference = Classify(input, format, 3);
+
+	unsigned listCapacity = reference.tileCountX * reference.tileCountY;
+	std::vector<uint32_t> tileCounts;
+	std::vector<uint32_t> tiles(3 * listCapacity, 0xDEAD);
+	for (unsigned material = 0; material < 3; material++)
+	{
+		const auto& list = reference.materialTiles[material];
+		tileCounts.push_back((uint32_t)list.size());
+		std::copy(list.rbegin(), list.rend(), tiles.begin() + material * listCapacity);
+	}
+
+	auto gpuLists = MaterialClassification::FromGPUBuffers(tileCounts, tiles, reference.tileCountX, reference.tileCountY);
+	CHECK(MaterialClassification::CompareTileLists(reference, gpuLists).IsIdentical());
+
+	// A tile dropped by the GPU is reported as missing
+	tileCounts[0]--;
+	gpuLists = MaterialClassification::FromGPUBuffers(tileCounts, tiles, reference.tileCountX, reference.tileCountY);
+	auto comparison = MaterialClassification::CompareTileLists(reference, gpuLists);
+	CHECK(comparison.mismatchedMaterialCount == 1 && comparison.missingTileCount == 1);
+}
+
+// The GPU visibility texture read back can reference data the CPU doesn't have, those pixels are counted and skipped
+TEST(MaterialClassification, InvalidPixels)
+{
+	auto format = VisibilityBuffer::Format::R32;
+	auto input = CreateInput(format, { 1, 2, 1 }, 20, 12, GetTestMeshlet);
+	CHECK(Classify(input, format, 3).invalidPixelCount == 0);
+
+	// Pixel (0, 0) references a visible meshlet past the end of the list, pixel (1, 0) a missing instance
+	input.visibleMeshlets.push_back({ 7, 0 });
+	input.visibility[0] = VisibilityBuffer::EncodeVisibility(4, 0);
+	input.visibility[1] = VisibilityBuffer::EncodeVisibility(3, 0);
+	// Meshlet 2 uses a material past the material count
+	input.instances[2].materialIndex = 3;
+
+	auto lists = Classify(input, format, 3);
+	CHECK(lists.invalidPixelCount == 3);
+	// Tile (0, 0) is still classified from its valid pixels, the tile (2, 1) only had meshlet 2
+	CHECK((lists.materialTiles[1] == std::vector<uint32_t>{ MaterialClassification::PackTile(0, 0), MaterialClassification::PackTile(1, 0),
+		MaterialClassification::PackTile(0, 1), MaterialClassification::PackTile(1, 1) }));
+}
@@ -0,0 +1,127 @@
+#include "Test.hpp"
+#include "MatrixUtils.hpp"
+#include <cfloat>
+#include <cmath>
+
+// Points spread evenly over a unit sphere (Fibonacci lattice)
+static std::vector<glm::vec3> GetUnitSpherePoints(unsigned count)
+{
+	std::vector<glm::vec3> points;
+	const float goldenAngle = 3.14159265f * (3.0f - sqrt(5.0f));
+	for (unsigned i = 0; i < count; i++)
+	{
+		float y = 1.0f - 2.0f * (i + 0.5f) / count;
+		float r = sqrt(1.0f - y * y);
+		float phi = goldenAngle * i;
+		points.push_back(glm::vec3(cos(phi) * r, y, sin(phi) * r));
+	}
+	return points;
+}
+
+// View space spheres in front of the camera, from centered to far off the view axis
+static std::vector<glm::vec4> GetTestSpheres(float nearPlane)
+{
+	std::vector<glm::vec4> spheres;
+	for (float radius : { 0.01f, 0.5f, 3.0f })
+	{
+		for (float z : { 0.05f, 1.0f, 10.0f, 200.0f })
+		{
+			for (float x : { -2.0f, -0.5f, 0.0f, 0.7f, 3.0f })
+			{
+				for (float y : { -1.5f, 0.0f, 0.3f, 2.0f })
+				{
+					// Offsets relative to the depth so that the off axis spheres stay at a similar angle
+					glm::vec3 center(x * z, y * z, z + radius + nearPlane);
+					spheres.push_back(glm::vec4(center, radius));
+				}
+			}
+		}
+	}
+	return spheres;
+}
+
+TEST(MatrixUtils, ProjectSphereContainsProjectedSurface)
+{
+	const float nearPlane = 0.1f;
+	glm::mat4x4 projection = MatrixUtils::Perspective(60.0f, 16.0f / 9.0f, nearPlane, 1000.0f);
+	float p00 = projection[0][0];
+	float p11 = projection[1][1];
+	auto points = GetUnitSpherePoints(4096);
+
+	for (const auto& sphere : GetTestSpheres(nearPlane))
+	{
+		glm::vec3 center(sphere);
+		glm::vec4 boundsNDC;
+		CHECK(MatrixUtils::ProjectSphere(center, sphere.w, nearPlane, p00, p11, boundsNDC));
+		CHECK(boundsNDC.x <= boundsNDC.z && boundsNDC.y <= boundsNDC.w);
+
+		// Every point of the surface projects inside the bounds, and the bounds are tight: the sampled points
+		// reach each edge up to the spacing of the samples
+		glm::vec4 sampledBounds(FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (const auto& point : points)
+		{
+			glm::vec3 pointVS = center + point * sphere.w;
+			float x = pointVS.x / pointVS.z * p00;
+			float y = pointVS.y / pointVS.z * p11;
+			sampledBounds = glm::vec4(std::min(sampledBounds.x, x), std::min(sampledBounds.y, y), std::max(sampledBounds.z, x), std::max(sampledBounds.w, y));
+		}
+
+		float extent = std::max(boundsNDC.z - boundsNDC.x, boundsNDC.w - boundsNDC.y);
+		float epsilon = 1e-5f * std::max(1.0f, std::max(std::abs(boundsNDC.x), std::abs(boundsNDC.z)));
+		CHECK(boundsNDC.x <= sampledBounds.x + epsilon);
+		CHECK(boundsNDC.y <= sampledBounds.y + epsilon);
+		CHECK(boundsNDC.z >= sampledBounds.z - epsilon);
+		CHECK(boundsNDC.w >= sampledBounds.w - epsilon);
+
+		float tolerance = 0.01f * extent + epsilon;
+		CHECK(sampledBounds.x - boundsNDC.x <= tolerance);
+		CHECK(sampledBounds.y - boundsNDC.y <= tolerance);
+		CHECK(boundsNDC.z - sampledBounds.z <= tolerance);
+		CHECK(boundsNDC.w - sampledBounds.w <= tolerance);
+	}
+}
+
+TEST(MatrixUtils, ProjectedSphereSizeIsConservative)
+{
+	const float nearPlane = 0.1f;
+	const glm::vec2 resolution(1920, 1080);
+	glm::mat4x4 projection = MatrixUtils::Perspective(60.0f, resolution.x / resolution.y, nearPlane, 1000.0f);
+	float p00 = projection[0][0];
+	float p11 = projection[1][1];
+	auto points = GetUnitSpherePoints(4096);
+
+	for (const auto& sphere : GetTestSpheres(nearPlane))
+	{
+		glm::vec3 center(sphere);
+		float size = MatrixUtils::GetProjectedSphereSizeInPixels(center, sphere.w, nearPlane, p00, p11, resolution);
+
+		// Largest distance in pixels along x or y between two projected points of the surface
+		glm::vec2 minPixel(FLT_MAX);
+		glm::vec2 maxPixel(-FLT_MAX);
+		for (const auto& point : points)
+		{
+			glm::vec3 pointVS = center + point * sphere.w;
+			glm::vec2 pixel(pointVS.x / pointVS.z * p00 * 0.5f * resolution.x, pointVS.y / pointVS.z * p11 * 0.5f * resolution.y);
+			minPixel = glm::min(minPixel, pixel);
+			maxPixel = glm::max(maxPixel, pixel);
+		}
+
+		// The float rounding of the far off axis samples is around 1e-4 pixels, well below the culling threshold
+		float sampledSize = std::max(maxPixel.x - minPixel.x, maxPixel.y - minPixel.y);
+		CHECK(size >= sampledSize * (1.0f - 1e-5f) - 1e-3f);
+	}
+}
+
+TEST(MatrixUtils, ProjectSphereCrossingNearPlaneIsUnbounded)
+{
+	const float nearPlane = 0.1f;
+	glm::vec4 boundsNDC;
+
+	// Crossing the near plane, behind the camera and containing the camera
+	CHECK(!MatrixUtils::ProjectSphere(glm::vec3(0, 0, 0.5f), 1.0f, nearPlane, 1.0f, 1.0f, boundsNDC));
+	CHECK(!MatrixUtils::ProjectSphere(glm::vec3(2, 0, -5.0f), 1.0f, nearPlane, 1.0f, 1.0f, boundsNDC));
+	CHECK(!MatrixUtils::ProjectSphere(glm::vec3(0, 0, 0), 1.0f, nearPlane, 1.0f, 1.0f, boundsNDC));
+
+	// Unbounded spheres are never culled as small features
+	CHECK(MatrixUtils::GetProjectedSphereSizeInPixels(glm::vec3(0, 0, 0.5f), 1.0f, nearPlane, 1.0f, 1.0f, glm::vec2(1920, 1080)) == FLT_MAX);
+}
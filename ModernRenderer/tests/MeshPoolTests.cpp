@@ -0,0 +1,205 @@
+#include "Test.hpp"
+#include "MeshPool.hpp"
+
+// Empties the MeshPool before and after a test, the heaps are never resident in the tests
+class TestPool
+{
+public:
+	TestPool() { Clear(); }
+	~TestPool() { Clear(); }
+
+	static void Clear()
+	{
+		MeshPool::meshes.clear();
+		MeshPool::meshlets.clear();
+		MeshPool::meshletIndices.clear();
+		MeshPool::meshletTriangles.clear();
+		MeshPool::vertices.clear();
+		MeshPool::bounds.clear();
+		MeshPool::indices.clear();
+		MeshPool::vertexAllocator.Reset(MeshPool::defaultVertexCapacity);
+		MeshPool::indexAllocator.Reset(MeshPool::defaultIndexCapacity);
+		MeshPool::meshletAllocator.Reset(MeshPool::defaultMeshletCapacity);
+		MeshPool::meshletIndexAllocator.Reset(MeshPool::defaultMeshletIndexCapacity);
+		MeshPool::meshletTriangleAllocator.Reset(MeshPool::defaultMeshletTriangleCapacity);
+	}
+};
+
+// Mesh with meshletCount meshlets of vertexCount vertices, the data depends on the seed to detect misplaced copies
+static std::shared_ptr<Mesh> CreateMesh(unsigned seed, unsigned meshletCount, unsigned vertexCount)
+{
+	auto mesh = std::make_shared<Mesh>();
+	mesh->name = "Mesh " + std::to_string(seed);
+
+	unsigned meshletVertexCount = std::min(vertexCount, 8u);
+	for (unsigned i = 0; i < vertexCount; i++)
+	{
+		Mesh::Vertex vertex = {};
+		vertex.position = glm::vec3((float)seed, (float)i, 0.0f);
+		mesh->vertices.push_back(vertex);
+	}
+
+	for (unsigned m = 0; m < meshletCount; m++)
+	{
+		meshopt_Meshlet meshlet = {};
+		meshlet.vertex_offset = (unsigned)mesh->meshletIndices.size();
+		meshlet.triangle_offset = (unsigned)mesh->meshletTriangles.size();
+		meshlet.vertex_count = meshletVertexCount;
+		meshlet.triangle_count = meshletVertexCount - 2;
+		mesh->meshlets.push_back(meshlet);
+
+		meshopt_Bounds bounds = {};
+		bounds.radius = (float)(seed * 100 + m);
+		mesh->meshletBounds.push_back(bounds);
+
+		for (unsigned v = 0; v < meshletVertexCount; v++)
+			mesh->meshletIndices.push_back((m + v + seed) % vertexCount);
+		for (unsigned t = 0; t < meshlet.triangle_count; t++)
+		{
+			uint8_t triangle[] = { 0, (uint8_t)(t + 1), (uint8_t)(t + 2) };
+			mesh->meshletTriangles.insert(mesh->meshletTriangles.end(), triangle, triangle + 3);
+			for (uint8_t vertex : triangle)
+				mesh->indices.push_back(mesh->meshletIndices[meshlet.vertex_offset + vertex]);
+		}
+	}
+
+	mesh->meshletCount = mesh->meshlets.size();
+	return mesh;
+}
+
+// The CPU copy of the heaps contains the mesh at its ranges, with the offsets of the ranges added to the references
+static bool IsMeshInPool(const std::shared_ptr<Mesh>& mesh)
+{
+	auto f = MeshPool::meshes.find(mesh);
+	if (f == MeshPool::meshes.end())
+		return false;
+	const MeshPool::MeshAllocation& allocation = f->second;
+
+	if (mesh->meshletOffset != (int)allocation.meshlets.offset || mesh->raytracedPrimitiveIndex != allocation.indices.offset)
+		return false;
+	if (allocation.vertices.size != mesh->vertices.size() || allocation.indices.size != mesh->indices.size()
+		|| allocation.meshlets.size != mesh->meshlets.size() || allocation.meshletIndices.size != mesh->meshletIndices.size()
+		|| allocation.meshletTriangles.size != mesh->meshletTriangles.size())
+		return false;
+
+	for (uint32_t i = 0; i < allocation.vertices.size; i++)
+		if (MeshPool::vertices[allocation.vertices.offset + i].position != mesh->vertices[i].position)
+			return false;
+	for (uint32_t i = 0; i < allocation.indices.size; i++)
+		if (MeshPool::indices[allocation.indices.offset + i] != mesh->indices[i] + allocation.vertices.offset)
+			return false;
+	for (uint32_t i = 0; i < allocation.meshletIndices.size; i++)
+		if (MeshPool::meshletIndices[allocation.meshletIndices.offset + i] != mesh->meshletIndices[i] + allocation.vertices.offset)
+			return false;
+	for (uint32_t i = 0; i < allocation.meshletTriangles.size; i++)
+		if (MeshPool::meshletTriangles[allocation.meshletTriangles.offset + i] != mesh->meshletTriangles[i])
+			return false;
+	for (uint32_t i = 0; i < allocation.meshlets.size; i++)
+	{
+		const meshopt_Meshlet& meshlet = MeshPool::meshlets[allocation.meshlets.offset + i];
+		if (meshlet.vertex_offset != mesh->meshlets[i].vertex_offset + allocation.meshletIndices.offset
+			|| meshlet.triangle_offset != mesh->meshlets[i].triangle_offset + allocation.meshletTriangles.offset
+			|| meshlet.vertex_count != mesh->meshlets[i].vertex_count || meshlet.triangle_count != mesh->meshlets[i].triangle_count)
+			return false;
+		if (MeshPool::bounds[allocation.meshlets.offset + i].radius != mesh->meshletBounds[i].radius)
+			return false;
+	}
+	return true;
+}
+
+// No hole before the end of the last range of every heap
+static bool IsCompact()
+{
+	for (const auto& heap : MeshPool::GetHeapStatistics())
+		if (heap.allocator.usedEnd != heap.allocator.usedSize)
+			return false;
+	return true;
+}
+
+TEST(MeshPool, PushNewMesh)
+{
+	TestPool pool;
+	auto a = CreateMesh(1, 3, 20);
+	auto b = CreateMesh(2, 2, 10);
+
+	CHECK(MeshPool::PushNewMesh(a) == 0);
+	CHECK(MeshPool::PushNewMesh(b) == 3);
+	// Pushed once
+	CHECK(MeshPool::PushNewMesh(a) == 0);
+	CHECK(MeshPool::meshes.size() == 2);
+
+	CHECK(IsMeshInPool(a));
+	CHECK(IsMeshInPool(b));
+	CHECK(MeshPool::meshes[b].vertices.offset == 20);
+	CHECK(b->raytracedPrimitiveIndex == a->indices.size());
+}
+
+TEST(MeshPool, CompactionRewritesReferences)
+{
+	TestPool pool;
+	auto a = CreateMesh(1, 3, 20);
+	auto b = CreateMesh(2, 4, 30);
+	auto c = CreateMesh(3, 2, 12);
+	auto d = CreateMesh(4, 5, 40);
+	for (const auto& mesh : { a, b, c, d })
+		MeshPool::PushNewMesh(mesh);
+
+	MeshPool::MeshAllocation before = MeshPool::meshes[d];
+	// Before the heaps are resident the ranges are released right away
+	MeshPool::RemoveMesh(b);
+	CHECK(!IsCompact());
+
+	CHECK(MeshPool::Compact());
+	CHECK(IsCompact());
+	for (const auto& mesh : { a, c, d })
+		CHECK(IsMeshInPool(mesh));
+	CHECK(MeshPool::meshes.count(b) == 0);
+
+	// The meshes after the removed one moved in every heap
+	const MeshPool::MeshAllocation& after = MeshPool::meshes[d];
+	CHECK(after.vertices.offset == before.vertices.offset - 30);
+	CHECK(after.meshlets.offset == before.meshlets.offset - 4);
+	CHECK(d->meshletOffset == 3 + 2);
+	CHECK(d->raytracedPrimitiveIndex == a->indices.size() + c->indices.size());
+
+	// The CPU copy ends at the last range, it is uploaded whole when the heaps are created
+	CHECK(MeshPool::vertices.size() == 20 + 12 + 40);
+	CHECK(MeshPool::meshlets.size() == 3 + 2 + 5);
+	CHECK(MeshPool::bounds.size() == MeshPool::meshlets.size());
+
+	// Nothing to move
+	CHECK(MeshPool::Compact());
+	CHECK(IsMeshInPool(d));
+}
+
+TEST(MeshPool, RandomRemovals)
+{
+	TestPool pool;
+	TestRandom random(5);
+
+	std::vector<std::shared_ptr<Mesh>> live;
+	for (unsigned round = 0; round < 20; round++)
+	{
+		for (unsigned i = 0; i < 8; i++)
+		{
+			auto mesh = CreateMesh(round * 8 + i, 1 + random.NextIndex(6), 3 + random.NextIndex(60));
+			CHECK(MeshPool::PushNewMesh(mesh) != MeshPool::invalidMeshletOffset);
+			live.push_back(mesh);
+		}
+		for (unsigned i = 0; i < 4; i++)
+		{
+			size_t index = random.NextIndex((uint32_t)live.size());
+			MeshPool::RemoveMesh(live[index]);
+			live.erase(live.begin() + index);
+		}
+
+		// Compacted every other round so that the new meshes also fill holes
+		if (round % 2 == 1)
+		{
+			CHECK(MeshPool::Compact());
+			CHECK(IsCompact());
+		}
+		for (const auto& mesh : live)
+			CHECK(IsMeshInPool(mesh));
+	}
+}
@@ -0,0 +1,289 @@
+#include "Test.hpp"
+#include "RangeAllocator.hpp"
+#include <algorithm>
+
+using Allocation = RangeAllocator::Allocation;
+
+static bool IsAllocation(const Allocation& allocation, uint32_t offset, uint32_t size)
+{
+	return allocation.offset == offset && allocation.size == size;
+}
+
+TEST(RangeAllocator, FreeMergesNeighbors)
+{
+	RangeAllocator allocator(100);
+	Allocation a = allocator.Allocate(10);
+	Allocation b = allocator.Allocate(20);
+	Allocation c = allocator.Allocate(30);
+	CHECK(IsAllocation(a, 0, 10));
+	CHECK(IsAllocation(b, 10, 20));
+	CHECK(IsAllocation(c, 30, 30));
+
+	auto statistics = allocator.GetStatistics();
+	CHECK(statistics.usedSize == 60 && statistics.freeSize == 40 && statistics.allocationCount == 3);
+	CHECK(statistics.freeBlockCount == 1 && statistics.usedEnd == 60);
+
+	allocator.Free(b);
+	statistics = allocator.GetStatistics();
+	CHECK(statistics.freeBlockCount == 2);
+	CHECK(statistics.largestFreeBlock == 40);
+
+	// Merged with the free block after it
+	allocator.Free(a);
+	statistics = allocator.GetStatistics();
+	CHECK(statistics.freeBlockCount == 2);
+	CHECK(statistics.largestFreeBlock == 40);
+	CHECK(IsAllocation(allocator.AllocateAt(0, 30), 0, 30));
+	allocator.Free({ 0, 30 });
+
+	// Merged with the free blocks on both sides
+	allocator.Free(c);
+	statistics = allocator.GetStatistics();
+	CHECK(statistics.freeBlockCount == 1);
+	CHECK(statistics.largestFreeBlock == 100);
+	CHECK(statistics.usedSize == 0 && statistics.allocationCount == 0 && statistics.usedEnd == 0);
+	CHECK(statistics.fragmentation == 0.0f);
+
+	CHECK(!allocator.Allocate(101).IsValid());
+	CHECK(IsAllocation(allocator.Allocate(100), 0, 100));
+	CHECK(!allocator.Allocate(1).IsValid());
+}
+
+TEST(RangeAllocator, EmptyAllocations)
+{
+	RangeAllocator allocator(16);
+	Allocation empty = allocator.Allocate(0);
+	CHECK(empty.IsValid() && empty.size == 0);
+	CHECK(allocator.GetStatistics().allocationCount == 0);
+	allocator.Free(empty);
+	allocator.Free({});
+	CHECK(allocator.GetStatistics().freeSize == 16);
+
+	RangeAllocator none;
+	CHECK(!none.Allocate(1).IsValid());
+	CHECK(none.Allocate(0).IsValid());
+}
+
+TEST(RangeAllocator, AllocateAt)
+{
+	RangeAllocator allocator(100);
+
+	// Splits the free block on both sides
+	CHECK(IsAllocation(allocator.AllocateAt(40, 20), 40, 20));
+	auto statistics = allocator.GetStatistics();
+	CHECK(statistics.freeBlockCount == 2 && statistics.usedSize == 20 && statistics.usedEnd == 60);
+
+	CHECK(!allocator.AllocateAt(50, 1).IsValid());
+	CHECK(!allocator.AllocateAt(30, 11).IsValid());
+	CHECK(!allocator.AllocateAt(59, 2).IsValid());
+	CHECK(!allocator.AllocateAt(90, 11).IsValid());
+	CHECK(IsAllocation(allocator.AllocateAt(30, 10), 30, 10));
+	CHECK(IsAllocation(allocator.AllocateAt(60, 40), 60, 40));
+	CHECK(allocator.GetStatistics().freeBlockCount == 1);
+	CHECK(allocator.GetStatistics().largestFreeBlock == 30);
+	CHECK(allocator.GetStatistics().usedEnd == 100);
+}
+
+TEST(RangeAllocator, SizeClasses)
+{
+	// Two free blocks of the same size class [4, 8) and no larger block
+	RangeAllocator allocator(14);
+	Allocation a = allocator.Allocate(5);
+	allocator.Allocate(1);
+	Allocation c = allocator.Allocate(6);
+	allocator.Allocate(2);
+	CHECK(IsAllocation(c, 6, 6));
+	allocator.Free(a);
+	allocator.Free(c);
+
+	// Only the second block of the class fits
+	CHECK(IsAllocation(allocator.Allocate(6), 6, 6));
+	CHECK(IsAllocation(allocator.Allocate(5), 0, 5));
+	CHECK(!allocator.Allocate(1).IsValid());
+
+	// A larger class is preferred to a search in the class of the size, the lowest offset is used in a class
+	RangeAllocator classes(64);
+	Allocation small = classes.Allocate(6);
+	classes.Allocate(1);
+	Allocation large0 = classes.Allocate(20);
+	classes.Allocate(1);
+	Allocation large1 = classes.Allocate(20);
+	classes.Allocate(16);
+	classes.Free(small);
+	classes.Free(large1);
+	classes.Free(large0);
+	CHECK(IsAllocation(classes.Allocate(5), large0.offset, 5));
+	// A power of two always fits in the blocks of its class
+	CHECK(IsAllocation(classes.Allocate(4), small.offset, 4));
+}
+
+TEST(RangeAllocator, Grow)
+{
+	RangeAllocator allocator(10);
+	allocator.Allocate(6);
+	allocator.Grow(5);
+	CHECK(allocator.GetCapacity() == 10);
+
+	// Merged with the free block at the end
+	allocator.Grow(32);
+	auto statistics = allocator.GetStatistics();
+	CHECK(statistics.capacity == 32 && statistics.freeSize == 26 && statistics.freeBlockCount == 1);
+	CHECK(statistics.allocationCount == 1 && statistics.usedEnd == 6);
+	CHECK(IsAllocation(allocator.Allocate(26), 6, 26));
+
+	// A full heap gets a new block
+	allocator.Grow(40);
+	CHECK(IsAllocation(allocator.Allocate(8), 32, 8));
+	CHECK(allocator.GetUsedSize() == 40);
+}
+
+TEST(RangeAllocator, Fragmentation)
+{
+	RangeAllocator allocator(100);
+	std::vector<Allocation> allocations;
+	for (unsigned i = 0; i < 10; i++)
+		allocations.push_back(allocator.Allocate(10));
+	CHECK(allocator.GetStatistics().fragmentation == 0.0f);
+
+	// Free blocks of 10 and 30 elements
+	allocator.Free(allocations[1]);
+	allocator.Free(allocations[5]);
+	allocator.Free(allocations[6]);
+	allocator.Free(allocations[7]);
+	auto statistics = allocator.GetStatistics();
+	CHECK(statistics.freeSize == 40 && statistics.largestFreeBlock == 30 && statistics.freeBlockCount == 2);
+	CHECK(statistics.fragmentation == 0.25f);
+	CHECK(statistics.usedEnd == 100);
+
+	allocator.Free(allocations[8]);
+	allocator.Free(allocations[9]);
+	statistics = allocator.GetStatistics();
+	CHECK(statistics.largestFreeBlock == 50 && statistics.usedEnd == 50);
+	CHECK(statistics.fragmentation == 1.0f - 50.0f / 60.0f);
+}
+
+// Compares the allocator to a map of the used elements after random operations
+TEST(RangeAllocator, MatchesBitmapModel)
+{
+	static constexpr uint32_t capacity = 1000;
+
+	TestRandom random(3);
+	RangeAllocator allocator(capacity);
+	std::vector<bool> used(capacity, false);
+	std::vector<Allocation> allocations;
+
+	auto isFree = [&](uint32_t offset, uint32_t size)
+	{
+		return offset + size <= capacity && std::none_of(used.begin() + offset, used.begin() + offset + size, [](bool u) { return u; });
+	};
+	auto mark = [&](const Allocation& allocation, bool value)
+	{
+		std::fill(used.begin() + allocation.offset, used.begin() + allocation.offset + allocation.size, value);
+	};
+
+	for (unsigned operation = 0; operation < 20000; operation++)
+	{
+		unsigned type = random.NextIndex(10);
+		if (type < 4)
+		{
+			uint32_t size = 1 + random.NextIndex(random.NextIndex(4) == 0 ? 200 : 24);
+			Allocation allocation = allocator.Allocate(size);
+			if (allocation.IsValid())
+			{
+				CHECK(allocation.size == size && isFree(allocation.offset, size));
+				mark(allocation, true);
+				allocations.push_back(allocation);
+			}
+			else
+			{
+				// Fails only when no free run is large enough
+				bool fits = false;
+				for (uint32_t offset = 0; offset + size <= capacity && !fits; offset++)
+					fits = isFree(offset, size);
+				CHECK(!fits);
+			}
+		}
+		else if (type < 6)
+		{
+			uint32_t offset = random.NextIndex(capacity);
+			uint32_t size = 1 + random.NextIndex(16);
+			Allocation allocation = allocator.AllocateAt(offset, size);
+			CHECK(allocation.IsValid() == isFree(offset, size));
+			if (allocation.IsValid())
+			{
+				mark(allocation, true);
+				allocations.push_back(allocation);
+			}
+		}
+		else if (!allocations.empty())
+		{
+			size_t index = random.NextIndex((uint32_t)allocations.size());
+			allocator.Free(allocations[index]);
+			mark(allocations[index], false);
+			allocations[index] = allocations.back();
+			allocations.pop_back();
+		}
+
+		uint32_t usedSize = 0;
+		uint32_t freeBlockCount = 0;
+		uint32_t largestFreeBlock = 0;
+		uint32_t usedEnd = 0;
+		uint32_t run = 0;
+		for (uint32_t i = 0; i < capacity; i++)
+		{
+			if (used[i])
+			{
+				usedSize++;
+				usedEnd = i + 1;
+				run = 0;
+				continue;
+			}
+			if (run++ == 0)
+				freeBlockCount++;
+			largestFreeBlock = std::max(largestFreeBlock, run);
+		}
+
+		// The free blocks are always merged, one block per run of free elements
+		auto statistics = allocator.GetStatistics();
+		CHECK(statistics.usedSize == usedSize);
+		CHECK(statistics.allocationCount == allocations.size());
+		CHECK(statistics.freeBlockCount == freeBlockCount);
+		CHECK(statistics.largestFreeBlock == largestFreeBlock);
+		CHECK(statistics.usedEnd == usedEnd);
+	}
+}
+
+TEST(RangeAllocator, RejectsFreeOfUnallocatedRange)
+{
+	RangeAllocator allocator(100);
+	Allocation a = allocator.Allocate(10);
+	Allocation b = allocator.Allocate(20);
+	CHECK(allocator.Free(a));
+	auto statistics = allocator.GetStatistics();
+
+	auto unchanged = [&]()
+	{
+		auto current = allocator.GetStatistics();
+		return current.usedSize == statistics.usedSize && current.freeBlockCount == statistics.freeBlockCount &&
+			current.largestFreeBlock == statistics.largestFreeBlock && current.allocationCount == statistics.allocationCount;
+	};
+
+	// Double free
+	CHECK(!allocator.Free(a));
+	CHECK(unchanged());
+	// Offset inside an allocation, wrong size, free space and beyond the capacity
+	CHECK(!allocator.Free({ b.offset + 5, 5 }));
+	CHECK(!allocator.Free({ b.offset, b.size - 1 }));
+	CHECK(!allocator.Free({ b.offset, b.size + 1 }));
+	CHECK(!allocator.Free({ 50, 10 }));
+	CHECK(!allocator.Free({ 200, 10 }));
+	CHECK(unchanged());
+
+	// The space added by Grow is free and can't be released again
+	allocator.Grow(150);
+	CHECK(!allocator.Free({ 100, 50 }));
+	CHECK(allocator.GetStatistics().allocationCount == 1);
+
+	CHECK(allocator.Free(b));
+	CHECK(allocator.GetStatistics().usedSize == 0 && allocator.GetStatistics().largestFreeBlock == 150);
+}
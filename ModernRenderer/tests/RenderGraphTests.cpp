@@ -0,0 +1,233 @@
+#include "Test.hpp"
+#include "RenderGraph.hpp"
+#include <algorithm>
+
+using Barrier = RenderGraph::Barrier;
+
+static const RenderGraph::ExecuteFunction noExecute = [](std::shared_ptr<CommandList> cmd) {};
+
+static std::vector<unsigned> GetOrder(const RenderGraph::CompiledGraph& compiled)
+{
+	std::vector<unsigned> order;
+	for (const auto& pass : compiled.passes)
+		order.push_back(pass.passIndex);
+	return order;
+}
+
+static const std::vector<Barrier>& GetBarriers(const RenderGraph::CompiledGraph& compiled, unsigned passIndex)
+{
+	static const std::vector<Barrier> none;
+	for (const auto& pass : compiled.passes)
+		if (pass.passIndex == passIndex)
+			return pass.barriers;
+	return none;
+}
+
+static unsigned GetPosition(const std::vector<unsigned>& order, unsigned passIndex)
+{
+	return (unsigned)(std::find(order.begin(), order.end(), passIndex) - order.begin());
+}
+
+TEST(RenderGraph, CullsPassesWithoutOutput)
+{
+	RenderGraph graph;
+	auto unused = graph.Import("Unused", nullptr);
+	auto intermediate = graph.Import("Intermediate", nullptr);
+	auto output = graph.Import("Output", nullptr, ResourceState::kCommon, ResourceState::kCommon, true);
+	auto readback = graph.Import("Readback", nullptr);
+
+	graph.AddPass("Unused", [&](RenderGraph::PassBuilder& b) { b.Write(unused, ResourceState::kUnorderedAccess); }, noExecute);
+	graph.AddPass("Producer", [&](RenderGraph::PassBuilder& b) { b.Write(intermediate, ResourceState::kRenderTarget); }, noExecute);
+	graph.AddPass("Consumer", [&](RenderGraph::PassBuilder& b)
+	{
+		b.Read(intermediate, ResourceState::kPixelShaderResource);
+		b.Write(output, ResourceState::kRenderTarget);
+	}, noExecute);
+	// Overwritten by the next pass before anything reads it
+	graph.AddPass("Overwritten", [&](RenderGraph::PassBuilder& b) { b.Write(output, ResourceState::kRenderTarget); }, noExecute);
+	graph.AddPass("Final", [&](RenderGraph::PassBuilder& b) { b.ReadWrite(output, ResourceState::kRenderTarget); }, noExecute);
+	graph.AddPass("Readback", [&](RenderGraph::PassBuilder& b)
+	{
+		b.Read(unused, ResourceState::kCopySource);
+		b.Write(readback, ResourceState::kCopyDest);
+		b.SetSideEffect();
+	}, noExecute);
+
+	auto compiled = graph.Compile();
+	auto order = GetOrder(compiled);
+	std::sort(order.begin(), order.end());
+
+	// The output written by "Consumer" is overwritten before "Final" reads it, so "Consumer" and its producer are
+	// culled. The side effect keeps "Readback" and its producer "Unused".
+	CHECK((order == std::vector<unsigned>{ 0, 3, 4, 5 }));
+	CHECK((compiled.culledPasses == std::vector<unsigned>{ 1, 2 }));
+
+	RenderGraph culled;
+	auto a = culled.Import("A", nullptr);
+	auto b = culled.Import("B", nullptr);
+	auto out = culled.Import("Output", nullptr, ResourceState::kCommon, ResourceState::kCommon, true);
+	culled.AddPass("WritesA", [&](RenderGraph::PassBuilder& builder) { builder.Write(a, ResourceState::kUnorderedAccess); }, noExecute);
+	culled.AddPass("ReadsAWritesB", [&](RenderGraph::PassBuilder& builder)
+	{
+		builder.Read(a, ResourceState::kNonPixelShaderResource);
+		builder.Write(b, ResourceState::kUnorderedAccess);
+	}, noExecute);
+	culled.AddPass("WritesOutput", [&](RenderGraph::PassBuilder& builder) { builder.Write(out, ResourceState::kRenderTarget); }, noExecute);
+
+	auto culledCompiled = culled.Compile();
+	CHECK((GetOrder(culledCompiled) == std::vector<unsigned>{ 2 }));
+	CHECK((culledCompiled.culledPasses == std::vector<unsigned>{ 0, 1 }));
+	// Culled passes don't use the resources
+	CHECK(culledCompiled.firstUse[a] == RenderGraph::CompiledGraph::invalidPosition);
+	CHECK(culledCompiled.firstUse[out] == 0);
+}
+
+TEST(RenderGraph, OrderRespectsDependencies)
+{
+	RenderGraph graph;
+	auto depth = graph.Import("Depth", nullptr);
+	auto shadow = graph.Import("Shadow", nullptr);
+	auto color = graph.Import("Color", nullptr, ResourceState::kCommon, ResourceState::kCommon, true);
+
+	graph.AddPass("Depth", [&](RenderGraph::PassBuilder& b) { b.Write(depth, ResourceState::kDepthStencilWrite); }, noExecute);
+	graph.AddPass("DepthConsumer", [&](RenderGraph::PassBuilder& b)
+	{
+		b.Read(depth, ResourceState::kDepthStencilRead);
+		b.ReadWrite(color, ResourceState::kRenderTarget);
+	}, noExecute);
+	graph.AddPass("Shadow", [&](RenderGraph::PassBuilder& b) { b.Write(shadow, ResourceState::kDepthStencilWrite); }, noExecute);
+	graph.AddPass("ShadowConsumer", [&](RenderGraph::PassBuilder& b)
+	{
+		b.Read(shadow, ResourceState::kPixelShaderResource);
+		b.ReadWrite(color, ResourceState::kRenderTarget);
+	}, noExecute);
+	// Write after read: must wait for the first consumer of the depth
+	graph.AddPass("DepthOverwrite", [&](RenderGraph::PassBuilder& b)
+	{
+		b.Write(depth, ResourceState::kDepthStencilWrite);
+		b.ReadWrite(color, ResourceState::kRenderTarget);
+	}, noExecute);
+
+	auto compiled = graph.Compile();
+	auto order = GetOrder(compiled);
+	CHECK(order.size() == 5);
+	CHECK(GetPosition(order, 0) < GetPosition(order, 1));
+	CHECK(GetPosition(order, 2) < GetPosition(order, 3));
+	CHECK(GetPosition(order, 1) < GetPosition(order, 3));
+	CHECK(GetPosition(order, 1) < GetPosition(order, 4));
+	CHECK(GetPosition(order, 3) < GetPosition(order, 4));
+	// The independent shadow pass is moved between the depth pass and its consumer
+	CHECK((order == std::vector<unsigned>{ 0, 2, 1, 3, 4 }));
+}
+
+TEST(RenderGraph, ConsecutiveReadsAreMerged)
+{
+	RenderGraph graph;
+	auto texture = graph.Import("Texture", nullptr, ResourceState::kCommon, ResourceState::kUnknown);
+	auto output = graph.Import("Output", nullptr, ResourceState::kCommon, ResourceState::kCommon, true);
+
+	graph.AddPass("Write", [&](RenderGraph::PassBuilder& b) { b.Write(texture, ResourceState::kRenderTarget); }, noExecute);
+	graph.AddPass("PixelRead", [&](RenderGraph::PassBuilder& b)
+	{
+		b.Read(texture, ResourceState::kPixelShaderResource);
+		b.ReadWrite(output, ResourceState::kUnorderedAccess);
+	}, noExecute);
+	graph.AddPass("ComputeRead", [&](RenderGraph::PassBuilder& b)
+	{
+		b.Read(texture, ResourceState::kNonPixelShaderResource);
+		b.ReadWrite(output, ResourceState::kUnorderedAccess);
+	}, noExecute);
+	graph.AddPass("CopyRead", [&](RenderGraph::PassBuilder& b)
+	{
+		// Two reads of the same pass are combined
+		b.Read(texture, ResourceState::kCopySource);
+		b.Read(texture, ResourceState::kPixelShaderResource);
+		b.ReadWrite(output, ResourceState::kUnorderedAccess);
+	}, noExecute);
+
+	auto compiled = graph.Compile();
+	CHECK((GetOrder(compiled) == std::vector<unsigned>{ 0, 1, 2, 3 }));
+
+	ResourceState allReads = RenderGraph::CombineStates(RenderGraph::CombineStates(ResourceState::kPixelShaderResource, ResourceState::kNonPixelShaderResource), ResourceState::kCopySource);
+	CHECK((GetBarriers(compiled, 0) == std::vector<Barrier>{ { Barrier::Type::Transition, texture, ResourceState::kCommon, ResourceState::kRenderTarget } }));
+	// A single transition to every state read by the following passes
+	const auto& firstRead = GetBarriers(compiled, 1);
+	CHECK(std::count(firstRead.begin(), firstRead.end(), Barrier{ Barrier::Type::Transition, texture, ResourceState::kRenderTarget, allReads }) == 1);
+	for (unsigned pass : { 2u, 3u })
+		for (const auto& barrier : GetBarriers(compiled, pass))
+			CHECK(barrier.resource != texture);
+
+	// The final state is left as is
+	CHECK(compiled.finalStates[texture] == allReads);
+	for (const auto& barrier : compiled.finalBarriers)
+		CHECK(barrier.resource != texture);
+	CHECK((compiled.finalBarriers == std::vector<Barrier>{ { Barrier::Type::Transition, output, ResourceState::kUnorderedAccess, ResourceState::kCommon } }));
+}
+
+TEST(RenderGraph, UAVBarriersBetweenUnorderedAccesses)
+{
+	RenderGraph graph;
+	auto buffer = graph.Import("Buffer", nullptr, ResourceState::kUnorderedAccess, ResourceState::kUnorderedAccess);
+	auto output = graph.Import("Output", nullptr, ResourceState::kUnorderedAccess, ResourceState::kUnorderedAccess, true);
+
+	// Read only passes in the unordered access state don't need to wait for each other
+	graph.AddPass("Read0", [&](RenderGraph::PassBuilder& b)
+	{
+		b.Read(buffer, ResourceState::kUnorderedAccess);
+		b.ReadWrite(output, ResourceState::kUnorderedAccess);
+	}, noExecute);
+	graph.AddPass("Read1", [&](RenderGraph::PassBuilder& b)
+	{
+		b.Read(buffer, ResourceState::kUnorderedAccess);
+		b.ReadWrite(output, ResourceState::kUnorderedAccess);
+	}, noExecute);
+	graph.AddPass("Write", [&](RenderGraph::PassBuilder& b)
+	{
+		b.ReadWrite(buffer, ResourceState::kUnorderedAccess);
+		b.ReadWrite(output, ResourceState::kUnorderedAccess);
+	}, noExecute);
+	graph.AddPass("ReadAfterWrite", [&](RenderGraph::PassBuilder& b)
+	{
+		b.Read(buffer, ResourceState::kUnorderedAccess);
+		b.ReadWrite(output, ResourceState::kUnorderedAccess);
+	}, noExecute);
+
+	auto compiled = graph.Compile();
+	CHECK((GetOrder(compiled) == std::vector<unsigned>{ 0, 1, 2, 3 }));
+
+	Barrier bufferUAV = { Barrier::Type::UAV, buffer, ResourceState::kUnorderedAccess, ResourceState::kUnorderedAccess };
+	Barrier outputUAV = { Barrier::Type::UAV, output, ResourceState::kUnorderedAccess, ResourceState::kUnorderedAccess };
+	// The first write of the output waits for the accesses before the graph
+	CHECK((GetBarriers(compiled, 0) == std::vector<Barrier>{ outputUAV }));
+	CHECK((GetBarriers(compiled, 1) == std::vector<Barrier>{ outputUAV }));
+	CHECK((GetBarriers(compiled, 2) == std::vector<Barrier>{ bufferUAV, outputUAV }));
+	CHECK((GetBarriers(compiled, 3) == std::vector<Barrier>{ bufferUAV, outputUAV }));
+	CHECK(compiled.finalBarriers.empty());
+	CHECK(compiled.GetBarrierCount() == 6);
+}
+
+TEST(RenderGraph, ResourceLifetimes)
+{
+	RenderGraph graph;
+	auto first = graph.Import("First", nullptr);
+	auto second = graph.Import("Second", nullptr);
+	auto output = graph.Import("Output", nullptr, ResourceState::kCommon, ResourceState::kCommon, true);
+
+	graph.AddPass("WriteFirst", [&](RenderGraph::PassBuilder& b) { b.Write(first, ResourceState::kUnorderedAccess); }, noExecute);
+	graph.AddPass("FirstToSecond", [&](RenderGraph::PassBuilder& b)
+	{
+		b.Read(first, ResourceState::kNonPixelShaderResource);
+		b.Write(second, ResourceState::kUnorderedAccess);
+	}, noExecute);
+	graph.AddPass("SecondToOutput", [&](RenderGraph::PassBuilder& b)
+	{
+		b.Read(second, ResourceState::kNonPixelShaderResource);
+		b.Write(output, ResourceState::kUnorderedAccess);
+	}, noExecute);
+
+	auto compiled = graph.Compile();
+	CHECK((GetOrder(compiled) == std::vector<unsigned>{ 0, 1, 2 }));
+	CHECK(compiled.firstUse[first] == 0 && compiled.lastUse[first] == 1);
+	CHECK(compiled.firstUse[second] == 1 && compiled.lastUse[second] == 2);
+	CHECK(compiled.firstUse[output] == 2 && compiled.lastUse[output] == 2);
+}
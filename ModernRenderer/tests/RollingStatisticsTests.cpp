@@ -0,0 +1,64 @@
+#include "Test.hpp"
+#include "RollingStatistics.hpp"
+#include <algorithm>
+#include <cmath>
+
+TEST(RollingStatistics, Empty)
+{
+	RollingStatistics statistics;
+	CHECK(statistics.GetSampleCount() == 0);
+	CHECK(statistics.GetMean() == 0 && statistics.GetMin() == 0 && statistics.GetMax() == 0);
+	CHECK(statistics.GetWindowMean() == 0 && statistics.GetLatest() == 0);
+	CHECK(statistics.GetP50() == 0);
+}
+
+// Mean, min and max cover every sample like the percentiles, not only the last window
+TEST(RollingStatistics, AllSamples)
+{
+	RollingStatistics statistics(4);
+	for (double value : { 10.0, -2.0, 3.0, 5.0, 1.0, 1.0, 1.0, 1.0 })
+		statistics.AddSample(value);
+
+	CHECK(statistics.GetSampleCount() == 8);
+	CHECK(statistics.GetMean() == 20.0 / 8);
+	CHECK(statistics.GetMin() == -2.0);
+	CHECK(statistics.GetMax() == 10.0);
+	CHECK(statistics.GetWindowSize() == 4);
+	CHECK(statistics.GetWindowMean() == 1.0);
+	CHECK(statistics.GetLatest() == 1.0);
+}
+
+TEST(RollingStatistics, Reset)
+{
+	RollingStatistics statistics(4);
+	for (int i = 0; i < 10; i++)
+		statistics.AddSample(100.0 + i);
+	statistics.Reset();
+	statistics.AddSample(2.0);
+	statistics.AddSample(4.0);
+
+	CHECK(statistics.GetSampleCount() == 2);
+	CHECK(statistics.GetMean() == 3.0);
+	CHECK(statistics.GetMin() == 2.0 && statistics.GetMax() == 4.0);
+	CHECK(statistics.GetWindowMean() == 3.0);
+}
+
+// The P-Square estimates stay close to the exact quantiles of a uniform distribution
+TEST(RollingStatistics, Percentiles)
+{
+	RollingStatistics statistics;
+	std::vector<double> samples;
+	TestRandom random(32);
+	for (int i = 0; i < 20000; i++)
+	{
+		samples.push_back(random.NextFloat() * 10.0);
+		statistics.AddSample(samples.back());
+	}
+	std::sort(samples.begin(), samples.end());
+
+	auto exact = [&](double quantile) { return samples[(size_t)(quantile * (samples.size() - 1))]; };
+	CHECK(std::abs(statistics.GetP50() - exact(0.50)) < 0.1);
+	CHECK(std::abs(statistics.GetP95() - exact(0.95)) < 0.1);
+	CHECK(std::abs(statistics.GetP99() - exact(0.99)) < 0.1);
+	CHECK(statistics.GetMin() == samples.front() && statistics.GetMax() == samples.back());
+}
@@ -0,0 +1,145 @@
+#include "Test.hpp"
+#include "Scene.hpp"
+#include "InstanceUpdater.hpp"
+#include <algorithm>
+
+// Dirty bits for instanceCount instances, as after Scene::UploadInstancesToGPU
+static void ResetDirtyBits(Scene& scene, unsigned instanceCount)
+{
+	scene.instanceDirtyBits.assign((instanceCount + 63) / 64, 0);
+	scene.dirtyInstanceCount = 0;
+}
+
+static std::vector<Scene::InstanceRange> Consume(Scene& scene)
+{
+	std::vector<Scene::InstanceRange> ranges;
+	scene.ConsumeDirtyInstanceRanges(ranges);
+	return ranges;
+}
+
+static bool SameRanges(const std::vector<Scene::InstanceRange>& ranges, const std::vector<std::pair<unsigned, unsigned>>& expected)
+{
+	if (ranges.size() != expected.size())
+		return false;
+	for (size_t i = 0; i < ranges.size(); i++)
+		if (ranges[i].first != expected[i].first || ranges[i].count != expected[i].second)
+			return false;
+	return true;
+}
+
+TEST(Scene, DirtyRangesAcrossWords)
+{
+	Scene scene;
+	ResetDirtyBits(scene, 300);
+
+	// Runs crossing the boundaries of the 64 bit words are merged, including a run covering a whole word
+	for (unsigned i = 60; i < 70; i++)
+		scene.MarkInstanceDataDirty(i);
+	for (unsigned i = 127; i < 193; i++)
+		scene.MarkInstanceDataDirty(i);
+	// Marked twice, counted once
+	scene.MarkInstanceDataDirty(60);
+	CHECK(scene.dirtyInstanceCount == 10 + 66);
+
+	CHECK(SameRanges(Consume(scene), { { 60, 10 }, { 127, 66 } }));
+}
+
+TEST(Scene, DirtyRangesOrder)
+{
+	Scene scene;
+	ResetDirtyBits(scene, 128);
+
+	// Marked in any order, returned in increasing order with the separate runs of a word kept apart
+	for (unsigned i : { 90u, 5u, 3u, 64u, 4u, 63u, 91u, 7u })
+		scene.MarkInstanceDataDirty(i);
+
+	CHECK(SameRanges(Consume(scene), { { 3, 3 }, { 7, 1 }, { 63, 2 }, { 90, 2 } }));
+}
+
+TEST(Scene, DirtyRangesLastPartialWord)
+{
+	Scene scene;
+	ResetDirtyBits(scene, 150);
+	CHECK(scene.instanceDirtyBits.size() == 3);
+
+	scene.MarkInstanceDataDirty(149);
+	scene.MarkInstanceDataDirty(128);
+	scene.MarkInstanceDataDirty(148);
+	scene.MarkInstanceDataDirty(127);
+
+	CHECK(SameRanges(Consume(scene), { { 127, 2 }, { 148, 2 } }));
+}
+
+TEST(Scene, DirtyRangesClearedAfterConsume)
+{
+	Scene scene;
+	ResetDirtyBits(scene, 200);
+	for (unsigned i = 0; i < 200; i++)
+		scene.MarkInstanceDataDirty(i);
+	CHECK(SameRanges(Consume(scene), { { 0, 200 } }));
+
+	CHECK(scene.dirtyInstanceCount == 0);
+	CHECK(std::all_of(scene.instanceDirtyBits.begin(), scene.instanceDirtyBits.end(), [](uint64_t word) { return word == 0; }));
+	CHECK(Consume(scene).empty());
+
+	// Marking again after a consume starts new ranges
+	scene.MarkInstanceDataDirty(42);
+	CHECK(scene.dirtyInstanceCount == 1);
+	CHECK(SameRanges(Consume(scene), { { 42, 1 } }));
+}
+
+TEST(Scene, DirtyRangesRandom)
+{
+	const unsigned instanceCount = 1000;
+	Scene scene;
+	ResetDirtyBits(scene, instanceCount);
+	TestRandom random(46);
+
+	for (unsigned frame = 0; frame < 20; frame++)
+	{
+		std::vector<bool> dirty(instanceCount, false);
+		unsigned markCount = (unsigned)random.NextIndex(400);
+		for (unsigned i = 0; i < markCount; i++)
+		{
+			unsigned index = (unsigned)random.NextIndex(instanceCount);
+			dirty[index] = true;
+			scene.MarkInstanceDataDirty(index);
+		}
+
+		// The ranges cover exactly the dirty instances, in increasing order and never adjacent
+		std::vector<bool> covered(instanceCount, false);
+		auto ranges = Consume(scene);
+		bool valid = true;
+		for (size_t i = 0; i < ranges.size(); i++)
+		{
+			valid = valid && ranges[i].count > 0 && ranges[i].first + ranges[i].count <= instanceCount;
+			if (i > 0)
+				valid = valid && ranges[i - 1].first + ranges[i - 1].count < ranges[i].first;
+			for (unsigned j = 0; j < ranges[i].count && valid; j++)
+				covered[ranges[i].first + j] = true;
+		}
+		CHECK(valid);
+		CHECK(covered == dirty);
+	}
+}
+
+// Up to maxCopyRanges ranges are copied with one region each, more are scattered by a single dispatch
+TEST(Scene, InstanceUpdaterScatterThreshold)
+{
+	CHECK(InstanceUpdater::maxCopyRanges == 16);
+	CHECK(!InstanceUpdater::UsesScatter(1));
+	CHECK(!InstanceUpdater::UsesScatter(16));
+	CHECK(InstanceUpdater::UsesScatter(17));
+
+	// Every other instance dirty gives one range per instance
+	Scene scene;
+	ResetDirtyBits(scene, 100);
+	for (unsigned i = 0; i < 17 * 2; i += 2)
+		scene.MarkInstanceDataDirty(i);
+	CHECK(InstanceUpdater::UsesScatter(Consume(scene).size()));
+
+	// The same number of dirty instances in consecutive runs is copied
+	for (unsigned i = 0; i < 17; i++)
+		scene.MarkInstanceDataDirty(i);
+	CHECK(!InstanceUpdater::UsesScatter(Consume(scene).size()));
+}
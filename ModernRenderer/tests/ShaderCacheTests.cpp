@@ -0,0 +1,115 @@
+#include "Test.hpp"
+#include "ShaderCache.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+// Shader files written to a temporary directory, removed at the end of the test
+class TestShaderFiles
+{
+private:
+	std::filesystem::path directory;
+
+public:
+	TestShaderFiles()
+	{
+		directory = std::filesystem::temp_directory_path() / "ModernRendererShaderCacheTests";
+		std::filesystem::remove_all(directory);
+		std::filesystem::create_directories(directory / "Utils");
+	}
+
+	~TestShaderFiles()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(directory, error);
+	}
+
+	std::string Write(const std::string& name, const std::string& source)
+	{
+		std::filesystem::path path = directory / name;
+		std::ofstream(path, std::ios::binary) << source;
+		return path.string();
+	}
+};
+
+// Main.hlsl includes Common.hlsl, which includes Utils/Math.hlsl relative to its own directory
+static std::string WriteTestShader(TestShaderFiles& files)
+{
+	files.Write("Utils/Math.hlsl", "float Square(float x) { return x * x; }\n");
+	files.Write("Common.hlsl", "#include \"Utils/Math.hlsl\"\ncbuffer Constants { float scale; };\n");
+	return files.Write("Main.hlsl", "#include \"Common.hlsl\"\nfloat4 main() : SV_Target { return Square(scale); }\n");
+}
+
+static ShaderDesc CreateDesc(const std::string& path)
+{
+	return { path, "main", ShaderType::kPixel, "6_5" };
+}
+
+TEST(ShaderCache, KeyStableForSameSource)
+{
+	TestShaderFiles files;
+	ShaderDesc desc = CreateDesc(WriteTestShader(files));
+
+	uint64_t key = ShaderCache::ComputeKey(desc);
+	CHECK(key != 0);
+	CHECK(ShaderCache::ComputeKey(desc) == key);
+
+	// Rewriting the same content keeps the key, only the content is hashed
+	WriteTestShader(files);
+	CHECK(ShaderCache::ComputeKey(desc) == key);
+}
+
+TEST(ShaderCache, KeyChangesWithIncludedFiles)
+{
+	TestShaderFiles files;
+	ShaderDesc desc = CreateDesc(WriteTestShader(files));
+	uint64_t key = ShaderCache::ComputeKey(desc);
+
+	// Edit of a file included by an included file
+	files.Write("Utils/Math.hlsl", "float Square(float x) { return x * x * 1.0; }\n");
+	uint64_t editedKey = ShaderCache::ComputeKey(desc);
+	CHECK(editedKey != 0 && editedKey != key);
+
+	files.Write("Utils/Math.hlsl", "float Square(float x) { return x * x; }\n");
+	CHECK(ShaderCache::ComputeKey(desc) == key);
+
+	files.Write("Common.hlsl", "#include \"Utils/Math.hlsl\"\ncbuffer Constants { float scale; float bias; };\n");
+	CHECK(ShaderCache::ComputeKey(desc) != key);
+}
+
+TEST(ShaderCache, KeyChangesWithDesc)
+{
+	TestShaderFiles files;
+	ShaderDesc desc = CreateDesc(WriteTestShader(files));
+	uint64_t key = ShaderCache::ComputeKey(desc);
+
+	ShaderDesc other = desc;
+	other.entrypoint = "main2";
+	CHECK(ShaderCache::ComputeKey(other) != key);
+	other = desc;
+	other.model = "6_6";
+	CHECK(ShaderCache::ComputeKey(other) != key);
+	other = desc;
+	other.type = ShaderType::kCompute;
+	CHECK(ShaderCache::ComputeKey(other) != key);
+	other = desc;
+	other.define["VISIBILITY_BUFFER_64BIT"] = "1";
+	CHECK(ShaderCache::ComputeKey(other) != key);
+
+	other.shader_path = desc.shader_path + ".missing";
+	CHECK(ShaderCache::ComputeKey(other) == 0);
+}
+
+TEST(ShaderCache, Dependencies)
+{
+	TestShaderFiles files;
+	std::string path = WriteTestShader(files);
+	// Recursive includes are left to the compiler, the expansion stops
+	files.Write("Utils/Math.hlsl", "#include \"../Common.hlsl\"\nfloat Square(float x) { return x * x; }\n");
+
+	std::vector<std::string> dependencies = ShaderCache::GetDependencies(path);
+	CHECK(dependencies.size() == 3);
+	for (const char* name : { "Main.hlsl", "Common.hlsl", "Math.hlsl" })
+		CHECK(std::any_of(dependencies.begin(), dependencies.end(), [&](const std::string& file) { return std::filesystem::path(file).filename() == name; }));
+	CHECK(ShaderCache::ComputeKey(CreateDesc(path)) != 0);
+}
@@ -0,0 +1,336 @@
+#include "Test.hpp"
+#include "SoftwareRasterizer.hpp"
+#include "MeshPool.hpp"
+#include <cfloat>
+#include <cmath>
+#include <string>
+
+// Triangles written directly into the CPU copy of the MeshPool heaps, which is all the rasterizer reads
+class TestGeometry
+{
+public:
+	TestGeometry() { Clear(); }
+	~TestGeometry() { Clear(); }
+
+	static void Clear()
+	{
+		MeshPool::meshlets.clear();
+		MeshPool::meshletIndices.clear();
+		MeshPool::meshletTriangles.clear();
+		MeshPool::vertices.clear();
+	}
+
+	// One triangle per 3 positions, returns the index of the meshlet
+	static unsigned AddMeshlet(const std::vector<glm::vec3>& positions)
+	{
+		meshopt_Meshlet meshlet = {};
+		meshlet.vertex_offset = (unsigned)MeshPool::meshletIndices.size();
+		meshlet.triangle_offset = (unsigned)MeshPool::meshletTriangles.size();
+		meshlet.vertex_count = (unsigned)positions.size();
+		meshlet.triangle_count = (unsigned)positions.size() / 3;
+
+		for (unsigned i = 0; i < positions.size(); i++)
+		{
+			Mesh::Vertex vertex = {};
+			vertex.position = positions[i];
+			MeshPool::meshletIndices.push_back((uint32_t)MeshPool::vertices.size());
+			MeshPool::vertices.push_back(vertex);
+			MeshPool::meshletTriangles.push_back((uint8_t)i);
+		}
+
+		MeshPool::meshlets.push_back(meshlet);
+		return (unsigned)MeshPool::meshlets.size() - 1;
+	}
+
+	// The rasterizer multiplies row vectors, the translation is in the last component of the first 3 columns
+	static Scene::InstanceData MakeInstance(unsigned meshletIndex, unsigned meshletCount, const glm::vec3& translation = glm::vec3(0))
+	{
+		Scene::InstanceData instance = {};
+		instance.objectToWorld = glm::mat4(1.0f);
+		instance.objectToWorld[0][3] = translation.x;
+		instance.objectToWorld[1][3] = translation.y;
+		instance.objectToWorld[2][3] = translation.z;
+		instance.meshletIndex = meshletIndex;
+		instance.meshletCount = meshletCount;
+		return instance;
+	}
+};
+
+// With an identity view projection the positions are in NDC and z is the depth
+static GPUCameraData MakeNDCCamera()
+{
+	GPUCameraData camera = {};
+	camera.viewProjectionMatrix = glm::mat4(1.0f);
+	camera.cameraPosition = glm::vec4(0);
+	return camera;
+}
+
+// Perspective projection looking down +z for row vectors, depth is 0 at the near plane and 1 at the far plane
+static GPUCameraData MakePerspectiveCamera(float nearPlane, float farPlane)
+{
+	GPUCameraData camera = MakeNDCCamera();
+	camera.viewProjectionMatrix[2][2] = farPlane / (farPlane - nearPlane);
+	camera.viewProjectionMatrix[2][3] = -farPlane * nearPlane / (farPlane - nearPlane);
+	camera.viewProjectionMatrix[3][2] = 1.0f;
+	camera.viewProjectionMatrix[3][3] = 0.0f;
+	return camera;
+}
+
+// One character per pixel: '.' where the depth is cleared, then 'a' + triangle for the first visible meshlet,
+// 'A' + triangle for the second one and '0' + triangle for the others
+static std::vector<std::string> ToText(const SoftwareRasterizer& rasterizer)
+{
+	auto visibility = rasterizer.GetVisibility();
+	auto depth = rasterizer.GetDepth();
+	unsigned componentCount = VisibilityBuffer::GetComponentCount(rasterizer.GetFormat());
+
+	std::vector<std::string> rows(rasterizer.GetHeight(), std::string(rasterizer.GetWidth(), '.'));
+	for (unsigned y = 0; y < rasterizer.GetHeight(); y++)
+	{
+		for (unsigned x = 0; x < rasterizer.GetWidth(); x++)
+		{
+			unsigned pixel = y * rasterizer.GetWidth() + x;
+			if (depth[pixel] == 1.0f)
+				continue;
+
+			uint32_t meshlet = 0, triangle = 0, instance = 0;
+			if (componentCount == 2)
+				VisibilityBuffer::DecodeVisibility64(visibility[pixel * 2] | ((uint64_t)visibility[pixel * 2 + 1] << 32), instance, meshlet, triangle);
+			else
+				VisibilityBuffer::DecodeVisibility(visibility[pixel], meshlet, triangle);
+			rows[y][x] = (char)((meshlet == 0 ? 'a' : meshlet == 1 ? 'A' : '0') + triangle);
+		}
+	}
+	return rows;
+}
+
+static bool CompareText(const std::vector<std::string>& rows, const std::vector<std::string>& expected)
+{
+	if (rows == expected)
+		return true;
+
+	for (unsigned y = 0; y < rows.size(); y++)
+		printf("%s%s\n", rows[y].c_str(), y < expected.size() && rows[y] == expected[y] ? "" : "   <- differs");
+	return false;
+}
+
+// Two overlapping meshlets at different depths and a back facing triangle, in an image smaller than a tile
+static std::vector<SoftwareRasterizer::VisibleMeshlet> CreateGoldenScene(std::vector<Scene::InstanceData>& instances)
+{
+	unsigned meshlet = TestGeometry::AddMeshlet({
+		// a: near, top left
+		{ -0.9f, 0.8f, 0.2f }, { 0.3f, 0.8f, 0.2f }, { -0.9f, -0.8f, 0.2f },
+		// b: far, right
+		{ -0.2f, 0.5f, 0.6f }, { 0.9f, 0.5f, 0.6f }, { 0.9f, -0.9f, 0.6f },
+		// c: counter clockwise on screen, culled
+		{ -0.8f, -0.9f, 0.1f }, { 0.8f, -0.9f, 0.1f }, { -0.8f, -0.3f, 0.1f },
+	});
+	unsigned secondMeshlet = TestGeometry::AddMeshlet({
+		// A: between a and b, the depth increases from left to right
+		{ -0.5f, 0.1f, 0.1f }, { 0.6f, 0.1f, 0.9f }, { -0.5f, -0.7f, 0.1f },
+	});
+
+	instances = { TestGeometry::MakeInstance(meshlet, 1), TestGeometry::MakeInstance(secondMeshlet, 1) };
+	return SoftwareRasterizer::GatherAllMeshlets(instances);
+}
+
+// Checked by hand against the pixel centers: top-left fill rule on the edges of a, depth test between a, A and b
+static const std::vector<std::string> goldenImage =
+{
+	"........................................",
+	"........................................",
+	"..aaaaaaaaaaaaaaaaaaaaaaa...............",
+	"..aaaaaaaaaaaaaaaaaaaaaa................",
+	"..aaaaaaaaaaaaaaaaaaaa..................",
+	"..aaaaaaaaaaaaaaaaaaabbbbbbbbbbbbbbbbb..",
+	"..aaaaaaaaaaaaaaaaabbbbbbbbbbbbbbbbbbb..",
+	"..aaaaaaaaaaaaaaaa..bbbbbbbbbbbbbbbbbb..",
+	"..aaaaaaaaaaaaaa.....bbbbbbbbbbbbbbbbb..",
+	"..aaaaaaaaAAAaaAAAAAAAAAbbbbbbbbbbbbbb..",
+	"..aaaaaaaaAAAAAAAAAAAAAAAbbbbbbbbbbbbb..",
+	"..aaaaaaaaAAAAAAAAAAAAAAA.bbbbbbbbbbbb..",
+	"..aaaaaaaaAAAAAAAAAAAA......bbbbbbbbbb..",
+	"..aaaaaaa.AAAAAAAAAA.........bbbbbbbbb..",
+	"..aaaaa...AAAAAAA..............bbbbbbb..",
+	"..aaaa....AAAA..................bbbbbb..",
+	"..aa......A.......................bbbb..",
+	"..a.................................bb..",
+	".....................................b..",
+	"........................................",
+};
+
+TEST(SoftwareRasterizer, GoldenImage)
+{
+	TestGeometry geometry;
+	std::vector<Scene::InstanceData> instances;
+	auto visibleMeshlets = CreateGoldenScene(instances);
+
+	SoftwareRasterizer rasterizer(40, 20, 1);
+	rasterizer.Rasterize(visibleMeshlets, instances, MakeNDCCamera());
+	CHECK(CompareText(ToText(rasterizer), goldenImage));
+}
+
+TEST(SoftwareRasterizer, GoldenImageVisibility64)
+{
+	TestGeometry geometry;
+	std::vector<Scene::InstanceData> instances;
+	auto visibleMeshlets = CreateGoldenScene(instances);
+
+	SoftwareRasterizer rasterizer(40, 20, 1, VisibilityBuffer::Format::R32G32);
+	rasterizer.Rasterize(visibleMeshlets, instances, MakeNDCCamera());
+	CHECK(CompareText(ToText(rasterizer), goldenImage));
+
+	// The instance of the second meshlet is stored in the high bits
+	auto visibility = rasterizer.GetVisibility();
+	auto depth = rasterizer.GetDepth();
+	for (unsigned pixel = 0; pixel < depth.size(); pixel++)
+	{
+		uint32_t instance = 0, meshlet = 0, triangle = 0;
+		VisibilityBuffer::DecodeVisibility64(visibility[pixel * 2] | ((uint64_t)visibility[pixel * 2 + 1] << 32), instance, meshlet, triangle);
+		CHECK(depth[pixel] == 1.0f || instance == visibleMeshlets[meshlet].instanceIndex);
+	}
+}
+
+TEST(SoftwareRasterizer, DepthIsInterpolatedLinearly)
+{
+	TestGeometry geometry;
+	std::vector<Scene::InstanceData> instances;
+	auto visibleMeshlets = CreateGoldenScene(instances);
+
+	SoftwareRasterizer rasterizer(40, 20, 1);
+	rasterizer.Rasterize(visibleMeshlets, instances, MakeNDCCamera());
+	auto depth = rasterizer.GetDepth();
+
+	// a has a constant depth, A goes from 0.1 at x = -0.5 to 0.9 at x = 0.6 in NDC
+	CHECK(depth[5 * 40 + 4] == 0.2f);
+	for (unsigned x = 15; x < 23; x++)
+	{
+		float ndcX = (x + 0.5f) / 40 * 2.0f - 1.0f;
+		float expected = 0.1f + 0.8f * (ndcX + 0.5f) / 1.1f;
+		CHECK(std::abs(depth[10 * 40 + x] - expected) < 1e-4f);
+	}
+}
+
+// Pixel centers on the edge shared by two triangles belong to exactly one of them
+TEST(SoftwareRasterizer, SharedEdgesCoverPixelsOnce)
+{
+	TestGeometry geometry;
+	const unsigned width = 80;
+	const unsigned height = 70;
+
+	// Fan around a center at an arbitrary sub pixel position, crossing the tile boundaries. The ring is ordered
+	// clockwise on screen and contains vertices exactly on pixel centers and on pixel corners.
+	auto toNDC = [&](float x, float y) { return glm::vec3(x / width * 2.0f - 1.0f, 1.0f - y / height * 2.0f, 0.5f); };
+	glm::vec3 center = toNDC(40.3f, 33.7f);
+	std::vector<glm::vec3> ring =
+	{
+		toNDC(10.5f, 5.5f), toNDC(40.0f, 2.0f), toNDC(70.5f, 8.25f), toNDC(77.0f, 40.0f), toNDC(66.5f, 66.5f),
+		toNDC(40.5f, 68.0f), toNDC(8.0f, 60.0f), toNDC(3.5f, 33.5f),
+	};
+
+	std::vector<Scene::InstanceData> instances;
+	for (unsigned i = 0; i < ring.size(); i++)
+	{
+		unsigned meshlet = TestGeometry::AddMeshlet({ center, ring[i], ring[(i + 1) % ring.size()] });
+		instances.push_back(TestGeometry::MakeInstance(meshlet, 1));
+	}
+
+	// Each triangle is rasterized alone since the depth test would hide the pixels covered twice
+	SoftwareRasterizer rasterizer(width, height, 1);
+	std::vector<unsigned> coverage(width * height, 0);
+	for (unsigned i = 0; i < instances.size(); i++)
+	{
+		rasterizer.Rasterize({ { i, instances[i].meshletIndex } }, instances, MakeNDCCamera());
+		auto depth = rasterizer.GetDepth();
+		for (unsigned pixel = 0; pixel < depth.size(); pixel++)
+			coverage[pixel] += depth[pixel] != 1.0f;
+	}
+
+	// Pixels strictly inside the polygon are covered once, the ones outside never
+	auto edgeDistance = [&](float px, float py, unsigned i)
+	{
+		glm::vec3 a = ring[i];
+		glm::vec3 b = ring[(i + 1) % ring.size()];
+		glm::vec2 screenA((a.x * 0.5f + 0.5f) * width, (0.5f - a.y * 0.5f) * height);
+		glm::vec2 screenB((b.x * 0.5f + 0.5f) * width, (0.5f - b.y * 0.5f) * height);
+		glm::vec2 edge = screenB - screenA;
+		return ((px - screenA.x) * edge.y - (py - screenA.y) * edge.x) / glm::length(edge);
+	};
+
+	unsigned coveredCount = 0;
+	for (unsigned y = 0; y < height; y++)
+	{
+		for (unsigned x = 0; x < width; x++)
+		{
+			float minDistance = FLT_MAX;
+			for (unsigned i = 0; i < ring.size(); i++)
+				minDistance = std::min(minDistance, -edgeDistance(x + 0.5f, y + 0.5f, i));
+
+			unsigned count = coverage[y * width + x];
+			CHECK(count <= 1);
+			if (minDistance > 0.01f)
+				CHECK(count == 1);
+			if (minDistance < -0.01f)
+				CHECK(count == 0);
+			coveredCount += count;
+		}
+	}
+	CHECK(coveredCount > width * height / 2);
+}
+
+// The tiles are rasterized in parallel, the output must not depend on the number of threads
+TEST(SoftwareRasterizer, ThreadCountDoesNotChangeOutput)
+{
+	TestGeometry geometry;
+
+	TestRandom generator(42);
+	auto random = [&]() { return generator.NextFloat(); };
+
+	std::vector<Scene::InstanceData> instances;
+	for (unsigned i = 0; i < 64; i++)
+	{
+		std::vector<glm::vec3> positions;
+		for (unsigned j = 0; j < 3 * 16; j++)
+			positions.push_back(glm::vec3(random() * 2.4f - 1.2f, random() * 2.4f - 1.2f, random()));
+		unsigned meshlet = TestGeometry::AddMeshlet(positions);
+		instances.push_back(TestGeometry::MakeInstance(meshlet, 1, glm::vec3(0, 0, random() * 0.1f)));
+	}
+	auto visibleMeshlets = SoftwareRasterizer::GatherAllMeshlets(instances);
+
+	SoftwareRasterizer singleThreaded(200, 150, 1);
+	SoftwareRasterizer multiThreaded(200, 150, 8);
+	singleThreaded.Rasterize(visibleMeshlets, instances, MakeNDCCamera());
+	multiThreaded.Rasterize(visibleMeshlets, instances, MakeNDCCamera());
+	CHECK(singleThreaded.GetVisibility() == multiThreaded.GetVisibility());
+	CHECK(singleThreaded.GetDepth() == multiThreaded.GetDepth());
+
+	unsigned coveredCount = 0;
+	for (float depth : singleThreaded.GetDepth())
+		coveredCount += depth != 1.0f;
+	CHECK(coveredCount > 0);
+}
+
+// A triangle going behind the camera is clipped at the near plane, the visible part is still rasterized
+TEST(SoftwareRasterizer, NearPlaneClipping)
+{
+	TestGeometry geometry;
+	const float nearPlane = 1.0f;
+	unsigned meshlet = TestGeometry::AddMeshlet({ { -1.0f, -1.0f, -5.0f }, { -1.0f, 1.0f, 10.0f }, { 1.0f, -1.0f, 10.0f } });
+	std::vector<Scene::InstanceData> instances = { TestGeometry::MakeInstance(meshlet, 1) };
+
+	SoftwareRasterizer rasterizer(64, 64, 1);
+	rasterizer.Rasterize(SoftwareRasterizer::GatherAllMeshlets(instances), instances, MakePerspectiveCamera(nearPlane, 100.0f));
+
+	unsigned coveredCount = 0;
+	for (float depth : rasterizer.GetDepth())
+	{
+		CHECK(depth >= 0.0f && depth <= 1.0f);
+		coveredCount += depth != 1.0f;
+	}
+	CHECK(coveredCount > 0);
+
+	// The near plane cuts the triangle along x + y = -1.2 in NDC, the bottom left corner is behind it
+	auto depth = rasterizer.GetDepth();
+	CHECK(depth[48 * 64 + 16] != 1.0f);
+	CHECK(depth[63 * 64] == 1.0f);
+}
@@ -0,0 +1,52 @@
+#include "Test.hpp"
+#include <cstring>
+
+unsigned Test::failedCheckCount = 0;
+
+std::vector<Test::Case>& Test::GetCases()
+{
+	// Function local so that the registration order of the translation units doesn't matter
+	static std::vector<Case> cases;
+	return cases;
+}
+
+bool Test::Register(const char* suite, const char* name, Function function)
+{
+	GetCases().push_back({ suite, name, function });
+	return true;
+}
+
+void Test::Fail(const char* file, int line, const char* expression)
+{
+	printf("%s(%d): check failed: %s\n", file, line, expression);
+	failedCheckCount++;
+}
+
+unsigned Test::Run(const char* suite)
+{
+	unsigned runCount = 0;
+	unsigned failedCount = 0;
+	for (const auto& testCase : GetCases())
+	{
+		if (suite != nullptr && strcmp(suite, testCase.suite) != 0)
+			continue;
+
+		unsigned previousFailedCheckCount = failedCheckCount;
+		testCase.function();
+		bool failed = failedCheckCount != previousFailedCheckCount;
+		printf("[%s] %s.%s\n", failed ? "FAILED" : "OK", testCase.suite, testCase.name);
+
+		runCount++;
+		if (failed)
+			failedCount++;
+	}
+
+	if (runCount == 0)
+	{
+		printf("No test in suite %s\n", suite != nullptr ? suite : "(all suites)");
+		return 1;
+	}
+
+	printf("%u/%u tests passed\n", runCount - failedCount, runCount);
+	return failedCount;
+}
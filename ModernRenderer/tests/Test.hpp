@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Minimal unit test registry. Tests register themselves at startup with the TEST macro and a failed CHECK reports
+// the expression and keeps running the test, so one run lists every broken check.
+class Test
+{
+public:
+	using Function = void(*)();
+
+	struct Case
+	{
+		const char* suite;
+		const char* name;
+		Function function;
+	};
+
+private:
+	static unsigned failedCheckCount;
+
+	static std::vector<Case>& GetCases();
+
+public:
+	static bool Register(const char* suite, const char* name, Function function);
+	static void Fail(const char* file, int line, const char* expression);
+
+	// Runs the tests of a suite, or every test when suite is null. Returns the number of failed tests.
+	static unsigned Run(const char* suite);
+};
+
+// SplitMix64, so that the random inputs of the tests are the same with every standard library
+class TestRandom
+{
+private:
+	uint64_t state;
+
+public:
+	TestRandom(uint64_t seed) : state(seed) {}
+
+	uint64_t Next()
+	{
+		uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	// In [0, 1)
+	float NextFloat() { return (float)(Next() >> 40) / (float)(1 << 24); }
+	// In [0, count)
+	uint32_t NextIndex(uint32_t count) { return (uint32_t)(Next() % count); }
+};
+
+#define TEST(suite, name) \
+	static void suite##_##name(); \
+	static const bool suite##_##name##_registered = Test::Register(#suite, #name, suite##_##name); \
+	static void suite##_##name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) Test::Fail(__FILE__, __LINE__, #expression); } while (false)
@@ -0,0 +1,142 @@
+#include "Test.hpp"
+#include "TransientResourcePlanner.hpp"
+#include <algorithm>
+
+using Request = TransientResourcePlanner::Request;
+
+// Every request is aligned, inside the heap and doesn't share memory with a request alive at the same time
+static bool IsValid(const std::vector<Request>& requests, const TransientResourcePlanner::Plan& plan)
+{
+	if (plan.offsets.size() != requests.size())
+		return false;
+
+	uint64_t end = 0;
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		if (plan.offsets[i] % std::max<uint64_t>(requests[i].alignment, 1) != 0)
+			return false;
+		end = std::max(end, plan.offsets[i] + requests[i].size);
+
+		for (size_t j = i + 1; j < requests.size(); j++)
+		{
+			if (!TransientResourcePlanner::LifetimesOverlap(requests[i], requests[j]) || requests[i].size == 0 || requests[j].size == 0)
+				continue;
+			if (plan.offsets[i] < plan.offsets[j] + requests[j].size && plan.offsets[j] < plan.offsets[i] + requests[i].size)
+				return false;
+		}
+	}
+	return plan.heapSize == end;
+}
+
+TEST(TransientResourcePlanner, DisjointLifetimesShareMemory)
+{
+	std::vector<Request> requests =
+	{
+		{ 1000, 1, 0, 1 },
+		{ 1000, 1, 2, 3 },
+		{ 600, 1, 4, 4 },
+	};
+
+	auto plan = TransientResourcePlanner::Pack(requests);
+	CHECK(IsValid(requests, plan));
+	CHECK((plan.offsets == std::vector<uint64_t>{ 0, 0, 0 }));
+	CHECK(plan.heapSize == 1000);
+	CHECK(plan.unaliasedSize == 2600);
+	CHECK(plan.GetSavedBytes() == 1600);
+}
+
+TEST(TransientResourcePlanner, OverlappingLifetimesDontAlias)
+{
+	// Lifetimes are inclusive, requests sharing a single pass overlap
+	std::vector<Request> requests =
+	{
+		{ 1000, 1, 0, 2 },
+		{ 1000, 1, 2, 3 },
+		{ 500, 1, 1, 2 },
+	};
+
+	auto plan = TransientResourcePlanner::Pack(requests);
+	CHECK(IsValid(requests, plan));
+	CHECK(plan.heapSize == 2500);
+	CHECK(plan.GetSavedBytes() == 0);
+
+	// The third request now fits in the memory of the second one, which isn't alive yet
+	requests[2].lastPass = 1;
+	plan = TransientResourcePlanner::Pack(requests);
+	CHECK(IsValid(requests, plan));
+	CHECK((plan.offsets == std::vector<uint64_t>{ 0, 1000, 1000 }));
+	CHECK(plan.heapSize == 2000);
+}
+
+TEST(TransientResourcePlanner, AlignmentIsRespected)
+{
+	std::vector<Request> requests =
+	{
+		{ 100, 1, 0, 1 },
+		{ 64, 256, 0, 1 },
+		{ 10, 64, 1, 1 },
+	};
+
+	auto plan = TransientResourcePlanner::Pack(requests);
+	CHECK(IsValid(requests, plan));
+	CHECK((plan.offsets == std::vector<uint64_t>{ 0, 256, 128 }));
+	CHECK(plan.heapSize == 320);
+	// Each request is aligned after the previous one when nothing aliases
+	CHECK(plan.unaliasedSize == 256 + 64 + 10);
+
+	CHECK(TransientResourcePlanner::AlignUp(0, 256) == 0);
+	CHECK(TransientResourcePlanner::AlignUp(1, 256) == 256);
+	CHECK(TransientResourcePlanner::AlignUp(256, 256) == 256);
+	CHECK(TransientResourcePlanner::AlignUp(7, 0) == 7);
+}
+
+TEST(TransientResourcePlanner, NeverLargerThanUnaliased)
+{
+	// Placed first, the largest request pushes the aligned one after it
+	std::vector<Request> requests =
+	{
+		{ 21230, 4096, 14, 23 },
+		{ 975979, 1, 8, 15 },
+	};
+
+	auto plan = TransientResourcePlanner::Pack(requests);
+	CHECK(IsValid(requests, plan));
+	CHECK((plan.offsets == std::vector<uint64_t>{ 0, 21230 }));
+	CHECK(plan.heapSize == 997209);
+	CHECK(plan.GetSavedBytes() == 0);
+}
+
+TEST(TransientResourcePlanner, RandomRequests)
+{
+	static constexpr unsigned passCount = 24;
+	static constexpr uint64_t alignments[] = { 1, 256, 4096, 65536 };
+
+	TestRandom random(7);
+	for (unsigned iteration = 0; iteration < 200; iteration++)
+	{
+		std::vector<Request> requests(1 + random.NextIndex(40));
+		for (auto& request : requests)
+		{
+			request.size = random.NextIndex(8) == 0 ? 0 : 1 + random.NextIndex(1 << 20);
+			request.alignment = alignments[random.NextIndex(4)];
+			request.firstPass = random.NextIndex(passCount);
+			request.lastPass = request.firstPass + random.NextIndex(passCount - request.firstPass);
+		}
+
+		auto plan = TransientResourcePlanner::Pack(requests);
+		CHECK(IsValid(requests, plan));
+		CHECK(plan.heapSize <= plan.unaliasedSize);
+
+		// The heap holds at least the requests alive during the busiest pass
+		uint64_t busiestPass = 0;
+		for (unsigned pass = 0; pass < passCount; pass++)
+		{
+			uint64_t aliveSize = 0;
+			for (const auto& request : requests)
+				if (request.firstPass <= pass && pass <= request.lastPass)
+					aliveSize += request.size;
+			busiestPass = std::max(busiestPass, aliveSize);
+		}
+		CHECK(plan.heapSize >= busiestPass);
+	}
+}
@@ -0,0 +1,93 @@
+#include "Test.hpp"
+#include "VisibilityBuffer.hpp"
+#include <cfloat>
+
+using namespace VisibilityBuffer;
+
+static bool RoundTrip(uint32_t visibleMeshletID, uint32_t triangleID)
+{
+	uint32_t meshlet = UINT32_MAX, triangle = UINT32_MAX;
+	DecodeVisibility(EncodeVisibility(visibleMeshletID, triangleID), meshlet, triangle);
+	return meshlet == visibleMeshletID && triangle == triangleID;
+}
+
+static bool RoundTrip64(uint32_t instanceID, uint32_t visibleMeshletID, uint32_t triangleID)
+{
+	uint32_t instance = UINT32_MAX, meshlet = UINT32_MAX, triangle = UINT32_MAX;
+	DecodeVisibility64(EncodeVisibility64(instanceID, visibleMeshletID, triangleID), instance, meshlet, triangle);
+	return instance == instanceID && meshlet == visibleMeshletID && triangle == triangleID;
+}
+
+TEST(VisibilityBuffer, Boundaries)
+{
+	const uint32_t meshlets[] = { 0, 1, meshletMask - 1, meshletMask };
+	const uint32_t triangles[] = { 0, 1, triangleMask - 1, triangleMask };
+	for (uint32_t m : meshlets)
+		for (uint32_t t : triangles)
+			CHECK(RoundTrip(m, t));
+
+	// Values past the field widths are cut and don't leak into the other field
+	uint32_t meshlet = 0, triangle = 0;
+	DecodeVisibility(EncodeVisibility(meshletMask + 1, triangleMask + 1), meshlet, triangle);
+	CHECK(meshlet == 0 && triangle == 0);
+	// The cleared visibility texture decodes to the first triangle of the first meshlet
+	CHECK(EncodeVisibility(0, 0) == 0);
+}
+
+TEST(VisibilityBuffer, Boundaries64)
+{
+	const uint32_t meshlets[] = { 0, 1, meshletMask, meshletMask + 1, UINT32_MAX - 1, UINT32_MAX };
+	const uint32_t triangles[] = { 0, 1, triangleMask, triangleMask + 1, triangleMask64 - 1, triangleMask64 };
+	const uint32_t instances[] = { 0, 1, instanceMask64 - 1, instanceMask64 };
+	for (uint32_t i : instances)
+		for (uint32_t m : meshlets)
+			for (uint32_t t : triangles)
+				CHECK(RoundTrip64(i, m, t));
+
+	uint32_t instance = 0, meshlet = 0, triangle = 0;
+	DecodeVisibility64(EncodeVisibility64(instanceMask64 + 1, 0, triangleMask64 + 1), instance, meshlet, triangle);
+	CHECK(instance == 0 && meshlet == 0 && triangle == 0);
+	// The meshlet is in the x channel
+	CHECK((uint32_t)EncodeVisibility64(5, 0x12345678, 3) == 0x12345678);
+}
+
+TEST(VisibilityBuffer, RandomRoundTrips)
+{
+	TestRandom random(29);
+	for (unsigned i = 0; i < 100000; i++)
+	{
+		uint32_t value = (uint32_t)random.Next();
+		CHECK(RoundTrip(value & meshletMask, (value >> 7) & triangleMask));
+
+		uint64_t bits = random.Next();
+		CHECK(RoundTrip64((uint32_t)bits & instanceMask64, (uint32_t)(bits >> 32), (uint32_t)(bits >> 8) & triangleMask64));
+	}
+}
+
+TEST(VisibilityBuffer, PackedDepthOrdering)
+{
+	// The atomic min keeps the closest surface, visibility only breaks depth ties
+	CHECK(PackDepthVisibility(0.25f, UINT32_MAX) < PackDepthVisibility(0.5f, 0));
+	CHECK(PackDepthVisibility(0.0f, UINT32_MAX) < PackDepthVisibility(FLT_MIN, 0));
+	CHECK(PackDepthVisibility(1.0f, 3) < PackDepthVisibility(1.0f, 4));
+
+	TestRandom random(30);
+	for (unsigned i = 0; i < 100000; i++)
+	{
+		float a = random.NextFloat();
+		float b = random.NextFloat();
+		uint32_t visibilityA = (uint32_t)random.Next();
+		uint32_t visibilityB = (uint32_t)random.Next();
+		uint64_t packedA = PackDepthVisibility(a, visibilityA);
+		uint64_t packedB = PackDepthVisibility(b, visibilityB);
+		if (a != b)
+			CHECK((a < b) == (packedA < packedB));
+		else
+			CHECK((visibilityA < visibilityB) == (packedA < packedB));
+
+		float depth = 0;
+		uint32_t visibility = 0;
+		UnpackDepthVisibility(packedA, depth, visibility);
+		CHECK(depth == a && visibility == visibilityA);
+	}
+}
@@ -0,0 +1,7 @@
+#include "Test.hpp"
+
+// Usage: ModernRendererTests [suite], runs every suite by default
+int main(int argc, char** argv)
+{
+	return Test::Run(argc > 1 ? argv[1] : nullptr) == 0 ? 0 : 1;
+}